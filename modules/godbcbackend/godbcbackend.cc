@@ -67,6 +67,7 @@ public:
     declare(suffix, "username", "User to connect as", "powerdns");
     declare(suffix, "password", "Password to connect with", "");
     declare(suffix, "dnssec", "Enable DNSSEC processing", "no");
+    declare(suffix, "bulk-insert-rows", "Number of records inserted per query when loading a zone, 0 to insert them one by one", "100");
 
     string record_query = "SELECT content,ttl,prio,type,domain_id,disabled,name,auth FROM records WHERE";
 
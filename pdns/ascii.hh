@@ -20,6 +20,13 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 #pragma once
+#include <cstddef>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
 
 inline bool dns_isspace(char c)
 {
@@ -39,3 +46,88 @@ inline unsigned char dns_tolower(unsigned char c)
     c+='a'-'A';
   return c;
 }
+
+/* The functions below work on whole buffers, like the labels of a name or a packet used as a cache key.
+   They handle 16 bytes at once using SSE2 (always available on x86_64) or NEON (aarch64), and the
+   remaining bytes one at a time.
+*/
+
+#if defined(__SSE2__)
+inline __m128i dns_tolower16(__m128i v)
+{
+  /* signed comparisons, but bytes >= 0x80 are negative so they are never seen as uppercase */
+  const __m128i isUpper = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('A' - 1)), _mm_cmplt_epi8(v, _mm_set1_epi8('Z' + 1)));
+  return _mm_or_si128(v, _mm_and_si128(isUpper, _mm_set1_epi8(0x20)));
+}
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+inline uint8x16_t dns_tolower16(uint8x16_t v)
+{
+  const uint8x16_t isUpper = vandq_u8(vcgeq_u8(v, vdupq_n_u8('A')), vcleq_u8(v, vdupq_n_u8('Z')));
+  return vorrq_u8(v, vandq_u8(isUpper, vdupq_n_u8(0x20)));
+}
+#endif
+
+//! Writes the lowercase version of the len bytes at src to dst, which can be the same as src
+inline void dns_tolower_buffer(unsigned char* dst, const unsigned char* src, size_t len)
+{
+  size_t pos = 0;
+#if defined(__SSE2__)
+  for (; pos + 16 <= len; pos += 16) {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + pos), dns_tolower16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + pos))));
+  }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  for (; pos + 16 <= len; pos += 16) {
+    vst1q_u8(dst + pos, dns_tolower16(vld1q_u8(src + pos)));
+  }
+#endif
+  for (; pos < len; ++pos) {
+    dst[pos] = dns_tolower(src[pos]);
+  }
+}
+
+//! Returns the position of the first byte that differs between a and b, ignoring case, or len if they are the same
+inline size_t dns_mismatch_ci(const unsigned char* a, const unsigned char* b, size_t len)
+{
+  size_t pos = 0;
+#if defined(__SSE2__)
+  for (; pos + 16 <= len; pos += 16) {
+    const __m128i va = dns_tolower16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + pos)));
+    const __m128i vb = dns_tolower16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(b + pos)));
+    const unsigned int differ = _mm_movemask_epi8(_mm_cmpeq_epi8(va, vb)) ^ 0xffff;
+    if (differ != 0) {
+      return pos + __builtin_ctz(differ);
+    }
+  }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  for (; pos + 16 <= len; pos += 16) {
+    const uint8x16_t same = vceqq_u8(dns_tolower16(vld1q_u8(a + pos)), dns_tolower16(vld1q_u8(b + pos)));
+    if (vminvq_u8(same) != 0xff) {
+      /* the byte by byte loop below finds out where */
+      break;
+    }
+  }
+#endif
+  for (; pos < len; ++pos) {
+    if (dns_tolower(a[pos]) != dns_tolower(b[pos])) {
+      return pos;
+    }
+  }
+  return len;
+}
+
+//! Case-insensitive equality of two buffers of len bytes
+inline bool dns_equal_ci(const unsigned char* a, const unsigned char* b, size_t len)
+{
+  return dns_mismatch_ci(a, b, len) == len;
+}
+
+//! Case-insensitive lexicographical comparison of two buffers, returning a value lower than, equal to or greater than 0 like memcmp()
+inline int dns_compare_ci(const unsigned char* a, size_t alen, const unsigned char* b, size_t blen)
+{
+  const size_t len = alen < blen ? alen : blen;
+  const size_t pos = dns_mismatch_ci(a, b, len);
+  if (pos < len) {
+    return dns_tolower(a[pos]) < dns_tolower(b[pos]) ? -1 : 1;
+  }
+  return alen < blen ? -1 : (alen > blen ? 1 : 0);
+}
@@ -21,7 +21,9 @@
  */
 
 #include "auth-caches.hh"
+#include "auth-denialcache.hh"
 #include "auth-querycache.hh"
+#include "auth-nsec3cache.hh"
 #include "auth-packetcache.hh"
 
 extern AuthPacketCache PC;
@@ -33,6 +35,8 @@ uint64_t purgeAuthCaches()
   uint64_t ret = 0;
   ret += PC.purge();
   ret += QC.purge();
+  ret += g_nsec3Cache.purge();
+  ret += g_denialCache.purge();
   return ret;
 }
 
@@ -42,6 +46,8 @@ uint64_t purgeAuthCaches(const std::string& match)
   uint64_t ret = 0;
   ret += PC.purge(match);
   ret += QC.purge(match);
+  ret += g_nsec3Cache.purge(match);
+  ret += g_denialCache.purge(match);
   return ret;
 }
 
@@ -51,6 +57,8 @@ uint64_t purgeAuthCachesExact(const DNSName& qname)
   uint64_t ret = 0;
   ret += PC.purgeExact(qname);
   ret += QC.purgeExact(qname);
+  ret += g_nsec3Cache.purgeExact(qname);
+  ret += g_denialCache.purgeExact(qname);
   return ret;
 }
 
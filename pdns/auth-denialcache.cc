@@ -0,0 +1,232 @@
+/*
+ * This file is part of PowerDNS or dnsdist.
+ * Copyright -- PowerDNS.COM B.V. and its contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of version 2 of the GNU General Public License as
+ * published by the Free Software Foundation.
+ *
+ * In addition, for the avoidance of any doubt, permission is granted to
+ * link this program with OpenSSL and to (re)distribute the binaries
+ * produced as the result of such linking.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <boost/algorithm/string/predicate.hpp>
+
+#include "auth-denialcache.hh"
+#include "logger.hh"
+#include "statbag.hh"
+extern StatBag S;
+
+const unsigned int AuthDenialCache::s_cleaninterval;
+
+AuthDenialCache::AuthDenialCache(size_t mapsCount) :
+  d_maps(mapsCount)
+{
+  S.declare("denial-cache-hit", "Number of hits on the denial cache");
+  S.declare("denial-cache-miss", "Number of misses on the denial cache");
+  S.declare("denial-cache-size", "Number of entries in the denial cache", StatType::gauge);
+
+  d_statnumhit = S.getPointer("denial-cache-hit");
+  d_statnummiss = S.getPointer("denial-cache-miss");
+  d_statnumentries = S.getPointer("denial-cache-size");
+}
+
+AuthDenialCache::~AuthDenialCache()
+{
+  try {
+    vector<WriteLock> locks;
+    for (auto& mc : d_maps) {
+      locks.push_back(WriteLock(mc.d_mut));
+    }
+    locks.clear();
+  }
+  catch (...) {
+  }
+}
+
+bool AuthDenialCache::getGap(int zoneId, const DNSName& qname, DNSName& before, DNSName& after)
+{
+  if (!enabled()) {
+    return false;
+  }
+
+  cleanupIfNeeded();
+
+  time_t now = time(nullptr);
+  auto& mc = getMap(zoneId);
+  TryReadLock rl(&mc.d_mut);
+  if (!rl.gotIt()) {
+    return false;
+  }
+
+  auto it = mc.d_map.find(zoneId);
+  if (it == mc.d_map.end() || it->second.d_ttd < now || it->second.d_gaps.empty() || !qname.isPartOf(it->second.d_zone)) {
+    (*d_statnummiss)++;
+    return false;
+  }
+
+  /* the gap starting with the largest name lower than the one we are looking for */
+  const auto& gaps = it->second.d_gaps;
+  auto gap = gaps.lower_bound(qname);
+  if (gap == gaps.begin()) {
+    (*d_statnummiss)++;
+    return false;
+  }
+  --gap;
+
+  bool covered;
+  if (gap->first.canonCompare(gap->second)) {
+    covered = qname.canonCompare(gap->second);
+  }
+  else {
+    /* last gap of the zone, 'after' is the apex */
+    covered = true;
+  }
+  /* empty non-terminals have no ordername in NSEC zones, so a gap can span them: a name with
+     the next one below it exists */
+  covered = covered && !gap->second.isPartOf(qname);
+
+  if (!covered) {
+    (*d_statnummiss)++;
+    return false;
+  }
+
+  before = gap->first;
+  after = gap->second;
+  (*d_statnumhit)++;
+  return true;
+}
+
+void AuthDenialCache::insertGap(int zoneId, const DNSName& zone, const DNSName& before, const DNSName& after)
+{
+  if (!enabled() || before.empty() || after.empty()) {
+    return;
+  }
+
+  time_t now = time(nullptr);
+  auto& mc = getMap(zoneId);
+  TryWriteLock wl(&mc.d_mut);
+  if (!wl.gotIt()) {
+    return;
+  }
+
+  auto& entry = mc.d_map[zoneId];
+  if (entry.d_ttd < now || entry.d_zone != zone || (d_maxEntries > 0 && *d_statnumentries >= d_maxEntries)) {
+    *d_statnumentries -= entry.d_gaps.size();
+    entry = ZoneEntry();
+    entry.d_zone = zone;
+    entry.d_ttd = now + d_ttl;
+  }
+
+  if (entry.d_gaps.emplace(before, after).second) {
+    (*d_statnumentries)++;
+  }
+}
+
+uint64_t AuthDenialCache::eraseLocked(cmap_t& map, cmap_t::iterator& it)
+{
+  uint64_t count = it->second.d_gaps.size();
+  *d_statnumentries -= count;
+  it = map.erase(it);
+  return count;
+}
+
+/* clears the entire cache. */
+uint64_t AuthDenialCache::purge()
+{
+  uint64_t delcount = 0;
+
+  for (auto& mc : d_maps) {
+    WriteLock wl(&mc.d_mut);
+    for (auto it = mc.d_map.begin(); it != mc.d_map.end();) {
+      delcount += eraseLocked(mc.d_map, it);
+    }
+  }
+
+  return delcount;
+}
+
+/* removes every zone containing qname: adding or removing a single name changes the gaps */
+uint64_t AuthDenialCache::purgeExact(const DNSName& qname)
+{
+  uint64_t delcount = 0;
+
+  for (auto& mc : d_maps) {
+    WriteLock wl(&mc.d_mut);
+    for (auto it = mc.d_map.begin(); it != mc.d_map.end();) {
+      if (qname.isPartOf(it->second.d_zone)) {
+        delcount += eraseLocked(mc.d_map, it);
+      }
+      else {
+        ++it;
+      }
+    }
+  }
+
+  return delcount;
+}
+
+/* If match ends on a $, it is treated as a suffix and all zones at or below it are removed */
+uint64_t AuthDenialCache::purge(const string& match)
+{
+  if (!boost::ends_with(match, "$")) {
+    return purgeExact(DNSName(match));
+  }
+
+  DNSName suffix(match.substr(0, match.size() - 1));
+  uint64_t delcount = 0;
+
+  for (auto& mc : d_maps) {
+    WriteLock wl(&mc.d_mut);
+    for (auto it = mc.d_map.begin(); it != mc.d_map.end();) {
+      if (it->second.d_zone.isPartOf(suffix) || suffix.isPartOf(it->second.d_zone)) {
+        delcount += eraseLocked(mc.d_map, it);
+      }
+      else {
+        ++it;
+      }
+    }
+  }
+
+  return delcount;
+}
+
+void AuthDenialCache::cleanup()
+{
+  time_t now = time(nullptr);
+  uint64_t totErased = 0;
+
+  for (auto& mc : d_maps) {
+    WriteLock wl(&mc.d_mut);
+    for (auto it = mc.d_map.begin(); it != mc.d_map.end();) {
+      if (it->second.d_ttd < now) {
+        totErased += eraseLocked(mc.d_map, it);
+      }
+      else {
+        ++it;
+      }
+    }
+  }
+
+  DLOG(g_log<<"Done with denial cache clean, cacheSize: "<<*d_statnumentries<<", totErased: "<<totErased<<endl);
+}
+
+void AuthDenialCache::cleanupIfNeeded()
+{
+  if (++d_ops % s_cleaninterval == 0) {
+    cleanup();
+  }
+}
@@ -0,0 +1,118 @@
+/*
+ * This file is part of PowerDNS or dnsdist.
+ * Copyright -- PowerDNS.COM B.V. and its contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of version 2 of the GNU General Public License as
+ * published by the Free Software Foundation.
+ *
+ * In addition, for the avoidance of any doubt, permission is granted to
+ * link this program with OpenSSL and to (re)distribute the binaries
+ * produced as the result of such linking.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#pragma once
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+#include "dnsname.hh"
+#include "lock.hh"
+#include "statbag.hh"
+#include "misc.hh"
+
+/* Per-zone cache of the gaps between the names of NSEC-ordered zones, as returned by
+   getBeforeAndAfterNames(). A name falling strictly inside a known gap does not exist in the zone,
+   so the backend does not have to be asked again for it, nor for any of the other names in
+   that gap. This is what makes a flood of random names below a node that only has a wildcard
+   (or nothing at all) cheap: after the first query, all of them land in the same gap.
+
+   Everything we know about a zone is dropped when the zone is changed (purgeAuthCaches()),
+   or when the entry is older than the TTL.
+*/
+class AuthDenialCache : public boost::noncopyable
+{
+public:
+  AuthDenialCache(size_t mapsCount = 128);
+  ~AuthDenialCache();
+
+  //! returns true and sets before and after if qname is known to lie strictly between two names of the zone, and is not an empty non-terminal
+  bool getGap(int zoneId, const DNSName& qname, DNSName& before, DNSName& after);
+  bool isAbsent(int zoneId, const DNSName& qname)
+  {
+    DNSName before, after;
+    return getGap(zoneId, qname, before, after);
+  }
+  void insertGap(int zoneId, const DNSName& zone, const DNSName& before, const DNSName& after);
+
+  size_t size() { return *d_statnumentries; } //!< number of entries in the cache
+  void cleanup(); //!< remove zones whose entries have expired
+  uint64_t purge();
+  uint64_t purge(const std::string& match); // could be $ terminated. Is not a dnsname!
+  uint64_t purgeExact(const DNSName& qname); // removes the zone qname is part of
+
+  void setTTL(uint32_t ttl)
+  {
+    d_ttl = ttl;
+  }
+
+  bool enabled() const
+  {
+    return d_ttl > 0;
+  }
+
+  void setMaxEntries(uint64_t maxEntries)
+  {
+    d_maxEntries = maxEntries;
+  }
+
+private:
+  struct ZoneEntry
+  {
+    DNSName d_zone;
+    /* keyed by the name starting the gap, in canonical order */
+    std::map<DNSName, DNSName, CanonDNSNameCompare> d_gaps;
+    time_t d_ttd{0};
+  };
+
+  typedef std::unordered_map<int, ZoneEntry> cmap_t;
+
+  struct MapCombo
+  {
+    MapCombo() {}
+    ~MapCombo() {}
+    MapCombo(const MapCombo&) = delete;
+    MapCombo& operator=(const MapCombo&) = delete;
+
+    ReadWriteLock d_mut;
+    cmap_t d_map;
+  };
+
+  vector<MapCombo> d_maps;
+  MapCombo& getMap(int zoneId)
+  {
+    return d_maps[static_cast<unsigned int>(zoneId) % d_maps.size()];
+  }
+
+  uint64_t eraseLocked(cmap_t& map, cmap_t::iterator& it);
+  void cleanupIfNeeded();
+
+  AtomicCounter d_ops{0};
+  StatCounter* d_statnumhit;
+  StatCounter* d_statnummiss;
+  StatCounter* d_statnumentries;
+
+  uint64_t d_maxEntries{0};
+  uint32_t d_ttl{0};
+  static const unsigned int s_cleaninterval = 4096;
+};
+
+extern AuthDenialCache g_denialCache;
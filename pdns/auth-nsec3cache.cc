@@ -0,0 +1,393 @@
+/*
+ * This file is part of PowerDNS or dnsdist.
+ * Copyright -- PowerDNS.COM B.V. and its contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of version 2 of the GNU General Public License as
+ * published by the Free Software Foundation.
+ *
+ * In addition, for the avoidance of any doubt, permission is granted to
+ * link this program with OpenSSL and to (re)distribute the binaries
+ * produced as the result of such linking.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <boost/algorithm/string/predicate.hpp>
+
+#include "auth-nsec3cache.hh"
+#include "dnsrecords.hh"
+#include "dnssecinfra.hh"
+#include "logger.hh"
+#include "statbag.hh"
+extern StatBag S;
+
+const unsigned int AuthNSEC3Cache::s_cleaninterval;
+
+AuthNSEC3Cache::AuthNSEC3Cache(size_t mapsCount) :
+  d_maps(mapsCount)
+{
+  S.declare("nsec3-cache-hit", "Number of hits on the NSEC3 cache");
+  S.declare("nsec3-cache-miss", "Number of misses on the NSEC3 cache");
+  S.declare("nsec3-cache-size", "Number of entries in the NSEC3 cache", StatType::gauge);
+
+  d_statnumhit = S.getPointer("nsec3-cache-hit");
+  d_statnummiss = S.getPointer("nsec3-cache-miss");
+  d_statnumentries = S.getPointer("nsec3-cache-size");
+}
+
+AuthNSEC3Cache::~AuthNSEC3Cache()
+{
+  try {
+    vector<WriteLock> locks;
+    for (auto& mc : d_maps) {
+      locks.push_back(WriteLock(mc.d_mut));
+    }
+    locks.clear();
+  }
+  catch (...) {
+  }
+}
+
+bool AuthNSEC3Cache::isValid(const ZoneEntry& entry, const NSEC3PARAMRecordContent& ns3prc, time_t now)
+{
+  return entry.d_ttd >= now && entry.d_iterations == ns3prc.d_iterations && entry.d_salt == ns3prc.d_salt;
+}
+
+AuthNSEC3Cache::ZoneEntry& AuthNSEC3Cache::getValidEntryLocked(cmap_t& map, int zoneId, const DNSName& zone, const NSEC3PARAMRecordContent& ns3prc, time_t now)
+{
+  auto& entry = map[zoneId];
+  if (!isValid(entry, ns3prc, now) || entry.d_zone != zone) {
+    *d_statnumentries -= entry.size();
+    entry = ZoneEntry();
+    entry.d_zone = zone;
+    entry.d_salt = ns3prc.d_salt;
+    entry.d_iterations = ns3prc.d_iterations;
+    entry.d_ttd = now + d_ttl;
+  }
+  else if (d_maxEntriesPerZone > 0 && entry.size() >= d_maxEntriesPerZone) {
+    /* only this zone is over its limit, leave the other ones alone. Hashes and authority
+       information are cheap to get again, the ranges cost a backend query each */
+    *d_statnumentries -= entry.d_hashes.size() + entry.d_auth.size();
+    entry.d_hashes.clear();
+    entry.d_auth.clear();
+    if (entry.d_ranges.size() >= d_maxEntriesPerZone) {
+      *d_statnumentries -= entry.d_ranges.size();
+      entry.d_ranges.clear();
+    }
+  }
+  return entry;
+}
+
+std::string AuthNSEC3Cache::getHash(int zoneId, const DNSName& zone, const NSEC3PARAMRecordContent& ns3prc, const DNSName& qname)
+{
+  if (!enabled()) {
+    return hashQNameWithSalt(ns3prc, qname);
+  }
+
+  cleanupIfNeeded();
+
+  time_t now = time(nullptr);
+  auto& mc = getMap(zoneId);
+  {
+    TryReadLock rl(&mc.d_mut);
+    if (rl.gotIt()) {
+      auto it = mc.d_map.find(zoneId);
+      if (it != mc.d_map.end() && isValid(it->second, ns3prc, now)) {
+        auto hash = it->second.d_hashes.find(qname);
+        if (hash != it->second.d_hashes.end()) {
+          (*d_statnumhit)++;
+          return hash->second;
+        }
+      }
+    }
+  }
+
+  (*d_statnummiss)++;
+  std::string hashed = hashQNameWithSalt(ns3prc, qname);
+
+  TryWriteLock wl(&mc.d_mut);
+  if (!wl.gotIt()) {
+    return hashed;
+  }
+
+  auto& entry = getValidEntryLocked(mc.d_map, zoneId, zone, ns3prc, now);
+  if (entry.d_hashes.emplace(qname, hashed).second) {
+    (*d_statnumentries)++;
+  }
+
+  return hashed;
+}
+
+bool AuthNSEC3Cache::getRange(int zoneId, const NSEC3PARAMRecordContent& ns3prc, const std::string& hashed, bool exact, DNSName& unhashed, std::string& before, std::string& after)
+{
+  if (!enabled()) {
+    return false;
+  }
+
+  cleanupIfNeeded();
+
+  time_t now = time(nullptr);
+  auto& mc = getMap(zoneId);
+  TryReadLock rl(&mc.d_mut);
+  if (!rl.gotIt()) {
+    return false;
+  }
+
+  auto it = mc.d_map.find(zoneId);
+  if (it == mc.d_map.end() || !isValid(it->second, ns3prc, now) || it->second.d_ranges.empty()) {
+    (*d_statnummiss)++;
+    return false;
+  }
+
+  const auto& ranges = it->second.d_ranges;
+  if (exact) {
+    auto range = ranges.find(hashed);
+    if (range == ranges.end()) {
+      (*d_statnummiss)++;
+      return false;
+    }
+    before = hashed;
+    after = range->second.after;
+    (*d_statnumhit)++;
+    return true;
+  }
+
+  /* the range starting with the largest hash lower than or equal to the one we are looking for,
+     or the last one (wrapping around to the start of the chain) if there is none */
+  auto range = ranges.upper_bound(hashed);
+  if (range == ranges.begin()) {
+    range = std::prev(ranges.end());
+  }
+  else {
+    --range;
+  }
+
+  bool covered;
+  if (range->first < range->second.after) {
+    covered = range->first <= hashed && hashed < range->second.after;
+  }
+  else {
+    /* last range of the chain, wrapping around */
+    covered = range->first <= hashed || hashed < range->second.after;
+  }
+
+  if (!covered) {
+    (*d_statnummiss)++;
+    return false;
+  }
+
+  before = range->first;
+  after = range->second.after;
+  unhashed = range->second.unhashed;
+  (*d_statnumhit)++;
+  return true;
+}
+
+bool AuthNSEC3Cache::isAbsent(int zoneId, const NSEC3PARAMRecordContent& ns3prc, const DNSName& qname)
+{
+  if (!enabled()) {
+    return false;
+  }
+
+  std::string hashed;
+  {
+    time_t now = time(nullptr);
+    auto& mc = getMap(zoneId);
+    TryReadLock rl(&mc.d_mut);
+    if (!rl.gotIt()) {
+      return false;
+    }
+
+    auto it = mc.d_map.find(zoneId);
+    if (it == mc.d_map.end() || !isValid(it->second, ns3prc, now) || it->second.d_ranges.empty()) {
+      (*d_statnummiss)++;
+      return false;
+    }
+
+    auto hash = it->second.d_hashes.find(qname);
+    if (hash != it->second.d_hashes.end()) {
+      hashed = hash->second;
+    }
+  }
+
+  if (hashed.empty()) {
+    hashed = hashQNameWithSalt(ns3prc, qname);
+  }
+
+  DNSName unhashed;
+  std::string before, after;
+  return getRange(zoneId, ns3prc, hashed, false, unhashed, before, after) && before != hashed;
+}
+
+void AuthNSEC3Cache::insertRange(int zoneId, const DNSName& zone, const NSEC3PARAMRecordContent& ns3prc, const std::string& before, const std::string& after, const DNSName& unhashed)
+{
+  if (!enabled() || before.empty() || after.empty()) {
+    return;
+  }
+
+  time_t now = time(nullptr);
+  auto& mc = getMap(zoneId);
+  TryWriteLock wl(&mc.d_mut);
+  if (!wl.gotIt()) {
+    return;
+  }
+
+  auto& entry = getValidEntryLocked(mc.d_map, zoneId, zone, ns3prc, now);
+  if (entry.d_ranges.emplace(before, Range{after, unhashed}).second) {
+    (*d_statnumentries)++;
+  }
+}
+
+bool AuthNSEC3Cache::getAuth(int zoneId, const NSEC3PARAMRecordContent& ns3prc, const DNSName& qname, bool& auth)
+{
+  if (!enabled()) {
+    return false;
+  }
+
+  cleanupIfNeeded();
+
+  time_t now = time(nullptr);
+  auto& mc = getMap(zoneId);
+  TryReadLock rl(&mc.d_mut);
+  if (!rl.gotIt()) {
+    return false;
+  }
+
+  auto it = mc.d_map.find(zoneId);
+  if (it != mc.d_map.end() && isValid(it->second, ns3prc, now)) {
+    auto found = it->second.d_auth.find(qname);
+    if (found != it->second.d_auth.end()) {
+      auth = found->second;
+      (*d_statnumhit)++;
+      return true;
+    }
+  }
+
+  (*d_statnummiss)++;
+  return false;
+}
+
+void AuthNSEC3Cache::insertAuth(int zoneId, const DNSName& zone, const NSEC3PARAMRecordContent& ns3prc, const DNSName& qname, bool auth)
+{
+  if (!enabled()) {
+    return;
+  }
+
+  time_t now = time(nullptr);
+  auto& mc = getMap(zoneId);
+  TryWriteLock wl(&mc.d_mut);
+  if (!wl.gotIt()) {
+    return;
+  }
+
+  auto& entry = getValidEntryLocked(mc.d_map, zoneId, zone, ns3prc, now);
+  if (entry.d_auth.emplace(qname, auth).second) {
+    (*d_statnumentries)++;
+  }
+}
+
+uint64_t AuthNSEC3Cache::eraseLocked(cmap_t& map, cmap_t::iterator& it)
+{
+  uint64_t count = it->second.size();
+  *d_statnumentries -= count;
+  it = map.erase(it);
+  return count;
+}
+
+/* clears the entire cache. */
+uint64_t AuthNSEC3Cache::purge()
+{
+  uint64_t delcount = 0;
+
+  for (auto& mc : d_maps) {
+    WriteLock wl(&mc.d_mut);
+    for (auto it = mc.d_map.begin(); it != mc.d_map.end();) {
+      delcount += eraseLocked(mc.d_map, it);
+    }
+  }
+
+  return delcount;
+}
+
+/* removes every zone containing qname: any change to a zone invalidates its NSEC3 chain */
+uint64_t AuthNSEC3Cache::purgeExact(const DNSName& qname)
+{
+  uint64_t delcount = 0;
+
+  for (auto& mc : d_maps) {
+    WriteLock wl(&mc.d_mut);
+    for (auto it = mc.d_map.begin(); it != mc.d_map.end();) {
+      if (qname.isPartOf(it->second.d_zone)) {
+        delcount += eraseLocked(mc.d_map, it);
+      }
+      else {
+        ++it;
+      }
+    }
+  }
+
+  return delcount;
+}
+
+/* If match ends on a $, it is treated as a suffix and all zones at or below it are removed */
+uint64_t AuthNSEC3Cache::purge(const string& match)
+{
+  if (!boost::ends_with(match, "$")) {
+    return purgeExact(DNSName(match));
+  }
+
+  DNSName suffix(match.substr(0, match.size() - 1));
+  uint64_t delcount = 0;
+
+  for (auto& mc : d_maps) {
+    WriteLock wl(&mc.d_mut);
+    for (auto it = mc.d_map.begin(); it != mc.d_map.end();) {
+      if (it->second.d_zone.isPartOf(suffix) || suffix.isPartOf(it->second.d_zone)) {
+        delcount += eraseLocked(mc.d_map, it);
+      }
+      else {
+        ++it;
+      }
+    }
+  }
+
+  return delcount;
+}
+
+void AuthNSEC3Cache::cleanup()
+{
+  time_t now = time(nullptr);
+  uint64_t totErased = 0;
+
+  for (auto& mc : d_maps) {
+    WriteLock wl(&mc.d_mut);
+    for (auto it = mc.d_map.begin(); it != mc.d_map.end();) {
+      if (it->second.d_ttd < now) {
+        totErased += eraseLocked(mc.d_map, it);
+      }
+      else {
+        ++it;
+      }
+    }
+  }
+
+  DLOG(g_log<<"Done with NSEC3 cache clean, cacheSize: "<<*d_statnumentries<<", totErased: "<<totErased<<endl);
+}
+
+void AuthNSEC3Cache::cleanupIfNeeded()
+{
+  if (++d_ops % s_cleaninterval == 0) {
+    cleanup();
+  }
+}
@@ -0,0 +1,152 @@
+/*
+ * This file is part of PowerDNS or dnsdist.
+ * Copyright -- PowerDNS.COM B.V. and its contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of version 2 of the GNU General Public License as
+ * published by the Free Software Foundation.
+ *
+ * In addition, for the avoidance of any doubt, permission is granted to
+ * link this program with OpenSSL and to (re)distribute the binaries
+ * produced as the result of such linking.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#pragma once
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "dnsname.hh"
+#include "lock.hh"
+#include "statbag.hh"
+#include "misc.hh"
+
+class NSEC3PARAMRecordContent;
+
+/* Per-zone cache of NSEC3 data for live-signed zones, so that negative answers
+   do not need to hash the same enclosers over and over again, nor ask the backend
+   for the position of a hash in the chain we already know about.
+
+   For each zone we keep:
+   - the hashes of names we have already hashed (closest enclosers, wildcards)
+   - the ranges of the NSEC3 chain (before -> after) the backend already told us about,
+     so that a hash falling into a known range can be answered from memory
+   - whether a name owns authoritative data, which is used to find the closest provable encloser
+
+   Everything we know about a zone is dropped when the zone is changed (purgeAuthCaches()),
+   when its NSEC3 parameters change, or when the entry is older than the TTL.
+   The hashes of query names are not kept, only those of names that exist (enclosers, wildcards),
+   and each zone is limited to a number of entries of its own, so that one busy zone cannot push
+   out what we know about the other ones.
+*/
+class AuthNSEC3Cache : public boost::noncopyable
+{
+public:
+  AuthNSEC3Cache(size_t mapsCount = 128);
+  ~AuthNSEC3Cache();
+
+  //! returns the hash of qname in zone, either from the cache or computed (and cached) on the fly
+  std::string getHash(int zoneId, const DNSName& zone, const NSEC3PARAMRecordContent& ns3prc, const DNSName& qname);
+
+  /* looks up the range of the chain covering hashed. If exact is set, hashed is known to be
+     in the chain and only the next hash is needed. unhashed is only set if exact is not set */
+  bool getRange(int zoneId, const NSEC3PARAMRecordContent& ns3prc, const std::string& hashed, bool exact, DNSName& unhashed, std::string& before, std::string& after);
+  void insertRange(int zoneId, const DNSName& zone, const NSEC3PARAMRecordContent& ns3prc, const std::string& before, const std::string& after, const DNSName& unhashed);
+  /* whether qname falls strictly inside a known range, meaning it does not exist. Does not hash qname unless the zone
+     has known ranges, and never caches its hash, so that looking up random names does not push out what we know */
+  bool isAbsent(int zoneId, const NSEC3PARAMRecordContent& ns3prc, const DNSName& qname);
+
+  bool getAuth(int zoneId, const NSEC3PARAMRecordContent& ns3prc, const DNSName& qname, bool& auth);
+  void insertAuth(int zoneId, const DNSName& zone, const NSEC3PARAMRecordContent& ns3prc, const DNSName& qname, bool auth);
+
+  size_t size() { return *d_statnumentries; } //!< number of entries in the cache
+  void cleanup(); //!< remove zones whose entries have expired
+  uint64_t purge();
+  uint64_t purge(const std::string& match); // could be $ terminated. Is not a dnsname!
+  uint64_t purgeExact(const DNSName& qname); // removes the zone qname is part of
+
+  void setTTL(uint32_t ttl)
+  {
+    d_ttl = ttl;
+  }
+
+  bool enabled() const
+  {
+    return d_ttl > 0;
+  }
+
+  void setMaxEntriesPerZone(uint64_t maxEntries)
+  {
+    d_maxEntriesPerZone = maxEntries;
+  }
+
+private:
+  struct Range
+  {
+    std::string after;
+    DNSName unhashed;
+  };
+
+  struct ZoneEntry
+  {
+    size_t size() const
+    {
+      return d_hashes.size() + d_ranges.size() + d_auth.size();
+    }
+
+    DNSName d_zone;
+    std::string d_salt;
+    std::unordered_map<DNSName, std::string> d_hashes;
+    /* keyed by the hash starting the range */
+    std::map<std::string, Range> d_ranges;
+    std::unordered_map<DNSName, bool> d_auth;
+    time_t d_ttd{0};
+    uint16_t d_iterations{0};
+  };
+
+  typedef std::unordered_map<int, ZoneEntry> cmap_t;
+
+  struct MapCombo
+  {
+    MapCombo() {}
+    ~MapCombo() {}
+    MapCombo(const MapCombo&) = delete;
+    MapCombo& operator=(const MapCombo&) = delete;
+
+    ReadWriteLock d_mut;
+    cmap_t d_map;
+  };
+
+  vector<MapCombo> d_maps;
+  MapCombo& getMap(int zoneId)
+  {
+    return d_maps[static_cast<unsigned int>(zoneId) % d_maps.size()];
+  }
+
+  static bool isValid(const ZoneEntry& entry, const NSEC3PARAMRecordContent& ns3prc, time_t now);
+  /* returns the entry for zoneId, resetting it if it is no longer valid and making room if it is full. Needs to be called
+     with the write lock held */
+  ZoneEntry& getValidEntryLocked(cmap_t& map, int zoneId, const DNSName& zone, const NSEC3PARAMRecordContent& ns3prc, time_t now);
+  uint64_t eraseLocked(cmap_t& map, cmap_t::iterator& it);
+  void cleanupIfNeeded();
+
+  AtomicCounter d_ops{0};
+  StatCounter* d_statnumhit;
+  StatCounter* d_statnummiss;
+  StatCounter* d_statnumentries;
+
+  uint64_t d_maxEntriesPerZone{0};
+  uint32_t d_ttl{0};
+  static const unsigned int s_cleaninterval = 4096;
+};
+
+extern AuthNSEC3Cache g_nsec3Cache;
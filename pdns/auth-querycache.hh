@@ -32,6 +32,7 @@ using namespace ::boost::multi_index;
 #include "dns.hh"
 #include "dnspacket.hh"
 #include "lock.hh"
+#include "statbag.hh"
 
 class AuthQueryCache : public boost::noncopyable
 {
@@ -113,9 +114,9 @@ private:
   void cleanupIfNeeded();
 
   AtomicCounter d_ops{0};
-  AtomicCounter *d_statnumhit;
-  AtomicCounter *d_statnummiss;
-  AtomicCounter *d_statnumentries;
+  StatCounter *d_statnumhit;
+  StatCounter *d_statnummiss;
+  StatCounter *d_statnumentries;
 
   uint64_t d_maxEntries{0};
   time_t d_lastclean; // doesn't need to be atomic
@@ -25,6 +25,7 @@
 #include <vector>
 #include "dnsname.hh"
 #include "lock.hh"
+#include "statbag.hh"
 #include "misc.hh"
 
 class AuthZoneCache : public boost::noncopyable
@@ -84,9 +85,9 @@ private:
     return d_maps[getMapIndex(qname)];
   }
 
-  AtomicCounter* d_statnumhit;
-  AtomicCounter* d_statnummiss;
-  AtomicCounter* d_statnumentries;
+  StatCounter* d_statnumhit;
+  StatCounter* d_statnummiss;
+  StatCounter* d_statnumentries;
 
   time_t d_refreshinterval{0};
 
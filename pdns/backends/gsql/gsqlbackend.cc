@@ -129,6 +129,22 @@ GSQLBackend::GSQLBackend(const string &mode, const string &suffix)
   d_SearchRecordsQuery = getArg("search-records-query");
   d_SearchCommentsQuery = getArg("search-comments-query");
 
+  try {
+    d_bulkInsertRows = std::max(getArgAsNum("bulk-insert-rows"), 0);
+  }
+  catch (const ArgException&) {
+    d_bulkInsertRows = 0;
+  }
+
+  if (d_bulkInsertRows > 1) {
+    d_InsertRecordBulkQuery = makeBulkQuery(d_InsertRecordQuery, 9, d_bulkInsertRows);
+    d_InsertEmptyNonTerminalOrderBulkQuery = makeBulkQuery(d_InsertEmptyNonTerminalOrderQuery, 4, d_bulkInsertRows);
+    if (d_InsertRecordBulkQuery.empty() || d_InsertEmptyNonTerminalOrderBulkQuery.empty()) {
+      g_log<<Logger::Warning<<d_logprefix<<"Unable to turn the insert queries into multi-row ones, records will be inserted one by one"<<endl;
+      d_bulkInsertRows = 0;
+    }
+  }
+
   d_query_stmt = nullptr;
   d_NoIdQuery_stmt = nullptr;
   d_IdQuery_stmt = nullptr;
@@ -1538,28 +1554,31 @@ bool GSQLBackend::feedRecord(const DNSResourceRecord &r, const DNSName &ordernam
     boost::trim_left(content);
   }
 
+  PendingRecord record;
+  record.qname = r.qname;
+  record.content = std::move(content);
+  record.qtype = r.qtype.toString();
+  if (!ordername.empty()) {
+    record.ordername = ordername.labelReverse().makeLowerCase().toString(" ", false);
+  }
+  record.ttl = r.ttl;
+  record.prio = prio;
+  record.domain_id = r.domain_id;
+  record.disabled = r.disabled;
+  record.auth = d_dnssecQueries ? r.auth : true;
+
+  if (bulkInsertEnabled()) {
+    d_pendingRecords.push_back(std::move(record));
+    if (d_pendingRecords.size() >= d_bulkInsertRows) {
+      flushPendingRecords();
+    }
+    return true;
+  }
+
   try {
     reconnectIfNeeded();
 
-    d_InsertRecordQuery_stmt->
-      bind("content",content)->
-      bind("ttl",r.ttl)->
-      bind("priority",prio)->
-      bind("qtype",r.qtype.toString())->
-      bind("domain_id",r.domain_id)->
-      bind("disabled",r.disabled)->
-      bind("qname",r.qname);
-
-    if (!ordername.empty())
-      d_InsertRecordQuery_stmt->bind("ordername", ordername.labelReverse().makeLowerCase().toString(" ", false));
-    else
-      d_InsertRecordQuery_stmt->bindNull("ordername");
-
-    if (d_dnssecQueries)
-      d_InsertRecordQuery_stmt->bind("auth", r.auth);
-    else
-      d_InsertRecordQuery_stmt->bind("auth", true);
-
+    bindPendingRecord(d_InsertRecordQuery_stmt.get(), record, 0);
     d_InsertRecordQuery_stmt->
       execute()->
       reset();
@@ -1573,14 +1592,24 @@ bool GSQLBackend::feedRecord(const DNSResourceRecord &r, const DNSName &ordernam
 bool GSQLBackend::feedEnts(int domain_id, map<DNSName,bool>& nonterm)
 {
   for(const auto& nt: nonterm) {
+    PendingEnt ent;
+    ent.qname = nt.first;
+    ent.domain_id = domain_id;
+    ent.auth = (nt.second || !d_dnssecQueries);
+
+    if (bulkInsertEnabled()) {
+      d_pendingEnts.push_back(std::move(ent));
+      if (d_pendingEnts.size() >= d_bulkInsertRows) {
+        flushPendingRecords();
+      }
+      continue;
+    }
+
     try {
       reconnectIfNeeded();
 
+      bindPendingEnt(d_InsertEmptyNonTerminalOrderQuery_stmt.get(), ent, 0);
       d_InsertEmptyNonTerminalOrderQuery_stmt->
-        bind("domain_id",domain_id)->
-        bind("qname", nt.first)->
-        bindNull("ordername")->
-        bind("auth",(nt.second || !d_dnssecQueries))->
         execute()->
         reset();
     }
@@ -1596,25 +1625,28 @@ bool GSQLBackend::feedEnts3(int domain_id, const DNSName &domain, map<DNSName,bo
   if(!d_dnssecQueries)
       return false;
 
-  string ordername;
-
   for(const auto& nt: nonterm) {
+    PendingEnt ent;
+    ent.qname = nt.first;
+    ent.domain_id = domain_id;
+    ent.auth = nt.second;
+    if (!narrow && nt.second) {
+      ent.ordername = toBase32Hex(hashQNameWithSalt(ns3prc, nt.first));
+    }
+
+    if (bulkInsertEnabled()) {
+      d_pendingEnts.push_back(std::move(ent));
+      if (d_pendingEnts.size() >= d_bulkInsertRows) {
+        flushPendingRecords();
+      }
+      continue;
+    }
+
     try {
       reconnectIfNeeded();
 
+      bindPendingEnt(d_InsertEmptyNonTerminalOrderQuery_stmt.get(), ent, 0);
       d_InsertEmptyNonTerminalOrderQuery_stmt->
-        bind("domain_id",domain_id)->
-        bind("qname", nt.first);
-      if (narrow || !nt.second) {
-        d_InsertEmptyNonTerminalOrderQuery_stmt->
-          bindNull("ordername");
-      } else {
-        ordername=toBase32Hex(hashQNameWithSalt(ns3prc, nt.first));
-        d_InsertEmptyNonTerminalOrderQuery_stmt->
-          bind("ordername", ordername);
-      }
-      d_InsertEmptyNonTerminalOrderQuery_stmt->
-        bind("auth",nt.second)->
         execute()->
         reset();
     }
@@ -1625,6 +1657,201 @@ bool GSQLBackend::feedEnts3(int domain_id, const DNSName &domain, map<DNSName,bo
   return true;
 }
 
+/* Turns an 'insert into ... values (...)' query taking nparams parameters into one inserting 'rows' rows at once.
+   The placeholders of the additional rows are renumbered ($1 becomes $10 for the second row of a 9 parameters query)
+   or renamed (:qname becomes :qname_1), '?' ones are left alone. Returns an empty string if the query does not
+   have that form. */
+string GSQLBackend::makeBulkQuery(const string& query, unsigned int nparams, size_t rows)
+{
+  string lowered = toLower(query);
+  size_t pos = lowered.rfind("values");
+  if (pos == string::npos || (pos > 0 && (isalnum(lowered.at(pos - 1)) || lowered.at(pos - 1) == '_'))) {
+    return string();
+  }
+
+  size_t open = lowered.find_first_not_of(" \t\r\n", pos + strlen("values"));
+  if (open == string::npos || lowered.at(open) != '(') {
+    return string();
+  }
+
+  /* find the end of the tuple */
+  size_t close = string::npos;
+  unsigned int depth = 0;
+  bool quoted = false;
+  for (size_t idx = open; idx < query.size() && close == string::npos; idx++) {
+    char c = query.at(idx);
+    if (c == '\'') {
+      quoted = !quoted;
+    }
+    else if (!quoted && c == '(') {
+      depth++;
+    }
+    else if (!quoted && c == ')' && --depth == 0) {
+      close = idx;
+    }
+  }
+  if (close == string::npos || query.find_first_not_of(" \t\r\n;", close + 1) != string::npos) {
+    return string();
+  }
+
+  const string tuple = query.substr(open, close - open + 1);
+  string result = query.substr(0, close + 1);
+  result.reserve(query.size() + (tuple.size() + 16) * rows);
+
+  for (size_t row = 1; row < rows; row++) {
+    result += ", ";
+    quoted = false;
+    for (size_t idx = 0; idx < tuple.size(); idx++) {
+      char c = tuple.at(idx);
+      if (c == '\'') {
+        quoted = !quoted;
+      }
+      if (quoted) {
+        result += c;
+        continue;
+      }
+
+      if (c == '$' && idx + 1 < tuple.size() && isdigit(tuple.at(idx + 1))) {
+        size_t end = idx + 1;
+        while (end < tuple.size() && isdigit(tuple.at(end))) {
+          end++;
+        }
+        result += "$" + std::to_string(pdns_stou(tuple.substr(idx + 1, end - idx - 1)) + row * nparams);
+        idx = end - 1;
+      }
+      else if (c == ':' && idx + 1 < tuple.size() && (isalpha(tuple.at(idx + 1)) || tuple.at(idx + 1) == '_') && (idx == 0 || tuple.at(idx - 1) != ':')) {
+        /* a named parameter, but not a '::type' cast */
+        size_t end = idx + 1;
+        while (end < tuple.size() && (isalnum(tuple.at(end)) || tuple.at(end) == '_')) {
+          end++;
+        }
+        result += tuple.substr(idx, end - idx) + "_" + std::to_string(row);
+        idx = end - 1;
+      }
+      else {
+        result += c;
+      }
+    }
+  }
+
+  result += query.substr(close + 1);
+  return result;
+}
+
+void GSQLBackend::bindPendingRecord(SSqlStatement* stmt, const PendingRecord& record, size_t row)
+{
+  const string suffix = row > 0 ? "_" + std::to_string(row) : "";
+
+  stmt->
+    bind("content" + suffix, record.content)->
+    bind("ttl" + suffix, record.ttl)->
+    bind("priority" + suffix, record.prio)->
+    bind("qtype" + suffix, record.qtype)->
+    bind("domain_id" + suffix, record.domain_id)->
+    bind("disabled" + suffix, record.disabled)->
+    bind("qname" + suffix, record.qname);
+
+  if (record.ordername)
+    stmt->bind("ordername" + suffix, *record.ordername);
+  else
+    stmt->bindNull("ordername" + suffix);
+
+  stmt->bind("auth" + suffix, record.auth);
+}
+
+void GSQLBackend::bindPendingEnt(SSqlStatement* stmt, const PendingEnt& ent, size_t row)
+{
+  const string suffix = row > 0 ? "_" + std::to_string(row) : "";
+
+  stmt->
+    bind("domain_id" + suffix, ent.domain_id)->
+    bind("qname" + suffix, ent.qname);
+
+  if (ent.ordername)
+    stmt->bind("ordername" + suffix, *ent.ordername);
+  else
+    stmt->bindNull("ordername" + suffix);
+
+  stmt->bind("auth" + suffix, ent.auth);
+}
+
+void GSQLBackend::flushPendingRecords()
+{
+  if (d_pendingRecords.empty() && d_pendingEnts.empty()) {
+    return;
+  }
+
+  /* whatever happens, these are gone: on error the transaction is going to be aborted anyway */
+  auto records = std::move(d_pendingRecords);
+  auto ents = std::move(d_pendingEnts);
+  d_pendingRecords.clear();
+  d_pendingEnts.clear();
+
+  try {
+    for (size_t pos = 0; pos < records.size(); ) {
+      size_t count = std::min(records.size() - pos, d_bulkInsertRows);
+      unique_ptr<SSqlStatement> partial;
+      SSqlStatement* stmt;
+      if (count == d_bulkInsertRows) {
+        if (!d_InsertRecordBulkQuery_stmt) {
+          d_InsertRecordBulkQuery_stmt = d_db->prepare(d_InsertRecordBulkQuery, 9 * d_bulkInsertRows);
+        }
+        stmt = d_InsertRecordBulkQuery_stmt.get();
+      }
+      else if (count == 1) {
+        stmt = d_InsertRecordQuery_stmt.get();
+      }
+      else {
+        partial = d_db->prepare(makeBulkQuery(d_InsertRecordQuery, 9, count), 9 * count);
+        stmt = partial.get();
+      }
+
+      for (size_t row = 0; row < count; row++) {
+        bindPendingRecord(stmt, records.at(pos + row), row);
+      }
+      stmt->
+        execute()->
+        reset();
+      pos += count;
+    }
+  }
+  catch (SSqlException &e) {
+    throw PDNSException("GSQLBackend unable to feed " + std::to_string(records.size()) + " records starting with " + records.at(0).qname.toLogString() + "|" + records.at(0).qtype + ": "+e.txtReason());
+  }
+
+  try {
+    for (size_t pos = 0; pos < ents.size(); ) {
+      size_t count = std::min(ents.size() - pos, d_bulkInsertRows);
+      unique_ptr<SSqlStatement> partial;
+      SSqlStatement* stmt;
+      if (count == d_bulkInsertRows) {
+        if (!d_InsertEmptyNonTerminalOrderBulkQuery_stmt) {
+          d_InsertEmptyNonTerminalOrderBulkQuery_stmt = d_db->prepare(d_InsertEmptyNonTerminalOrderBulkQuery, 4 * d_bulkInsertRows);
+        }
+        stmt = d_InsertEmptyNonTerminalOrderBulkQuery_stmt.get();
+      }
+      else if (count == 1) {
+        stmt = d_InsertEmptyNonTerminalOrderQuery_stmt.get();
+      }
+      else {
+        partial = d_db->prepare(makeBulkQuery(d_InsertEmptyNonTerminalOrderQuery, 4, count), 4 * count);
+        stmt = partial.get();
+      }
+
+      for (size_t row = 0; row < count; row++) {
+        bindPendingEnt(stmt, ents.at(pos + row), row);
+      }
+      stmt->
+        execute()->
+        reset();
+      pos += count;
+    }
+  }
+  catch (SSqlException &e) {
+    throw PDNSException("GSQLBackend unable to feed " + std::to_string(ents.size()) + " empty non-terminals starting with '" + ents.at(0).qname.toLogString() + "': "+e.txtReason());
+  }
+}
+
 bool GSQLBackend::startTransaction(const DNSName &domain, int domain_id)
 {
   try {
@@ -1652,6 +1879,8 @@ bool GSQLBackend::startTransaction(const DNSName &domain, int domain_id)
 
 bool GSQLBackend::commitTransaction()
 {
+  flushPendingRecords();
+
   try {
     d_db->commit();
     d_inTransaction = false;
@@ -1665,6 +1894,9 @@ bool GSQLBackend::commitTransaction()
 
 bool GSQLBackend::abortTransaction()
 {
+  d_pendingRecords.clear();
+  d_pendingEnts.clear();
+
   try {
     d_db->rollback();
     d_inTransaction = false;
@@ -22,6 +22,7 @@
 #pragma once
 #include <string>
 #include <map>
+#include <boost/optional.hpp>
 #include "ssql.hh"
 #include "pdns/arguments.hh"
 
@@ -179,6 +180,8 @@ protected:
     d_DeleteCommentsQuery_stmt.reset();
     d_SearchRecordsQuery_stmt.reset();
     d_SearchCommentsQuery_stmt.reset();
+    d_InsertRecordBulkQuery_stmt.reset();
+    d_InsertEmptyNonTerminalOrderBulkQuery_stmt.reset();
   }
 
 public:
@@ -246,6 +249,7 @@ protected:
   void extractRecord(SSqlStatement::row_t& row, DNSResourceRecord& rr);
   void extractComment(SSqlStatement::row_t& row, Comment& c);
   void setLastCheck(uint32_t domain_id, time_t lastcheck);
+  static string makeBulkQuery(const string& query, unsigned int nparams, size_t rows);
   bool isConnectionUsable() {
     if (d_db) {
       return d_db->isConnectionUsable();
@@ -254,7 +258,12 @@ protected:
   }
   void reconnectIfNeeded()
   {
-    if (inTransaction() || isConnectionUsable()) {
+    if (inTransaction()) {
+      /* whatever we are about to run has to see the records queued by feedRecord() and feedEnts() */
+      flushPendingRecords();
+      return;
+    }
+    if (isConnectionUsable()) {
       return;
     }
 
@@ -273,6 +282,35 @@ protected:
   unique_ptr<SSqlStatement>* d_query_stmt;
 
 private:
+  struct PendingRecord
+  {
+    DNSName qname;
+    string content;
+    string qtype;
+    boost::optional<string> ordername;
+    uint32_t ttl;
+    int prio;
+    int domain_id;
+    bool disabled;
+    bool auth;
+  };
+
+  struct PendingEnt
+  {
+    DNSName qname;
+    boost::optional<string> ordername;
+    int domain_id;
+    bool auth;
+  };
+
+  bool bulkInsertEnabled() const
+  {
+    return d_inTransaction && d_bulkInsertRows > 1;
+  }
+  void flushPendingRecords();
+  void bindPendingRecord(SSqlStatement* stmt, const PendingRecord& record, size_t row);
+  void bindPendingEnt(SSqlStatement* stmt, const PendingEnt& ent, size_t row);
+
   string d_NoIdQuery;
   string d_IdQuery;
   string d_ANYNoIdQuery;
@@ -410,6 +448,15 @@ private:
   unique_ptr<SSqlStatement> d_SearchRecordsQuery_stmt;
   unique_ptr<SSqlStatement> d_SearchCommentsQuery_stmt;
 
+  /* multi-row versions of the insert queries, used to load whole zones inside a transaction */
+  string d_InsertRecordBulkQuery;
+  string d_InsertEmptyNonTerminalOrderBulkQuery;
+  unique_ptr<SSqlStatement> d_InsertRecordBulkQuery_stmt;
+  unique_ptr<SSqlStatement> d_InsertEmptyNonTerminalOrderBulkQuery_stmt;
+  vector<PendingRecord> d_pendingRecords;
+  vector<PendingEnt> d_pendingEnts;
+  size_t d_bulkInsertRows{0};
+
 protected:
   std::unique_ptr<SSql> d_db{nullptr};
   bool d_dnssecQueries;
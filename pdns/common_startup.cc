@@ -56,6 +56,8 @@ StatBag S;  //!< Statistics are gathered across PDNS via the StatBag class S
 AuthPacketCache PC; //!< This is the main PacketCache, shared across all threads
 AuthQueryCache QC;
 AuthZoneCache g_zoneCache;
+AuthNSEC3Cache g_nsec3Cache;
+AuthDenialCache g_denialCache;
 std::unique_ptr<DNSProxy> DP{nullptr};
 std::unique_ptr<DynListener> dl{nullptr};
 CommunicatorClass Communicator;
@@ -107,6 +109,8 @@ void declareArguments()
   ::arg().set("query-local-address","Source IP addresses for sending queries")="0.0.0.0 ::";
   ::arg().set("overload-queue-length","Maximum queuelength moving to packetcache only")="0";
   ::arg().set("max-queue-length","Maximum queuelength before considering situation lost")="5000";
+  ::arg().setSwitch("latency-histograms", "Keep latency histograms for every stage of answering a query")="no";
+  ::arg().set("slow-backend-query-threshold", "With latency-histograms, record backend queries taking longer than this many milliseconds in the slow-backend-queries ring")="100";
 
   ::arg().set("retrieval-threads", "Number of AXFR-retrieval threads for slave operation")="2";
   ::arg().setSwitch("api", "Enable/disable the REST API (including HTTP listener)")="no";
@@ -181,6 +185,8 @@ void declareArguments()
   ::arg().set("cache-ttl","Seconds to store packets in the PacketCache")="20";
   ::arg().set("negquery-cache-ttl","Seconds to store negative query results in the QueryCache")="60";
   ::arg().set("query-cache-ttl","Seconds to store query results in the QueryCache")="20";
+  ::arg().set("nsec3-cache-ttl","Seconds to store NSEC3 hashes and chain ranges of live-signed zones in the NSEC3 cache")="20";
+  ::arg().set("denial-cache-ttl","Seconds to remember the gaps between names of live-signed zones, to answer for non-existing names without asking the backends")="20";
   ::arg().set("zone-cache-refresh-interval", "Seconds to cache list of known zones") = "300";
   ::arg().set("server-id", "Returned when queried for 'id.server' TXT or NSID, defaults to hostname - disabled or custom")="";
   ::arg().set("default-soa-content","Default SOA content")="a.misconfigured.dns.server.invalid hostmaster.@ 0 10800 3600 604800 3600";
@@ -350,6 +356,10 @@ void declareStats()
   S.declare("dnsupdate-changes", "DNS update changes to records in total.");
 
   S.declare("incoming-notifications", "NOTIFY packets received.");
+  S.declare("outgoing-notifications", "NOTIFY packets sent.");
+  S.declare("outgoing-notifications-answered", "Answers received to the NOTIFY packets we sent.");
+  S.declare("outgoing-notifications-failed", "Notifications that were given up on after all retries.");
+  S.declare("outgoing-notifications-queue", "Number of notifications waiting to be sent or answered.", StatType::gauge);
 
   S.declare("uptime", "Uptime of process in seconds", uptimeOfProcess, StatType::counter);
   S.declare("real-memory-usage", "Actual unique use of memory in bytes (approx)", getRealMemoryUsage, StatType::gauge);
@@ -392,6 +402,20 @@ void declareStats()
   S.declareComboRing("remotes","Remote server IP addresses");
   S.declareComboRing("remotes-unauth", "Remote hosts querying zones for which we are not auth");
   S.declareComboRing("remotes-corrupt","Remote hosts sending corrupt packets");
+
+  if (::arg().mustDo("latency-histograms")) {
+    S.declareHistogram("latency-receive", "Microseconds between the kernel receiving a UDP query and it being parsed");
+    S.declareHistogram("latency-cache", "Microseconds spent looking up UDP queries in the packet cache");
+    S.declareHistogram("latency-queue-wait", "Microseconds UDP queries waited for a distributor thread");
+    for (const auto& name : BackendMakers().getInstanceNames()) {
+      S.declareHistogram("latency-backend-" + name, "Microseconds the " + name + " backend spent answering a lookup");
+    }
+    S.declareHistogram("latency-signing", "Microseconds spent adding RRSIGs to answers");
+    S.declareHistogram("latency-packet-building", "Microseconds spent serializing UDP answers not built by the packet cache");
+    S.declareHistogram("latency-send", "Microseconds spent sending UDP answers");
+    S.declareHistogram("latency-total", "Microseconds between receiving a UDP query and sending the answer");
+    S.declareRing("slow-backend-queries", "Backend lookups slower than slow-backend-query-threshold");
+  }
 }
 
 int isGuarded(char **argv)
@@ -401,12 +425,26 @@ int isGuarded(char **argv)
   return !!p;
 }
 
-static void sendout(std::unique_ptr<DNSPacket>& a)
+static void sendout(std::unique_ptr<DNSPacket>& a, DTime received)
 {
   if(!a)
     return;
-  
-  N->send(*a);
+
+  static StatHistogram* buildingLatency = S.getHistogram("latency-packet-building");
+  static StatHistogram* sendLatency = S.getHistogram("latency-send");
+  static StatHistogram* totalLatency = S.getHistogram("latency-total");
+  if (sendLatency != nullptr) {
+    DTime dt;
+    dt.set();
+    a->getString();
+    (*buildingLatency)(dt.udiff());
+    N->send(*a);
+    (*sendLatency)(dt.udiffNoReset());
+    (*totalLatency)(received.udiffNoReset());
+  }
+  else {
+    N->send(*a);
+  }
 
   int diff=a->d_dt.udiff();
   avg_latency=0.999*avg_latency+0.001*diff;
@@ -423,13 +461,19 @@ try
   DNSPacket question(true);
   DNSPacket cached(false);
 
-  AtomicCounter &numreceived=*S.getPointer("udp-queries");
-  AtomicCounter &numreceiveddo=*S.getPointer("udp-do-queries");
+  StatCounter &numreceived=*S.getPointer("udp-queries");
+  StatCounter &numreceiveddo=*S.getPointer("udp-do-queries");
+
+  StatCounter &numreceived4=*S.getPointer("udp4-queries");
 
-  AtomicCounter &numreceived4=*S.getPointer("udp4-queries");
+  StatCounter &numreceived6=*S.getPointer("udp6-queries");
+  StatCounter &overloadDrops=*S.getPointer("overload-drops");
 
-  AtomicCounter &numreceived6=*S.getPointer("udp6-queries");
-  AtomicCounter &overloadDrops=*S.getPointer("overload-drops");
+  StatHistogram* receiveLatency = S.getHistogram("latency-receive");
+  StatHistogram* cacheLatency = S.getHistogram("latency-cache");
+  StatHistogram* sendLatency = S.getHistogram("latency-send");
+  StatHistogram* totalLatency = S.getHistogram("latency-total");
+  DTime stageTime;
 
   int diff;
   bool logDNSQueries = ::arg().mustDo("log-dns-queries");
@@ -452,6 +496,9 @@ try
     if(!NS->receive(question, buffer)) { // receive a packet         inline
       continue;                    // packet was broken, try again
     }
+    if (receiveLatency != nullptr) {
+      (*receiveLatency)(question.d_dt.udiffNoReset());
+    }
 
     numreceived++;
 
@@ -481,7 +528,13 @@ try
     }
 
     if(PC.enabled() && (question.d.opcode != Opcode::Notify && question.d.opcode != Opcode::Update) && question.couldBeCached()) {
+      if (cacheLatency != nullptr) {
+        stageTime.set();
+      }
       bool haveSomething=PC.get(question, cached); // does the PacketCache recognize this question?
+      if (cacheLatency != nullptr) {
+        (*cacheLatency)(stageTime.udiff());
+      }
       if (haveSomething) {
         if(logDNSQueries)
           g_log<<": packetcache HIT"<<endl;
@@ -493,6 +546,10 @@ try
         cached.d.id=question.d.id;
         cached.commitD(); // commit d to the packet                        inlined
         NS->send(cached); // answer it then                              inlined
+        if (sendLatency != nullptr) {
+          (*sendLatency)(stageTime.udiffNoReset());
+          (*totalLatency)(question.d_dt.udiffNoReset());
+        }
         diff=question.d_dt.udiff();
         avg_latency=0.999*avg_latency+0.001*diff; // 'EWMA'
         continue;
@@ -566,6 +623,10 @@ void mainthread()
    PC.setTTL(::arg().asNum("cache-ttl"));
    PC.setMaxEntries(::arg().asNum("max-packet-cache-entries"));
    QC.setMaxEntries(::arg().asNum("max-cache-entries"));
+   g_nsec3Cache.setTTL(::arg().asNum("nsec3-cache-ttl"));
+   g_nsec3Cache.setMaxEntriesPerZone(::arg().asNum("max-cache-entries"));
+   g_denialCache.setTTL(::arg().asNum("denial-cache-ttl"));
+   g_denialCache.setMaxEntries(::arg().asNum("max-cache-entries"));
    DNSSECKeeper::setMaxEntries(::arg().asNum("max-cache-entries"));
 
    if (!PC.enabled() && ::arg().mustDo("log-dns-queries")) {
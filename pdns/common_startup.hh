@@ -20,7 +20,9 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 #pragma once
+#include "auth-denialcache.hh"
 #include "auth-packetcache.hh"
+#include "auth-nsec3cache.hh"
 #include "auth-querycache.hh"
 #include "auth-zonecache.hh"
 #include "utility.hh"
@@ -27,7 +27,10 @@
 #include <list>
 #include <limits>
 #include <boost/multi_index_container.hpp>
+#include <boost/multi_index/composite_key.hpp>
+#include <boost/multi_index/hashed_index.hpp>
 #include <boost/multi_index/identity.hpp>
+#include <boost/multi_index/ordered_index.hpp>
 #include <boost/multi_index/sequenced_index.hpp>
 using namespace boost::multi_index;
 
@@ -68,61 +71,94 @@ typedef UniQueue::index<IDTag>::type domains_by_name_t;
 class NotificationQueue
 {
 public:
-  void add(const DNSName &domain, const string &ip)
+  void add(const DNSName &domain, const string &ip, time_t now = time(nullptr))
   {
     const ComboAddress caIp(ip);
 
     NotificationRequest nr;
     nr.domain   = domain;
     nr.ip       = caIp.toStringWithPort();
+    nr.remote   = caIp;
     nr.attempts = 0;
     nr.id       = dns_random_uint16();
-    nr.next     = time(0);
+    nr.next     = now;
 
-    d_nqueue.push_back(nr);
+    d_nqueue.insert(nr);
   }
 
-  bool removeIf(const string &remote, uint16_t id, const DNSName &domain)
+  bool removeIf(const ComboAddress& remote, uint16_t id, const DNSName &domain)
   {
-    ServiceTuple stRemote, stQueued;
-    parseService(remote, stRemote);
+    if (!cancel(remote, id, domain)) {
+      return false;
+    }
+    /* this target is answering, forget about its previous failures */
+    d_targets.erase(remote);
+    return true;
+  }
 
-    for(d_nqueue_t::iterator i=d_nqueue.begin(); i!=d_nqueue.end(); ++i) {
-      parseService(i->ip, stQueued);
-      if(i->id==id && stQueued.host == stRemote.host && i->domain==domain) {
-        d_nqueue.erase(i);
+  /* drops a notification that did not get an answer, the target keeps its backoff */
+  bool cancel(const ComboAddress& remote, uint16_t id, const DNSName &domain)
+  {
+    auto& idx = d_nqueue.get<QueryTag>();
+    auto range = idx.equal_range(std::make_tuple(id, domain));
+    for (auto i = range.first; i != range.second; ++i) {
+      if (ComboAddress::addressOnlyEqual()(i->remote, remote)) {
+        idx.erase(i);
         return true;
       }
     }
     return false;
   }
 
-  bool getOne(DNSName &domain, string &ip, uint16_t *id, bool &purged)
+  bool removeIf(const string &remote, uint16_t id, const DNSName &domain)
   {
-    for(d_nqueue_t::iterator i=d_nqueue.begin();i!=d_nqueue.end();++i) 
-      if(i->next <= time(0)) {
-        i->attempts++;
-        purged=false;
-        i->next=time(0)+1+(1<<i->attempts);
-        domain=i->domain;
-        ip=i->ip;
-        *id=i->id;
-        purged=false;
-        if(i->attempts>4) {
-          purged=true;
-          d_nqueue.erase(i);
-        }
-        return true;
-      }
-    return false;
+    return removeIf(ComboAddress(remote), id, domain);
+  }
+
+  bool getOne(DNSName &domain, string &ip, uint16_t *id, bool &purged, time_t now = time(nullptr))
+  {
+    auto& idx = d_nqueue.get<TimeTag>();
+    auto i = idx.begin();
+    if (i == idx.end() || i->next > now) {
+      return false;
+    }
+
+    domain = i->domain;
+    ip = i->ip;
+    *id = i->id;
+    purged = false;
+
+    int attempts = i->attempts + 1;
+    if (attempts > s_maxAttempts) {
+      purged = true;
+      /* the target did not answer any of our attempts, back off for the next notifications we send it */
+      auto& target = d_targets[i->remote];
+      target = std::min(target + 1, s_maxTargetBackoff);
+      idx.erase(i);
+      return true;
+    }
+
+    time_t next = now + getRetryDelay(i->remote, attempts);
+    idx.modify(i, [attempts, next](NotificationRequest& nr) {
+      nr.attempts = attempts;
+      nr.next = next;
+    });
+    return true;
+  }
+
+  time_t earliest(time_t now = time(nullptr)) const
+  {
+    time_t early=std::numeric_limits<time_t>::max() - 1;
+    const auto& idx = d_nqueue.get<TimeTag>();
+    if (!idx.empty()) {
+      early = min(early, idx.begin()->next);
+    }
+    return early-now;
   }
 
-  time_t earliest()
+  size_t size() const
   {
-    time_t early=std::numeric_limits<time_t>::max() - 1; 
-    for(d_nqueue_t::const_iterator i=d_nqueue.begin();i!=d_nqueue.end();++i) 
-      early=min(early,i->next);
-    return early-time(0);
+    return d_nqueue.size();
   }
 
   void dump();
@@ -132,14 +168,42 @@ private:
   {
     DNSName domain;
     string ip;
+    ComboAddress remote;
     time_t next;
     int attempts;
     uint16_t id;
   };
 
-  typedef std::list<NotificationRequest> d_nqueue_t;
+  /* the delay before retrying a notification, based on the number of attempts for this notification,
+     and on the number of previous notifications this target failed to answer */
+  time_t getRetryDelay(const ComboAddress& remote, int attempts) const
+  {
+    unsigned int backoff = 0;
+    auto target = d_targets.find(remote);
+    if (target != d_targets.end()) {
+      backoff = target->second;
+    }
+    return 1 + (static_cast<time_t>(1) << (attempts + backoff));
+  }
+
+  struct QueryTag{};
+  struct TimeTag{};
+  typedef multi_index_container<
+    NotificationRequest,
+    indexed_by<
+      hashed_non_unique<tag<QueryTag>,
+                        composite_key<NotificationRequest,
+                                      member<NotificationRequest, uint16_t, &NotificationRequest::id>,
+                                      member<NotificationRequest, DNSName, &NotificationRequest::domain>>>,
+      ordered_non_unique<tag<TimeTag>, member<NotificationRequest, time_t, &NotificationRequest::next>>
+    >
+  > d_nqueue_t;
   d_nqueue_t d_nqueue;
+  /* number of consecutive notifications each target failed to answer */
+  std::unordered_map<ComboAddress, unsigned int, ComboAddress::addressOnlyHash, ComboAddress::addressOnlyEqual> d_targets;
 
+  static const int s_maxAttempts{4};
+  static constexpr unsigned int s_maxTargetBackoff{4};
 };
 
 struct ZoneStatus;
@@ -171,7 +235,9 @@ public:
   void notify(const DNSName &domain, const string &ip);
   void mainloop();
   void retrievalLoopThread();
-  void sendNotification(int sock, const DNSName &domain, const ComboAddress& remote, uint16_t id, UeberBackend* B);
+  typedef vector<pair<ComboAddress, vector<uint8_t>>> notificationBatch_t;
+  bool makeNotification(const DNSName &domain, uint16_t id, UeberBackend* B, vector<uint8_t>& packet);
+  void sendNotifications(int sock, notificationBatch_t& batch);
   bool notifyDomain(const DNSName &domain, UeberBackend* B);
   vector<pair<DNSName, ComboAddress> > getSuckRequests();
   size_t getSuckRequestsWaiting();
@@ -208,6 +274,7 @@ private:
 
   set<string> d_alsoNotify;
   NotificationQueue d_nq;
+  static const size_t s_maxNotificationBatchSize{64};
   NetmaskGroup d_onlyNotify;
   bool d_masterschanged, d_slaveschanged;
   bool d_preventSelfNotification;
@@ -31,6 +31,7 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <fstream>
+#include <thread>
 #include <unordered_map>
 #include <boost/algorithm/string.hpp>
 #include <boost/format.hpp>
@@ -728,6 +729,51 @@ struct RecordStatus
 };
 
 
+/* Computes the NSEC3 ordername of each name. With a lot of names or iterations this is where rectifying a zone
+   spends most of its time, so large sets of names are split between as many threads as we have cores. */
+void DNSSECKeeper::hashOrderNames(const NSEC3PARAMRecordContent& ns3pr, const vector<DNSName>& names, vector<DNSName>& ordernames)
+{
+  static const size_t minNamesPerThread = 1000;
+
+  ordernames.resize(names.size());
+  auto hashRange = [&ns3pr, &names, &ordernames](size_t first, size_t last, std::exception_ptr& error) {
+    try {
+      for (size_t idx = first; idx < last; ++idx) {
+        ordernames[idx] = DNSName(toBase32Hex(hashQNameWithSalt(ns3pr, names[idx])));
+      }
+    }
+    catch (...) {
+      error = std::current_exception();
+    }
+  };
+
+  size_t threads = std::min(static_cast<size_t>(std::max(std::thread::hardware_concurrency(), 1U)), names.size() / minNamesPerThread);
+  if (threads <= 1) {
+    std::exception_ptr error;
+    hashRange(0, names.size(), error);
+    if (error) {
+      std::rethrow_exception(error);
+    }
+    return;
+  }
+
+  vector<std::thread> workers;
+  vector<std::exception_ptr> errors(threads);
+  size_t perThread = (names.size() + threads - 1) / threads;
+  for (size_t idx = 0; idx < threads; ++idx) {
+    size_t first = idx * perThread;
+    workers.emplace_back(hashRange, first, std::min(first + perThread, names.size()), std::ref(errors.at(idx)));
+  }
+  for (auto& worker : workers) {
+    worker.join();
+  }
+  for (const auto& error : errors) {
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  }
+}
+
 /* Rectifies the zone
  *
  * \param zone The zone to rectify
@@ -856,10 +902,30 @@ bool DNSSECKeeper::rectifyZone(const DNSName& zone, string& error, string& info,
   int updates=0;
   uint32_t maxent = ::arg().asNum("max-ent-entries");
 
+  static const size_t progressInterval = 100000;
+
   dononterm:;
+  /* hash all the names needing it first, the loop below picks the results up in the same order */
+  vector<DNSName> ordernames;
+  if (haveNSEC3 && !narrow) {
+    vector<DNSName> tohash;
+    for (const auto& qname: qnames) {
+      if (nsec3set.count(qname)) {
+        tohash.push_back(qname);
+      }
+    }
+    hashOrderNames(ns3pr, tohash, ordernames);
+  }
+  auto nextOrdername = ordernames.begin();
+  size_t processed = 0;
+
   std::unordered_map<DNSName,RecordStatus>::const_iterator it;
   for (const auto& qname: qnames)
   {
+    if (++processed % progressInterval == 0) {
+      g_log<<Logger::Info<<"Rectifying zone '"<<zone<<"': "<<processed<<"/"<<qnames.size()<<(realrr ? " names" : " empty non-terminals")<<" done, "<<updates<<" updates so far"<<endl;
+    }
+
     bool auth=true;
     DNSName ordername;
     auto shorter(qname);
@@ -879,7 +945,7 @@ bool DNSSECKeeper::rectifyZone(const DNSName& zone, string& error, string& info,
     {
       if(nsec3set.count(qname)) {
         if(!narrow)
-          ordername=DNSName(toBase32Hex(hashQNameWithSalt(ns3pr, qname)));
+          ordername=std::move(*nextOrdername++);
         if(!realrr && !isOptOut)
           auth=true;
       }
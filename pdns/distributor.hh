@@ -41,7 +41,8 @@ extern StatBag S;
 /** the Distributor template class enables you to multithread slow question/answer 
     processes. 
     
-    Questions are posed to the Distributor, which returns the answer via a callback.
+    Questions are posed to the Distributor, which returns the answer via a callback,
+    along with the time the question was received.
 
     The Distributor spawns sufficient backends, and if they thrown an exception,
     it will cycle the backend but drop the query that was active during the exception.
@@ -51,11 +52,19 @@ template<class Answer, class Question, class Backend> class Distributor
 {
 public:
   static Distributor* Create(int n=1); //!< Create a new Distributor with \param n threads
-  typedef std::function<void(std::unique_ptr<Answer>&)> callback_t;
+  typedef std::function<void(std::unique_ptr<Answer>&, DTime received)> callback_t;
   virtual int question(Question&, callback_t callback) =0; //!< Submit a question to the Distributor
   virtual int getQueueSize() =0; //!< Returns length of question queue
   virtual bool isOverloaded() =0;
   virtual ~Distributor() { cerr<<__func__<<endl;}
+
+protected:
+  Distributor(): d_queueWaitLatency(S.getHistogram("latency-queue-wait"))
+  {
+  }
+
+  //! nullptr unless latency histograms are enabled
+  StatHistogram* const d_queueWaitLatency;
 };
 
 template<class Answer, class Question, class Backend> class SingleThreadDistributor
@@ -65,7 +74,7 @@ public:
   SingleThreadDistributor(const SingleThreadDistributor&) = delete;
   void operator=(const SingleThreadDistributor&) = delete;
   SingleThreadDistributor();
-  typedef std::function<void(std::unique_ptr<Answer>&)> callback_t;
+  typedef std::function<void(std::unique_ptr<Answer>&, DTime received)> callback_t;
   int question(Question&, callback_t callback) override; //!< Submit a question to the Distributor
   int getQueueSize() override {
     return 0;
@@ -87,7 +96,7 @@ public:
   MultiThreadDistributor(const MultiThreadDistributor&) = delete;
   void operator=(const MultiThreadDistributor&) = delete;
   MultiThreadDistributor(int n);
-  typedef std::function<void(std::unique_ptr<Answer>&)> callback_t;
+  typedef std::function<void(std::unique_ptr<Answer>&, DTime received)> callback_t;
   int question(Question&, callback_t callback) override; //!< Submit a question to the Distributor
   void distribute(int n);
   int getQueueSize() override {
@@ -102,6 +111,7 @@ public:
 
     Question Q;
     callback_t callback;
+    DTime enqueued;
     int id;
   };
 
@@ -197,6 +207,11 @@ template<class Answer, class Question, class Backend>void MultiThreadDistributor
       tempQD = nullptr;
       std::unique_ptr<Answer> a = nullptr;
 
+      if (this->d_queueWaitLatency != nullptr) {
+        (*this->d_queueWaitLatency)(QD->enqueued.udiffNoReset());
+      }
+      DTime received = QD->Q.d_dt; // the queue-limit check below resets d_dt
+
       if(queuetimeout && QD->Q.d_dt.udiff()>queuetimeout*1000) {
         S.inc("timedout-packets");
         continue;
@@ -241,7 +256,7 @@ retry:
         }
       }
 
-      QD->callback(a);
+      QD->callback(a, received);
       QD.reset();
     }
 
@@ -301,7 +316,7 @@ retry:
       goto retry;
     }
   }
-  callback(a);
+  callback(a, q.d_dt);
   return 0;
 }
 
@@ -313,6 +328,9 @@ template<class Answer, class Question, class Backend>int MultiThreadDistributor<
   auto QD=new QuestionData(q);
   auto ret = QD->id = nextid++; // might be deleted after write!
   QD->callback=callback;
+  if (this->d_queueWaitLatency != nullptr) {
+    QD->enqueued.set();
+  }
 
   ++d_queued;
   if(write(d_pipes.at(QD->id % d_pipes.size()).second, &QD, sizeof(QD)) != sizeof(QD)) {
@@ -180,6 +180,16 @@ size_t BackendMakerClass::numLauncheable() const
   return d_instances.size();
 }
 
+vector<string> BackendMakerClass::getInstanceNames() const
+{
+  vector<string> ret;
+  ret.reserve(d_instances.size());
+  for (const auto& instance : d_instances) {
+    ret.push_back(instance.first + instance.second);
+  }
+  return ret;
+}
+
 vector<DNSBackend *> BackendMakerClass::all(bool metadataOnly)
 {
   vector<DNSBackend *> ret;
@@ -433,6 +433,7 @@ public:
   void load(const string &module);
   size_t numLauncheable() const;
   vector<string> getModules();
+  vector<string> getInstanceNames() const; //!< "module" or "module-name" for each launched backend, in the order all() creates them
   void clear();
 
 private:
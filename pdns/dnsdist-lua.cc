@@ -728,6 +728,7 @@ static void setupLuaConfig(LuaContext& luaCtx, bool client, bool configCheck)
       else for(const auto& p : boost::get<vector<pair<int,string>>>(inp)) {
 	nmg.addMask(p.second);
       }
+      nmg.freeze();
       g_ACL.setState(nmg);
   });
 
@@ -753,6 +754,7 @@ static void setupLuaConfig(LuaContext& luaCtx, bool client, bool configCheck)
         nmg.addMask(line);
       }
 
+      nmg.freeze();
       g_ACL.setState(nmg);
   });
 
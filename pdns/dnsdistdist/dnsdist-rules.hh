@@ -175,7 +175,11 @@ private:
 class NMGRule : public DNSRule
 {
 public:
-  NMGRule(const NetmaskGroup& nmg) : d_nmg(nmg) {}
+  NMGRule(const NetmaskGroup& nmg) : d_nmg(nmg)
+  {
+    /* our copy is never modified, so lookups can use the flat version */
+    d_nmg.freeze();
+  }
 protected:
   NetmaskGroup d_nmg;
 };
@@ -559,6 +563,8 @@ class SuffixMatchNodeRule : public DNSRule
 public:
   SuffixMatchNodeRule(const SuffixMatchNode& smn, bool quiet=false) : d_smn(smn), d_quiet(quiet)
   {
+    /* our copy is never modified, so lookups can use the flat version */
+    d_smn.freeze();
   }
   bool matches(const DNSQuestion* dq) const override
   {
@@ -481,28 +481,6 @@ void TCPConnectionToBackend::notifyAllQueriesFailed(const struct timeval& now, F
   release();
 }
 
-static uint32_t getSerialFromRawSOAContent(const std::vector<uint8_t>& raw)
-{
-  /* minimal size for a SOA record, as defined by rfc1035:
-     MNAME (root): 1
-     RNAME (root): 1
-     SERIAL: 4
-     REFRESH: 4
-     RETRY: 4
-     EXPIRE: 4
-     MINIMUM: 4
-     = 22 bytes
-  */
-  if (raw.size() < 22) {
-    throw std::runtime_error("Invalid content of size " + std::to_string(raw.size()) + " for a SOA record");
-  }
-  /* As rfc1025 states that "all domain names in the RDATA section of these RRs may be compressed",
-     and we don't want to parse these names, start at the end */
-  uint32_t serial = 0;
-  memcpy(&serial, &raw.at(raw.size() - 20), sizeof(serial));
-  return ntohl(serial);
-}
-
 IOState TCPConnectionToBackend::handleResponse(std::shared_ptr<TCPConnectionToBackend>& conn, const struct timeval& now)
 {
   d_downstreamFailures = 0;
@@ -652,22 +630,18 @@ bool TCPConnectionToBackend::isXFRFinished(const TCPResponse& response, TCPQuery
 {
   bool done = false;
   try {
-    MOADNSParser parser(true, reinterpret_cast<const char*>(response.d_buffer.data()), response.d_buffer.size());
-    if (parser.d_header.rcode != 0U) {
+    /* we only care about the SOA serials, no need to parse every record of the transfer */
+    DNSPacketView view(true, reinterpret_cast<const char*>(response.d_buffer.data()), response.d_buffer.size());
+    if (view.d_header.rcode != 0U) {
       done = true;
     }
     else {
-      for (const auto& record : parser.d_answers) {
-        if (record.first.d_class != QClass::IN || record.first.d_type != QType::SOA) {
+      for (const auto& record : view.getRecords()) {
+        if (record.d_class != QClass::IN || record.d_type != QType::SOA) {
           continue;
         }
 
-        auto unknownContent = getRR<UnknownRecordContent>(record.first);
-        if (!unknownContent) {
-          continue;
-        }
-        auto raw = unknownContent->getRawContent();
-        auto serial = getSerialFromRawSOAContent(raw);
+        auto serial = view.getSOASerial(record);
 
         ++query.d_xfrSerialCount;
         if (query.d_xfrMasterSerial == 0) {
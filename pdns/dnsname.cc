@@ -22,9 +22,13 @@
 #include "dnsname.hh"
 #include <boost/format.hpp>
 #include <string>
+#include <array>
 #include <cinttypes>
+#include <string_view>
+#include <unordered_map>
 
 #include "dnswriter.hh"
+#include "lock.hh"
 #include "misc.hh"
 
 #include <boost/functional/hash.hpp>
@@ -62,7 +66,7 @@ DNSName::DNSName(const char* p, size_t length)
         for(; iter != pend && *iter!='.'; ++iter) {
           labellen++;
         }
-        d_storage.append(begiter,iter);
+        d_storage.append(begiter, iter - begiter);
         if(iter != pend)
           ++iter;
         if(labellen > 63)
@@ -248,12 +252,7 @@ bool DNSName::isPartOf(const DNSName& parent) const
       break;
     }
     if (static_cast<size_t>(distance) == parent.d_storage.size()) {
-      auto p = parent.d_storage.cbegin();
-      for(; us != d_storage.cend(); ++us, ++p) {
-        if(dns_tolower(*p) != dns_tolower(*us))
-          return false;
-      }
-      return true;
+      return dns_equal_ci((const unsigned char*)us, (const unsigned char*)parent.d_storage.c_str(), parent.d_storage.size());
     }
     if (*us < 0) {
       throw std::out_of_range("negative label length in dnsname");
@@ -353,9 +352,10 @@ void DNSName::prependRawLabel(const std::string& label)
   if(d_storage.empty())
     d_storage.append(1, (char)0);
 
-  string_t prep(1, (char)label.size());
-  prep.append(label.c_str(), label.size());
-  d_storage = prep+d_storage;
+  char prep[64];
+  prep[0] = static_cast<char>(label.size());
+  memcpy(&prep[1], label.c_str(), label.size());
+  d_storage.insert(0, prep, label.size() + 1);
 }
 
 bool DNSName::slowCanonCompare(const DNSName& rhs) const 
@@ -445,6 +445,86 @@ size_t hash_value(DNSName const& d)
   return d.hash();
 }
 
+/* the process-wide table of interned names, sharded to keep threads from waiting on each other.
+   The table holds a reference to each buffer, which is only dropped by purge() once no name uses it anymore. */
+class DNSNameInternTable
+{
+public:
+  DNSNameStorage::SharedBuffer* get(const char* data, size_t size)
+  {
+    std::string_view key(data, size);
+    auto& shard = d_shards.at(std::hash<std::string_view>()(key) % d_shards.size());
+    auto map = shard.lock();
+    auto it = map->find(key);
+    if (it == map->end()) {
+      auto shared = DNSNameStorage::makeSharedBuffer(data, size);
+      it = map->emplace(std::string_view(shared->data(), size), shared).first;
+    }
+    it->second->d_refcount.fetch_add(1, std::memory_order_relaxed);
+    return it->second;
+  }
+
+  size_t purge()
+  {
+    size_t removed = 0;
+    for (auto& shard : d_shards) {
+      auto map = shard.lock();
+      for (auto it = map->begin(); it != map->end();) {
+        /* a name can only get a new reference to a buffer through another name or from us, under the lock */
+        if (it->second->d_refcount.load(std::memory_order_acquire) == 1) {
+          DNSNameStorage::releaseSharedBuffer(it->second);
+          it = map->erase(it);
+          ++removed;
+        }
+        else {
+          ++it;
+        }
+      }
+    }
+    return removed;
+  }
+
+  size_t size()
+  {
+    size_t count = 0;
+    for (auto& shard : d_shards) {
+      count += shard.lock()->size();
+    }
+    return count;
+  }
+
+private:
+  std::array<LockGuarded<std::unordered_map<std::string_view, DNSNameStorage::SharedBuffer*>>, 64> d_shards;
+};
+
+static DNSNameInternTable& getInternTable()
+{
+  static DNSNameInternTable table;
+  return table;
+}
+
+void DNSNameStorage::intern()
+{
+  if (d_mode != Mode::Heap) {
+    /* names stored inline do not allocate, interned ones are already shared */
+    return;
+  }
+  SharedBuffer* shared = getInternTable().get(data(), d_size);
+  size_type size = d_size;
+  release();
+  setSharedBuffer(shared, size);
+}
+
+size_t DNSNameStorage::purgeInterned()
+{
+  return getInternTable().purge();
+}
+
+size_t DNSNameStorage::getInternedCount()
+{
+  return getInternTable().size();
+}
+
 void DNSName::appendEscapedLabel(std::string& appendTo, const char* orig, size_t len)
 {
   size_t pos = 0;
@@ -20,6 +20,8 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 #pragma once
+#include <algorithm>
+#include <atomic>
 #include <cstring>
 #include <string>
 #include <vector>
@@ -29,14 +31,12 @@
 #include <stdexcept>
 #include <sstream>
 #include <iterator>
+#include <limits>
+#include <memory>
 #include <unordered_set>
 
 #include <boost/version.hpp>
 
-#if BOOST_VERSION >= 105300
-#include <boost/container/string.hpp>
-#endif
-
 #include "ascii.hh"
 
 uint32_t burtleCI(const unsigned char* k, uint32_t length, uint32_t init);
@@ -58,6 +58,458 @@ uint32_t burtleCI(const unsigned char* k, uint32_t length, uint32_t init);
    NOTE: For now, everything MUST be . terminated, otherwise it is an error
 */
 
+/* Storage for the wire format of a DNSName, offering the parts of the std::string interface that
+   DNSName and the users of DNSName::getStorage() need.
+   Up to s_inlineCapacity bytes are kept in the object itself, which is the size of a cache line.
+   That covers the vast majority of names, so parsing a name, copying it or storing it in a cache does
+   not involve the heap at all. Longer names are moved to a heap buffer owned by the object.
+   A long name can also be interned: it then points to a read-only, reference-counted buffer taken
+   from a process-wide table, shared by all the interned copies of the same name. Copying an interned
+   name does not allocate, and modifying it first turns it back into a private copy.
+*/
+class DNSNameStorage
+{
+public:
+  typedef char value_type;
+  typedef size_t size_type;
+  typedef char* iterator;
+  typedef const char* const_iterator;
+  typedef std::reverse_iterator<iterator> reverse_iterator;
+  typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+
+  static constexpr size_type npos = std::numeric_limits<size_type>::max();
+  static constexpr size_type s_inlineCapacity = 60; // one byte is kept for the terminating zero
+
+  DNSNameStorage() noexcept
+  {
+    d_buffer[0] = 0;
+  }
+
+  DNSNameStorage(size_type count, char c) : DNSNameStorage()
+  {
+    append(count, c);
+  }
+
+  DNSNameStorage(const DNSNameStorage& rhs)
+  {
+    copyFrom(rhs);
+  }
+
+  DNSNameStorage(DNSNameStorage&& rhs) noexcept
+  {
+    takeFrom(rhs);
+  }
+
+  ~DNSNameStorage()
+  {
+    release();
+  }
+
+  DNSNameStorage& operator=(const DNSNameStorage& rhs)
+  {
+    if (this != &rhs) {
+      if (d_mode == Mode::Heap && rhs.d_mode != Mode::Shared && rhs.d_size <= getHeapCapacity()) {
+        /* reuse our buffer */
+        memcpy(getHeapPointer(), rhs.data(), rhs.d_size + 1);
+        d_size = rhs.d_size;
+      }
+      else {
+        release();
+        copyFrom(rhs);
+      }
+    }
+    return *this;
+  }
+
+  DNSNameStorage& operator=(DNSNameStorage&& rhs) noexcept
+  {
+    if (this != &rhs) {
+      release();
+      takeFrom(rhs);
+    }
+    return *this;
+  }
+
+  size_type size() const
+  {
+    return d_size;
+  }
+
+  size_type length() const
+  {
+    return d_size;
+  }
+
+  bool empty() const
+  {
+    return d_size == 0;
+  }
+
+  size_type capacity() const
+  {
+    switch (d_mode) {
+    case Mode::Heap:
+      return getHeapCapacity();
+    case Mode::Shared:
+      return d_size;
+    default:
+      return s_inlineCapacity;
+    }
+  }
+
+  void reserve(size_type newCapacity)
+  {
+    unshare();
+    if (newCapacity > capacity()) {
+      grow(newCapacity);
+    }
+  }
+
+  void clear()
+  {
+    if (d_mode == Mode::Shared) {
+      release();
+      d_mode = Mode::Inline;
+    }
+    setSize(0);
+  }
+
+  const char* data() const
+  {
+    switch (d_mode) {
+    case Mode::Heap:
+      return getHeapPointer();
+    case Mode::Shared:
+      return getSharedBuffer()->data();
+    default:
+      return d_buffer;
+    }
+  }
+
+  char* data()
+  {
+    unshare();
+    return d_mode == Mode::Heap ? getHeapPointer() : d_buffer;
+  }
+
+  const char* c_str() const
+  {
+    return data();
+  }
+
+  char operator[](size_type pos) const
+  {
+    return data()[pos];
+  }
+
+  char& operator[](size_type pos)
+  {
+    return data()[pos];
+  }
+
+  char at(size_type pos) const
+  {
+    if (pos >= d_size) {
+      throw std::out_of_range("Trying to access position " + std::to_string(pos) + " of a DNSName storage of size " + std::to_string(d_size));
+    }
+    return data()[pos];
+  }
+
+  iterator begin() { return data(); }
+  iterator end() { return data() + d_size; }
+  const_iterator begin() const { return data(); }
+  const_iterator end() const { return data() + d_size; }
+  const_iterator cbegin() const { return data(); }
+  const_iterator cend() const { return data() + d_size; }
+  reverse_iterator rbegin() { return reverse_iterator(end()); }
+  reverse_iterator rend() { return reverse_iterator(begin()); }
+  const_reverse_iterator rbegin() const { return const_reverse_iterator(end()); }
+  const_reverse_iterator rend() const { return const_reverse_iterator(begin()); }
+
+  DNSNameStorage& assign(size_type count, char c)
+  {
+    clear();
+    return append(count, c);
+  }
+
+  DNSNameStorage& append(size_type count, char c)
+  {
+    if (count == 1 && d_mode == Mode::Inline && d_size < s_inlineCapacity) {
+      /* the common case of adding a label length or the root label while building a name */
+      d_buffer[d_size++] = c;
+      d_buffer[d_size] = 0;
+      return *this;
+    }
+    size_type oldSize = d_size;
+    reserveForAppend(count);
+    memset(data() + oldSize, c, count);
+    setSize(oldSize + count);
+    return *this;
+  }
+
+  DNSNameStorage& append(const char* str, size_type count)
+  {
+    if (d_mode == Mode::Inline && count <= s_inlineCapacity - d_size) {
+      memcpy(d_buffer + d_size, str, count);
+      d_size += count;
+      d_buffer[d_size] = 0;
+      return *this;
+    }
+    return insert(d_size, str, count);
+  }
+
+  DNSNameStorage& operator+=(const DNSNameStorage& rhs)
+  {
+    return append(rhs.data(), rhs.size());
+  }
+
+  DNSNameStorage& insert(size_type pos, const char* str, size_type count)
+  {
+    return replace(pos, 0, str, count);
+  }
+
+  DNSNameStorage& erase(size_type pos = 0, size_type count = npos)
+  {
+    checkPosition(pos);
+    count = std::min(count, d_size - pos);
+    char* ptr = data();
+    memmove(ptr + pos, ptr + pos + count, d_size - pos - count);
+    setSize(d_size - count);
+    return *this;
+  }
+
+  //! Replaces count bytes starting at pos (or up to the end, whichever comes first) with rhs
+  DNSNameStorage& replace(size_type pos, size_type count, const DNSNameStorage& rhs)
+  {
+    if (this == &rhs) {
+      DNSNameStorage copy(rhs);
+      return replace(pos, count, copy.data(), copy.size());
+    }
+    return replace(pos, count, rhs.data(), rhs.size());
+  }
+
+  DNSNameStorage& replace(size_type pos, size_type count, const char* str, size_type strCount)
+  {
+    checkPosition(pos);
+    count = std::min(count, d_size - pos);
+    size_type oldSize = d_size;
+    size_type newSize = oldSize - count + strCount;
+    const char* current = static_cast<const DNSNameStorage*>(this)->data();
+    if (str >= current && str < current + oldSize) {
+      /* the source is about to be moved around */
+      std::string copy(str, strCount);
+      return replace(pos, count, copy.data(), copy.size());
+    }
+    unshare();
+    if (newSize > oldSize) {
+      reserveForAppend(newSize - oldSize);
+    }
+    char* ptr = data();
+    memmove(ptr + pos + strCount, ptr + pos + count, oldSize - pos - count);
+    memmove(ptr + pos, str, strCount);
+    setSize(newSize);
+    return *this;
+  }
+
+  int compare(size_type pos, size_type count, const DNSNameStorage& rhs) const
+  {
+    checkPosition(pos);
+    count = std::min(count, d_size - pos);
+    int res = memcmp(data() + pos, rhs.data(), std::min(count, rhs.size()));
+    if (res != 0) {
+      return res;
+    }
+    return count < rhs.size() ? -1 : (count > rhs.size() ? 1 : 0);
+  }
+
+  //! Switches to the buffer of the process-wide table holding the same content, adding it first if needed. Does nothing for names stored inline.
+  void intern();
+  bool isInterned() const
+  {
+    return d_mode == Mode::Shared;
+  }
+  //! Removes the buffers no longer used by any name from the process-wide table, returning how many were removed
+  static size_t purgeInterned();
+  //! Number of buffers in the process-wide table
+  static size_t getInternedCount();
+
+private:
+  enum class Mode : uint8_t { Inline, Heap, Shared };
+
+  /* header of a buffer owned by the intern table, the name itself follows it */
+  struct SharedBuffer
+  {
+    SharedBuffer() : d_refcount(1)
+    {
+    }
+
+    char* data()
+    {
+      return reinterpret_cast<char*>(this + 1);
+    }
+
+    std::atomic<uint32_t> d_refcount;
+  };
+
+  friend class DNSNameInternTable;
+
+  /* the longest name is 255 bytes, growing to this straight away saves reallocations while a name is being built */
+  static constexpr size_type s_heapCapacity = 256;
+
+  static SharedBuffer* makeSharedBuffer(const char* str, size_type count)
+  {
+    void* mem = ::operator new(sizeof(SharedBuffer) + count + 1);
+    auto shared = new (mem) SharedBuffer();
+    memcpy(shared->data(), str, count);
+    shared->data()[count] = 0;
+    return shared;
+  }
+
+  static void releaseSharedBuffer(SharedBuffer* shared)
+  {
+    if (shared->d_refcount.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      shared->~SharedBuffer();
+      ::operator delete(shared);
+    }
+  }
+
+  char* getHeapPointer() const
+  {
+    char* ptr;
+    memcpy(&ptr, d_buffer, sizeof(ptr));
+    return ptr;
+  }
+
+  size_type getHeapCapacity() const
+  {
+    uint16_t heapCapacity;
+    memcpy(&heapCapacity, d_buffer + sizeof(char*), sizeof(heapCapacity));
+    return heapCapacity;
+  }
+
+  SharedBuffer* getSharedBuffer() const
+  {
+    SharedBuffer* shared;
+    memcpy(&shared, d_buffer, sizeof(shared));
+    return shared;
+  }
+
+  /* takes over a reference to shared, the current content must have been released */
+  void setSharedBuffer(SharedBuffer* shared, size_type size)
+  {
+    memcpy(d_buffer, &shared, sizeof(shared));
+    d_size = size;
+    d_mode = Mode::Shared;
+  }
+
+  void release() noexcept
+  {
+    if (d_mode == Mode::Heap) {
+      delete[] getHeapPointer();
+    }
+    else if (d_mode == Mode::Shared) {
+      releaseSharedBuffer(getSharedBuffer());
+    }
+  }
+
+  /* the current content must have been released */
+  void copyFrom(const DNSNameStorage& rhs)
+  {
+    d_size = rhs.d_size;
+    d_mode = rhs.d_mode;
+    if (rhs.d_mode == Mode::Inline) {
+      /* copying the whole buffer is cheaper than finding out how much of it we need */
+      memcpy(d_buffer, rhs.d_buffer, sizeof(d_buffer));
+    }
+    else if (rhs.d_mode == Mode::Shared) {
+      SharedBuffer* shared = rhs.getSharedBuffer();
+      shared->d_refcount.fetch_add(1, std::memory_order_relaxed);
+      memcpy(d_buffer, &shared, sizeof(shared));
+    }
+    else if (rhs.d_size <= s_inlineCapacity) {
+      /* it might have been shortened since it was moved to the heap */
+      d_mode = Mode::Inline;
+      memcpy(d_buffer, rhs.getHeapPointer(), rhs.d_size + 1);
+    }
+    else {
+      d_mode = Mode::Inline;
+      d_size = 0;
+      grow(rhs.d_size);
+      memcpy(getHeapPointer(), rhs.getHeapPointer(), rhs.d_size + 1);
+      d_size = rhs.d_size;
+    }
+  }
+
+  /* makes sure that we own our buffer before it gets modified */
+  void unshare()
+  {
+    if (d_mode != Mode::Shared) {
+      return;
+    }
+    SharedBuffer* shared = getSharedBuffer();
+    size_type size = d_size;
+    d_mode = Mode::Inline;
+    d_size = 0;
+    d_buffer[0] = 0;
+    append(shared->data(), size);
+    releaseSharedBuffer(shared);
+  }
+
+  void setSize(size_type newSize)
+  {
+    d_size = newSize;
+    data()[newSize] = 0;
+  }
+
+  void checkPosition(size_type pos) const
+  {
+    if (pos > d_size) {
+      throw std::out_of_range("Trying to access position " + std::to_string(pos) + " of a DNSName storage of size " + std::to_string(d_size));
+    }
+  }
+
+  void reserveForAppend(size_type count)
+  {
+    unshare();
+    if (count > capacity() - d_size) {
+      grow(std::max(d_size + count, std::min(s_heapCapacity, 2 * capacity())));
+    }
+  }
+
+  void grow(size_type newCapacity)
+  {
+    if (newCapacity > std::numeric_limits<uint16_t>::max()) {
+      throw std::range_error("name too long");
+    }
+    char* newBuffer = new char[newCapacity + 1];
+    memcpy(newBuffer, data(), d_size + 1);
+    if (d_mode == Mode::Heap) {
+      delete[] getHeapPointer();
+    }
+    uint16_t heapCapacity = newCapacity;
+    memcpy(d_buffer, &newBuffer, sizeof(newBuffer));
+    memcpy(d_buffer + sizeof(char*), &heapCapacity, sizeof(heapCapacity));
+    d_mode = Mode::Heap;
+  }
+
+  void takeFrom(DNSNameStorage& rhs) noexcept
+  {
+    memcpy(d_buffer, rhs.d_buffer, rhs.d_mode != Mode::Inline ? sizeof(char*) + sizeof(uint16_t) : rhs.d_size + 1);
+    d_size = rhs.d_size;
+    d_mode = rhs.d_mode;
+    rhs.d_mode = Mode::Inline;
+    rhs.d_size = 0;
+    rhs.d_buffer[0] = 0;
+  }
+
+  /* holds the name inline, or the pointer to the heap buffer followed by its capacity, or the pointer to the shared buffer */
+  char d_buffer[s_inlineCapacity + 1];
+  Mode d_mode{Mode::Inline};
+  uint16_t d_size{0};
+};
+
+static_assert(sizeof(DNSNameStorage) == 64, "DNSNameStorage should fit in a cache line");
+
 class DNSName
 {
 public:
@@ -111,9 +563,8 @@ public:
   }
   void makeUsLowerCase()
   {
-    for(auto & c : d_storage) {
-      c=dns_tolower(c);
-    }
+    auto data = reinterpret_cast<unsigned char*>(d_storage.data());
+    dns_tolower_buffer(data, data, d_storage.size());
   }
   void makeUsRelative(const DNSName& zone);
   DNSName getCommonLabels(const DNSName& other) const; //!< Return the list of common labels from the top, for example 'c.d' for 'a.b.c.d' and 'x.y.c.d'
@@ -157,14 +608,19 @@ public:
   inline bool canonCompare(const DNSName& rhs) const;
   bool slowCanonCompare(const DNSName& rhs) const;  
 
-#if BOOST_VERSION >= 105300
-  typedef boost::container::string string_t;
-#else
-  typedef std::string string_t;
-#endif
+  typedef DNSNameStorage string_t;
   const string_t& getStorage() const {
     return d_storage;
   }
+  //! Share our storage with the other interned copies of the same name, for names kept for a long time (cache keys). Only names too long to be stored inline are affected.
+  void intern()
+  {
+    d_storage.intern();
+  }
+  bool isInterned() const
+  {
+    return d_storage.isInterned();
+  }
 
   bool has8bitBytes() const; /* returns true if at least one byte of the labels forming the name is not included in [A-Za-z0-9_*./@ \\:-] */
 
@@ -209,28 +665,12 @@ inline bool DNSName::canonCompare(const DNSName& rhs) const
     ourcount--;
     rhscount--;
 
-    bool res=std::lexicographical_compare(
-					  d_storage.c_str() + ourpos[ourcount] + 1, 
-					  d_storage.c_str() + ourpos[ourcount] + 1 + *(d_storage.c_str() + ourpos[ourcount]),
-					  rhs.d_storage.c_str() + rhspos[rhscount] + 1, 
-					  rhs.d_storage.c_str() + rhspos[rhscount] + 1 + *(rhs.d_storage.c_str() + rhspos[rhscount]),
-					  [](const unsigned char& a, const unsigned char& b) {
-					    return dns_tolower(a) < dns_tolower(b);
-					  });
-    
-    //    cout<<"Forward: "<<res<<endl;
-    if(res)
+    const unsigned char* ourlabel = (const unsigned char*)d_storage.c_str() + ourpos[ourcount];
+    const unsigned char* rhslabel = (const unsigned char*)rhs.d_storage.c_str() + rhspos[rhscount];
+    int res = dns_compare_ci(ourlabel + 1, *ourlabel, rhslabel + 1, *rhslabel);
+    if(res < 0)
       return true;
-
-    res=std::lexicographical_compare(	  rhs.d_storage.c_str() + rhspos[rhscount] + 1, 
-					  rhs.d_storage.c_str() + rhspos[rhscount] + 1 + *(rhs.d_storage.c_str() + rhspos[rhscount]),
-					  d_storage.c_str() + ourpos[ourcount] + 1, 
-					  d_storage.c_str() + ourpos[ourcount] + 1 + *(d_storage.c_str() + ourpos[ourcount]),
-					  [](const unsigned char& a, const unsigned char& b) {
-					    return dns_tolower(a) < dns_tolower(b);
-					  });
-    //    cout<<"Reverse: "<<res<<endl;
-    if(res)
+    if(res > 0)
       return false;
   }
   return false;
@@ -428,6 +868,164 @@ struct SuffixMatchTree
   }
 };
 
+/* Immutable, flattened copy of a SuffixMatchTree, for lists that are built once and then
+   looked up a lot. The nodes live in a single vector, and the parent -> child edges in a
+   single open addressing hash table keyed on the parent index and the lowercased label.
+   A lookup walks the labels of the name straight from its storage, doing one probe per label
+   and no allocation.
+   The SuffixMatchTree serves as the builder: fill it, construct a FlatSuffixMatchTree from it
+   and publish that one (via a GlobalStateHolder or a shared_ptr) to replace the old one at once.
+*/
+template<typename T>
+class FlatSuffixMatchTree
+{
+public:
+  FlatSuffixMatchTree(): d_edges(1), d_nodes{s_noValue}
+  {
+  }
+
+  explicit FlatSuffixMatchTree(const SuffixMatchTree<T>& tree)
+  {
+    size_t edgesCount = countEdges(tree);
+    size_t tableSize = 1;
+    /* keep the load factor at or below 0.5 so that probe sequences stay short */
+    while (tableSize < edgesCount * 2) {
+      tableSize <<= 1;
+    }
+    d_edges.resize(tableSize);
+    d_mask = tableSize - 1;
+    d_nodes.reserve(edgesCount + 1);
+    d_nodes.push_back(s_noValue);
+    addChildren(tree, 0);
+  }
+
+  /* returns the value of the longest suffix of name present in the tree, like SuffixMatchTree::lookup() */
+  const T* lookup(const DNSName& name) const
+  {
+    const T* result = getValue(0);
+    if (d_nodes.size() == 1) {
+      return result;
+    }
+
+    const auto& storage = name.getStorage();
+    const unsigned char* data = reinterpret_cast<const unsigned char*>(storage.data());
+    /* a name is at most 255 bytes long, so it has at most 127 labels and every offset fits in a byte */
+    uint8_t offsets[128];
+    size_t labelsCount = 0;
+    for (size_t pos = 0; pos < storage.size() && data[pos] != 0 && labelsCount < sizeof(offsets); pos += data[pos] + 1) {
+      offsets[labelsCount++] = pos;
+    }
+
+    uint32_t node = 0;
+    while (labelsCount > 0) {
+      --labelsCount;
+      const unsigned char* label = data + offsets[labelsCount];
+      node = findChild(node, label + 1, *label);
+      if (node == 0) {
+        break;
+      }
+      const T* value = getValue(node);
+      if (value != nullptr) {
+        result = value;
+      }
+    }
+
+    return result;
+  }
+
+  bool empty() const
+  {
+    return d_values.empty();
+  }
+
+private:
+  struct Edge
+  {
+    uint32_t d_parent{0};
+    uint32_t d_labelOffset{0};
+    uint32_t d_child{0}; // 0 is the root, never a child, so it marks an empty slot
+    uint8_t d_labelLength{0};
+  };
+
+  /* not a plain T, we need to hand out pointers and std::vector<bool> does not have any */
+  struct Value
+  {
+    T d_value;
+  };
+
+  static constexpr uint32_t s_noValue = std::numeric_limits<uint32_t>::max();
+
+  static size_t countEdges(const SuffixMatchTree<T>& tree)
+  {
+    size_t count = tree.children.size();
+    for (const auto& child : tree.children) {
+      count += countEdges(child);
+    }
+    return count;
+  }
+
+  void addChildren(const SuffixMatchTree<T>& tree, uint32_t index)
+  {
+    if (tree.endNode) {
+      d_nodes.at(index) = d_values.size();
+      d_values.push_back({tree.d_value});
+    }
+
+    for (const auto& child : tree.children) {
+      uint32_t childIndex = d_nodes.size();
+      d_nodes.push_back(s_noValue);
+
+      /* siblings are unique without regard to case in the SuffixMatchTree, so they are once lowercased */
+      Edge edge;
+      edge.d_parent = index;
+      edge.d_labelOffset = d_labels.size();
+      edge.d_labelLength = child.d_name.size();
+      edge.d_child = childIndex;
+      for (const auto c : child.d_name) {
+        d_labels.push_back(dns_tolower(c));
+      }
+
+      uint32_t slot = burtleCI(reinterpret_cast<const unsigned char*>(child.d_name.data()), child.d_name.size(), index) & d_mask;
+      while (d_edges[slot].d_child != 0) {
+        slot = (slot + 1) & d_mask;
+      }
+      d_edges[slot] = edge;
+
+      addChildren(child, childIndex);
+    }
+  }
+
+  uint32_t findChild(uint32_t parent, const unsigned char* label, uint8_t length) const
+  {
+    for (uint32_t slot = burtleCI(label, length, parent) & d_mask; d_edges[slot].d_child != 0; slot = (slot + 1) & d_mask) {
+      const auto& edge = d_edges[slot];
+      if (edge.d_parent != parent || edge.d_labelLength != length) {
+        continue;
+      }
+      const char* stored = d_labels.data() + edge.d_labelOffset;
+      uint8_t idx = 0;
+      while (idx < length && static_cast<char>(dns_tolower(label[idx])) == stored[idx]) {
+        ++idx;
+      }
+      if (idx == length) {
+        return edge.d_child;
+      }
+    }
+    return 0;
+  }
+
+  const T* getValue(uint32_t node) const
+  {
+    return d_nodes[node] == s_noValue ? nullptr : &d_values[d_nodes[node]].d_value;
+  }
+
+  std::vector<Edge> d_edges;
+  std::vector<uint32_t> d_nodes; // index of the value in d_values, or s_noValue if not an end node
+  std::vector<Value> d_values;
+  std::string d_labels; // all labels, lowercased, back to back
+  uint32_t d_mask{0};
+};
+
 /* Quest in life: serve as a rapid block list. If you add a DNSName to a root SuffixMatchNode,
    anything part of that domain will return 'true' in check */
 struct SuffixMatchNode
@@ -441,6 +1039,7 @@ struct SuffixMatchNode
     {
       d_tree.add(dnsname, true);
       d_nodes.insert(dnsname);
+      d_frozen.reset();
     }
 
     void add(const std::string& name)
@@ -451,6 +1050,7 @@ struct SuffixMatchNode
     void add(std::vector<std::string> labels)
     {
       d_tree.add(labels, true);
+      d_frozen.reset();
       DNSName tmp;
       while (!labels.empty()) {
         tmp.appendRawLabel(labels.back());
@@ -463,11 +1063,13 @@ struct SuffixMatchNode
     {
       d_tree.remove(name);
       d_nodes.erase(name);
+      d_frozen.reset();
     }
 
     void remove(std::vector<std::string> labels)
     {
       d_tree.remove(labels);
+      d_frozen.reset();
       DNSName tmp;
       while (!labels.empty()) {
         tmp.appendRawLabel(labels.back());
@@ -476,8 +1078,18 @@ struct SuffixMatchNode
       d_nodes.erase(tmp);
     }
 
+    /* Builds a flat, immutable copy of the names added so far, which check() uses until
+       the next add() or remove(). Call it once the node has been filled, before sharing it. */
+    void freeze()
+    {
+      d_frozen = std::make_shared<const FlatSuffixMatchTree<bool>>(d_tree);
+    }
+
     bool check(const DNSName& dnsname) const
     {
+      if (d_frozen) {
+        return d_frozen->lookup(dnsname) != nullptr;
+      }
       return d_tree.lookup(dnsname) != nullptr;
     }
 
@@ -497,6 +1109,7 @@ struct SuffixMatchNode
 
   private:
     mutable std::set<DNSName> d_nodes; // Only used for string generation
+    std::shared_ptr<const FlatSuffixMatchTree<bool>> d_frozen{nullptr};
 };
 
 std::ostream & operator<<(std::ostream &os, const DNSName& d);
@@ -513,13 +1126,7 @@ bool DNSName::operator==(const DNSName& rhs) const
   if(rhs.empty() != empty() || rhs.d_storage.size() != d_storage.size())
     return false;
 
-  auto us = d_storage.cbegin();
-  auto p = rhs.d_storage.cbegin();
-  for(; us != d_storage.cend() && p != rhs.d_storage.cend(); ++us, ++p) { 
-    if(dns_tolower(*p) != dns_tolower(*us))
-      return false;
-  }
-  return true;
+  return dns_equal_ci((const unsigned char*)d_storage.c_str(), (const unsigned char*)rhs.d_storage.c_str(), d_storage.size());
 }
 
 extern const DNSName g_rootdnsname, g_wildcarddnsname;
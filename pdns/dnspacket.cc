@@ -53,12 +53,80 @@
 
 bool DNSPacket::s_doEDNSSubnetProcessing;
 uint16_t DNSPacket::s_udpTruncationThreshold;
- 
+
+/* The buffers of the answers this thread is done with, handed to the next answers it builds so that
+   answering a query does not allocate them again and again. */
+class DNSPacketBufferPool
+{
+public:
+  ~DNSPacketBufferPool()
+  {
+    /* packets might still be destroyed by this thread after us */
+    t_poolDestroyed = true;
+  }
+
+  static DNSPacketBufferPool* get()
+  {
+    if (t_poolDestroyed) {
+      return nullptr;
+    }
+    static thread_local DNSPacketBufferPool pool;
+    return &pool;
+  }
+
+  void acquire(string& rawPacket, vector<DNSZoneRecord>& rrs)
+  {
+    if (!d_rawPackets.empty()) {
+      rawPacket = std::move(d_rawPackets.back());
+      d_rawPackets.pop_back();
+    }
+    if (!d_records.empty()) {
+      rrs = std::move(d_records.back());
+      d_records.pop_back();
+    }
+  }
+
+  void release(string& rawPacket, vector<DNSZoneRecord>& rrs)
+  {
+    /* don't keep the huge buffers used for AXFR around */
+    if (d_rawPackets.size() < s_maxBuffers && rawPacket.capacity() <= s_maxRawPacketCapacity) {
+      rawPacket.clear();
+      d_rawPackets.push_back(std::move(rawPacket));
+    }
+    if (d_records.size() < s_maxBuffers && rrs.capacity() > 0 && rrs.capacity() <= s_maxRecordsCapacity) {
+      rrs.clear();
+      d_records.push_back(std::move(rrs));
+    }
+  }
+
+  //! The buffer DNSPacketWriter builds the answers in, before they are copied to the packet
+  vector<uint8_t> d_writerBuffer;
+
+private:
+  static constexpr size_t s_maxBuffers = 16;
+  static constexpr size_t s_maxRawPacketCapacity = 65535;
+  static constexpr size_t s_maxRecordsCapacity = 1024;
+  static thread_local bool t_poolDestroyed;
+
+  vector<string> d_rawPackets;
+  vector<vector<DNSZoneRecord>> d_records;
+};
+
+thread_local bool DNSPacketBufferPool::t_poolDestroyed{false};
+
 DNSPacket::DNSPacket(bool isQuery): d_isQuery(isQuery)
 {
   memset(&d, 0, sizeof(d));
 }
 
+DNSPacket::~DNSPacket()
+{
+  auto pool = DNSPacketBufferPool::get();
+  if (pool != nullptr) {
+    pool->release(d_rawpacket, d_rrs);
+  }
+}
+
 const string& DNSPacket::getString()
 {
   if(!d_wrapped)
@@ -239,7 +307,9 @@ void DNSPacket::wrapup()
   }
   d_wrapped=true;
 
-  vector<uint8_t> packet;
+  auto pool = DNSPacketBufferPool::get();
+  vector<uint8_t> localPacket;
+  vector<uint8_t>& packet = pool != nullptr ? pool->d_writerBuffer : localPacket;
   DNSPacketWriter pw(packet, qdomain, qtype.getCode(), qclass);
 
   pw.getHeader()->rcode=d.rcode;
@@ -340,7 +410,7 @@ void DNSPacket::wrapup()
   if(d_trc.d_algoName.countLabels())
     addTSIG(pw, d_trc, d_tsigkeyname, d_tsigsecret, d_tsigprevious, d_tsigtimersonly);
   
-  d_rawpacket.assign((char*)&packet[0], packet.size()); // XXX we could do this natively on a vector..
+  d_rawpacket.assign((char*)&packet[0], packet.size()); // no allocation when d_rawpacket comes from the pool
 
   // copy RR counts so they can be read later
   d.qdcount = pw.getHeader()->qdcount;
@@ -366,6 +436,10 @@ void DNSPacket::setQuestion(int op, const DNSName &qd, int newqtype)
 std::unique_ptr<DNSPacket> DNSPacket::replyPacket() const
 {
   auto r=make_unique<DNSPacket>(false);
+  auto pool = DNSPacketBufferPool::get();
+  if (pool != nullptr) {
+    pool->acquire(r->d_rawpacket, r->d_rrs);
+  }
   r->setSocket(d_socket);
   r->d_anyLocal=d_anyLocal;
   r->setRemote(&d_remote);
@@ -55,6 +55,7 @@ public:
   DNSPacket(bool isQuery);
   DNSPacket(const DNSPacket &orig) = default;
   DNSPacket & operator=(const DNSPacket &) = default;
+  ~DNSPacket();
 
   int noparse(const char *mesg, size_t len); //!< just suck the data inward
   int parse(const char *mesg, size_t len); //!< parse a raw UDP or TCP packet and suck the data inward
@@ -213,6 +213,17 @@ DNSResourceRecord DNSResourceRecord::fromWire(const DNSRecord& d) {
   return rr;
 }
 
+/* in a query, we only parse the content of the records that we expect to find there */
+static bool isRecordExpectedInQuery(const DNSRecord& dr, uint16_t qtype)
+{
+  if (qtype == QType::IXFR && dr.d_place == DNSResourceRecord::AUTHORITY && dr.d_type == QType::SOA) {
+    // IXFR queries have a SOA in their AUTHORITY section
+    return true;
+  }
+
+  return !(dr.d_place == DNSResourceRecord::ANSWER || dr.d_place == DNSResourceRecord::AUTHORITY || (dr.d_type != QType::OPT && dr.d_type != QType::TSIG && dr.d_type != QType::SIG && dr.d_type != QType::TKEY) || ((dr.d_type == QType::TSIG || dr.d_type == QType::SIG || dr.d_type == QType::TKEY) && dr.d_class != QClass::ANY));
+}
+
 void MOADNSParser::init(bool query, const pdns_string_view& packet)
 {
   if (packet.size() < sizeof(dnsheader))
@@ -271,9 +282,7 @@ void MOADNSParser::init(bool query, const pdns_string_view& packet)
       dr.d_name=name;
       dr.d_clen=ah.d_clen;
 
-      if (query &&
-          !(d_qtype == QType::IXFR && dr.d_place == DNSResourceRecord::AUTHORITY && dr.d_type == QType::SOA) && // IXFR queries have a SOA in their AUTHORITY section
-          (dr.d_place == DNSResourceRecord::ANSWER || dr.d_place == DNSResourceRecord::AUTHORITY || (dr.d_type != QType::OPT && dr.d_type != QType::TSIG && dr.d_type != QType::SIG && dr.d_type != QType::TKEY) || ((dr.d_type == QType::TSIG || dr.d_type == QType::SIG || dr.d_type == QType::TKEY) && dr.d_class != QClass::ANY))) {
+      if (query && !isRecordExpectedInQuery(dr, d_qtype)) {
 //        cerr<<"discarding RR, query is "<<query<<", place is "<<dr.d_place<<", type is "<<dr.d_type<<", class is "<<dr.d_class<<endl;
         dr.d_content=std::make_shared<UnknownRecordContent>(dr, pr);
       }
@@ -343,6 +352,299 @@ bool MOADNSParser::hasEDNS() const
   return false;
 }
 
+/* returns the position right after the name starting at pos, without following compression pointers */
+static uint16_t skipName(const pdns_string_view& packet, uint16_t pos)
+{
+  for (;;) {
+    uint8_t labellen = packet.at(pos);
+    if ((labellen & 0xc0) == 0xc0) {
+      packet.at(pos + 1);
+      return pos + 2;
+    }
+    if (labellen & 0xc0) {
+      throw std::out_of_range("Found an invalid label length in name");
+    }
+    pos += labellen + 1;
+    if (labellen == 0) {
+      return pos;
+    }
+  }
+}
+
+DNSPacketView::DNSPacketView(bool query, const pdns_string_view& packet): d_packet(packet), d_query(query)
+{
+  if (packet.size() < sizeof(dnsheader)) {
+    throw MOADNSException("Packet shorter than minimal header");
+  }
+  if (packet.size() > std::numeric_limits<uint16_t>::max()) {
+    throw MOADNSException("Packet too large");
+  }
+
+  memcpy(&d_header, packet.data(), sizeof(dnsheader));
+
+  if (d_header.opcode != Opcode::Query && d_header.opcode != Opcode::Notify && d_header.opcode != Opcode::Update) {
+    throw MOADNSException("Can't parse non-query packet with opcode="+ std::to_string(d_header.opcode));
+  }
+
+  d_header.qdcount = ntohs(d_header.qdcount);
+  d_header.ancount = ntohs(d_header.ancount);
+  d_header.nscount = ntohs(d_header.nscount);
+  d_header.arcount = ntohs(d_header.arcount);
+
+  if (query && d_header.qdcount > 1) {
+    throw MOADNSException("Query with QD > 1 ("+std::to_string(d_header.qdcount)+")");
+  }
+
+  const unsigned int total = d_header.ancount + d_header.nscount + d_header.arcount;
+  unsigned int n = 0;
+  uint16_t pos = sizeof(dnsheader);
+  bool validPacket = false;
+  try {
+    for (n = 0; n < d_header.qdcount; ++n) {
+      d_qnamePos = pos;
+      pos = skipName(d_packet, pos);
+      d_qtype = (static_cast<uint8_t>(d_packet.at(pos)) << 8) + static_cast<uint8_t>(d_packet.at(pos + 1));
+      d_qclass = (static_cast<uint8_t>(d_packet.at(pos + 2)) << 8) + static_cast<uint8_t>(d_packet.at(pos + 3));
+      pos += 4;
+    }
+
+    validPacket = true;
+    bool seenTSIG = false;
+    /* the smallest record is 11 bytes long, don't let a bogus count make us allocate more than that */
+    d_records.reserve(std::min(total, static_cast<unsigned int>(packet.size() / 11)));
+    for (n = 0; n < total; ++n) {
+      Record record;
+      if (n < d_header.ancount) {
+        record.d_place = DNSResourceRecord::ANSWER;
+      }
+      else if (n < d_header.ancount + d_header.nscount) {
+        record.d_place = DNSResourceRecord::AUTHORITY;
+      }
+      else {
+        record.d_place = DNSResourceRecord::ADDITIONAL;
+      }
+
+      record.d_namePos = pos;
+      pos = skipName(d_packet, pos);
+
+      struct dnsrecordheader ah;
+      if (static_cast<size_t>(pos) + sizeof(ah) > d_packet.size()) {
+        throw std::out_of_range("record header past the end of the packet");
+      }
+      memcpy(&ah, d_packet.data() + pos, sizeof(ah));
+      record.d_type = ntohs(ah.d_type);
+      record.d_class = ntohs(ah.d_class);
+      record.d_ttl = ntohl(ah.d_ttl);
+      record.d_clen = ntohs(ah.d_clen);
+      record.d_contentPos = pos + sizeof(ah);
+      if (static_cast<size_t>(record.d_contentPos) + record.d_clen > d_packet.size()) {
+        throw std::out_of_range("record content past the end of the packet");
+      }
+      pos = record.d_contentPos + record.d_clen;
+
+      if (record.d_place == DNSResourceRecord::ADDITIONAL && seenTSIG) {
+        /* only XPF records are allowed after a TSIG */
+        throw MOADNSException("Packet has an unexpected record ("+std::to_string(record.d_type)+") after a TSIG one.");
+      }
+
+      if (record.d_type == QType::TSIG && record.d_class == QClass::ANY) {
+        if (seenTSIG || record.d_place != DNSResourceRecord::ADDITIONAL) {
+          throw MOADNSException("Packet has a TSIG record in an invalid position.");
+        }
+        seenTSIG = true;
+        d_tsigPos = record.d_namePos;
+      }
+
+      d_records.push_back(record);
+    }
+  }
+  catch (const std::out_of_range& re) {
+    if (validPacket && d_header.tc) { // don't sweat it over truncated packets, but do adjust an, ns and arcount
+      if (n < d_header.ancount) {
+        d_header.ancount = n; d_header.nscount = d_header.arcount = 0;
+      }
+      else if (n < d_header.ancount + d_header.nscount) {
+        d_header.nscount = n - d_header.ancount; d_header.arcount = 0;
+      }
+      else {
+        d_header.arcount = n - d_header.ancount - d_header.nscount;
+      }
+    }
+    else {
+      throw MOADNSException("Error parsing packet of "+std::to_string(packet.size())+" bytes (rd="+
+                            std::to_string(d_header.rd)+
+                            "), out of bounds: "+string(re.what()));
+    }
+  }
+}
+
+DNSName DNSPacketView::getQName() const
+{
+  if (d_qnamePos == 0) {
+    return DNSName();
+  }
+  return PacketReader(d_packet, d_qnamePos).getName();
+}
+
+bool DNSPacketView::qnameEquals(const DNSName& name) const
+{
+  if (d_qnamePos == 0) {
+    return name.empty();
+  }
+  return nameEqualsAt(d_qnamePos, name);
+}
+
+DNSName DNSPacketView::getName(const Record& record) const
+{
+  return PacketReader(d_packet, record.d_namePos).getName();
+}
+
+bool DNSPacketView::nameEquals(const Record& record, const DNSName& name) const
+{
+  return nameEqualsAt(record.d_namePos, name);
+}
+
+bool DNSPacketView::nameEqualsAt(uint16_t pos, const DNSName& name) const
+{
+  const auto& storage = name.getStorage();
+  if (storage.empty()) {
+    return false;
+  }
+
+  size_t namePos = 0;
+  /* same rules as the DNSName parser: pointers have to go backward, and not before the header */
+  uint16_t lowest = pos;
+  for (;;) {
+    uint8_t labellen = d_packet.at(pos);
+    if ((labellen & 0xc0) == 0xc0) {
+      uint16_t target = ((labellen & ~0xc0) << 8) + static_cast<uint8_t>(d_packet.at(pos + 1));
+      if (target >= lowest || target < sizeof(dnsheader)) {
+        throw MOADNSException("Invalid compression pointer in name");
+      }
+      lowest = pos = target;
+      continue;
+    }
+    if (labellen & 0xc0) {
+      throw MOADNSException("Found an invalid label length in name");
+    }
+    if (namePos >= storage.size() || static_cast<uint8_t>(storage.at(namePos)) != labellen) {
+      return false;
+    }
+    if (labellen == 0) {
+      return true;
+    }
+    if (static_cast<size_t>(pos) + 1 + labellen > d_packet.size()) {
+      throw MOADNSException("Name past the end of the packet");
+    }
+    if (strncasecmp(d_packet.data() + pos + 1, storage.c_str() + namePos + 1, labellen) != 0) {
+      return false;
+    }
+    pos += labellen + 1;
+    namePos += labellen + 1;
+  }
+}
+
+ComboAddress DNSPacketView::getAddress(const Record& record) const
+{
+  if (record.d_type == QType::A && record.d_clen == 4) {
+    return makeComboAddressFromRaw(4, d_packet.data() + record.d_contentPos, record.d_clen);
+  }
+  if (record.d_type == QType::AAAA && record.d_clen == 16) {
+    return makeComboAddressFromRaw(6, d_packet.data() + record.d_contentPos, record.d_clen);
+  }
+  throw MOADNSException("Invalid content of size "+std::to_string(record.d_clen)+" for a record of type "+std::to_string(record.d_type));
+}
+
+DNSName DNSPacketView::getTarget(const Record& record) const
+{
+  PacketReader pr(d_packet, record.d_contentPos);
+  auto target = pr.getName();
+  if (pr.getPosition() != record.d_contentPos + record.d_clen) {
+    throw MOADNSException("Invalid content of size "+std::to_string(record.d_clen)+" for a record of type "+std::to_string(record.d_type));
+  }
+  return target;
+}
+
+DNSPacketView::SOA DNSPacketView::getSOA(const Record& record) const
+{
+  PacketReader pr(d_packet, record.d_contentPos);
+  SOA soa;
+  soa.d_mname = pr.getName();
+  soa.d_rname = pr.getName();
+  soa.d_serial = pr.get32BitInt();
+  soa.d_refresh = pr.get32BitInt();
+  soa.d_retry = pr.get32BitInt();
+  soa.d_expire = pr.get32BitInt();
+  soa.d_minimum = pr.get32BitInt();
+  if (pr.getPosition() != record.d_contentPos + record.d_clen) {
+    throw MOADNSException("Invalid content of size "+std::to_string(record.d_clen)+" for a SOA record");
+  }
+  return soa;
+}
+
+uint32_t DNSPacketView::getSOASerial(const Record& record) const
+{
+  /* minimal size for a SOA record, as defined by rfc1035:
+     MNAME (root): 1
+     RNAME (root): 1
+     SERIAL: 4
+     REFRESH: 4
+     RETRY: 4
+     EXPIRE: 4
+     MINIMUM: 4
+     = 22 bytes
+  */
+  if (record.d_clen < 22) {
+    throw MOADNSException("Invalid content of size "+std::to_string(record.d_clen)+" for a SOA record");
+  }
+  /* the names might be compressed and we don't want to parse them, start at the end */
+  uint32_t serial = 0;
+  memcpy(&serial, d_packet.data() + record.d_contentPos + record.d_clen - 20, sizeof(serial));
+  return ntohl(serial);
+}
+
+DNSRecord DNSPacketView::getDNSRecord(const Record& record) const
+{
+  DNSRecord dr;
+  dr.d_name = getName(record);
+  dr.d_type = record.d_type;
+  dr.d_class = record.d_class;
+  dr.d_ttl = record.d_ttl;
+  dr.d_clen = record.d_clen;
+  dr.d_place = record.d_place;
+
+  PacketReader pr(d_packet, record.d_contentPos - sizeof(dnsrecordheader));
+  struct dnsrecordheader ah;
+  pr.getDnsrecordheader(ah);
+  if (d_query && !isRecordExpectedInQuery(dr, d_qtype)) {
+    dr.d_content = std::make_shared<UnknownRecordContent>(dr, pr);
+  }
+  else {
+    dr.d_content = DNSRecordContent::mastermake(dr, pr, d_header.opcode);
+  }
+  return dr;
+}
+
+std::shared_ptr<DNSRecordContent> DNSPacketView::getContent(const Record& record) const
+{
+  return getDNSRecord(record).d_content;
+}
+
+bool DNSPacketView::hasEDNS() const
+{
+  if (d_header.arcount == 0) {
+    return false;
+  }
+
+  for (const auto& record : d_records) {
+    if (record.d_place == DNSResourceRecord::ADDITIONAL && record.d_type == QType::OPT) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
 void PacketReader::getDnsrecordheader(struct dnsrecordheader &ah)
 {
   unsigned int n;
@@ -430,6 +430,88 @@ private:
   uint16_t d_tsigPos;
 };
 
+/*! Lazy counterpart of MOADNSParser: the constructor only walks the structure of the packet, keeping the
+  position of every record, and names and record contents are decoded when, and only if, they are requested.
+  The accessors for the common types do not allocate a DNSRecordContent at all.
+  The packet has to outlive the view, and since names and contents are not validated upfront, an invalid one
+  is only reported (by an exception) when it is accessed. */
+class DNSPacketView : public boost::noncopyable
+{
+public:
+  struct Record
+  {
+    uint16_t d_namePos;
+    uint16_t d_contentPos;
+    uint16_t d_type;
+    uint16_t d_class;
+    uint32_t d_ttl;
+    uint16_t d_clen;
+    DNSResourceRecord::Place d_place;
+  };
+
+  struct SOA
+  {
+    DNSName d_mname;
+    DNSName d_rname;
+    uint32_t d_serial;
+    uint32_t d_refresh;
+    uint32_t d_retry;
+    uint32_t d_expire;
+    uint32_t d_minimum;
+  };
+
+  DNSPacketView(bool query, const pdns_string_view& packet);
+  DNSPacketView(bool query, const char* packet, size_t len) : DNSPacketView(query, pdns_string_view(packet, len))
+  {
+  }
+
+  //! Same as MOADNSParser::d_header, counts are in host byte order
+  dnsheader d_header;
+  uint16_t d_qtype{0};
+  uint16_t d_qclass{0};
+
+  //! Everything but the question section
+  const std::vector<Record>& getRecords() const
+  {
+    return d_records;
+  }
+
+  DNSName getQName() const;
+  bool qnameEquals(const DNSName& name) const;
+
+  DNSName getName(const Record& record) const;
+  //! Case-insensitive comparison of the record name, without decoding it
+  bool nameEquals(const Record& record, const DNSName& name) const;
+
+  //! A or AAAA, port is 0
+  ComboAddress getAddress(const Record& record) const;
+  //! Records whose content is a single name: CNAME, NS, PTR, DNAME
+  DNSName getTarget(const Record& record) const;
+  SOA getSOA(const Record& record) const;
+  //! Only reads the serial, not the names
+  uint32_t getSOASerial(const Record& record) const;
+
+  //! Fully parsed content, exactly as MOADNSParser would have done it
+  std::shared_ptr<DNSRecordContent> getContent(const Record& record) const;
+  DNSRecord getDNSRecord(const Record& record) const;
+
+  uint16_t getTSIGPos() const
+  {
+    return d_tsigPos;
+  }
+
+  bool hasEDNS() const;
+
+private:
+  bool nameEqualsAt(uint16_t pos, const DNSName& name) const;
+
+  const pdns_string_view d_packet;
+  std::vector<Record> d_records;
+  uint16_t d_qnamePos{0};
+  uint16_t d_tsigPos{0};
+  bool d_query;
+};
+
 string simpleCompress(const string& label, const string& root="");
 void ageDNSPacket(char* packet, size_t length, uint32_t seconds);
 void ageDNSPacket(std::string& packet, uint32_t seconds);
@@ -27,6 +27,7 @@
 #include <arpa/inet.h>
 #include "dnspacket.hh"
 #include "lock.hh"
+#include "statbag.hh"
 #include "iputils.hh"
 
 #include "namespaces.hh"
@@ -76,9 +77,9 @@ private:
 
   // Data
   ComboAddress d_remote;
-  AtomicCounter* d_resanswers;
-  AtomicCounter* d_udpanswers;
-  AtomicCounter* d_resquestions;
+  StatCounter* d_resanswers;
+  StatCounter* d_udpanswers;
+  StatCounter* d_resquestions;
   std::mutex d_lock;
   map_t d_conntrack;
   int d_sock;
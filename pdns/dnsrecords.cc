@@ -874,6 +874,34 @@ bool getEDNSOpts(const MOADNSParser& mdp, EDNSOpts* eo)
   return false;
 }
 
+bool getEDNSOpts(const DNSPacketView& view, EDNSOpts* eo)
+{
+  eo->d_extFlags=0;
+  if(view.d_header.arcount == 0) {
+    return false;
+  }
+
+  for(const auto& record : view.getRecords()) {
+    if(record.d_place == DNSResourceRecord::ADDITIONAL && record.d_type == QType::OPT) {
+      eo->d_packetsize=record.d_class;
+
+      EDNS0Record stuff;
+      uint32_t ttl=ntohl(record.d_ttl);
+      memcpy(&stuff, &ttl, sizeof(stuff));
+
+      eo->d_extRCode=stuff.extRCode;
+      eo->d_version=stuff.version;
+      eo->d_extFlags = ntohs(stuff.extFlags);
+      auto orc = std::dynamic_pointer_cast<OPTRecordContent>(view.getContent(record));
+      if(orc == nullptr)
+        return false;
+      orc->getData(eo->d_options);
+      return true;
+    }
+  }
+  return false;
+}
+
 DNSRecord makeOpt(const uint16_t udpsize, const uint16_t extRCode, const uint16_t extFlags)
 {
   EDNS0Record stuff;
@@ -1029,7 +1029,9 @@ struct EDNSOpts
 //! Convenience function that fills out EDNS0 options, and returns true if there are any
 
 class MOADNSParser;
+class DNSPacketView;
 bool getEDNSOpts(const MOADNSParser& mdp, EDNSOpts* eo);
+bool getEDNSOpts(const DNSPacketView& view, EDNSOpts* eo);
 DNSRecord makeOpt(const uint16_t udpsize, const uint16_t extRCode, const uint16_t extFlags);
 void reportBasicTypes();
 void reportOtherTypes();
@@ -238,6 +238,7 @@ public:
   void getSoaEdit(const DNSName& zname, std::string& value, bool useCache=true);
   bool unSecureZone(const DNSName& zone, std::string& error, std::string& info);
   bool rectifyZone(const DNSName& zone, std::string& error, std::string& info, bool doTransaction);
+  static void hashOrderNames(const NSEC3PARAMRecordContent& ns3pr, const std::vector<DNSName>& names, std::vector<DNSName>& ordernames);
 
   static void setMaxEntries(size_t maxEntries);
 
@@ -39,7 +39,7 @@ static signaturecache_t g_signatures;
 static int g_cacheweekno;
 
 const static std::set<uint16_t> g_KSKSignedQTypes {QType::DNSKEY, QType::CDS, QType::CDNSKEY};
-AtomicCounter* g_signatureCount;
+StatCounter* g_signatureCount;
 
 static std::string getLookupKey(const std::string& msg)
 {
@@ -22,10 +22,6 @@
 #ifdef HAVE_CONFIG_H
 #include "config.h"
 #endif
-#include <boost/version.hpp>
-#if BOOST_VERSION >= 105400
-#include <boost/container/static_vector.hpp>
-#endif
 #include "dnswriter.hh"
 #include "misc.hh"
 #include "dnsparser.hh"
@@ -58,7 +54,6 @@ template <typename Container> GenericDNSPacketWriter<Container>::GenericDNSPacke
   uint8_t* dptr=(&*d_content.begin());
 
   memcpy(dptr, ptr, sizeof(dnsheader));
-  d_namepositions.reserve(16);
   xfrName(qname, false);
   xfr16BitInt(qtype);
   xfr16BitInt(qclass);
@@ -206,118 +201,154 @@ template <typename Container> void GenericDNSPacketWriter<Container>::xfrUnquote
 
 static constexpr bool l_verbose=false;
 static constexpr uint16_t maxCompressionOffset=16384;
-template <typename Container> uint16_t GenericDNSPacketWriter<Container>::lookupName(const DNSName& name, uint16_t* matchLen)
+/* compressing names with more labels than this is not worth it */
+static constexpr size_t maxCompressionLabels=34;
+
+/* Fills labels with the offset of each label of raw, and hashes with the hash of the suffix starting at that
+   label (case-insensitive, chained from the root up so that every suffix of a name is hashed in a single pass).
+   Returns false for names with more labels than we are willing to compress. */
+static bool getSuffixHashes(const DNSName::string_t& raw, uint16_t* labels, uint32_t* hashes, size_t& count)
 {
-  // iterate over the written labels, see if we find a match
-  const auto& raw = name.getStorage();
+  count = 0;
+  for (size_t pos = 0; pos < raw.size() && raw[pos] != 0; pos += static_cast<uint8_t>(raw[pos]) + 1) {
+    if (count == maxCompressionLabels) {
+      return false;
+    }
+    labels[count++] = pos;
+  }
 
-  /* name might be a.root-servers.net, we need to be able to benefit from finding:
-     b.root-servers.net, or even:
-     b\xc0\x0c 
-  */
-  unsigned int bestpos=0;
-  *matchLen=0;
-#if BOOST_VERSION >= 105400
-  boost::container::static_vector<uint16_t, 34> nvect, pvect;
-#else
-  vector<uint16_t> nvect, pvect;
-#endif
+  uint32_t hash = 0;
+  for (size_t idx = count; idx > 0; idx--) {
+    const auto* label = reinterpret_cast<const unsigned char*>(raw.c_str()) + labels[idx - 1];
+    hash = burtleCI(label, *label + 1, hash);
+    hashes[idx - 1] = hash;
+  }
+  return true;
+}
 
-  try {
-    for(auto riter= raw.cbegin(); riter < raw.cend(); ) {
-      if(!*riter)
-        break;
-      nvect.push_back(riter - raw.cbegin());
-      riter+=*riter+1;
+/* Whether the name in the packet at offset, once pointers are followed, is exactly (modulo case) the part of raw
+   starting at start */
+template <typename Container> bool GenericDNSPacketWriter<Container>::isNameAt(uint16_t offset, const DNSName::string_t& raw, uint16_t start) const
+{
+  size_t packetPos = offset;
+  size_t namePos = start;
+  /* pointers always go backwards in what we wrote, this is only there in case someone messed with the content */
+  unsigned int jumps = 0;
+
+  while (packetPos < d_content.size() && namePos < raw.size()) {
+    uint8_t plen = d_content[packetPos];
+    if ((plen & 0xc0) == 0xc0) {
+      if (packetPos + 1 >= d_content.size() || ++jumps > maxCompressionLabels) {
+        return false;
+      }
+      packetPos = 0x100 * (plen & ~0xc0) + d_content[packetPos + 1];
+      continue;
     }
+
+    uint8_t nlen = raw[namePos];
+    if (nlen != plen) {
+      return false;
+    }
+    if (nlen == 0) {
+      return true;
+    }
+    if (packetPos + 1 + plen > d_content.size() || strncasecmp(raw.c_str() + namePos + 1, reinterpret_cast<const char*>(&d_content[packetPos + 1]), nlen) != 0) {
+      return false;
+    }
+    packetPos += plen + 1;
+    namePos += nlen + 1;
   }
-  catch(std::bad_alloc& ba) {
-    if(l_verbose)
-      cout<<"Domain "<<name<<" too large to compress"<<endl;
+  return false;
+}
+
+/* Returns the offset of the earliest written occurrence of the longest suffix of raw present in the packet, setting matchLen
+   to the length of that suffix, or 0 if no suffix matched. This is the same choice the previous linear scan over every name
+   position made, so the output is unchanged, but it only costs one hash probe per label of the name instead of walking every
+   name written so far. */
+template <typename Container> uint16_t GenericDNSPacketWriter<Container>::lookupName(const DNSName::string_t& raw, const uint16_t* labels, const uint32_t* hashes, size_t count, uint16_t* matchLen) const
+{
+  *matchLen = 0;
+  if (d_nameIndex.empty()) {
     return 0;
   }
-  
-  if(l_verbose) {
-    cout<<"Input vector for lookup "<<name<<": ";
-    for(const auto n : nvect) 
-      cout << n<<" ";
-    cout<<endl;
-    cout<<makeHexDump(string(raw.c_str(), raw.c_str()+raw.size()))<<endl;
-  }
 
-  if(l_verbose)
-    cout<<"Have "<<d_namepositions.size()<<" to ponder"<<endl;
-  int counter=1;
-  for(auto p : d_namepositions) {
-    if(l_verbose) {
-      cout<<"Pos: "<<p<<", "<<d_content.size()<<endl;
-      DNSName pname((const char*)&d_content[0], d_content.size(), p, true); // only for debugging
-      cout<<"Looking at '"<<pname<<"' in packet at position "<<p<<"/"<<d_content.size()<<", option "<<counter<<"/"<<d_namepositions.size()<<endl;
-      ++counter;
-    }
-    // memcmp here makes things _slower_
-    pvect.clear();
-    try {
-      for(auto iter = d_content.cbegin() + p; iter < d_content.cend();) {
-        uint8_t c=*iter;
-        if(l_verbose)
-          cout<<"Found label length: "<<(int)c<<endl;
-        if(c & 0xc0) {
-          uint16_t npos = 0x100*(c & (~0xc0)) + *++iter;
-          iter = d_content.begin() + npos;
-          if(l_verbose)
-            cout<<"Is compressed label to newpos "<<npos<<", going there"<<endl;
-          // check against going forward here
-          continue;
+  const size_t mask = d_nameIndex.size() - 1;
+  for (size_t idx = 0; idx < count; idx++) {
+    for (size_t slot = hashes[idx] & mask; d_nameIndex[slot].d_offset != 0; slot = (slot + 1) & mask) {
+      const auto& entry = d_nameIndex[slot];
+      if (entry.d_hash == hashes[idx] && isNameAt(entry.d_offset, raw, labels[idx])) {
+        *matchLen = raw.size() - labels[idx];
+        if (l_verbose) {
+          cout<<"Found a suffix of "<<*matchLen<<" bytes at offset "<<entry.d_offset<<endl;
         }
-        if(!c)
-          break;
-        auto offset = iter - d_content.cbegin();
-        if (offset >= maxCompressionOffset) break; // compression pointers cannot point here
-        pvect.push_back(offset);
-        iter+=*iter+1;
+        return entry.d_offset;
       }
     }
-    catch(std::bad_alloc& ba) {
-      if(l_verbose)
-        cout<<"Domain "<<name<<" too large to compress"<<endl;
-      continue;
+  }
+  return 0;
+}
+
+template <typename Container> void GenericDNSPacketWriter<Container>::insertIntoNameIndex(uint32_t hash, uint16_t offset)
+{
+  if (d_nameIndex.empty()) {
+    d_nameIndex.resize(32);
+  }
+  else if ((d_nameIndexCount + 1) * 2 > d_nameIndex.size()) {
+    /* keep the load factor at or below 0.5 */
+    std::vector<NameIndexEntry> old(d_nameIndex.size() * 2);
+    old.swap(d_nameIndex);
+    d_nameIndexCount = 0;
+    for (const auto& entry : old) {
+      if (entry.d_offset != 0) {
+        insertIntoNameIndex(entry.d_hash, entry.d_offset);
+      }
     }
-    if(l_verbose) {
-      cout<<"Packet vector: "<<endl;
-      for(const auto n : pvect) 
-        cout << n<<" ";
-      cout<<endl;
+  }
+
+  const size_t mask = d_nameIndex.size() - 1;
+  size_t slot = hash & mask;
+  while (d_nameIndex[slot].d_offset != 0) {
+    slot = (slot + 1) & mask;
+  }
+  d_nameIndex[slot].d_hash = hash;
+  d_nameIndex[slot].d_offset = offset;
+  ++d_nameIndexCount;
+}
+
+/* Records the suffixes of raw that have just been written at pos (the first uniqueLength bytes of raw, the remaining
+   ones having been compressed), unless they are already known: a compression pointer always goes to the first
+   occurrence. */
+template <typename Container> void GenericDNSPacketWriter<Container>::addToNameIndex(const DNSName::string_t& raw, const uint16_t* labels, const uint32_t* hashes, size_t count, size_t pos, size_t uniqueLength)
+{
+  for (size_t idx = 0; idx < count && labels[idx] < uniqueLength; idx++) {
+    size_t offset = pos + labels[idx];
+    if (offset >= maxCompressionOffset) {
+      break; // compression pointers cannot point here
     }
-    auto niter=nvect.crbegin(), piter=pvect.crbegin();
-    unsigned int cmatchlen=1;
-    for(; niter != nvect.crend() && piter != pvect.crend(); ++niter, ++piter) {
-      // niter is an offset in raw, pvect an offset in packet
-      uint8_t nlen = raw[*niter], plen=d_content[*piter];
-      if(l_verbose)
-        cout<<"nlnen="<<(int)nlen<<", plen="<<(int)plen<<endl;
-      if(nlen != plen)
-        break;
-      if(strncasecmp(raw.c_str()+*niter+1, (const char*)&d_content[*piter]+1, nlen)) {
-        if(l_verbose)
-          cout<<"Mismatch: "<<string(raw.c_str()+*niter+1, raw.c_str()+*niter+nlen+1)<< " != "<<string((const char*)&d_content[*piter]+1, (const char*)&d_content[*piter]+nlen+1)<<endl;
-        break;
-      }
-      cmatchlen+=nlen+1;
-      if(cmatchlen == raw.length()) { // have matched all of it, can't improve
-        if(l_verbose)
-          cout<<"Stopping search, matched whole name"<<endl;
-        *matchLen = cmatchlen;
-        return *piter;
+
+    uint16_t unused;
+    if (lookupName(raw, labels + idx, hashes + idx, 1, &unused) == 0) {
+      if (l_verbose) {
+        cout<<"Inserting pos "<<offset<<endl;
       }
+      insertIntoNameIndex(hashes[idx], offset);
     }
-    if(piter != pvect.crbegin() && *matchLen < cmatchlen) {
-      *matchLen = cmatchlen;
-      bestpos=*--piter;
+  }
+}
+
+/* after a rollback or a truncation, forget about the names that are no longer there */
+template <typename Container> void GenericDNSPacketWriter<Container>::pruneNameIndex()
+{
+  std::vector<NameIndexEntry> old(d_nameIndex.size());
+  old.swap(d_nameIndex);
+  d_nameIndexCount = 0;
+  for (const auto& entry : old) {
+    if (entry.d_offset != 0 && entry.d_offset < d_content.size()) {
+      insertIntoNameIndex(entry.d_hash, entry.d_offset);
     }
   }
-  return bestpos;
 }
+
 // this is the absolute hottest function in the pdns recursor
 template <typename Container> void GenericDNSPacketWriter<Container>::xfrName(const DNSName& name, bool compress, bool)
 {
@@ -331,10 +362,16 @@ template <typename Container> void GenericDNSPacketWriter<Container>::xfrName(co
     return;
   }
 
+  const auto& dns=name.getStorage();
+  uint16_t labels[maxCompressionLabels];
+  uint32_t hashes[maxCompressionLabels];
+  size_t labelsCount = 0;
+  /* names with too many labels are neither compressed nor used as compression targets */
+  const bool indexable = getSuffixHashes(dns, labels, hashes, labelsCount);
+
   uint16_t li=0;
   uint16_t matchlen=0;
-  if(d_compress && compress && (li=lookupName(name, &matchlen)) && li < maxCompressionOffset) {
-    const auto& dns=name.getStorage(); 
+  if(d_compress && compress && indexable && (li=lookupName(dns, labels, hashes, labelsCount, &matchlen)) && li < maxCompressionOffset) {
     if(l_verbose)
       cout<<"Found a substring of "<<matchlen<<" bytes from the back, offset: "<<li<<", dnslen: "<<dns.size()<<endl;
     // found a substring, if www.powerdns.com matched powerdns.com, we get back matchlen = 13
@@ -343,7 +380,7 @@ template <typename Container> void GenericDNSPacketWriter<Container>::xfrName(co
     if(pos < maxCompressionOffset && matchlen != dns.size()) {
       if(l_verbose)
         cout<<"Inserting pos "<<pos<<" for "<<name<<" for compressed case"<<endl;
-      d_namepositions.push_back(pos);
+      addToNameIndex(dns, labels, hashes, labelsCount, pos, dns.size() - matchlen);
     }
 
     if(l_verbose)
@@ -359,10 +396,10 @@ template <typename Container> void GenericDNSPacketWriter<Container>::xfrName(co
     unsigned int pos=d_content.size();
     if(l_verbose)
       cout<<"Found nothing, we are at pos "<<pos<<", inserting whole name"<<endl;
-    if(pos < maxCompressionOffset) {
+    if(pos < maxCompressionOffset && indexable) {
       if(l_verbose)
         cout<<"Inserting pos "<<pos<<" for "<<name<<" for uncompressed case"<<endl;
-      d_namepositions.push_back(pos);
+      addToNameIndex(dns, labels, hashes, labelsCount, pos, dns.size());
     }
 
     std::unique_ptr<DNSName> lc;
@@ -469,11 +506,13 @@ template <typename Container> void GenericDNSPacketWriter<Container>::rollback()
 {
   d_content.resize(d_rollbackmarker);
   d_sor = 0;
+  pruneNameIndex();
 }
 
 template <typename Container> void GenericDNSPacketWriter<Container>::truncate()
 {
   d_content.resize(d_truncatemarker);
+  pruneNameIndex();
   dnsheader* dh=reinterpret_cast<dnsheader*>( &*d_content.begin());
   dh->ancount = dh->nscount = dh->arcount = 0;
 }
@@ -161,8 +161,21 @@ public:
   size_t getSizeWithOpts(const optvect_t& options) const;
 
 private:
-  uint16_t lookupName(const DNSName& name, uint16_t* matchlen);
-  vector<uint16_t> d_namepositions;
+  struct NameIndexEntry
+  {
+    uint32_t d_hash{0};
+    uint16_t d_offset{0}; // 0 marks an empty slot, nothing can be compressed to the header
+  };
+
+  bool isNameAt(uint16_t offset, const DNSName::string_t& raw, uint16_t start) const;
+  uint16_t lookupName(const DNSName::string_t& raw, const uint16_t* labels, const uint32_t* hashes, size_t count, uint16_t* matchlen) const;
+  void addToNameIndex(const DNSName::string_t& raw, const uint16_t* labels, const uint32_t* hashes, size_t count, size_t pos, size_t uniqueLength);
+  void insertIntoNameIndex(uint32_t hash, uint16_t offset);
+  void pruneNameIndex();
+
+  // open addressing table of the suffixes written so far, keyed on their hash, pointing to their first occurrence
+  vector<NameIndexEntry> d_nameIndex;
+  size_t d_nameIndexCount{0};
   // We declare 1 uint_16 in the public section, these 3 align on a 8-byte boundary
   uint16_t d_sor;
   uint16_t d_rollbackmarker; // start of last complete packet, for rollback
@@ -43,86 +43,333 @@ DNSFilterEngine::DNSFilterEngine()
 {
 }
 
-bool DNSFilterEngine::Zone::findExactQNamePolicy(const DNSName& qname, DNSFilterEngine::Policy& pol) const
+bool DNSFilterEngine::NameTriggers::LabelCompare::operator()(const std::string_view& lhs, const std::string_view& rhs) const
 {
-  return findExactNamedPolicy(d_qpolName, qname, pol);
+  const auto len = std::min(lhs.size(), rhs.size());
+  for (size_t idx = 0; idx < len; ++idx) {
+    const auto left = dns_tolower(lhs[idx]);
+    const auto right = dns_tolower(rhs[idx]);
+    if (left != right) {
+      return left < right;
+    }
+  }
+  return lhs.size() < rhs.size();
 }
 
-bool DNSFilterEngine::Zone::findExactNSPolicy(const DNSName& qname, DNSFilterEngine::Policy& pol) const
+DNSFilterEngine::NameTriggers::Labels::Labels(const DNSName& name) :
+  d_storage(name.getStorage().data())
 {
-  return findExactNamedPolicy(d_propolName, qname, pol);
+  const auto& storage = name.getStorage();
+  size_t pos = 0;
+  while (pos < storage.size() && storage[pos] != 0) {
+    d_offsets.at(d_count) = static_cast<uint8_t>(pos);
+    ++d_count;
+    pos += static_cast<uint8_t>(storage[pos]) + 1;
+  }
+  d_wildcard = d_count > 0 && (*this)[d_count - 1] == "*";
 }
 
-bool DNSFilterEngine::Zone::findNSIPPolicy(const ComboAddress& addr, DNSFilterEngine::Policy& pol) const
+const DNSFilterEngine::NameTriggers::Entry* DNSFilterEngine::NameTriggers::getEntry(const Node* base, const Node* delta, bool wildcard)
 {
-  if (const auto fnd = d_propolNSAddr.lookup(addr)) {
-    pol = fnd->second;
-    return true;
+  if (delta != nullptr) {
+    const auto& slot = wildcard ? delta->d_wildcard : delta->d_exact;
+    if (slot) {
+      return slot->d_removed ? nullptr : slot.get();
+    }
   }
-  return false;
+  if (base != nullptr) {
+    const auto& slot = wildcard ? base->d_wildcard : base->d_exact;
+    return slot.get();
+  }
+  return nullptr;
 }
 
-bool DNSFilterEngine::Zone::findResponsePolicy(const ComboAddress& addr, DNSFilterEngine::Policy& pol) const
+const DNSFilterEngine::NameTriggers::Node* DNSFilterEngine::NameTriggers::findNode(const Node& root, const Labels& labels)
 {
-  if (const auto fnd = d_postpolAddr.lookup(addr)) {
-    pol = fnd->second;
-    return true;
+  const Node* node = &root;
+  for (size_t idx = 0; idx < labels.getNodeDepth() && node != nullptr; ++idx) {
+    node = node->getChild(labels[idx]);
   }
-  return false;
+  return node;
 }
 
-bool DNSFilterEngine::Zone::findClientPolicy(const ComboAddress& addr, DNSFilterEngine::Policy& pol) const
+/* returns the slot for that exact trigger, creating the nodes leading to it if needed */
+std::shared_ptr<const DNSFilterEngine::NameTriggers::Entry>& DNSFilterEngine::NameTriggers::getSlot(Node& root, const Labels& labels)
 {
-  if (const auto fnd = d_qpolAddr.lookup(addr)) {
-    pol = fnd->second;
-    return true;
+  Node* node = &root;
+  for (size_t idx = 0; idx < labels.getNodeDepth(); ++idx) {
+    const auto label = labels[idx];
+    auto it = node->d_children.find(label);
+    if (it == node->d_children.end()) {
+      it = node->d_children.emplace(std::string(label), Node()).first;
+    }
+    node = &it->second;
   }
-  return false;
+
+  return labels.isWildcard() ? node->d_wildcard : node->d_exact;
 }
 
-bool DNSFilterEngine::Zone::findNamedPolicy(const std::unordered_map<DNSName, DNSFilterEngine::Policy>& polmap, const DNSName& qname, DNSFilterEngine::Policy& pol)
+/* clears the slot for that exact trigger, then prunes the nodes left empty */
+void DNSFilterEngine::NameTriggers::eraseSlot(Node& root, const Labels& labels)
 {
-  if (polmap.empty()) {
+  const auto depth = labels.getNodeDepth();
+  std::vector<Node*> path;
+  path.reserve(depth + 1);
+  path.push_back(&root);
+  for (size_t idx = 0; idx < depth; ++idx) {
+    auto it = path.back()->d_children.find(labels[idx]);
+    if (it == path.back()->d_children.end()) {
+      return;
+    }
+    path.push_back(&it->second);
+  }
+
+  auto& slot = labels.isWildcard() ? path.back()->d_wildcard : path.back()->d_exact;
+  slot.reset();
+
+  for (size_t idx = depth; idx > 0 && path.at(idx)->empty(); --idx) {
+    auto& children = path.at(idx - 1)->d_children;
+    children.erase(children.find(labels[idx - 1]));
+  }
+}
+
+const DNSFilterEngine::NameTriggers::Entry* DNSFilterEngine::NameTriggers::find(const DNSName& name) const
+{
+  const Labels labels(name);
+  return getEntry(findNode(*d_base, labels), d_deltaSize > 0 ? findNode(d_delta, labels) : nullptr, labels.isWildcard());
+}
+
+/* applies the entries and removals of the delta layer to the base one, then prunes the nodes left empty */
+void DNSFilterEngine::NameTriggers::mergeNode(Node& base, const Node& delta)
+{
+  const auto mergeSlot = [](std::shared_ptr<const Entry>& baseSlot, const std::shared_ptr<const Entry>& deltaSlot) {
+    if (deltaSlot) {
+      baseSlot = deltaSlot->d_removed ? nullptr : deltaSlot;
+    }
+  };
+  mergeSlot(base.d_exact, delta.d_exact);
+  mergeSlot(base.d_wildcard, delta.d_wildcard);
+
+  for (const auto& child : delta.d_children) {
+    auto it = base.d_children.find(child.first);
+    if (it == base.d_children.end()) {
+      it = base.d_children.emplace(child.first, Node()).first;
+    }
+    mergeNode(it->second, child.second);
+    if (it->second.empty()) {
+      base.d_children.erase(it);
+    }
+  }
+}
+
+/* we can only update the base layer in place if no other copy is using it,
+   and if there is no pending update in the delta layer that would override it */
+bool DNSFilterEngine::NameTriggers::canUpdateBase() const
+{
+  return d_deltaSize == 0 && d_base.use_count() == 1;
+}
+
+void DNSFilterEngine::NameTriggers::setInDelta(const Labels& labels, std::shared_ptr<const Entry>&& entry)
+{
+  auto& slot = getSlot(d_delta, labels);
+  if (!slot) {
+    ++d_deltaSize;
+  }
+  slot = std::move(entry);
+
+  /* merging the delta layer costs a full copy of the base one if it is shared,
+     so only do that once the delta represents a sizeable part of the zone */
+  if (d_deltaSize > 1024 && d_deltaSize * 8 > d_size) {
+    compact();
+  }
+}
+
+void DNSFilterEngine::NameTriggers::compact()
+{
+  if (d_base.use_count() > 1) {
+    d_base = std::make_shared<Node>(*d_base);
+  }
+
+  mergeNode(*d_base, d_delta);
+
+  d_delta = Node();
+  d_deltaSize = 0;
+}
+
+void DNSFilterEngine::NameTriggers::insert(const DNSName& name, Entry&& entry)
+{
+  if (find(name) == nullptr) {
+    ++d_size;
+  }
+
+  const Labels labels(name);
+  auto newEntry = std::make_shared<const Entry>(std::move(entry));
+  if (canUpdateBase()) {
+    getSlot(*d_base, labels) = std::move(newEntry);
+    return;
+  }
+
+  setInDelta(labels, std::move(newEntry));
+}
+
+bool DNSFilterEngine::NameTriggers::erase(const DNSName& name)
+{
+  if (find(name) == nullptr) {
     return false;
   }
+  --d_size;
 
-  /* for www.powerdns.com, we need to check:
+  const Labels labels(name);
+  if (canUpdateBase()) {
+    eraseSlot(*d_base, labels);
+    return true;
+  }
+
+  if (getEntry(findNode(*d_base, labels), nullptr, labels.isWildcard()) == nullptr) {
+    /* it only existed in the delta layer */
+    eraseSlot(d_delta, labels);
+    --d_deltaSize;
+    return true;
+  }
+
+  auto removed = std::make_shared<Entry>();
+  removed->d_removed = true;
+  setInDelta(labels, std::move(removed));
+  return true;
+}
+
+const DNSFilterEngine::NameTriggers::Entry* DNSFilterEngine::NameTriggers::lookup(const std::vector<const NameTriggers*>& tries, const DNSName& qname, size_t& which, DNSName& trigger)
+{
+  /* for www.powerdns.com, we need to check in each trie:
      www.powerdns.com.
        *.powerdns.com.
                 *.com.
                     *.
+     which are all found on the way down to www.powerdns.com.
    */
+  const Labels labels(qname);
+
+  struct State
+  {
+    const Node* d_base{nullptr};
+    const Node* d_delta{nullptr};
+    /* most specific wildcard match so far, and the number of labels of its parent */
+    const Entry* d_wildcard{nullptr};
+    size_t d_wildcardDepth{0};
+
+    bool active() const
+    {
+      return d_base != nullptr || d_delta != nullptr;
+    }
+  };
+
+  std::vector<State> states(tries.size());
+  size_t active = 0;
+  for (size_t idx = 0; idx < tries.size(); ++idx) {
+    const auto trie = tries[idx];
+    if (trie != nullptr && !trie->empty()) {
+      states[idx].d_base = trie->d_base.get();
+      states[idx].d_delta = trie->d_deltaSize > 0 ? &trie->d_delta : nullptr;
+      ++active;
+    }
+  }
+
+  /* once a trie has a (wildcard) match, the ones after it can no longer win */
+  size_t limit = tries.size();
+  for (size_t depth = 0; depth < labels.size() && active > 0; ++depth) {
+    const auto label = labels[depth];
+    for (size_t idx = 0; idx < limit; ++idx) {
+      auto& state = states[idx];
+      if (!state.active()) {
+        continue;
+      }
 
-  std::unordered_map<DNSName, DNSFilterEngine::Policy>::const_iterator iter;
-  iter = polmap.find(qname);
+      if (const auto wildcard = getEntry(state.d_base, state.d_delta, true)) {
+        state.d_wildcard = wildcard;
+        state.d_wildcardDepth = depth;
+        for (size_t later = idx + 1; later < limit; ++later) {
+          if (states[later].active()) {
+            states[later] = State();
+            --active;
+          }
+        }
+        limit = idx + 1;
+      }
 
-  if(iter != polmap.end()) {
-    pol=iter->second;
-    return true;
+      state.d_base = state.d_base != nullptr ? state.d_base->getChild(label) : nullptr;
+      state.d_delta = state.d_delta != nullptr ? state.d_delta->getChild(label) : nullptr;
+      if (!state.active()) {
+        --active;
+      }
+    }
   }
 
-  DNSName s(qname);
-  while(s.chopOff()){
-    iter = polmap.find(g_wildcarddnsname+s);
-    if(iter != polmap.end()) {
-      pol=iter->second;
-      pol.d_trigger = iter->first;
-      pol.d_hit = qname.toStringNoDot();
-      return true;
+  for (size_t idx = 0; idx < limit; ++idx) {
+    const auto& state = states[idx];
+    if (const auto entry = getEntry(state.d_base, state.d_delta, false)) {
+      which = idx;
+      trigger = qname;
+      return entry;
+    }
+    if (state.d_wildcard != nullptr) {
+      which = idx;
+      trigger = g_wildcarddnsname;
+      for (size_t depth = state.d_wildcardDepth; depth > 0; --depth) {
+        const auto label = labels[depth - 1];
+        trigger.appendRawLabel(label.data(), label.size());
+      }
+      return state.d_wildcard;
     }
   }
+
+  return nullptr;
+}
+
+bool DNSFilterEngine::Zone::findExactQNamePolicy(const DNSName& qname, DNSFilterEngine::Policy& pol) const
+{
+  return findExactNamedPolicy(d_qpolName, qname, PolicyType::QName, pol);
+}
+
+bool DNSFilterEngine::Zone::findExactNSPolicy(const DNSName& qname, DNSFilterEngine::Policy& pol) const
+{
+  return findExactNamedPolicy(d_propolName, qname, PolicyType::NSDName, pol);
+}
+
+bool DNSFilterEngine::Zone::findNSIPPolicy(const ComboAddress& addr, DNSFilterEngine::Policy& pol) const
+{
+  if (const auto fnd = d_propolNSAddr->lookup(addr)) {
+    pol = fnd->second;
+    return true;
+  }
+  return false;
+}
+
+bool DNSFilterEngine::Zone::findResponsePolicy(const ComboAddress& addr, DNSFilterEngine::Policy& pol) const
+{
+  if (const auto fnd = d_postpolAddr->lookup(addr)) {
+    pol = fnd->second;
+    return true;
+  }
   return false;
 }
 
-bool DNSFilterEngine::Zone::findExactNamedPolicy(const std::unordered_map<DNSName, DNSFilterEngine::Policy>& polmap, const DNSName& qname, DNSFilterEngine::Policy& pol)
+bool DNSFilterEngine::Zone::findClientPolicy(const ComboAddress& addr, DNSFilterEngine::Policy& pol) const
 {
-  if (polmap.empty()) {
+  if (const auto fnd = d_qpolAddr->lookup(addr)) {
+    pol = fnd->second;
+    return true;
+  }
+  return false;
+}
+
+bool DNSFilterEngine::Zone::findExactNamedPolicy(const NameTriggers& triggers, const DNSName& qname, PolicyType type, DNSFilterEngine::Policy& pol) const
+{
+  if (triggers.empty()) {
     return false;
   }
 
-  const auto& it = polmap.find(qname);
-  if (it != polmap.end()) {
-    pol = it->second;
+  if (const auto found = triggers.find(qname)) {
+    pol = getPolicy(*found, type);
     pol.d_trigger = qname;
     pol.d_hit = qname.toStringNoDot();
     return true;
@@ -134,28 +381,15 @@ bool DNSFilterEngine::Zone::findExactNamedPolicy(const std::unordered_map<DNSNam
 bool DNSFilterEngine::getProcessingPolicy(const DNSName& qname, const std::unordered_map<std::string,bool>& discardedPolicies, Policy& pol) const
 {
   // cout<<"Got question for nameserver name "<<qname<<endl;
-  std::vector<bool> zoneEnabled(d_zones.size());
+  std::vector<const NameTriggers*> triggers(d_zones.size(), nullptr);
   size_t count = 0;
   bool allEmpty = true;
   for (const auto& z : d_zones) {
-    bool enabled = true;
     const auto& zoneName = z->getName();
-    if (z->getPriority() >= pol.getPriority()) {
-      enabled = false;
-    }
-    else if (discardedPolicies.find(zoneName) != discardedPolicies.end()) {
-      enabled = false;
+    if (z->getPriority() < pol.getPriority() && discardedPolicies.find(zoneName) == discardedPolicies.end() && z->hasNSPolicies()) {
+      allEmpty = false;
+      triggers[count] = &z->getNSTriggers();
     }
-    else {
-      if (z->hasNSPolicies()) {
-        allEmpty = false;
-      }
-      else {
-        enabled = false;
-      }
-    }
-
-    zoneEnabled[count] = enabled;
     ++count;
   }
 
@@ -163,41 +397,19 @@ bool DNSFilterEngine::getProcessingPolicy(const DNSName& qname, const std::unord
     return false;
   }
 
-  /* prepare the wildcard-based names */
-  std::vector<DNSName> wcNames;
-  wcNames.reserve(qname.countLabels());
-  DNSName s(qname);
-  while (s.chopOff()){
-    wcNames.emplace_back(g_wildcarddnsname+s);
-  }
-
-  count = 0;
-  for(const auto& z : d_zones) {
-    if (!zoneEnabled[count]) {
-      ++count;
-      continue;
-    }
-    if (z->findExactNSPolicy(qname, pol)) {
-      // cerr<<"Had a hit on the nameserver ("<<qname<<") used to process the query"<<endl;
-      pol.d_trigger = qname;
-      pol.d_trigger.appendRawLabel(rpzNSDnameName);
-      pol.d_hit = qname.toStringNoDot();
-      return true;
-    }
-
-    for (const auto& wc : wcNames) {
-      if (z->findExactNSPolicy(wc, pol)) {
-        // cerr<<"Had a hit on the nameserver ("<<qname<<") used to process the query"<<endl;
-        pol.d_trigger = wc;
-        pol.d_trigger.appendRawLabel(rpzNSDnameName);
-        pol.d_hit = qname.toStringNoDot();
-        return true;
-      }
-    }
-    ++count;
+  size_t which = 0;
+  DNSName trigger;
+  const auto entry = NameTriggers::lookup(triggers, qname, which, trigger);
+  if (entry == nullptr) {
+    return false;
   }
 
-  return false;
+  // cerr<<"Had a hit on the nameserver ("<<qname<<") used to process the query"<<endl;
+  pol = d_zones[which]->getPolicy(*entry, PolicyType::NSDName);
+  pol.d_trigger = std::move(trigger);
+  pol.d_trigger.appendRawLabel(rpzNSDnameName);
+  pol.d_hit = qname.toStringNoDot();
+  return true;
 }
 
 bool DNSFilterEngine::getProcessingPolicy(const ComboAddress& address, const std::unordered_map<std::string,bool>& discardedPolicies, Policy& pol) const
@@ -247,29 +459,15 @@ bool DNSFilterEngine::getClientPolicy(const ComboAddress& ca, const std::unorder
 bool DNSFilterEngine::getQueryPolicy(const DNSName& qname, const std::unordered_map<std::string,bool>& discardedPolicies, Policy& pol) const
 {
   //cerr<<"Got question for "<<qname<<' '<< pol.getPriority()<< endl;
-  std::vector<bool> zoneEnabled(d_zones.size());
+  std::vector<const NameTriggers*> triggers(d_zones.size(), nullptr);
   size_t count = 0;
   bool allEmpty = true;
   for (const auto& z : d_zones) {
-    bool enabled = true;
-    if (z->getPriority() >= pol.getPriority()) {
-      enabled = false;
-    } else {
-      const auto& zoneName = z->getName();
-      if (discardedPolicies.find(zoneName) != discardedPolicies.end()) {
-        enabled = false;
-      }
-      else {
-        if (z->hasQNamePolicies()) {
-          allEmpty = false;
-        }
-        else {
-          enabled = false;
-        }
-      }
+    const auto& zoneName = z->getName();
+    if (z->getPriority() < pol.getPriority() && discardedPolicies.find(zoneName) == discardedPolicies.end() && z->hasQNamePolicies()) {
+      allEmpty = false;
+      triggers[count] = &z->getQNameTriggers();
     }
-
-    zoneEnabled[count] = enabled;
     ++count;
   }
 
@@ -277,41 +475,18 @@ bool DNSFilterEngine::getQueryPolicy(const DNSName& qname, const std::unordered_
     return false;
   }
 
-  /* prepare the wildcard-based names */
-  std::vector<DNSName> wcNames;
-  wcNames.reserve(qname.countLabels());
-  DNSName s(qname);
-  while (s.chopOff()){
-    wcNames.emplace_back(g_wildcarddnsname+s);
-  }
-
-  count = 0;
-  for (const auto& z : d_zones) {
-    if (!zoneEnabled[count]) {
-      ++count;
-      continue;
-    }
-
-    if (z->findExactQNamePolicy(qname, pol)) {
-      // cerr<<"Had a hit on the name of the query"<<endl;
-      pol.d_trigger = qname;
-      pol.d_hit = qname.toStringNoDot();
-      return true;
-    }
-
-    for (const auto& wc : wcNames) {
-      if (z->findExactQNamePolicy(wc, pol)) {
-        // cerr<<"Had a hit on the name of the query"<<endl;
-        pol.d_trigger = wc;
-        pol.d_hit = qname.toStringNoDot();
-        return true;
-      }
-    }
-
-    ++count;
+  size_t which = 0;
+  DNSName trigger;
+  const auto entry = NameTriggers::lookup(triggers, qname, which, trigger);
+  if (entry == nullptr) {
+    return false;
   }
 
-  return false;
+  // cerr<<"Had a hit on the name of the query"<<endl;
+  pol = d_zones[which]->getPolicy(*entry, PolicyType::QName);
+  pol.d_trigger = std::move(trigger);
+  pol.d_hit = qname.toStringNoDot();
+  return true;
 }
 
 bool DNSFilterEngine::getPostPolicy(const vector<DNSRecord>& records, const std::unordered_map<std::string,bool>& discardedPolicies, Policy& pol) const
@@ -372,12 +547,11 @@ void DNSFilterEngine::assureZones(size_t zone)
     d_zones.resize(zone+1);
 }
 
-void DNSFilterEngine::Zone::addNameTrigger(std::unordered_map<DNSName,Policy>& map, const DNSName& n, Policy&& pol, bool ignoreDuplicate, PolicyType ptype)
+void DNSFilterEngine::Zone::addNameTrigger(NameTriggers& triggers, const DNSName& n, Policy&& pol, bool ignoreDuplicate, PolicyType ptype)
 {
-  auto it = map.find(n);
-
-  if (it != map.end()) {
-    auto& existingPol = it->second;
+  if (const auto found = triggers.find(n)) {
+    /* entries are shared with the other copies of this zone, update a copy */
+    auto existingPol = *found;
 
     if (pol.d_kind != PolicyKind::Custom && !ignoreDuplicate) {
       throw std::runtime_error("Adding a " + getTypeToString(ptype) + "-based filter policy of kind " + getKindToString(pol.d_kind) + " but a policy of kind " + getKindToString(existingPol.d_kind) + " already exists for the following name: " + n.toLogString());
@@ -390,16 +564,24 @@ void DNSFilterEngine::Zone::addNameTrigger(std::unordered_map<DNSName,Policy>& m
     existingPol.d_custom.reserve(existingPol.d_custom.size() + pol.d_custom.size());
 
     std::move(pol.d_custom.begin(), pol.d_custom.end(), std::back_inserter(existingPol.d_custom));
+    triggers.insert(n, std::move(existingPol));
   }
   else {
-    auto& qpol = map.insert({n, std::move(pol)}).first->second;
-    qpol.d_zoneData = d_zoneData;
-    qpol.d_type = ptype;
+    triggers.insert(n, NameTriggers::Entry{std::move(pol.d_custom), pol.d_ttl, pol.d_kind});
+  }
+}
+
+NetmaskTree<DNSFilterEngine::Policy>& DNSFilterEngine::Zone::getWritable(std::shared_ptr<NetmaskTree<Policy>>& nmt)
+{
+  if (nmt.use_count() > 1) {
+    nmt = std::make_shared<NetmaskTree<Policy>>(*nmt);
   }
+  return *nmt;
 }
 
-void DNSFilterEngine::Zone::addNetmaskTrigger(NetmaskTree<Policy>& nmt, const Netmask& nm, Policy&& pol, bool ignoreDuplicate, PolicyType ptype)
+void DNSFilterEngine::Zone::addNetmaskTrigger(std::shared_ptr<NetmaskTree<Policy>>& sharedNmt, const Netmask& nm, Policy&& pol, bool ignoreDuplicate, PolicyType ptype)
 {
+  auto& nmt = getWritable(sharedNmt);
   bool exists = nmt.has_key(nm);
 
   if (exists) {
@@ -426,19 +608,21 @@ void DNSFilterEngine::Zone::addNetmaskTrigger(NetmaskTree<Policy>& nmt, const Ne
   }
 }
 
-bool DNSFilterEngine::Zone::rmNameTrigger(std::unordered_map<DNSName,Policy>& map, const DNSName& n, const Policy& pol)
+bool DNSFilterEngine::Zone::rmNameTrigger(NameTriggers& triggers, const DNSName& n, const Policy& pol)
 {
-  auto found = map.find(n);
-  if (found == map.end()) {
+  const auto found = triggers.find(n);
+  if (found == nullptr) {
     return false;
   }
 
-  auto& existing = found->second;
-  if (existing.d_kind != DNSFilterEngine::PolicyKind::Custom) {
-    map.erase(found);
+  if (found->d_kind != DNSFilterEngine::PolicyKind::Custom) {
+    triggers.erase(n);
     return true;
   }
 
+  /* entries are shared with the other copies of this zone, update a copy */
+  auto existing = *found;
+
   /* for custom types, we might have more than one type,
      and then we need to remove only the right ones. */
   bool result = false;
@@ -454,20 +638,26 @@ bool DNSFilterEngine::Zone::rmNameTrigger(std::unordered_map<DNSName,Policy>& ma
 
   // No records left for this trigger?
   if (existing.d_custom.size() == 0) {
-    map.erase(found);
+    triggers.erase(n);
     return true;
   }
 
+  if (result) {
+    triggers.insert(n, std::move(existing));
+  }
+
   return result;
 }
 
-bool DNSFilterEngine::Zone::rmNetmaskTrigger(NetmaskTree<Policy>& nmt, const Netmask& nm, const Policy& pol)
+bool DNSFilterEngine::Zone::rmNetmaskTrigger(std::shared_ptr<NetmaskTree<Policy>>& sharedNmt, const Netmask& nm, const Policy& pol)
 {
-  bool found = nmt.has_key(nm);
+  bool found = sharedNmt->has_key(nm);
   if (!found) {
     return false;
   }
 
+  auto& nmt = getWritable(sharedNmt);
+
   // XXX NetMaskTree's node_type has a non-const second, but lookup() returns a const node_type *, so we cannot modify second
   // Should look into making lookup) return a non-const node_type *...
   auto& existing = const_cast<Policy&>(nmt.lookup(nm)->second);
@@ -773,23 +963,24 @@ void DNSFilterEngine::Zone::dump(FILE* fp) const
   auto soa = DNSRecordContent::mastermake(QType::SOA, QClass::IN, "fake.RPZ. hostmaster.fake.RPZ. " + std::to_string(d_serial) + " " + std::to_string(d_refresh) + " 600 3600000 604800");
   fprintf(fp, "%s IN SOA %s\n", d_domain.toString().c_str(), soa->getZoneRepresentation().c_str());
 
-  for (const auto& pair : d_qpolName) {
-    dumpNamedPolicy(fp, pair.first + d_domain, pair.second);
-  }
+  d_qpolName.visit([fp, this](const DNSName& name, const NameTriggers::Entry& entry) {
+    dumpNamedPolicy(fp, name + d_domain, getPolicy(entry, PolicyType::QName));
+  });
 
-  for (const auto& pair : d_propolName) {
-    dumpNamedPolicy(fp, pair.first + DNSName(rpzNSDnameName) + d_domain, pair.second);
-  }
+  const DNSName nsdnameSuffix = DNSName(rpzNSDnameName) + d_domain;
+  d_propolName.visit([fp, this, &nsdnameSuffix](const DNSName& name, const NameTriggers::Entry& entry) {
+    dumpNamedPolicy(fp, name + nsdnameSuffix, getPolicy(entry, PolicyType::NSDName));
+  });
 
-  for (const auto& pair : d_qpolAddr) {
+  for (const auto& pair : *d_qpolAddr) {
     dumpAddrPolicy(fp, pair.first, DNSName(rpzClientIPName) + d_domain, pair.second);
   }
 
-  for (const auto& pair : d_propolNSAddr) {
+  for (const auto& pair : *d_propolNSAddr) {
     dumpAddrPolicy(fp, pair.first, DNSName(rpzNSIPName) + d_domain, pair.second);
   }
 
-  for (const auto& pair : d_postpolAddr) {
+  for (const auto& pair : *d_postpolAddr) {
     dumpAddrPolicy(fp, pair.first, DNSName(rpzIPName) + d_domain, pair.second);
   }
 }
@@ -24,7 +24,9 @@
 #include "dns.hh"
 #include "dnsname.hh"
 #include "dnsparser.hh"
+#include <array>
 #include <map>
+#include <memory>
 #include <unordered_map>
 #include <limits>
 
@@ -171,6 +173,178 @@ public:
     DNSRecord getRecordFromCustom(const DNSName& qname, const std::shared_ptr<DNSRecordContent>& custom) const;
   };
 
+  /* Label trie holding the QNAME or NSDNAME triggers of a zone. A trigger for
+     "*.example.com." is stored on the node of "example.com.", so that the exact
+     match and every covering wildcard are found while walking the labels of a
+     name once, from the root down, without building any intermediate DNSName.
+
+     The trie has two layers: a base one, shared by the copies of a zone made to
+     apply an IXFR, and a small delta one belonging to each copy and overriding
+     the base. Updates to a shared base go to the delta layer, which is merged
+     into a private copy of the base once it gets too large.
+
+     Entries do not store their trigger name, which is given by their place in
+     the trie and rebuilt from it when needed. */
+  class NameTriggers
+  {
+  public:
+    /* what a Policy holds, minus what is common to the whole zone */
+    struct Entry
+    {
+      std::vector<std::shared_ptr<DNSRecordContent>> d_custom;
+      int32_t d_ttl{0};
+      PolicyKind d_kind{PolicyKind::NoAction};
+      /* only in the delta layer, marks a trigger removed from the base one */
+      bool d_removed{false};
+    };
+
+    struct LabelCompare
+    {
+      using is_transparent = void;
+      bool operator()(const std::string_view& lhs, const std::string_view& rhs) const;
+    };
+
+    struct Node
+    {
+      const Node* getChild(const std::string_view& label) const
+      {
+        const auto it = d_children.find(label);
+        return it != d_children.end() ? &it->second : nullptr;
+      }
+
+      bool empty() const
+      {
+        return d_children.empty() && !d_exact && !d_wildcard;
+      }
+
+      std::map<std::string, Node, LabelCompare> d_children;
+      std::shared_ptr<const Entry> d_exact{nullptr};
+      std::shared_ptr<const Entry> d_wildcard{nullptr};
+    };
+
+    /* the labels of a trigger name, starting from the top-level one, pointing into the name's storage */
+    class Labels
+    {
+    public:
+      explicit Labels(const DNSName& name);
+
+      size_t size() const
+      {
+        return d_count;
+      }
+
+      std::string_view operator[](size_t idx) const
+      {
+        const auto offset = d_offsets[d_count - 1 - idx];
+        return std::string_view(d_storage + offset + 1, static_cast<uint8_t>(d_storage[offset]));
+      }
+
+      /* the number of labels leading to the node holding the trigger, which
+         for a wildcard is the node of its parent */
+      size_t getNodeDepth() const
+      {
+        return d_wildcard ? d_count - 1 : d_count;
+      }
+
+      bool isWildcard() const
+      {
+        return d_wildcard;
+      }
+
+    private:
+      std::array<uint8_t, 128> d_offsets;
+      const char* d_storage;
+      size_t d_count{0};
+      bool d_wildcard{false};
+    };
+
+    NameTriggers() :
+      d_base(std::make_shared<Node>())
+    {
+    }
+
+    const Entry* find(const DNSName& name) const;
+    /* replaces any existing entry for that exact trigger */
+    void insert(const DNSName& name, Entry&& entry);
+    bool erase(const DNSName& name);
+
+    /* calls v(name, entry) for every trigger */
+    template <typename V>
+    void visit(const V& v) const
+    {
+      visitNodes(d_base.get(), d_deltaSize > 0 ? &d_delta : nullptr, g_rootdnsname, v);
+    }
+
+    size_t size() const
+    {
+      return d_size;
+    }
+
+    bool empty() const
+    {
+      return d_size == 0;
+    }
+
+    void clear()
+    {
+      d_base = std::make_shared<Node>();
+      d_delta = Node();
+      d_size = 0;
+      d_deltaSize = 0;
+    }
+
+    /* Looks qname up in all the non-null tries at once, in a single walk over its labels.
+       Within a trie the exact trigger wins over the most specific wildcard, and the first
+       trie with a match wins over the next ones. which is set to the index of that trie,
+       and trigger to the name of the trigger that matched. */
+    static const Entry* lookup(const std::vector<const NameTriggers*>& tries, const DNSName& qname, size_t& which, DNSName& trigger);
+
+  private:
+    /* walks both layers at once, so that an entry of the delta layer hides the base one */
+    template <typename V>
+    static void visitNodes(const Node* base, const Node* delta, const DNSName& name, const V& v)
+    {
+      if (const auto entry = getEntry(base, delta, false)) {
+        v(name, *entry);
+      }
+      if (const auto entry = getEntry(base, delta, true)) {
+        v(g_wildcarddnsname + name, *entry);
+      }
+
+      const auto visitChild = [&name, &v](const std::string& label, const Node* baseChild, const Node* deltaChild) {
+        DNSName childName(name);
+        childName.prependRawLabel(label);
+        visitNodes(baseChild, deltaChild, childName, v);
+      };
+      if (base != nullptr) {
+        for (const auto& child : base->d_children) {
+          visitChild(child.first, &child.second, delta != nullptr ? delta->getChild(child.first) : nullptr);
+        }
+      }
+      if (delta != nullptr) {
+        for (const auto& child : delta->d_children) {
+          if (base == nullptr || base->getChild(child.first) == nullptr) {
+            visitChild(child.first, nullptr, &child.second);
+          }
+        }
+      }
+    }
+
+    static const Entry* getEntry(const Node* base, const Node* delta, bool wildcard);
+    static const Node* findNode(const Node& root, const Labels& labels);
+    static std::shared_ptr<const Entry>& getSlot(Node& root, const Labels& labels);
+    static void eraseSlot(Node& root, const Labels& labels);
+    static void mergeNode(Node& base, const Node& delta);
+    bool canUpdateBase() const;
+    void setInDelta(const Labels& labels, std::shared_ptr<const Entry>&& entry);
+    void compact();
+
+    std::shared_ptr<Node> d_base;
+    Node d_delta;
+    size_t d_size{0};
+    size_t d_deltaSize{0};
+  };
+
   class Zone {
   public:
     Zone(): d_zoneData(std::make_shared<PolicyZoneData>())
@@ -179,15 +353,15 @@ public:
 
     void clear()
     {
-      d_qpolAddr.clear();
-      d_postpolAddr.clear();
+      d_qpolAddr = std::make_shared<NetmaskTree<Policy>>();
+      d_postpolAddr = std::make_shared<NetmaskTree<Policy>>();
       d_propolName.clear();
-      d_propolNSAddr.clear();
+      d_propolNSAddr = std::make_shared<NetmaskTree<Policy>>();
       d_qpolName.clear();
     }
-    void reserve(size_t entriesCount)
+    void reserve(size_t)
     {
-      d_qpolName.reserve(entriesCount);
+      /* the name triggers are stored in a trie, nothing to reserve */
     }
     void setName(const std::string& name)
     {
@@ -244,7 +418,7 @@ public:
 
     size_t size() const
     {
-      return d_qpolAddr.size() + d_postpolAddr.size() + d_propolName.size() + d_propolNSAddr.size() + d_qpolName.size();
+      return d_qpolAddr->size() + d_postpolAddr->size() + d_propolName.size() + d_propolNSAddr->size() + d_qpolName.size();
     }
 
     void dump(FILE * fp) const;
@@ -269,7 +443,7 @@ public:
 
     bool hasClientPolicies() const
     {
-      return !d_qpolAddr.empty();
+      return !d_qpolAddr->empty();
     }
     bool hasQNamePolicies() const
     {
@@ -281,11 +455,23 @@ public:
     }
     bool hasNSIPPolicies() const
     {
-      return !d_propolNSAddr.empty();
+      return !d_propolNSAddr->empty();
     }
     bool hasResponsePolicies() const
     {
-      return !d_postpolAddr.empty();
+      return !d_postpolAddr->empty();
+    }
+    const NameTriggers& getQNameTriggers() const
+    {
+      return d_qpolName;
+    }
+    const NameTriggers& getNSTriggers() const
+    {
+      return d_propolName;
+    }
+    Policy getPolicy(const NameTriggers::Entry& entry, PolicyType type) const
+    {
+      return Policy(entry.d_kind, type, entry.d_ttl, d_zoneData, entry.d_custom);
     }
     Priority getPriority() const {
       return d_zoneData->d_priority;
@@ -297,22 +483,23 @@ public:
     static DNSName maskToRPZ(const Netmask& nm);
 
   private:
-    void addNameTrigger(std::unordered_map<DNSName,Policy>& map, const DNSName& n, Policy&& pol, bool ignoreDuplicate, PolicyType ptype);
-    void addNetmaskTrigger(NetmaskTree<Policy>& nmt, const Netmask& nm, Policy&& pol, bool ignoreDuplicate, PolicyType ptype);
-    bool rmNameTrigger(std::unordered_map<DNSName,Policy>& map, const DNSName& n, const Policy& pol);
-    bool rmNetmaskTrigger(NetmaskTree<Policy>& nmt, const Netmask& nm, const Policy& pol);
+    void addNameTrigger(NameTriggers& triggers, const DNSName& n, Policy&& pol, bool ignoreDuplicate, PolicyType ptype);
+    void addNetmaskTrigger(std::shared_ptr<NetmaskTree<Policy>>& nmt, const Netmask& nm, Policy&& pol, bool ignoreDuplicate, PolicyType ptype);
+    bool rmNameTrigger(NameTriggers& triggers, const DNSName& n, const Policy& pol);
+    bool rmNetmaskTrigger(std::shared_ptr<NetmaskTree<Policy>>& nmt, const Netmask& nm, const Policy& pol);
+    static NetmaskTree<Policy>& getWritable(std::shared_ptr<NetmaskTree<Policy>>& nmt);
 
   private:
-    static bool findExactNamedPolicy(const std::unordered_map<DNSName, DNSFilterEngine::Policy>& polmap, const DNSName& qname, DNSFilterEngine::Policy& pol);
-    static bool findNamedPolicy(const std::unordered_map<DNSName, DNSFilterEngine::Policy>& polmap, const DNSName& qname, DNSFilterEngine::Policy& pol);
+    bool findExactNamedPolicy(const NameTriggers& triggers, const DNSName& qname, PolicyType type, DNSFilterEngine::Policy& pol) const;
     static void dumpNamedPolicy(FILE* fp, const DNSName& name, const Policy& pol);
     static void dumpAddrPolicy(FILE* fp, const Netmask& nm, const DNSName& name, const Policy& pol);
 
-    std::unordered_map<DNSName, Policy> d_qpolName;   // QNAME trigger (RPZ)
-    NetmaskTree<Policy> d_qpolAddr;         // Source address
-    std::unordered_map<DNSName, Policy> d_propolName; // NSDNAME (RPZ)
-    NetmaskTree<Policy> d_propolNSAddr;     // NSIP (RPZ)
-    NetmaskTree<Policy> d_postpolAddr;      // IP trigger (RPZ)
+    /* copies of a zone share the netmask trees until one of them modifies a tree */
+    NameTriggers d_qpolName;                // QNAME trigger (RPZ)
+    std::shared_ptr<NetmaskTree<Policy>> d_qpolAddr{std::make_shared<NetmaskTree<Policy>>()};     // Source address
+    NameTriggers d_propolName;              // NSDNAME (RPZ)
+    std::shared_ptr<NetmaskTree<Policy>> d_propolNSAddr{std::make_shared<NetmaskTree<Policy>>()}; // NSIP (RPZ)
+    std::shared_ptr<NetmaskTree<Policy>> d_postpolAddr{std::make_shared<NetmaskTree<Policy>>()};  // IP trigger (RPZ)
     DNSName d_domain;
     std::shared_ptr<PolicyZoneData> d_zoneData{nullptr};
     uint32_t d_serial{0};
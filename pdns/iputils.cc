@@ -327,6 +327,42 @@ void fillMSGHdr(struct msghdr* msgh, struct iovec* iov, cmsgbuf_aligned* cbuf, s
   msgh->msg_flags = 0;
 }
 
+size_t sendUDPBatch(int sock, const std::vector<std::pair<ComboAddress, std::vector<uint8_t>>>& packets)
+{
+  size_t sent = 0;
+#ifdef HAVE_SENDMMSG
+  std::vector<struct mmsghdr> msgVec(packets.size());
+  std::vector<struct iovec> iovVec(packets.size());
+  for (size_t idx = 0; idx < packets.size(); idx++) {
+    const auto& packet = packets.at(idx);
+    fillMSGHdr(&msgVec.at(idx).msg_hdr, &iovVec.at(idx), nullptr, 0, const_cast<char*>(reinterpret_cast<const char*>(packet.second.data())), packet.second.size(), const_cast<ComboAddress*>(&packet.first));
+    msgVec.at(idx).msg_len = 0;
+  }
+
+  size_t pos = 0;
+  while (pos < packets.size()) {
+    int res = sendmmsg(sock, &msgVec.at(pos), packets.size() - pos, 0);
+    if (res <= 0) {
+      if (res < 0 && errno == EINTR) {
+        continue;
+      }
+      /* the first remaining packet could not be sent, skip it */
+      pos++;
+      continue;
+    }
+    sent += res;
+    pos += res;
+  }
+#else
+  for (const auto& packet : packets) {
+    if (sendto(sock, packet.second.data(), packet.second.size(), 0, reinterpret_cast<const struct sockaddr*>(&packet.first), packet.first.getSocklen()) >= 0) {
+      sent++;
+    }
+  }
+#endif /* HAVE_SENDMMSG */
+  return sent;
+}
+
 // warning: various parts of PowerDNS assume 'truncate' will never throw
 void ComboAddress::truncate(unsigned int bits) noexcept
 {
@@ -27,7 +27,12 @@
 #include <iostream>
 #include <stdio.h>
 #include <functional>
+#include <algorithm>
 #include <bitset>
+#include <limits>
+#include <memory>
+#include <tuple>
+#include <vector>
 #include "pdnsexception.hh"
 #include "misc.hh"
 #include <sys/socket.h>
@@ -1276,6 +1281,324 @@ private:
   size_type d_size;
 };
 
+/* Immutable, path-compressed copy of a NetmaskTree, for prefix lists that are built once and then
+   looked up a lot (ACLs, block lists). All nodes live in a single vector, and a node is only created
+   where a prefix is stored or where two branches diverge, so a lookup visits at most one node per
+   stored prefix on its path instead of one per bit. The network bits of each node are kept as two
+   host order 64-bit words, so a node is checked with a couple of XOR and mask operations.
+   It can be built from a NetmaskTree or in bulk from a vector of (Netmask, value) pairs, which is
+   sorted and turned into the tree in a single pass without any per-prefix allocation.
+   Since it is never modified, it can be shared between threads and replaced at once by publishing
+   a new one (via a GlobalStateHolder or a shared_ptr<const>): readers never wait on a writer.
+*/
+template <typename T>
+class FlatNetmaskTree
+{
+public:
+  typedef Netmask key_type;
+  typedef T value_type;
+  typedef std::pair<const key_type, value_type> node_type;
+  typedef size_t size_type;
+
+  FlatNetmaskTree()
+  {
+  }
+
+  explicit FlatNetmaskTree(const NetmaskTree<T>& tree)
+  {
+    std::vector<std::pair<key_type, value_type>> entries;
+    entries.reserve(tree.size());
+    for (const auto& entry : tree) {
+      entries.emplace_back(entry.first, entry.second);
+    }
+    build(std::move(entries));
+  }
+
+  /* bulk build, if the same prefix is present more than once the last value wins */
+  explicit FlatNetmaskTree(std::vector<std::pair<key_type, value_type>> entries)
+  {
+    build(std::move(entries));
+  }
+
+  //<! Returns "best match" for key_type, which might not be value
+  const node_type* lookup(const key_type& value) const
+  {
+    return lookup(value.getNetwork(), value.getBits());
+  }
+
+  //<! Perform best match lookup for value, using at most max_bits, like NetmaskTree::lookup()
+  const node_type* lookup(const ComboAddress& value, int max_bits = 128) const
+  {
+    size_t family;
+    if (value.isIPv4()) {
+      family = 0;
+    }
+    else if (value.isIPv6()) {
+      family = 1;
+    }
+    else {
+      throw NetmaskException("invalid address family");
+    }
+
+    uint8_t addr_bits = value.getBits();
+    if (max_bits < 0 || max_bits > addr_bits) {
+      max_bits = addr_bits;
+    }
+
+    uint64_t key[2];
+    toKey(value, key);
+
+    uint32_t index = d_roots[family];
+    const node_type* ret = nullptr;
+    const auto& table = d_tables[family];
+    if (!table.empty() && max_bits >= s_tableBits) {
+      /* skip the top of the tree, where every lookup goes through, in a single step */
+      const auto& slot = table[key[0] >> (64 - s_tableBits)];
+      index = slot.d_node;
+      if (slot.d_value != s_none) {
+        ret = &d_values[slot.d_value];
+      }
+    }
+
+    while (index != s_none) {
+      const auto& node = d_nodes[index];
+      if (node.d_bits > max_bits || !prefixMatches(key, node.d_key, node.d_bits)) {
+        break;
+      }
+      if (node.d_value != s_none) {
+        ret = &d_values[node.d_value];
+      }
+      if (node.d_bits == max_bits) {
+        break;
+      }
+      index = node.d_children[getBit(key, node.d_bits)];
+    }
+
+    return ret;
+  }
+
+  //<! check if given key is present
+  bool has_key(const key_type& key) const
+  {
+    const node_type* ptr = lookup(key);
+    return ptr && ptr->first == key;
+  }
+
+  //<! See if given ComboAddress matches any prefix
+  bool match(const ComboAddress& value) const
+  {
+    return lookup(value) != nullptr;
+  }
+
+  bool empty() const
+  {
+    return d_values.empty();
+  }
+
+  size_type size() const
+  {
+    return d_values.size();
+  }
+
+private:
+  struct Node
+  {
+    uint64_t d_key[2]; // network bits, host order, left aligned (an IPv4 address fills the top 32 bits)
+    uint32_t d_children[2]{s_none, s_none};
+    uint32_t d_value{s_none}; // index in d_values, if a prefix ends here
+    uint8_t d_bits{0};
+  };
+
+  struct Slot
+  {
+    uint32_t d_node; // first node with at least s_tableBits bits on the path, if any
+    uint32_t d_value; // longest prefix of less than s_tableBits bits covering the slot, if any
+  };
+
+  struct Entry
+  {
+    uint64_t d_key[2];
+    uint32_t d_index; // in the vector passed to build()
+    uint8_t d_bits;
+  };
+
+  static constexpr uint32_t s_none = std::numeric_limits<uint32_t>::max();
+  /* a family with that many prefixes gets a table indexed on the first s_tableBits bits of the address */
+  static constexpr size_t s_tableThreshold = 4096;
+  static constexpr uint8_t s_tableBits = 16;
+
+  static void toKey(const ComboAddress& addr, uint64_t key[2])
+  {
+    if (addr.isIPv4()) {
+      key[0] = static_cast<uint64_t>(ntohl(addr.sin4.sin_addr.s_addr)) << 32;
+      key[1] = 0;
+    }
+    else {
+      memcpy(&key[0], &addr.sin6.sin6_addr.s6_addr[0], sizeof(key[0]));
+      memcpy(&key[1], &addr.sin6.sin6_addr.s6_addr[8], sizeof(key[1]));
+      key[0] = be64toh(key[0]);
+      key[1] = be64toh(key[1]);
+    }
+  }
+
+  static void applyMask(uint64_t key[2], uint8_t bits)
+  {
+    if (bits < 64) {
+      key[0] = bits == 0 ? 0 : key[0] & (~static_cast<uint64_t>(0) << (64 - bits));
+      key[1] = 0;
+    }
+    else if (bits < 128) {
+      key[1] = bits == 64 ? 0 : key[1] & (~static_cast<uint64_t>(0) << (128 - bits));
+    }
+  }
+
+  static bool prefixMatches(const uint64_t key[2], const uint64_t prefix[2], uint8_t bits)
+  {
+    uint64_t diff[2] = {key[0] ^ prefix[0], key[1] ^ prefix[1]};
+    applyMask(diff, bits);
+    return (diff[0] | diff[1]) == 0;
+  }
+
+  static unsigned int getBit(const uint64_t key[2], uint8_t bit)
+  {
+    return bit < 64 ? (key[0] >> (63 - bit)) & 1 : (key[1] >> (127 - bit)) & 1;
+  }
+
+  static uint8_t commonBits(const uint64_t a[2], const uint64_t b[2])
+  {
+    if (a[0] != b[0]) {
+      return __builtin_clzll(a[0] ^ b[0]);
+    }
+    if (a[1] != b[1]) {
+      return 64 + __builtin_clzll(a[1] ^ b[1]);
+    }
+    return 128;
+  }
+
+  void build(std::vector<std::pair<key_type, value_type>>&& entries)
+  {
+    if (entries.size() >= s_none) {
+      throw std::range_error("Too many entries for a FlatNetmaskTree");
+    }
+
+    std::vector<Entry> sorted[2];
+    for (size_t idx = 0; idx < entries.size(); idx++) {
+      const auto& mask = entries[idx].first;
+      if (!mask.isIPv4() && !mask.isIPv6()) {
+        throw NetmaskException("invalid address family");
+      }
+      Entry entry;
+      toKey(mask.getNetwork(), entry.d_key);
+      entry.d_bits = mask.getBits();
+      applyMask(entry.d_key, entry.d_bits);
+      entry.d_index = idx;
+      sorted[mask.isIPv4() ? 0 : 1].push_back(entry);
+    }
+
+    d_nodes.reserve(entries.size() * 2);
+    d_values.reserve(entries.size());
+    for (size_t family = 0; family < 2; family++) {
+      auto& list = sorted[family];
+      if (list.empty()) {
+        continue;
+      }
+      /* by network then prefix length, so that a prefix comes right before the more specific ones it covers */
+      std::stable_sort(list.begin(), list.end(), [](const Entry& a, const Entry& b) {
+        return std::tie(a.d_key[0], a.d_key[1], a.d_bits) < std::tie(b.d_key[0], b.d_key[1], b.d_bits);
+      });
+      /* the sort is stable, so the last entry of a run of duplicates is the one that was added last */
+      size_t kept = 0;
+      for (size_t idx = 0; idx < list.size(); idx++) {
+        if (idx + 1 < list.size() && list[idx].d_bits == list[idx + 1].d_bits && list[idx].d_key[0] == list[idx + 1].d_key[0] && list[idx].d_key[1] == list[idx + 1].d_key[1]) {
+          continue;
+        }
+        list[kept++] = list[idx];
+      }
+      list.resize(kept);
+
+      d_roots[family] = buildNode(list, 0, list.size(), entries);
+      if (list.size() >= s_tableThreshold) {
+        buildTable(family);
+      }
+    }
+  }
+
+  void buildTable(size_t family)
+  {
+    auto& table = d_tables[family];
+    table.resize(static_cast<size_t>(1) << s_tableBits);
+    for (size_t idx = 0; idx < table.size(); idx++) {
+      uint64_t key[2] = {static_cast<uint64_t>(idx) << (64 - s_tableBits), 0};
+      uint32_t index = d_roots[family];
+      uint32_t value = s_none;
+      while (index != s_none) {
+        const auto& node = d_nodes[index];
+        if (!prefixMatches(key, node.d_key, std::min(node.d_bits, s_tableBits))) {
+          index = s_none;
+          break;
+        }
+        if (node.d_bits >= s_tableBits) {
+          break;
+        }
+        if (node.d_value != s_none) {
+          value = node.d_value;
+        }
+        index = node.d_children[getBit(key, node.d_bits)];
+      }
+      table[idx] = {index, value};
+    }
+  }
+
+  /* builds the node covering [begin, end[, sorted and without duplicates, and returns its index */
+  uint32_t buildNode(const std::vector<Entry>& list, size_t begin, size_t end, std::vector<std::pair<key_type, value_type>>& entries)
+  {
+    /* the entries are sorted so the first and the last ones have the shortest common prefix */
+    uint8_t bits = commonBits(list[begin].d_key, list[end - 1].d_key);
+    for (size_t idx = begin; idx < end; idx++) {
+      bits = std::min(bits, list[idx].d_bits);
+    }
+
+    uint32_t index = d_nodes.size();
+    d_nodes.emplace_back();
+    auto& node = d_nodes.back();
+    node.d_key[0] = list[begin].d_key[0];
+    node.d_key[1] = list[begin].d_key[1];
+    applyMask(node.d_key, bits);
+    node.d_bits = bits;
+
+    /* if one of the prefixes ends here, it has the lowest network and is therefore the first one */
+    if (list[begin].d_bits == bits) {
+      auto& entry = entries[list[begin].d_index];
+      node.d_value = d_values.size();
+      d_values.emplace_back(entry.first.getNormalized(), std::move(entry.second));
+      begin++;
+    }
+
+    if (begin < end) {
+      auto middle = std::partition_point(list.begin() + begin, list.begin() + end, [bits](const Entry& entry) {
+        return getBit(entry.d_key, bits) == 0;
+      });
+      size_t split = middle - list.begin();
+      /* d_nodes might be reallocated by the recursive calls, so no reference to our node past this point */
+      if (begin < split) {
+        uint32_t child = buildNode(list, begin, split, entries);
+        d_nodes[index].d_children[0] = child;
+      }
+      if (split < end) {
+        uint32_t child = buildNode(list, split, end, entries);
+        d_nodes[index].d_children[1] = child;
+      }
+    }
+
+    return index;
+  }
+
+  std::vector<Node> d_nodes;
+  std::vector<node_type> d_values;
+  std::vector<Slot> d_tables[2];
+  uint32_t d_roots[2]{s_none, s_none}; // IPv4, IPv6
+};
+
 /** This class represents a group of supplemental Netmask classes. An IP address matches
     if it is matched by one or more of the Netmask objects within.
 */
@@ -1289,7 +1612,7 @@ public:
 
   bool match(const ComboAddress *ip) const
   {
-    const auto &ret = tree.lookup(*ip);
+    const auto &ret = d_frozen ? d_frozen->lookup(*ip) : tree.lookup(*ip);
     if(ret) return ret->second;
     return false;
   }
@@ -1301,7 +1624,7 @@ public:
 
   bool lookup(const ComboAddress* ip, Netmask* nmp) const
   {
-    const auto &ret = tree.lookup(*ip);
+    const auto &ret = d_frozen ? d_frozen->lookup(*ip) : tree.lookup(*ip);
     if (ret) {
       if (nmp != nullptr)
         *nmp = ret->first;
@@ -1330,6 +1653,7 @@ public:
   void addMask(const Netmask& nm, bool positive=true)
   {
     tree.insert(nm).second=positive;
+    d_frozen.reset();
   }
 
   void addMasks(const NetmaskGroup& group, boost::optional<bool> positive)
@@ -1343,6 +1667,7 @@ public:
   void deleteMask(const Netmask& nm)
   {
     tree.erase(nm);
+    d_frozen.reset();
   }
 
   void deleteMask(const std::string& ip)
@@ -1354,6 +1679,7 @@ public:
   void clear()
   {
     tree.clear();
+    d_frozen.reset();
   }
 
   bool empty() const
@@ -1395,8 +1721,16 @@ public:
       addMask(*iter);
   }
 
+  /* Builds a flat, immutable copy of the masks added so far, which match() and lookup() use
+     until the next change. Call it once the group has been filled, before sharing it. */
+  void freeze()
+  {
+    d_frozen = std::make_shared<const FlatNetmaskTree<bool>>(tree);
+  }
+
 private:
   NetmaskTree<bool> tree;
+  std::shared_ptr<const FlatNetmaskTree<bool>> d_frozen{nullptr};
 };
 
 struct SComboAddress
@@ -1449,6 +1783,9 @@ void fillMSGHdr(struct msghdr* msgh, struct iovec* iov, cmsgbuf_aligned* cbuf, s
 int sendOnNBSocket(int fd, const struct msghdr *msgh);
 ssize_t sendfromto(int sock, const void* data, size_t len, int flags, const ComboAddress& from, const ComboAddress& to);
 size_t sendMsgWithOptions(int fd, const char* buffer, size_t len, const ComboAddress* dest, const ComboAddress* local, unsigned int localItf, int flags);
+/* sends each packet to its destination over the (unconnected) UDP socket, using as few system calls as possible.
+   A packet that can't be sent is skipped, the number of packets actually sent is returned */
+size_t sendUDPBatch(int sock, const std::vector<std::pair<ComboAddress, std::vector<uint8_t>>>& packets);
 
 /* requires a non-blocking, connected TCP socket */
 bool isTCPSocketUsable(int sock);
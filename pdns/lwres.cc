@@ -49,6 +49,7 @@
 #include "ednssubnet.hh"
 #include "query-local-address.hh"
 #include "tcpiohandler.hh"
+#include "rec-tcpout.hh"
 
 #include "rec-protozero.hh"
 #include "uuid-utils.hh"
@@ -80,7 +81,8 @@ static void logFstreamQuery(const std::shared_ptr<std::vector<std::unique_ptr<Fr
 
   struct timespec ts;
   TIMEVAL_TO_TIMESPEC(&queryTime, &ts);
-  std::string str;
+  static thread_local std::string str;
+  str.clear();
   DnstapMessage message(str, DnstapMessage::MessageType::resolver_query, SyncRes::s_serverID, &localip, &ip, protocol, reinterpret_cast<const char*>(&*packet.begin()), packet.size(), &ts, nullptr, auth);
 
   for (auto& logger : *fstreamLoggers) {
@@ -109,7 +111,8 @@ static void logFstreamResponse(const std::shared_ptr<std::vector<std::unique_ptr
   struct timespec ts1, ts2;
   TIMEVAL_TO_TIMESPEC(&queryTime, &ts1);
   TIMEVAL_TO_TIMESPEC(&replyTime, &ts2);
-  std::string str;
+  static thread_local std::string str;
+  str.clear();
   DnstapMessage message(str, DnstapMessage::MessageType::resolver_response, SyncRes::s_serverID, &localip, &ip, protocol, reinterpret_cast<const char*>(packet.data()), packet.size(), &ts1, &ts2, auth);
 
   for (auto& logger : *fstreamLoggers) {
@@ -229,6 +232,49 @@ static void logIncomingResponse(const std::shared_ptr<std::vector<std::unique_pt
   }
 }
 
+// Sends the query over the connection and reads the answer into buf, the connection is left open
+static LWResult::Result tcpsendrecv(const ComboAddress& ip, TCPOutConnectionManager::Connection& connection, ComboAddress& localip, const vector<uint8_t>& vpacket, size_t& len, PacketBuffer& buf)
+{
+  socklen_t slen = ip.getSocklen();
+  uint16_t tlen = htons(vpacket.size());
+  const char *lenP = reinterpret_cast<const char*>(&tlen);
+
+  len = 0; // in case of error
+  localip.sin4.sin_family = ip.sin4.sin_family;
+  if (getsockname(connection.d_handler->getDescriptor(), reinterpret_cast<sockaddr*>(&localip), &slen) != 0) {
+    return LWResult::Result::PermanentError;
+  }
+
+  PacketBuffer packet;
+  packet.reserve(2 + vpacket.size());
+  packet.insert(packet.end(), lenP, lenP + 2);
+  packet.insert(packet.end(), vpacket.begin(), vpacket.end());
+
+  LWResult::Result ret = asendtcp(packet, connection.d_handler);
+  if (ret != LWResult::Result::Success) {
+    return ret;
+  }
+
+  ret = arecvtcp(packet, 2, connection.d_handler, false);
+  if (ret != LWResult::Result::Success) {
+    return ret;
+  }
+
+  memcpy(&tlen, packet.data(), sizeof(tlen));
+  len = ntohs(tlen); // switch to the 'len' shared with the rest of the calling function
+
+  // XXX receive into buf directly?
+  packet.resize(len);
+  ret = arecvtcp(packet, len, connection.d_handler, false);
+  if (ret != LWResult::Result::Success) {
+    return ret;
+  }
+
+  buf.resize(len);
+  memcpy(buf.data(), packet.data(), len);
+  return LWResult::Result::Success;
+}
+
 /** lwr is only filled out in case 1 was returned, and even when returning 1 for 'success', lwr might contain DNS errors
     Never throws! 
  */
@@ -342,75 +388,57 @@ LWResult::Result asyncresolve(const ComboAddress& ip, const DNSName& domain, int
     ret = arecvfrom(buf, 0, ip, &len, qid, domain, type, queryfd, now);
   }
   else {
-    try {
-      const struct timeval timeout{ g_networkTimeoutMsec / 1000, static_cast<suseconds_t>(g_networkTimeoutMsec) % 1000 * 1000};
-
-      Socket s(ip.sin4.sin_family, SOCK_STREAM);
-      s.setNonBlocking();
-      localip = pdns::getQueryLocalAddress(ip.sin4.sin_family, 0);
-      s.bind(localip);
-
-      std::shared_ptr<TLSCtx> tlsCtx{nullptr};
-      if (SyncRes::s_dot_to_port_853 && ip.getPort() == 853) {
-        TLSContextParameters tlsParams;
-        tlsParams.d_provider = "openssl";
-        tlsParams.d_validateCertificates = false;
-        //tlsParams.d_caStore = caaStore;
-        tlsCtx = getTLSContext(tlsParams);
-        if (tlsCtx == nullptr) {
-          g_log << Logger::Error << "DoT to " << ip << " requested but not available" << endl;
-        }
-        else {
-          dnsOverTLS = true;
+    bool isNew = true;
+    do {
+      try {
+        // Use a new connection if we don't have an idle one to this remote, or if a reused
+        // one turns out to have been closed by the remote end in the meantime
+        auto connection = t_tcp_manager.get(ip);
+        isNew = connection.d_handler == nullptr;
+        localip = pdns::getQueryLocalAddress(ip.sin4.sin_family, 0);
+
+        if (isNew) {
+          const struct timeval timeout{ g_networkTimeoutMsec / 1000, static_cast<suseconds_t>(g_networkTimeoutMsec) % 1000 * 1000};
+
+          Socket s(ip.sin4.sin_family, SOCK_STREAM);
+          s.setNonBlocking();
+          s.bind(localip);
+
+          std::shared_ptr<TLSCtx> tlsCtx{nullptr};
+          if (SyncRes::s_dot_to_port_853 && ip.getPort() == 853) {
+            TLSContextParameters tlsParams;
+            tlsParams.d_provider = "openssl";
+            tlsParams.d_validateCertificates = false;
+            //tlsParams.d_caStore = caaStore;
+            tlsCtx = getTLSContext(tlsParams);
+            if (tlsCtx == nullptr) {
+              g_log << Logger::Error << "DoT to " << ip << " requested but not available" << endl;
+            }
+          }
+          connection.d_handler = std::make_shared<TCPIOHandler>("", s.releaseHandle(), timeout, tlsCtx, now->tv_sec);
+          // Returned state ignored
+          connection.d_handler->tryConnect(SyncRes::s_tcp_fast_open_connect, ip);
         }
-      }
-      auto handler = std::make_shared<TCPIOHandler>("", s.releaseHandle(), timeout, tlsCtx, now->tv_sec);
-      // Returned state ignored
-      handler->tryConnect(SyncRes::s_tcp_fast_open_connect, ip);
-
-      uint16_t tlen=htons(vpacket.size());
-      char *lenP=(char*)&tlen;
-      const char *msgP=(const char*)&*vpacket.begin();
-      PacketBuffer packet;
-      packet.reserve(2 + vpacket.size());
-      packet.insert(packet.end(), lenP, lenP+2);
-      packet.insert(packet.end(), msgP, msgP+vpacket.size());
-      ret = asendtcp(packet, handler);
-      if (ret != LWResult::Result::Success) {
-        handler->close();
-        return ret;
-      }
+        dnsOverTLS = connection.d_handler->isTLS();
 
+        ret = tcpsendrecv(ip, connection, localip, vpacket, len, buf);
 #ifdef HAVE_FSTRM
-      if (fstrmQEnabled) {
-        logFstreamQuery(fstrmLoggers, queryTime, localip, ip, !dnsOverTLS ? DnstapMessage::ProtocolType::DoTCP : DnstapMessage::ProtocolType::DoT, context ? context->d_auth : boost::none, vpacket);
-      }
+        if (fstrmQEnabled && ret != LWResult::Result::PermanentError) {
+          logFstreamQuery(fstrmLoggers, queryTime, localip, ip, !dnsOverTLS ? DnstapMessage::ProtocolType::DoTCP : DnstapMessage::ProtocolType::DoT, context ? context->d_auth : boost::none, vpacket);
+        }
 #endif /* HAVE_FSTRM */
 
-      ret = arecvtcp(packet, 2, handler, false);
-      if (ret != LWResult::Result::Success) {
-        return ret;
+        if (ret == LWResult::Result::Success) {
+          connection.d_numqueries++;
+          t_tcp_manager.store(*now, ip, std::move(connection));
+          break;
+        }
+        connection.d_handler->close();
       }
-
-      memcpy(&tlen, packet.data(), sizeof(tlen));
-      len=ntohs(tlen); // switch to the 'len' shared with the rest of the function
-
-      // XXX receive into buf directly?
-      packet.resize(len);
-      ret = arecvtcp(packet, len, handler, false);
-      if (ret != LWResult::Result::Success) {
-        return ret;
+      catch (const NetworkError& ne) {
+        ret = LWResult::Result::OSLimitError; // OS limits error
       }
-
-      buf.resize(len);
-      memcpy(buf.data(), packet.data(), len);
-
-      handler->close();
-      ret = LWResult::Result::Success;
-    }
-    catch (const NetworkError& ne) {
-      ret = LWResult::Result::OSLimitError; // OS limits error
-    }
+    } while (!isNew && ret == LWResult::Result::PermanentError);
   }
 
   lwr->d_usec=dt.udiff();
@@ -438,12 +466,13 @@ LWResult::Result asyncresolve(const ComboAddress& ip, const DNSName& domain, int
   lwr->d_records.clear();
   try {
     lwr->d_tcbit=0;
-    MOADNSParser mdp(false, reinterpret_cast<const char*>(buf.data()), buf.size());
-    lwr->d_aabit=mdp.d_header.aa;
-    lwr->d_tcbit=mdp.d_header.tc;
-    lwr->d_rcode=mdp.d_header.rcode;
+    /* names and contents are only decoded once we know that this is the answer we were waiting for */
+    DNSPacketView view(false, reinterpret_cast<const char*>(buf.data()), buf.size());
+    lwr->d_aabit=view.d_header.aa;
+    lwr->d_tcbit=view.d_header.tc;
+    lwr->d_rcode=view.d_header.rcode;
     
-    if(mdp.d_header.rcode == RCode::FormErr && mdp.d_qname.empty() && mdp.d_qtype == 0 && mdp.d_qclass == 0) {
+    if(view.d_header.rcode == RCode::FormErr && view.d_header.qdcount == 0 && view.d_qtype == 0 && view.d_qclass == 0) {
       if(outgoingLoggers) {
         logIncomingResponse(outgoingLoggers, context ? context->d_initialRequestId : boost::none, uuid, ip, domain, type, qid, doTCP, srcmask, len, lwr->d_rcode, lwr->d_records, queryTime, exportTypes);
       }
@@ -451,20 +480,20 @@ LWResult::Result asyncresolve(const ComboAddress& ip, const DNSName& domain, int
       return LWResult::Result::Success; // this is "success", the error is set in lwr->d_rcode
     }
 
-    if(domain != mdp.d_qname) { 
-      if(!mdp.d_qname.empty() && domain.toString().find((char)0) == string::npos /* ugly */) {// embedded nulls are too noisy, plus empty domains are too
-        g_log<<Logger::Notice<<"Packet purporting to come from remote server "<<ip.toString()<<" contained wrong answer: '" << domain << "' != '" << mdp.d_qname << "'" << endl;
+    if(!view.qnameEquals(domain)) {
+      if(view.d_header.qdcount != 0 && domain.toString().find((char)0) == string::npos /* ugly */) {// embedded nulls are too noisy, plus empty domains are too
+        g_log<<Logger::Notice<<"Packet purporting to come from remote server "<<ip.toString()<<" contained wrong answer: '" << domain << "' != '" << view.getQName() << "'" << endl;
       }
       // unexpected count has already been done @ pdns_recursor.cc
       goto out;
     }
 
-    lwr->d_records.reserve(mdp.d_answers.size());
-    for(const auto& a : mdp.d_answers)
-      lwr->d_records.push_back(a.first);
+    lwr->d_records.reserve(view.getRecords().size());
+    for(const auto& record : view.getRecords())
+      lwr->d_records.push_back(view.getDNSRecord(record));
 
     EDNSOpts edo;
-    if(EDNS0Level > 0 && getEDNSOpts(mdp, &edo)) {
+    if(EDNS0Level > 0 && getEDNSOpts(view, &edo)) {
       lwr->d_haveEDNS = true;
 
       if(weWantEDNSSubnet) {
@@ -500,6 +529,7 @@ LWResult::Result asyncresolve(const ComboAddress& ip, const DNSName& domain, int
       g_log<<Logger::Notice<<"Unable to parse packet from remote server "<<ip.toString()<<": "<<mde.what()<<endl;
     }
 
+    lwr->d_records.clear();
     lwr->d_rcode = RCode::FormErr;
     lwr->d_validpacket = false;
     g_stats.serverParseError++;
@@ -41,6 +41,9 @@
 #include "base64.hh"
 #include "namespaces.hh"
 #include "query-local-address.hh"
+#include "statbag.hh"
+
+extern StatBag S;
 
 
 void CommunicatorClass::queueNotifyDomain(const DomainInfo& di, UeberBackend* B)
@@ -131,7 +134,7 @@ bool CommunicatorClass::notifyDomain(const DNSName &domain, UeberBackend* B)
 void NotificationQueue::dump()
 {
   cerr<<"Waiting for notification responses: "<<endl;
-  for(NotificationRequest& nr :  d_nqueue) {
+  for(const NotificationRequest& nr :  d_nqueue) {
     cerr<<nr.domain<<", "<<nr.ip<<endl;
   }
 }
@@ -195,18 +198,21 @@ time_t CommunicatorClass::doNotifications(PacketHandler *P)
     if(p.d.rcode)
       g_log<<Logger::Warning<<"Received unsuccessful notification report for '"<<p.qdomain<<"' from "<<from.toStringWithPort()<<", error: "<<RCode::to_s(p.d.rcode)<<endl;      
 
-    if(d_nq.removeIf(from.toStringWithPort(), p.d.id, p.qdomain))
+    if(d_nq.removeIf(from, p.d.id, p.qdomain)) {
+      S.inc("outgoing-notifications-answered");
       g_log<<Logger::Notice<<"Removed from notification list: '"<<p.qdomain<<"' to "<<from.toStringWithPort()<<" "<< (p.d.rcode ? RCode::to_s(p.d.rcode) : "(was acknowledged)")<<endl;
+    }
     else {
       g_log<<Logger::Warning<<"Received spurious notify answer for '"<<p.qdomain<<"' from "<< from.toStringWithPort()<<endl;
       //d_nq.dump();
     }
   }
 
-  // send out possible new notifications
+  // send out possible new notifications, in batches
   DNSName domain;
   string ip;
   uint16_t id=0;
+  notificationBatch_t batch4, batch6;
 
   bool purged;
   while(d_nq.getOne(domain, ip, &id, purged)) {
@@ -216,27 +222,57 @@ time_t CommunicatorClass::doNotifications(PacketHandler *P)
         if((d_nsock6 < 0 && remote.sin4.sin_family == AF_INET6) ||
            (d_nsock4 < 0 && remote.sin4.sin_family == AF_INET)) {
              g_log<<Logger::Warning<<"Unable to notify "<<remote.toStringWithPort()<<" for domain '"<<domain<<"', address family is disabled. Is an IPv"<<(remote.sin4.sin_family == AF_INET ? "4" : "6")<<" address set in query-local-address?"<<endl;
-             d_nq.removeIf(remote.toStringWithPort(), id, domain); // Remove, we'll never be able to notify
+             d_nq.cancel(remote, id, domain); // Remove, we'll never be able to notify
              continue; // don't try to notify what we can't!
         }
         if(d_preventSelfNotification && AddressIsUs(remote))
           continue;
 
-        sendNotification(remote.sin4.sin_family == AF_INET ? d_nsock4 : d_nsock6, domain, remote, id, B);
+        vector<uint8_t> packet;
+        if (!makeNotification(domain, id, B, packet)) {
+          continue;
+        }
+
+        bool v4 = remote.sin4.sin_family == AF_INET;
+        auto& batch = v4 ? batch4 : batch6;
+        batch.emplace_back(remote, std::move(packet));
+        if (batch.size() >= s_maxNotificationBatchSize) {
+          sendNotifications(v4 ? d_nsock4 : d_nsock6, batch);
+        }
         drillHole(domain, ip);
       }
       catch(ResolverException &re) {
         g_log<<Logger::Warning<<"Error trying to resolve '"<<ip<<"' for notifying '"<<domain<<"' to server: "<<re.reason<<endl;
       }
     }
-    else
+    else {
+      S.inc("outgoing-notifications-failed");
       g_log<<Logger::Warning<<"Notification for "<<domain<<" to "<<ip<<" failed after retries"<<endl;
+    }
   }
 
+  sendNotifications(d_nsock4, batch4);
+  sendNotifications(d_nsock6, batch6);
+  S.set("outgoing-notifications-queue", d_nq.size());
+
   return d_nq.earliest();
 }
 
-void CommunicatorClass::sendNotification(int sock, const DNSName& domain, const ComboAddress& remote, uint16_t id, UeberBackend *B)
+void CommunicatorClass::sendNotifications(int sock, notificationBatch_t& batch)
+{
+  if (batch.empty()) {
+    return;
+  }
+
+  size_t sent = sendUDPBatch(sock, batch);
+  S.deposit("outgoing-notifications", sent);
+  if (sent != batch.size()) {
+    g_log<<Logger::Warning<<"Unable to send "<<(batch.size() - sent)<<" out of "<<batch.size()<<" notifications, they will be retried"<<endl;
+  }
+  batch.clear();
+}
+
+bool CommunicatorClass::makeNotification(const DNSName& domain, uint16_t id, UeberBackend *B, vector<uint8_t>& packet)
 {
   vector<string> meta;
   DNSName tsigkeyname;
@@ -248,7 +284,6 @@ void CommunicatorClass::sendNotification(int sock, const DNSName& domain, const
     tsigkeyname = DNSName(meta[0]);
   }
 
-  vector<uint8_t> packet;
   DNSPacketWriter pw(packet, domain, QType::SOA, 1, Opcode::Notify);
   pw.getHeader()->id = id;
   pw.getHeader()->aa = true; 
@@ -256,7 +291,7 @@ void CommunicatorClass::sendNotification(int sock, const DNSName& domain, const
   if (tsigkeyname.empty() == false) {
     if (!B->getTSIGKey(tsigkeyname, &tsigalgorithm, &tsigsecret64)) {
       g_log<<Logger::Warning<<"TSIG key '"<<tsigkeyname<<"' for domain '"<<domain<<"' not found"<<endl;
-      return;
+      return false;
     }
     TSIGRecordContent trc;
     if (tsigalgorithm.toStringNoDot() == "hmac-md5")
@@ -269,14 +304,12 @@ void CommunicatorClass::sendNotification(int sock, const DNSName& domain, const
     trc.d_eRcode=0;
     if (B64Decode(tsigsecret64, tsigsecret) == -1) {
       g_log<<Logger::Error<<"Unable to Base-64 decode TSIG key '"<<tsigkeyname<<"' for domain '"<<domain<<"'"<<endl;
-      return;
+      return false;
     }
     addTSIG(pw, trc, tsigkeyname, tsigsecret, "", false);
   }
 
-  if(sendto(sock, &packet[0], packet.size(), 0, (struct sockaddr*)(&remote), remote.getSocklen()) < 0) {
-    throw ResolverException("Unable to send notify to "+remote.toStringWithPort()+": "+stringerror());
-  }
+  return true;
 }
 
 void CommunicatorClass::drillHole(const DNSName &domain, const string &ip)
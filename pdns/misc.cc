@@ -958,6 +958,9 @@ uint32_t burtle(const unsigned char* k, uint32_t length, uint32_t initval)
 uint32_t burtleCI(const unsigned char* k, uint32_t length, uint32_t initval)
 {
   uint32_t a,b,c,len;
+  /* the key is lowercased into this buffer a chunk at a time, which is much faster than doing it byte per byte.
+     The size is a multiple of 12 so that the chunks end where a round of the loop below does. */
+  unsigned char lowered[240];
 
    /* Set up the internal state */
   len = length;
@@ -966,11 +969,15 @@ uint32_t burtleCI(const unsigned char* k, uint32_t length, uint32_t initval)
 
   /*---------------------------------------- handle most of the key */
   while (len >= 12) {
-    a += (dns_tolower(k[0]) +((uint32_t)dns_tolower(k[1])<<8) +((uint32_t)dns_tolower(k[2])<<16) +((uint32_t)dns_tolower(k[3])<<24));
-    b += (dns_tolower(k[4]) +((uint32_t)dns_tolower(k[5])<<8) +((uint32_t)dns_tolower(k[6])<<16) +((uint32_t)dns_tolower(k[7])<<24));
-    c += (dns_tolower(k[8]) +((uint32_t)dns_tolower(k[9])<<8) +((uint32_t)dns_tolower(k[10])<<16)+((uint32_t)dns_tolower(k[11])<<24));
-    burtlemix(a,b,c);
-    k += 12; len -= 12;
+    uint32_t chunk = std::min(len - (len % 12), static_cast<uint32_t>(sizeof(lowered)));
+    dns_tolower_buffer(lowered, k, chunk);
+    for (const unsigned char* l = lowered; l < lowered + chunk; l += 12) {
+      a += (l[0] +((uint32_t)l[1]<<8) +((uint32_t)l[2]<<16) +((uint32_t)l[3]<<24));
+      b += (l[4] +((uint32_t)l[5]<<8) +((uint32_t)l[6]<<16) +((uint32_t)l[7]<<24));
+      c += (l[8] +((uint32_t)l[9]<<8) +((uint32_t)l[10]<<16)+((uint32_t)l[11]<<24));
+      burtlemix(a,b,c);
+    }
+    k += chunk; len -= chunk;
   }
 
   /*------------------------------------- handle the last 11 bytes */
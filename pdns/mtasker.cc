@@ -267,7 +267,15 @@ template<class Key, class Val, class Cmp>void MTasker<Key,Val,Cmp>::makeThread(t
   auto uc=std::make_shared<pdns_ucontext_t>();
   
   uc->uc_link = &d_kernel; // come back to kernel after dying
-  uc->uc_stack.resize (d_stacksize+1);
+  if (!d_stackPool.empty()) {
+    uc->uc_stack = std::move(d_stackPool.back());
+    d_stackPool.pop_back();
+    ++d_stackPoolHits;
+  }
+  else {
+    uc->uc_stack = pdns_stack_t(d_stacksize+1);
+    ++d_stackPoolMisses;
+  }
 #ifdef PDNS_USE_VALGRIND
   uc->valgrind_id = VALGRIND_STACK_REGISTER(&uc->uc_stack[0],
                                             &uc->uc_stack[uc->uc_stack.size()-1]);
@@ -318,7 +326,14 @@ template<class Key, class Val, class Cmp>bool MTasker<Key,Val,Cmp>::schedule(con
     return true;
   }
   if(!d_zombiesQueue.empty()) {
-    d_threads.erase(d_zombiesQueue.front());
+    auto zombie = d_threads.find(d_zombiesQueue.front());
+    if (zombie != d_threads.end()) {
+      // nobody else should be holding the context of a thread that is done, but better safe than sorry
+      if (zombie->second.context.use_count() == 1) {
+        recycleStack(*zombie->second.context);
+      }
+      d_threads.erase(zombie);
+    }
     --d_threadsCount;
     d_zombiesQueue.pop();
     return true;
@@ -403,6 +418,35 @@ template<class Key, class Val, class Cmp>uint64_t MTasker<Key,Val,Cmp>::getMaxSt
   return d_threads[d_tid].startOfStack - d_threads[d_tid].highestStackSeen;
 }
 
+//! Returns the largest part of a stack ever used by any MThread, as far as the platform can tell
+/** Unlike getMaxStackUsage(), this looks at how much of the stacks has actually been touched, and not only
+    at the depth reached when waiting for an event. It needs a system call per stack so it should not be called too often.
+*/
+template<class Key, class Val, class Cmp>uint64_t MTasker<Key,Val,Cmp>::getStackHighWaterMark()
+{
+  for (const auto& stack : d_stackPool) {
+    d_stackHighWaterMark = std::max(d_stackHighWaterMark, stack.getHighWaterMark());
+  }
+  for (const auto& thread : d_threads) {
+    if (thread.second.context) {
+      d_stackHighWaterMark = std::max(d_stackHighWaterMark, thread.second.context->uc_stack.getHighWaterMark());
+    }
+  }
+  return d_stackHighWaterMark;
+}
+
+//! Puts the stack of a thread that is done back into the pool, if there is room for it
+template<class Key, class Val, class Cmp>void MTasker<Key,Val,Cmp>::recycleStack(pdns_ucontext_t& context)
+{
+  if (d_stackPool.size() < d_stackPoolSize) {
+    d_stackPool.push_back(std::move(context.uc_stack));
+  }
+  else if (d_stackPoolSize > 0) {
+    // this stack is about to be unmapped, remember how much of it was used
+    d_stackHighWaterMark = std::max(d_stackHighWaterMark, context.uc_stack.getHighWaterMark());
+  }
+}
+
 //! Returns the maximum stack usage so far of this MThread
 template<class Key, class Val, class Cmp>unsigned int MTasker<Key,Val,Cmp>::getUsec()
 {
@@ -67,7 +67,12 @@ private:
 
   typedef std::map<int, ThreadInfo> mthreads_t;
   mthreads_t d_threads;
+  std::vector<pdns_stack_t> d_stackPool;
   size_t d_stacksize;
+  size_t d_stackPoolSize;
+  size_t d_stackHighWaterMark{0};
+  uint64_t d_stackPoolHits{0};
+  uint64_t d_stackPoolMisses{0};
   size_t d_threadsCount;
   int d_tid;
   int d_maxtid;
@@ -117,13 +122,15 @@ public:
   /** Constructor with a small default stacksize. If any of your threads exceeds this stack, your application will crash. 
       This limit applies solely to the stack, the heap is not limited in any way. If threads need to allocate a lot of data,
       the use of new/delete is suggested. 
+      Up to stackPoolSize stacks of threads that are done are kept around to be reused by new threads.
    */
-  MTasker(size_t stacksize=16*8192) : d_stacksize(stacksize), d_threadsCount(0), d_tid(0), d_maxtid(0), d_waitstatus(Error)
+  MTasker(size_t stacksize=16*8192, size_t stackPoolSize=0) : d_stacksize(stacksize), d_stackPoolSize(stackPoolSize), d_threadsCount(0), d_tid(0), d_maxtid(0), d_waitstatus(Error)
   {
     initMainStackBounds();
 
     // make sure our stack is 16-byte aligned to make all the architectures happy
     d_stacksize = d_stacksize >> 4 << 4;
+    d_stackPool.reserve(d_stackPoolSize);
   }
 
   typedef void tfunc_t(void *); //!< type of the pointer that starts a thread 
@@ -137,9 +144,20 @@ public:
   unsigned int numProcesses() const;
   int getTid() const;
   uint64_t getMaxStackUsage();
+  uint64_t getStackHighWaterMark();
+  uint64_t getStackPoolHits() const
+  {
+    return d_stackPoolHits;
+  }
+  uint64_t getStackPoolMisses() const
+  {
+    return d_stackPoolMisses;
+  }
   unsigned int getUsec();
 
 private:
+  void recycleStack(pdns_ucontext_t& context);
+
   EventKey d_eventkey;   // for waitEvent, contains exact key it was awoken for
 };
 #include "mtasker.cc"
@@ -28,3 +28,106 @@
 #else
 #include "mtasker_ucontext.cc"
 #endif
+
+#include <stdexcept>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// On OpenBSD mem used as stack should be marked MAP_STACK
+#if !defined(MAP_STACK)
+#define MAP_STACK 0
+#endif
+
+static size_t getStackPageSize()
+{
+  static const size_t pageSize = sysconf(_SC_PAGESIZE);
+  return pageSize;
+}
+
+pdns_stack_t::pdns_stack_t(size_t size) :
+  d_size(size)
+{
+  const auto pageSize = getStackPageSize();
+  /* the stack itself, rounded up to a page, plus the guard page */
+  d_mappingSize = ((size + pageSize - 1) / pageSize) * pageSize + pageSize;
+
+  void* mapping = mmap(nullptr, d_mappingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON | MAP_STACK, -1, 0);
+  if (mapping == MAP_FAILED) {
+    throw std::bad_alloc();
+  }
+  d_mapping = static_cast<char*>(mapping);
+
+  /* the stack grows downwards, so the guard page is the lowest one */
+  if (mprotect(d_mapping, pageSize, PROT_NONE) != 0) {
+    munmap(d_mapping, d_mappingSize);
+    throw std::bad_alloc();
+  }
+
+  /* and the stack ends at the top of the mapping */
+  d_stack = d_mapping + d_mappingSize - d_size;
+}
+
+pdns_stack_t::pdns_stack_t(pdns_stack_t&& rhs) noexcept :
+  d_mapping(rhs.d_mapping), d_stack(rhs.d_stack), d_mappingSize(rhs.d_mappingSize), d_size(rhs.d_size)
+{
+  rhs.d_mapping = nullptr;
+  rhs.d_stack = nullptr;
+  rhs.d_mappingSize = 0;
+  rhs.d_size = 0;
+}
+
+pdns_stack_t& pdns_stack_t::operator=(pdns_stack_t&& rhs) noexcept
+{
+  if (this != &rhs) {
+    release();
+    d_mapping = rhs.d_mapping;
+    d_stack = rhs.d_stack;
+    d_mappingSize = rhs.d_mappingSize;
+    d_size = rhs.d_size;
+    rhs.d_mapping = nullptr;
+    rhs.d_stack = nullptr;
+    rhs.d_mappingSize = 0;
+    rhs.d_size = 0;
+  }
+  return *this;
+}
+
+pdns_stack_t::~pdns_stack_t()
+{
+  release();
+}
+
+void pdns_stack_t::release()
+{
+  if (d_mapping != nullptr) {
+    munmap(d_mapping, d_mappingSize);
+    d_mapping = nullptr;
+    d_stack = nullptr;
+  }
+}
+
+size_t pdns_stack_t::getHighWaterMark() const
+{
+#ifdef __linux__
+  if (d_mapping == nullptr) {
+    return 0;
+  }
+
+  /* pages that have never been touched are not resident, and since the stack grows
+     downwards the lowest resident page tells us how deep it has been used */
+  const auto pageSize = getStackPageSize();
+  char* const firstPage = d_mapping + pageSize;
+  const size_t pages = (d_mappingSize - pageSize) / pageSize;
+  std::vector<unsigned char> resident(pages);
+  if (mincore(firstPage, pages * pageSize, resident.data()) != 0) {
+    return 0;
+  }
+
+  for (size_t idx = 0; idx < pages; ++idx) {
+    if (resident.at(idx) & 1) {
+      return std::min(d_size, static_cast<size_t>(d_mapping + d_mappingSize - (firstPage + idx * pageSize)));
+    }
+  }
+#endif /* __linux__ */
+  return 0;
+}
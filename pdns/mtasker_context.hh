@@ -20,11 +20,46 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 #pragma once
-#include "lazy_allocator.hh"
 #include <boost/function.hpp>
+#include <cstddef>
 #include <vector>
 #include <exception>
 
+/* The stack of an MThread, mmap()ed with a guard page below it so that an
+   overflow crashes right away instead of silently corrupting the memory
+   located there. Pages are only backed by memory once they are touched. */
+class pdns_stack_t {
+public:
+    pdns_stack_t() = default;
+    explicit pdns_stack_t (size_t size);
+    pdns_stack_t (pdns_stack_t&& rhs) noexcept;
+    pdns_stack_t& operator= (pdns_stack_t&& rhs) noexcept;
+    pdns_stack_t (pdns_stack_t const&) = delete;
+    pdns_stack_t& operator= (pdns_stack_t const&) = delete;
+    ~pdns_stack_t ();
+
+    char* data () const {
+        return d_stack;
+    }
+    size_t size () const {
+        return d_size;
+    }
+    char& operator[] (size_t idx) {
+        return d_stack[idx];
+    }
+    /* number of bytes of this stack that have been used so far, rounded up to
+       a page, or 0 if that information is not available on this platform */
+    size_t getHighWaterMark () const;
+
+private:
+    void release ();
+
+    char* d_mapping{nullptr};
+    char* d_stack{nullptr};
+    size_t d_mappingSize{0};
+    size_t d_size{0};
+};
+
 struct pdns_ucontext_t {
     pdns_ucontext_t ();
     pdns_ucontext_t (pdns_ucontext_t const&) = delete;
@@ -33,7 +68,7 @@ struct pdns_ucontext_t {
 
     void* uc_mcontext;
     pdns_ucontext_t* uc_link;
-    std::vector<char, lazy_allocator<char>> uc_stack;
+    pdns_stack_t uc_stack;
     std::exception_ptr exception;
 #ifdef PDNS_USE_VALGRIND
     int valgrind_id;
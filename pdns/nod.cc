@@ -31,6 +31,9 @@
 #include <stdlib.h>
 #include "logger.hh"
 #include "misc.hh"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 using namespace nod;
 namespace filesystem = boost::filesystem;
@@ -49,11 +52,47 @@ void PersistentSBF::remove_tmp_files(const filesystem::path& p, std::lock_guard<
   }
 }
 
-// This looks for an old (per-thread) snapshot. The first one it finds,
-// it restores from that. Then immediately snapshots with the current thread id,// before removing the old snapshot
-// In this way, we can have per-thread SBFs, but still snapshot and restore.
-// The mutex has to be static because we can't have multiple (i.e. per-thread)
-// instances iterating and writing to the cache dir at the same time
+// Map the file rather than reading it through a stream, as it is
+// one byte per cell and thus quite large
+static void restoreFromFile(bf::stableBF& sbf, const std::string& filename)
+{
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("Cannot open file: " + stringerror());
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    int err = errno;
+    close(fd);
+    throw std::runtime_error("Cannot stat file: " + stringerror(err));
+  }
+  if (st.st_size == 0) {
+    close(fd);
+    throw std::runtime_error("SBF: read failed (file too short?)");
+  }
+  void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  int err = errno;
+  close(fd);
+  if (data == MAP_FAILED) {
+    throw std::runtime_error("Cannot map file: " + stringerror(err));
+  }
+  madvise(data, st.st_size, MADV_SEQUENTIAL);
+  try {
+    sbf.restore(static_cast<const char*>(data), st.st_size);
+  }
+  catch (...) {
+    munmap(data, st.st_size);
+    throw;
+  }
+  munmap(data, st.st_size);
+}
+
+// This looks for an old snapshot. The first one it finds, it restores
+// from that. Then immediately snapshots with the current thread id,
+// before removing the old snapshots: older versions kept one snapshot
+// per thread, now that the SBF is shared the others are just stale.
+// The mutex has to be static because we can't have multiple instances
+// iterating and writing to the cache dir at the same time
 bool PersistentSBF::init(bool ignore_pid) {
   if (d_init)
     return false;
@@ -65,6 +104,7 @@ bool PersistentSBF::init(bool ignore_pid) {
       if (filesystem::exists(p) && filesystem::is_directory(p)) {
         remove_tmp_files(p, lock);
         filesystem::path newest_file;
+        std::vector<filesystem::path> old_files;
         std::time_t newest_time=time(nullptr);
         Regex file_regex(d_prefix + ".*\\." + bf_suffix + "$");
         for (filesystem::directory_iterator i(p); i != filesystem::directory_iterator(); ++i) {
@@ -72,6 +112,7 @@ bool PersistentSBF::init(bool ignore_pid) {
               file_regex.match(i->path().filename().string())) {
             if (ignore_pid ||
                 (i->path().filename().string().find(std::to_string(getpid())) == std::string::npos)) {
+              old_files.push_back(i->path());
               // look for the newest file matching the regex
               if ((last_write_time(i->path()) < newest_time) ||
                   newest_file.empty()) {
@@ -83,23 +124,24 @@ bool PersistentSBF::init(bool ignore_pid) {
         }
         if (filesystem::exists(newest_file)) {
           std::string filename = newest_file.string();
-          std::ifstream infile;
+          bool restored = false;
           try {
-            infile.open(filename, std::ios::in | std::ios::binary);
             g_log << Logger::Warning << "Found SBF file " << filename << endl;
             // read the file into the sbf
-            d_sbf.lock()->restore(infile);
-            infile.close();
-            // now dump it out again with new thread id & process id
-            snapshotCurrent(std::this_thread::get_id());
-            // Remove the old file we just read to stop proliferation
-            filesystem::remove(newest_file);
+            restoreFromFile(d_sbf, filename);
+            restored = true;
           }
           catch (const std::runtime_error& e) {
-            infile.close();
-            filesystem::remove(newest_file);
             g_log<<Logger::Warning<<"NODDB init: Cannot parse file: " << filename << ": " << e.what() << "; removed" << endl;
           }
+          // Remove the old files to stop proliferation
+          for (const auto& old_file : old_files) {
+            filesystem::remove(old_file);
+          }
+          if (restored) {
+            // now dump it out again with new thread id & process id
+            snapshotCurrent(std::this_thread::get_id());
+          }
         }
       }
     }
@@ -138,12 +180,9 @@ bool PersistentSBF::snapshotCurrent(std::thread::id tid)
     f /= ss.str() + "_" + std::to_string(getpid()) + "." + bf_suffix;
     if (filesystem::exists(p) && filesystem::is_directory(p)) {
       try {
-        std::ofstream ofile;
         std::stringstream iss;
-        {
-          // only lock while dumping to a stringstream
-          d_sbf.lock()->dump(iss);
-        }
+        // the SBF is not locked, updates done while dumping might be missed
+        d_sbf.dump(iss);
         // Now write it out to the file
         std::string ftmp = f.string() + ".XXXXXXXX";
         int fd = mkstemp(&ftmp.at(0));
@@ -25,7 +25,6 @@
 #include <thread>
 #include <boost/filesystem.hpp>
 #include "dnsname.hh"
-#include "lock.hh"
 #include "stable-bloom.hh"
 
 namespace nod {
@@ -36,33 +35,26 @@ namespace nod {
   const std::string bf_suffix = "bf";
   const std::string sbf_prefix = "sbf";
 
-  // Theses classes are not designed to be shared between threads
-  // Use a new instance per-thread, e.g. using thread local storage
+  // A single instance of these classes can be shared by all threads, the
+  // underlying filter is lock-free
   // Synchronization (at the class level) is still needed for reading from
   // and writing to the cache dir
-  // Synchronization (at the instance level) is needed when snapshotting
   class PersistentSBF {
   public:
-    PersistentSBF() : d_sbf(bf::stableBF(c_fp_rate, c_num_cells, c_num_dec)) {}
-    PersistentSBF(uint32_t num_cells) : d_sbf(bf::stableBF(c_fp_rate, num_cells, c_num_dec)) {}
+    PersistentSBF() : d_sbf(c_fp_rate, c_num_cells, c_num_dec) {}
+    PersistentSBF(uint32_t num_cells) : d_sbf(c_fp_rate, num_cells, c_num_dec) {}
     bool init(bool ignore_pid=false);
     void setPrefix(const std::string& prefix) { d_prefix = prefix; } // Added to filenames in cachedir
     void setCacheDir(const std::string& cachedir);
     bool snapshotCurrent(std::thread::id tid); // Write the current file out to disk
-    void add(const std::string& data) { 
-      // The only time this should block is when snapshotting
-      d_sbf.lock()->add(data);
-    }
-    bool test(const std::string& data) { return d_sbf.lock()->test(data); }
-    bool testAndAdd(const std::string& data) { 
-      // The only time this should block is when snapshotting
-      return d_sbf.lock()->testAndAdd(data);
-    }
+    void add(const std::string& data) { d_sbf.add(data); }
+    bool test(const std::string& data) { return d_sbf.test(data); }
+    bool testAndAdd(const std::string& data) { return d_sbf.testAndAdd(data); }
   private:
     void remove_tmp_files(const boost::filesystem::path&, std::lock_guard<std::mutex>&);
 
     bool d_init{false};
-    LockGuarded<bf::stableBF> d_sbf; // Stable Bloom Filter
+    bf::stableBF d_sbf; // Stable Bloom Filter
     std::string d_cachedir;
     std::string d_prefix = sbf_prefix;
     static std::mutex d_cachedir_mutex; // One mutex for all instances of this class
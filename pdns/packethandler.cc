@@ -23,6 +23,8 @@
 #include "config.h"
 #endif
 #include "packetcache.hh"
+#include "auth-denialcache.hh"
+#include "auth-nsec3cache.hh"
 #include "utility.hh"
 #include "base32.hh"
 #include <string>
@@ -330,6 +332,8 @@ vector<DNSZoneRecord> PacketHandler::getBestReferralNS(DNSPacket& p, const DNSNa
   do {
     if(subdomain == d_sd.qname) // stop at SOA
       break;
+    if(isKnownAbsent(subdomain))
+      continue;
     B.lookup(QType(QType::NS), subdomain, d_sd.domain_id, &p);
     while(B.get(rr)) {
       ret.push_back(rr); // this used to exclude auth NS records for some reason
@@ -349,15 +353,17 @@ vector<DNSZoneRecord> PacketHandler::getBestDNAMESynth(DNSPacket& p, DNSName &ta
   do {
     DLOG(g_log<<"Attempting DNAME lookup for "<<subdomain<<", d_sd.qname="<<d_sd.qname<<endl);
 
-    B.lookup(QType(QType::DNAME), subdomain, d_sd.domain_id, &p);
-    while(B.get(rr)) {
-      ret.push_back(rr);  // put in the original
-      rr.dr.d_type = QType::CNAME;
-      rr.dr.d_name = prefix + rr.dr.d_name;
-      rr.dr.d_content = std::make_shared<CNAMERecordContent>(CNAMERecordContent(prefix + getRR<DNAMERecordContent>(rr.dr)->getTarget()));
-      rr.auth = false; // don't sign CNAME
-      target= getRR<CNAMERecordContent>(rr.dr)->getTarget();
-      ret.push_back(rr); 
+    if(!isKnownAbsent(subdomain)) {
+      B.lookup(QType(QType::DNAME), subdomain, d_sd.domain_id, &p);
+      while(B.get(rr)) {
+        ret.push_back(rr);  // put in the original
+        rr.dr.d_type = QType::CNAME;
+        rr.dr.d_name = prefix + rr.dr.d_name;
+        rr.dr.d_content = std::make_shared<CNAMERecordContent>(CNAMERecordContent(prefix + getRR<DNAMERecordContent>(rr.dr)->getTarget()));
+        rr.auth = false; // don't sign CNAME
+        target= getRR<CNAMERecordContent>(rr.dr)->getTarget();
+        ret.push_back(rr);
+      }
     }
     if(!ret.empty())
       return ret;
@@ -390,12 +396,12 @@ bool PacketHandler::getBestWildcard(DNSPacket& p, const DNSName &target, DNSName
   
   wildcard=subdomain;
   while( subdomain.chopOff() && !haveSomething )  {
-    if (subdomain.empty()) {
-      B.lookup(QType(QType::ANY), g_wildcarddnsname, d_sd.domain_id, &p);
-    } else {
-      B.lookup(QType(QType::ANY), g_wildcarddnsname+subdomain, d_sd.domain_id, &p);
+    DNSName wildcardName = g_wildcarddnsname+subdomain;
+    bool wildcardAbsent = isKnownAbsent(wildcardName);
+    if (!wildcardAbsent) {
+      B.lookup(QType(QType::ANY), wildcardName, d_sd.domain_id, &p);
     }
-    while(B.get(rr)) {
+    while(!wildcardAbsent && B.get(rr)) {
 #ifdef HAVE_LUA_RECORDS
       if(rr.dr.d_type == QType::LUA) {
         if(!doLua) {
@@ -441,6 +447,10 @@ bool PacketHandler::getBestWildcard(DNSPacket& p, const DNSName &target, DNSName
     if ( subdomain == d_sd.qname || haveSomething ) // stop at SOA or result
       break;
 
+    if (isKnownAbsent(subdomain)) {
+      wildcard=subdomain;
+      continue;
+    }
     B.lookup(QType(QType::ANY), subdomain, d_sd.domain_id, &p);
     if (B.get(rr)) {
       DLOG(g_log<<"No wildcard match, ancestor exists"<<endl);
@@ -758,7 +768,7 @@ void PacketHandler::addNSECX(DNSPacket& p, std::unique_ptr<DNSPacket>& r, const
   }
 }
 
-bool PacketHandler::getNSEC3Hashes(bool narrow, const std::string& hashed, bool decrement, DNSName& unhashed, std::string& before, std::string& after, int mode)
+bool PacketHandler::getNSEC3Hashes(bool narrow, const NSEC3PARAMRecordContent& ns3rc, const std::string& hashed, bool decrement, DNSName& unhashed, std::string& before, std::string& after, int mode)
 {
   bool ret;
   if(narrow) { // nsec3-narrow
@@ -772,13 +782,23 @@ bool PacketHandler::getNSEC3Hashes(bool narrow, const std::string& hashed, bool
     incrementHash(after);
   }
   else {
+    bool exact = (!decrement && mode >= 2);
+    if (g_nsec3Cache.getRange(d_sd.domain_id, ns3rc, hashed, exact, unhashed, before, after)) {
+      return true;
+    }
+
     DNSName hashedName = DNSName(toBase32Hex(hashed));
     DNSName beforeName, afterName;
-    if (!decrement && mode >= 2)
+    if (exact)
       beforeName = hashedName;
     ret=d_sd.db->getBeforeAndAfterNamesAbsolute(d_sd.domain_id, hashedName, unhashed, beforeName, afterName);
     before=fromBase32Hex(beforeName.toString());
     after=fromBase32Hex(afterName.toString());
+
+    // only learn ranges the backend looked up itself, an exact match only tells us about 'after'
+    if (ret && !exact) {
+      g_nsec3Cache.insertRange(d_sd.domain_id, d_sd.qname, ns3rc, before, after, unhashed);
+    }
   }
   return ret;
 }
@@ -806,11 +826,18 @@ void PacketHandler::addNSEC3(DNSPacket& p, std::unique_ptr<DNSPacket>& r, const
 
   // add matching NSEC3 RR
   if (mode != 3) {
-    unhashed=(mode == 0 || mode == 1 || mode == 5) ? target : closest;
-    hashed=hashQNameWithSalt(ns3rc, unhashed);
+    if (mode == 0 || mode == 1 || mode == 5) {
+      unhashed=target;
+      // not cached, the target of a negative answer is most likely a name we will never see again
+      hashed=hashQNameWithSalt(ns3rc, unhashed);
+    }
+    else {
+      unhashed=closest;
+      hashed=g_nsec3Cache.getHash(d_sd.domain_id, d_sd.qname, ns3rc, unhashed);
+    }
     DLOG(g_log<<"1 hash: "<<toBase32Hex(hashed)<<" "<<unhashed<<endl);
 
-    getNSEC3Hashes(narrow, hashed, false, unhashed, before, after, mode);
+    getNSEC3Hashes(narrow, ns3rc, hashed, false, unhashed, before, after, mode);
 
     if (((mode == 0 && ns3rc.d_flags) ||  mode == 1) && (hashed != before)) {
       DLOG(g_log<<"No matching NSEC3, do closest (provable) encloser"<<endl);
@@ -818,19 +845,22 @@ void PacketHandler::addNSEC3(DNSPacket& p, std::unique_ptr<DNSPacket>& r, const
       bool doBreak = false;
       DNSZoneRecord rr;
       while( closest.chopOff() && (closest != d_sd.qname))  { // stop at SOA
-        B.lookup(QType(QType::ANY), closest, d_sd.domain_id, &p);
-        while(B.get(rr))
-          if (rr.auth)
-            doBreak = true;
+        if (!g_nsec3Cache.getAuth(d_sd.domain_id, ns3rc, closest, doBreak)) {
+          B.lookup(QType(QType::ANY), closest, d_sd.domain_id, &p);
+          while(B.get(rr))
+            if (rr.auth)
+              doBreak = true;
+          g_nsec3Cache.insertAuth(d_sd.domain_id, d_sd.qname, ns3rc, closest, doBreak);
+        }
         if(doBreak)
           break;
       }
       doNextcloser = true;
       unhashed=closest;
-      hashed=hashQNameWithSalt(ns3rc, unhashed);
+      hashed=g_nsec3Cache.getHash(d_sd.domain_id, d_sd.qname, ns3rc, unhashed);
       DLOG(g_log<<"1 hash: "<<toBase32Hex(hashed)<<" "<<unhashed<<endl);
 
-      getNSEC3Hashes(narrow, hashed, false, unhashed, before, after);
+      getNSEC3Hashes(narrow, ns3rc, hashed, false, unhashed, before, after);
     }
 
     if (!after.empty()) {
@@ -850,7 +880,7 @@ void PacketHandler::addNSEC3(DNSPacket& p, std::unique_ptr<DNSPacket>& r, const
     hashed=hashQNameWithSalt(ns3rc, unhashed);
     DLOG(g_log<<"2 hash: "<<toBase32Hex(hashed)<<" "<<unhashed<<endl);
 
-    getNSEC3Hashes(narrow, hashed, true, unhashed, before, after);
+    getNSEC3Hashes(narrow, ns3rc, hashed, true, unhashed, before, after);
     DLOG(g_log<<"Done calling for covering, hashed: '"<<toBase32Hex(hashed)<<"' before='"<<toBase32Hex(before)<<"', after='"<<toBase32Hex(after)<<"'"<<endl);
     emitNSEC3( r, ns3rc, unhashed, before, after, mode);
   }
@@ -859,10 +889,10 @@ void PacketHandler::addNSEC3(DNSPacket& p, std::unique_ptr<DNSPacket>& r, const
   if (mode == 2 || mode == 4) {
     unhashed=g_wildcarddnsname+closest;
 
-    hashed=hashQNameWithSalt(ns3rc, unhashed);
+    hashed=g_nsec3Cache.getHash(d_sd.domain_id, d_sd.qname, ns3rc, unhashed);
     DLOG(g_log<<"3 hash: "<<toBase32Hex(hashed)<<" "<<unhashed<<endl);
 
-    getNSEC3Hashes(narrow, hashed, (mode != 2), unhashed, before, after);
+    getNSEC3Hashes(narrow, ns3rc, hashed, (mode != 2), unhashed, before, after);
     DLOG(g_log<<"Done calling for '*', hashed: '"<<toBase32Hex(hashed)<<"' before='"<<toBase32Hex(before)<<"', after='"<<toBase32Hex(after)<<"'"<<endl);
     emitNSEC3( r, ns3rc, unhashed, before, after, mode);
   }
@@ -879,8 +909,17 @@ void PacketHandler::addNSEC(DNSPacket& p, std::unique_ptr<DNSPacket>& r, const D
     }
   }
 
+  auto getBeforeAndAfterNames = [this](const DNSName& name, DNSName& before, DNSName& after) {
+    if (d_denialMode == DenialMode::NSEC && g_denialCache.getGap(d_sd.domain_id, name, before, after)) {
+      return;
+    }
+    if (d_sd.db->getBeforeAndAfterNames(d_sd.domain_id, d_sd.qname, name, before, after) && d_denialMode == DenialMode::NSEC && before != name) {
+      g_denialCache.insertGap(d_sd.domain_id, d_sd.qname, before, after);
+    }
+  };
+
   DNSName before,after;
-  d_sd.db->getBeforeAndAfterNames(d_sd.domain_id, d_sd.qname, target, before, after);
+  getBeforeAndAfterNames(target, before, after);
   if (mode != 5 || before == target)
     emitNSEC(r, before, after, mode);
 
@@ -892,12 +931,76 @@ void PacketHandler::addNSEC(DNSPacket& p, std::unique_ptr<DNSPacket>& r, const D
       closest.chopOff();
       closest.prependRawLabel("*");
     }
-    d_sd.db->getBeforeAndAfterNames(d_sd.domain_id, d_sd.qname, closest, before, after);
+    getBeforeAndAfterNames(closest, before, after);
     emitNSEC(r, before, after, mode);
   }
   return;
 }
 
+void PacketHandler::setupDenial()
+{
+  d_denialMode = DenialMode::None;
+
+  if (!g_denialCache.enabled() || !d_dk.isSecuredZone(d_sd.qname) || d_dk.isPresigned(d_sd.qname)) {
+    return;
+  }
+
+  bool narrow = false;
+  if (d_dk.getNSEC3PARAM(d_sd.qname, &d_denialNS3PRC, &narrow)) {
+    // narrow zones have no chain to look at, and opt-out ones have no hash for insecure delegations
+    if (narrow || d_denialNS3PRC.d_flags != 0 || !g_nsec3Cache.enabled()) {
+      return;
+    }
+    d_denialMode = DenialMode::NSEC3;
+  }
+  else {
+    d_denialMode = DenialMode::NSEC;
+  }
+}
+
+bool PacketHandler::isKnownAbsent(const DNSName& name)
+{
+  switch (d_denialMode) {
+  case DenialMode::NSEC:
+    return g_denialCache.isAbsent(d_sd.domain_id, name);
+  case DenialMode::NSEC3:
+    return g_nsec3Cache.isAbsent(d_sd.domain_id, d_denialNS3PRC, name);
+  case DenialMode::None:
+    break;
+  }
+  return false;
+}
+
+/* asks the backend where target would be in the NSEC(3) chain, so that the next names
+   falling into the same gap are known not to exist without asking again */
+void PacketHandler::learnAbsent(const DNSName& target)
+{
+  if (d_denialMode == DenialMode::None) {
+    return;
+  }
+
+  if (d_sd.db == nullptr) {
+    if(!B.getSOAUncached(d_sd.qname, d_sd)) {
+      return;
+    }
+  }
+
+  if (d_denialMode == DenialMode::NSEC) {
+    DNSName before, after;
+    if (d_sd.db->getBeforeAndAfterNames(d_sd.domain_id, d_sd.qname, target, before, after) && before != target) {
+      g_denialCache.insertGap(d_sd.domain_id, d_sd.qname, before, after);
+    }
+  }
+  else {
+    // not cached, target is most likely a name we will never see again
+    string hashed = hashQNameWithSalt(d_denialNS3PRC, target);
+    string before, after;
+    DNSName unhashed;
+    // inserts the range into the NSEC3 cache
+    getNSEC3Hashes(false, d_denialNS3PRC, hashed, false, unhashed, before, after);
+  }
+}
+
 /* Semantics:
    
 - only one backend owns the SOA of a zone
@@ -1116,7 +1219,7 @@ std::unique_ptr<DNSPacket> PacketHandler::question(DNSPacket& p)
   }
 
   if(p.d.rd) {
-    static AtomicCounter &rdqueries=*S.getPointer("rd-queries");  
+    static StatCounter &rdqueries=*S.getPointer("rd-queries");  
     rdqueries++;
   }
 
@@ -1260,7 +1363,7 @@ std::unique_ptr<DNSPacket> PacketHandler::doQuestion(DNSPacket& p)
   set<DNSName> authSet;
 
   vector<DNSZoneRecord> rrset;
-  bool weDone=false, weRedirected=false, weHaveUnauth=false, doSigs=false;
+  bool weDone=false, weRedirected=false, weHaveUnauth=false, doSigs=false, targetAbsent=false;
   DNSName haveAlias;
   uint8_t aliasScopeMask;
 
@@ -1421,6 +1524,7 @@ std::unique_ptr<DNSPacket> PacketHandler::doQuestion(DNSPacket& p)
     authSet.insert(d_sd.qname);
     d_dnssec=(p.d_dnssecOk && d_dk.isSecuredZone(d_sd.qname));
     doSigs |= d_dnssec;
+    setupDenial();
 
     if(!retargetcount) r->qdomainzone=d_sd.qname;
 
@@ -1484,13 +1588,15 @@ std::unique_ptr<DNSPacket> PacketHandler::doQuestion(DNSPacket& p)
 #endif
 
     // see what we get..
-    B.lookup(QType(QType::ANY), target, d_sd.domain_id, &p);
+    targetAbsent = isKnownAbsent(target);
+    if(!targetAbsent)
+      B.lookup(QType(QType::ANY), target, d_sd.domain_id, &p);
     rrset.clear();
     haveAlias.trimToLabels(0);
     aliasScopeMask = 0;
     weDone = weRedirected = weHaveUnauth =  false;
     
-    while(B.get(rr)) {
+    while(!targetAbsent && B.get(rr)) {
 #ifdef HAVE_LUA_RECORDS
       if(rr.dr.d_type == QType::LUA) {
         if(!doLua)
@@ -1616,6 +1722,8 @@ std::unique_ptr<DNSPacket> PacketHandler::doQuestion(DNSPacket& p)
 
 
     if(rrset.empty()) {
+      if(!targetAbsent)
+        learnAbsent(target);
       DLOG(g_log<<Logger::Warning<<"Found nothing in the by-name ANY, but let's try wildcards.."<<endl);
       bool wereRetargeted(false), nodata(false);
       DNSName wildcard;
@@ -1700,8 +1808,18 @@ std::unique_ptr<DNSPacket> PacketHandler::doQuestion(DNSPacket& p)
         break;
       }
     }
-    if(doSigs)
-      addRRSigs(d_dk, B, authSet, r->getRRS());
+    if(doSigs) {
+      static StatHistogram* signingLatency = S.getHistogram("latency-signing");
+      if (signingLatency != nullptr) {
+        DTime dt;
+        dt.set();
+        addRRSigs(d_dk, B, authSet, r->getRRS());
+        (*signingLatency)(dt.udiffNoReset());
+      }
+      else {
+        addRRSigs(d_dk, B, authSet, r->getRRS());
+      }
+    }
       
     if(PC.enabled() && !noCache && p.couldBeCached())
       PC.insert(p, *r, r->getMinTTL()); // in the packet cache
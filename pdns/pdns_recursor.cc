@@ -103,6 +103,7 @@
 
 #include "rec-snmp.hh"
 #include "rec-taskqueue.hh"
+#include "rec-tcpout.hh"
 
 #ifdef HAVE_SYSTEMD
 #include <systemd/sd-daemon.h>
@@ -140,10 +141,6 @@ thread_local FDMultiplexer* t_fdm{nullptr};
 thread_local std::unique_ptr<addrringbuf_t> t_remotes, t_servfailremotes, t_largeanswerremotes, t_bogusremotes;
 thread_local std::unique_ptr<boost::circular_buffer<pair<DNSName, uint16_t> > > t_queryring, t_servfailqueryring, t_bogusqueryring;
 thread_local std::shared_ptr<NetmaskGroup> t_allowFrom;
-#ifdef NOD_ENABLED
-thread_local std::shared_ptr<nod::NODDB> t_nodDBp;
-thread_local std::shared_ptr<nod::UniqueResponseDB> t_udrDBp;
-#endif /* NOD_ENABLED */
 __thread struct timeval g_now; // timestamp, updated (too) frequently
 
 typedef vector<pair<int, boost::function< void(int, boost::any&) > > > deferredAdd_t;
@@ -233,6 +230,9 @@ static bool g_useKernelTimestamp;
 std::atomic<uint32_t> g_maxCacheEntries, g_maxPacketCacheEntries;
 #ifdef NOD_ENABLED
 static bool g_nodEnabled;
+// shared by all threads, so that a domain is newly observed once per process
+static std::shared_ptr<nod::NODDB> g_nodDBp;
+static std::shared_ptr<nod::UniqueResponseDB> g_udrDBp;
 static DNSName g_nodLookupDomain;
 static bool g_nodLog;
 static SuffixMatchNode g_nodDomainWL;
@@ -248,6 +248,9 @@ static std::set<uint16_t> s_avoidUdpSourcePorts;
 #endif
 static uint16_t s_minUdpSourcePort;
 static uint16_t s_maxUdpSourcePort;
+static size_t s_udpSocketPoolSize;
+static size_t s_prefetchBudget;
+static unsigned int s_udpSocketPoolMaxUses;
 static double s_balancingFactor;
 static bool s_addExtendedResolutionDNSErrors;
 
@@ -614,16 +617,38 @@ static void setSocketSendBuffer(int fd, uint32_t size)
 // you can ask this class for a UDP socket to send a query from
 // this socket is not yours, don't even think about deleting it
 // but after you call 'returnSocket' on it, don't assume anything anymore
+//
+// By default every query gets a fresh socket, bound to a random port and connected to the remote.
+// When a pool size is set, up to that many unconnected sockets bound to random ports are kept
+// around instead and handed out at random, each one carrying a single query at a time. Answers
+// are then matched on the remote address, ID and qname/qtype by the waiter lookup, and packets from
+// any other source are dropped by handleUDPServerResponse(), since the kernel no longer filters on
+// the source. Sockets are retired after a bounded number of uses so the set of ports in use keeps
+// changing.
 class UDPClientSocks
 {
   unsigned int d_numsocks;
 public:
-  UDPClientSocks() : d_numsocks(0)
+  UDPClientSocks(size_t poolSize = 0, unsigned int maxUses = 0) : d_numsocks(0), d_poolSize(poolSize), d_maxUses(maxUses)
+  {
+  }
+
+  ~UDPClientSocks()
   {
+    for (auto& idle : d_idle) {
+      for (const auto& entry : idle) {
+        closePooled(entry.fd);
+      }
+    }
   }
 
   LWResult::Result getSocket(const ComboAddress& toaddr, int* fd)
   {
+    if (d_poolSize > 0 && getPooledSocket(toaddr.sin4.sin_family, fd)) {
+      d_numsocks++;
+      return LWResult::Result::Success;
+    }
+
     *fd = makeClientSocket(toaddr.sin4.sin_family);
     if(*fd < 0) { // temporary error - receive exception otherwise
       return LWResult::Result::OSLimitError;
@@ -649,8 +674,29 @@ public:
     return LWResult::Result::Success;
   }
 
+  // pooled sockets are not connected, so the destination has to be passed for each query
+  bool isPooled(int fd) const
+  {
+    return d_busy.count(fd) != 0;
+  }
+
+  // open pooled sockets in advance so that the first queries don't pay for it
+  void prefill(int family, size_t count)
+  {
+    auto& idle = d_idle.at(familyIndex(family));
+    while (count-- > 0 && d_busy.size() + d_idle[0].size() + d_idle[1].size() < d_poolSize) {
+      int fd = makeClientSocket(family);
+      if (fd < 0) {
+        break;
+      }
+      g_stats.udpPoolSockets++;
+      idle.push_back({fd, 0});
+    }
+  }
+
   // return a socket to the pool, or simply erase it
-  void returnSocket(int fd)
+  // a pooled socket is only kept when it is known to have nothing left in flight
+  void returnSocket(int fd, bool reusable = false)
   {
     try {
       t_fdm->removeReadFD(fd);
@@ -659,14 +705,27 @@ public:
       // we sometimes return a socket that has not yet been assigned to t_fdm
     }
 
+    --d_numsocks;
+
+    auto busy = d_busy.find(fd);
+    if (busy != d_busy.end()) {
+      auto entry = busy->second;
+      d_busy.erase(busy);
+      if (reusable && entry.second.uses < d_maxUses) {
+        d_idle.at(entry.first).push_back(entry.second);
+      }
+      else {
+        closePooled(fd);
+      }
+      return;
+    }
+
     try {
       closesocket(fd);
     }
     catch(const PDNSException& e) {
       g_log<<Logger::Error<<"Error closing returned UDP socket: "<<e.reason<<endl;
     }
-
-    --d_numsocks;
   }
 
 private:
@@ -722,6 +781,65 @@ private:
     }
     return ret;
   }
+
+  struct PooledSocket
+  {
+    int fd;
+    unsigned int uses;
+  };
+
+  static size_t familyIndex(int family)
+  {
+    return family == AF_INET ? 0 : 1;
+  }
+
+  bool getPooledSocket(int family, int* fd)
+  {
+    auto index = familyIndex(family);
+    auto& idle = d_idle.at(index);
+    PooledSocket entry;
+
+    if (!idle.empty()) {
+      // pick a random one so that the source port stays as hard to guess as the pool is large
+      auto pos = dns_random(idle.size());
+      std::swap(idle.at(pos), idle.back());
+      entry = idle.back();
+      idle.pop_back();
+      g_stats.udpPoolReuses++;
+    }
+    else {
+      if (d_busy.size() + d_idle[0].size() + d_idle[1].size() >= d_poolSize) {
+        return false;
+      }
+      entry.fd = makeClientSocket(family);
+      if (entry.fd < 0) {
+        return false;
+      }
+      entry.uses = 0;
+      g_stats.udpPoolSockets++;
+    }
+
+    entry.uses++;
+    d_busy.emplace(entry.fd, std::make_pair(index, entry));
+    *fd = entry.fd;
+    return true;
+  }
+
+  static void closePooled(int fd)
+  {
+    try {
+      closesocket(fd);
+    }
+    catch(const PDNSException& e) {
+      g_log<<Logger::Error<<"Error closing pooled UDP socket: "<<e.reason<<endl;
+    }
+    g_stats.udpPoolSockets--;
+  }
+
+  std::array<std::vector<PooledSocket>, 2> d_idle;
+  std::unordered_map<int, std::pair<size_t, PooledSocket>> d_busy;
+  const size_t d_poolSize;
+  const unsigned int d_maxUses;
 };
 
 static thread_local std::unique_ptr<UDPClientSocks> t_udpclientsocks;
@@ -760,7 +878,13 @@ LWResult::Result asendto(const char *data, size_t len, int flags,
   pident->id=id;
 
   t_fdm->addReadFD(*fd, handleUDPServerResponse, pident);
-  ssize_t sent = send(*fd, data, len, 0);
+  ssize_t sent;
+  if (t_udpclientsocks->isPooled(*fd)) {
+    sent = sendto(*fd, data, len, 0, reinterpret_cast<const struct sockaddr*>(&toaddr), toaddr.getSocklen());
+  }
+  else {
+    sent = send(*fd, data, len, 0);
+  }
 
   int tmp = errno;
 
@@ -797,8 +921,9 @@ LWResult::Result arecvfrom(PacketBuffer& packet, int flags, const ComboAddress&
     *d_len=packet.size();
 
     if (nearMissLimit > 0 && pident->nearMisses > nearMissLimit) {
-      /* we have received more than nearMissLimit answers on the right IP and port, from the right source (we are using connected sockets),
-         for the correct qname and qtype, but with an unexpected message ID. That looks like a spoofing attempt. */
+      /* we have received more than nearMissLimit answers on the right IP and port, from the right source (checked by the kernel for
+         connected sockets, and by handleUDPServerResponse() for pooled ones), for the correct qname and qtype, but with an unexpected
+         message ID. That looks like a spoofing attempt. */
       g_log<<Logger::Error<<"Too many ("<<pident->nearMisses<<" > "<<nearMissLimit<<") answers with a wrong message ID for '"<<domain<<"' from "<<fromaddr.toString()<<", assuming spoof attempt."<<endl;
       g_stats.spoofCount++;
       return LWResult::Result::Spoofed;
@@ -1024,25 +1149,32 @@ static void protobufLogQuery(LocalStateHolder<LuaConfigItems>& luaconfsLocal, co
   ComboAddress requestor = requestorNM.getMaskedNetwork();
   requestor.setPort(remote.getPort());
 
-  pdns::ProtoZero::RecMessage m{128, std::string::size_type(policyTags.empty() ? 0 : 64)}; // It's a guess
-  m.setType(pdns::ProtoZero::Message::MessageType::DNSQueryType);
-  m.setRequest(uniqueId, requestor, local, qname, qtype, qclass, id, tcp, len);
-  m.setServerIdentity(SyncRes::s_serverID);
-  m.setEDNSSubnet(ednssubnet, ednssubnet.isIPv4() ? luaconfsLocal->protobufMaskV4 : luaconfsLocal->protobufMaskV6);
-  m.setRequestorId(requestorId);
-  m.setDeviceId(deviceId);
-  m.setDeviceName(deviceName);
+  /* kept across queries to reuse their capacity. The policy tags belong to the response part, which needs its own
+     buffer so that finish() can embed it. The message is in msgbuf once m is gone */
+  static thread_local std::string msgbuf;
+  static thread_local std::string rspbuf;
+  {
+    pdns::ProtoZero::RecMessage m{msgbuf, rspbuf};
+    m.reserve(128, std::string::size_type(policyTags.empty() ? 0 : 64)); // It's a guess
+    m.setType(pdns::ProtoZero::Message::MessageType::DNSQueryType);
+    m.setRequest(uniqueId, requestor, local, qname, qtype, qclass, id, tcp, len);
+    m.setServerIdentity(SyncRes::s_serverID);
+    m.setEDNSSubnet(ednssubnet, ednssubnet.isIPv4() ? luaconfsLocal->protobufMaskV4 : luaconfsLocal->protobufMaskV6);
+    m.setRequestorId(requestorId);
+    m.setDeviceId(deviceId);
+    m.setDeviceName(deviceName);
 
-  if (!policyTags.empty()) {
-    m.addPolicyTags(policyTags);
-  }
-  for (const auto& mit : meta) {
-    m.setMeta(mit.first, mit.second.stringVal, mit.second.intVal);
+    if (!policyTags.empty()) {
+      m.addPolicyTags(policyTags);
+    }
+    for (const auto& mit : meta) {
+      m.setMeta(mit.first, mit.second.stringVal, mit.second.intVal);
+    }
+    m.finish();
   }
 
-  std::string msg(m.finishAndMoveBuf());
   for (auto& server : *t_protobufServers) {
-    server->queueData(msg);
+    server->queueData(msgbuf);
   }
 }
 
@@ -1393,7 +1525,7 @@ static bool nodCheckNewDomain(const DNSName& dname)
   // First check the (sub)domain isn't ignored for NOD purposes
   if (!g_nodDomainWL.check(dname)) {
     // Now check the NODDB (note this is probabilistic so can have FNs/FPs)
-    if (t_nodDBp && t_nodDBp->isNewDomain(dname)) {
+    if (g_nodDBp && g_nodDBp->isNewDomain(dname)) {
       if (g_nodLog) {
         // This should probably log to a dedicated log file
         g_log<<Logger::Notice<<"Newly observed domain nod="<<dname<<endl;
@@ -1429,7 +1561,7 @@ static bool udrCheckUniqueDNSRecord(const DNSName& dname, uint16_t qtype, const
     // Create a string that represent a triplet of (qname, qtype and RR[type, name, content])
     std::stringstream ss;
     ss << dname.toDNSStringLC() << ":" << qtype <<  ":" << qtype << ":" << record.d_type << ":" << record.d_name.toDNSStringLC() << ":" << record.d_content->getZoneRepresentation();
-    if (t_udrDBp && t_udrDBp->isUniqueResponse(ss.str())) {
+    if (g_udrDBp && g_udrDBp->isUniqueResponse(ss.str())) {
       if (g_udrLog) {  
         // This should also probably log to a dedicated file. 
         g_log<<Logger::Notice<<"Unique response observed: qname="<<dname<<" qtype="<<QType(qtype)<< " rrtype=" << QType(record.d_type) << " rrname=" << record.d_name << " rrcontent=" << record.d_content->getZoneRepresentation() << endl;
@@ -3656,10 +3788,10 @@ static void doStats(void)
     g_log << Logger::Notice<< "stats: cache contended/acquired " << rc_stats.first << '/' << rc_stats.second << " = " << r << '%' << endl;
 
     g_log<<Logger::Notice<<"stats: throttle map: "
-      << broadcastAccFunction<uint64_t>(pleaseGetThrottleSize) <<", ns speeds: "
-      << broadcastAccFunction<uint64_t>(pleaseGetNsSpeedsSize)<<", failed ns: "
-      << broadcastAccFunction<uint64_t>(pleaseGetFailedServersSize)<<", ednsmap: "
-      <<broadcastAccFunction<uint64_t>(pleaseGetEDNSStatusesSize)<<endl;
+      << serverStateAccFunction(pleaseGetThrottleSize) <<", ns speeds: "
+      << serverStateAccFunction(pleaseGetNsSpeedsSize)<<", failed ns: "
+      << serverStateAccFunction(pleaseGetFailedServersSize)<<", ednsmap: "
+      << serverStateAccFunction(pleaseGetEDNSStatusesSize)<<endl;
     g_log<<Logger::Notice<<"stats: outpacket/query ratio "<<ratePercentage(SyncRes::s_outqueries, SyncRes::s_queries)<<"%";
     g_log<<Logger::Notice<<", "<<ratePercentage(SyncRes::s_throttledqueries, SyncRes::s_outqueries+SyncRes::s_throttledqueries)<<"% throttled"<<endl;
     g_log<<Logger::Notice<<"stats: "<<SyncRes::s_tcpoutqueries<<"/"<<SyncRes::s_dotoutqueries << " outgoing tcp/dot connections, "<<
@@ -3722,17 +3854,29 @@ static void houseKeeping(void *)
     if (last_prune < past) {
       t_packetCache->doPruneTo(g_maxPacketCacheEntries / (g_numWorkerThreads + g_numDistributorThreads));
 
-      time_t limit;
-      if(!((cleanCounter++)%40)) {  // this is a full scan!
-	limit=now.tv_sec-300;
-        SyncRes::pruneNSSpeeds(limit);
-      }
-      limit = now.tv_sec - SyncRes::s_serverdownthrottletime * 10;
-      SyncRes::pruneFailedServers(limit);
-      limit = now.tv_sec - 2*3600;
-      SyncRes::pruneEDNSStatuses(limit);
-      SyncRes::pruneThrottledServers();
-      SyncRes::pruneNonResolving(now.tv_sec - SyncRes::s_nonresolvingnsthrottletime);
+      // when the server tables are shared, the handler thread prunes them for everyone
+      if (!SyncRes::isServerStateShared() || isHandlerThread()) {
+        time_t limit;
+        if(!((cleanCounter++)%40)) {  // this is a full scan!
+          limit=now.tv_sec-300;
+          SyncRes::pruneNSSpeeds(limit);
+        }
+        limit = now.tv_sec - SyncRes::s_serverdownthrottletime * 10;
+        SyncRes::pruneFailedServers(limit);
+        limit = now.tv_sec - 2*3600;
+        SyncRes::pruneEDNSStatuses(limit);
+        SyncRes::pruneThrottledServers();
+        SyncRes::pruneNonResolving(now.tv_sec - SyncRes::s_nonresolvingnsthrottletime);
+      }
+      t_tcp_manager.cleanup(now);
+      if (s_prefetchBudget > 0 && s_threadInfos.at(t_id).isWorker) {
+        // each worker looks at its share of the record cache, the refreshes end up in its own task queue
+        // we get here every 5 seconds, so look at what will have expired by the next round after that
+        unsigned int worker = t_id - 1 - (g_weDistributeQueries ? g_numDistributorThreads : 0);
+        size_t budget = (s_prefetchBudget * 5 + g_numWorkerThreads - 1) / g_numWorkerThreads;
+        g_recCache->doPrefetch(now.tv_sec, 10, budget, worker, g_numWorkerThreads);
+      }
+      g_stats.maxMThreadStackHighWater = max(MT->getStackHighWaterMark(), g_stats.maxMThreadStackHighWater.load());
       Utility::gettimeofday(&last_prune, nullptr);
     }
 
@@ -3743,6 +3887,9 @@ static void houseKeeping(void *)
         if (g_aggressiveNSECCache) {
           g_aggressiveNSECCache->prune(now.tv_sec);
         }
+        if (MemRecursorCache::s_internNames) {
+          DNSName::string_t::purgeInterned();
+        }
         last_RC_prune = now.tv_sec;
       }
       // Divide by 12 to get the original 2 hour cycle if s_maxcachettl is default (1 day)
@@ -4123,6 +4270,29 @@ template vector<ComboAddress> broadcastAccFunction(const boost::function<vector<
 template vector<pair<DNSName,uint16_t> > broadcastAccFunction(const boost::function<vector<pair<DNSName, uint16_t> > *()>& fun); // explicit instantiation
 template ThreadTimes broadcastAccFunction(const boost::function<ThreadTimes*()>& fun);
 
+/* Number of bits of the source port an off-path attacker has to guess for a single outgoing UDP query:
+   the whole configured range when every query gets a fresh port, only the size of the per-thread pool otherwise */
+uint64_t getOutgoingUDPPortEntropy()
+{
+  double ports = s_maxUdpSourcePort - s_minUdpSourcePort + 1;
+  if (s_udpSocketPoolSize > 0) {
+    double pooled = static_cast<double>(g_stats.udpPoolSockets) / std::max(g_numWorkerThreads, 1U);
+    ports = std::max(std::min(ports, pooled), 1.0);
+  }
+  return static_cast<uint64_t>(std::log2(ports));
+}
+
+/* When the authoritative server tables are shared there is only one copy to look at,
+   otherwise every thread has to be asked about its own */
+uint64_t serverStateAccFunction(const boost::function<uint64_t*()>& func)
+{
+  if (SyncRes::isServerStateShared()) {
+    std::unique_ptr<uint64_t> ret(func());
+    return ret ? *ret : 0;
+  }
+  return broadcastAccFunction<uint64_t>(func);
+}
+
 static void handleRCC(int fd, FDMultiplexer::funcparam_t& var)
 {
   try {
@@ -4319,6 +4489,16 @@ static void handleUDPServerResponse(int fd, FDMultiplexer::funcparam_t& var)
 
   len=recvfrom(fd, &packet.at(0), packet.size(), 0, (sockaddr *)&fromaddr, &addrlen);
 
+  if (len >= 0 && fromaddr != pid->remote) {
+    /* the kernel only filters the source of connected sockets, pooled ones are not. The waiter lookup below would not
+       match this answer either, but it should not be able to end the query on that socket, nor count as a near miss */
+    g_stats.unexpectedCount++;
+    if (g_logCommonErrors) {
+      g_log<<Logger::Warning<<"Discarding packet from "<<fromaddr.toStringWithPort()<<" on a socket used for "<<pid->remote.toStringWithPort()<<endl;
+    }
+    return;
+  }
+
   if(len < (ssize_t) sizeof(dnsheader)) {
     if(len < 0)
       ; //      cerr<<"Error on fd "<<fd<<": "<<stringerror()<<"\n";
@@ -4384,7 +4564,7 @@ retryWithName:
     for (MT_t::waiters_t::iterator mthread = MT->d_waiters.begin(); mthread != MT->d_waiters.end(); ++mthread) {
       if (pident->fd == mthread->key->fd && mthread->key->remote == pident->remote &&  mthread->key->type == pident->type &&
          pident->domain == mthread->key->domain) {
-        /* we are expecting an answer from that exact source, on that exact port (since we are using connected sockets), for that qname/qtype,
+        /* we are expecting an answer from that exact source, on that exact port (the source has been checked above), for that qname/qtype,
            but with a different message ID. That smells like a spoofing attempt. For now we will just increase the counter and will deal with
            that later. */
         mthread->key->nearMisses++;
@@ -4405,8 +4585,9 @@ retryWithName:
     }
   }
   else if(fd >= 0) {
-    /* we either found a waiter (1) or encountered an issue (-1), it's up to us to clean the socket anyway */
-    t_udpclientsocks->returnSocket(fd);
+    /* we either found a waiter (1) or encountered an issue (-1), it's up to us to clean the socket anyway.
+       The query has been answered so a pooled socket can be used again. */
+    t_udpclientsocks->returnSocket(fd, true);
   }
 }
 
@@ -4605,6 +4786,9 @@ void parseACLs()
     allowFrom = nullptr;
   }
 
+  if (allowFrom) {
+    allowFrom->freeze();
+  }
   g_initialAllowFrom = allowFrom;
   broadcastFunction([=]{ return pleaseSupplantACLs(allowFrom); });
   oldAllowFrom = nullptr;
@@ -4678,41 +4862,41 @@ static void setCPUMap(const std::map<unsigned int, std::set<int> >& cpusMap, uns
 }
 
 #ifdef NOD_ENABLED
-static void setupNODThread()
+static void setupNODDBs()
 {
   if (g_nodEnabled) {
     uint32_t num_cells = ::arg().asNum("new-domain-db-size");
-    t_nodDBp = std::make_shared<nod::NODDB>(num_cells);
+    g_nodDBp = std::make_shared<nod::NODDB>(num_cells);
     try {
-      t_nodDBp->setCacheDir(::arg()["new-domain-history-dir"]);
+      g_nodDBp->setCacheDir(::arg()["new-domain-history-dir"]);
     }
     catch (const PDNSException& e) {
       g_log<<Logger::Error<<"new-domain-history-dir (" << ::arg()["new-domain-history-dir"] << ") is not readable or does not exist"<<endl;
       _exit(1);
     }
-    if (!t_nodDBp->init()) {
+    if (!g_nodDBp->init()) {
       g_log<<Logger::Error<<"Could not initialize domain tracking"<<endl;
       _exit(1);
     }
-    std::thread t(nod::NODDB::startHousekeepingThread, t_nodDBp, std::this_thread::get_id());
+    std::thread t(nod::NODDB::startHousekeepingThread, g_nodDBp, std::this_thread::get_id());
     t.detach();
     g_nod_pbtag = ::arg()["new-domain-pb-tag"];
   }
   if (g_udrEnabled) {
     uint32_t num_cells = ::arg().asNum("unique-response-db-size");
-    t_udrDBp = std::make_shared<nod::UniqueResponseDB>(num_cells);
+    g_udrDBp = std::make_shared<nod::UniqueResponseDB>(num_cells);
     try {
-      t_udrDBp->setCacheDir(::arg()["unique-response-history-dir"]);
+      g_udrDBp->setCacheDir(::arg()["unique-response-history-dir"]);
     }
     catch (const PDNSException& e) {
       g_log<<Logger::Error<<"unique-response-history-dir (" << ::arg()["unique-response-history-dir"] << ") is not readable or does not exist"<<endl;
       _exit(1);
     }
-    if (!t_udrDBp->init()) {
+    if (!g_udrDBp->init()) {
       g_log<<Logger::Error<<"Could not initialize unique response tracking"<<endl;
       _exit(1);
     }
-    std::thread t(nod::UniqueResponseDB::startHousekeepingThread, t_udrDBp, std::this_thread::get_id());
+    std::thread t(nod::UniqueResponseDB::startHousekeepingThread, g_udrDBp, std::this_thread::get_id());
     t.detach();
     g_udr_pbtag = ::arg()["unique-response-pb-tag"];
   }
@@ -4725,6 +4909,7 @@ static void parseNODIgnorelist(const std::string& wlist)
   for(const auto& a : parts) {
     g_nodDomainWL.add(DNSName(a));
   }
+  g_nodDomainWL.freeze();
 }
 
 static void setupNODGlobal()
@@ -4909,6 +5094,8 @@ static int serviceMain(int argc, char*argv[])
   SyncRes::s_serverdownthrottletime=::arg().asNum("server-down-throttle-time");
   SyncRes::s_nonresolvingnsmaxfails=::arg().asNum("non-resolving-ns-max-fails");
   SyncRes::s_nonresolvingnsthrottletime=::arg().asNum("non-resolving-ns-throttle-time");
+  SyncRes::setServerStateShards(::arg().asNum("shared-server-state-shards"));
+  SyncRes::setServerStateShared(::arg().mustDo("shared-server-state"));
   SyncRes::s_serverID=::arg()["server-id"];
   SyncRes::s_maxqperq=::arg().asNum("max-qperq");
   SyncRes::s_maxnsaddressqperq=::arg().asNum("max-ns-address-qperq");
@@ -4917,11 +5104,20 @@ static int serviceMain(int argc, char*argv[])
   SyncRes::s_rootNXTrust = ::arg().mustDo( "root-nx-trust");
   SyncRes::s_refresh_ttlperc = ::arg().asNum("refresh-on-ttl-perc");
   RecursorPacketCache::s_refresh_ttlperc = SyncRes::s_refresh_ttlperc;
+  s_prefetchBudget = ::arg().asNum("prefetch-budget");
+  MemRecursorCache::s_maxServedStaleExtensions = ::arg().asNum("serve-stale-extensions");
+  MemRecursorCache::s_internNames = ::arg().mustDo("intern-cache-names");
+  RecursorPacketCache::s_internNames = MemRecursorCache::s_internNames;
   SyncRes::s_tcp_fast_open = ::arg().asNum("tcp-fast-open");
   SyncRes::s_tcp_fast_open_connect = ::arg().mustDo("tcp-fast-open-connect");
 
   SyncRes::s_dot_to_port_853 = ::arg().mustDo("dot-to-port-853");
 
+  TCPOutConnectionManager::s_maxIdleTime = timeval{::arg().asNum("tcp-out-max-idle-ms") / 1000, ::arg().asNum("tcp-out-max-idle-ms") % 1000 * 1000};
+  TCPOutConnectionManager::s_maxIdlePerAuth = ::arg().asNum("tcp-out-max-idle-per-auth");
+  TCPOutConnectionManager::s_maxQueries = ::arg().asNum("tcp-out-max-queries");
+  TCPOutConnectionManager::s_maxIdlePerThread = ::arg().asNum("tcp-out-max-idle-per-thread");
+
   if (SyncRes::s_tcp_fast_open_connect) {
     checkFastOpenSysctl(true);
     checkTFOconnect();
@@ -4991,9 +5187,11 @@ static int serviceMain(int argc, char*argv[])
   g_useIncomingECS = ::arg().mustDo("use-incoming-edns-subnet");
 
   g_XPFAcl.toMasks(::arg()["xpf-allow-from"]);
+  g_XPFAcl.freeze();
   g_xpfRRCode = ::arg().asNum("xpf-rr-code");
 
   g_proxyProtocolACL.toMasks(::arg()["proxy-protocol-from"]);
+  g_proxyProtocolACL.freeze();
   g_proxyProtocolMaximumSize = ::arg().asNum("proxy-protocol-maximum-size");
 
   if (!::arg()["dns64-prefix"].empty()) {
@@ -5031,6 +5229,7 @@ static int serviceMain(int argc, char*argv[])
   g_lowercaseOutgoing = ::arg().mustDo("lowercase-outgoing");
 
   g_paddingFrom.toMasks(::arg()["edns-padding-from"]);
+  g_paddingFrom.freeze();
   if (::arg()["edns-padding-mode"] == "always") {
     g_paddingMode = PaddingMode::Always;
   }
@@ -5077,6 +5276,10 @@ static int serviceMain(int argc, char*argv[])
     }
   }
 
+  if (::arg().asNum("signature-cache-size") > 0 && g_dnssecmode != DNSSECMode::Off && g_dnssecmode != DNSSECMode::ProcessNoValidate) {
+    g_signatureCache = make_unique<SignatureVerificationCache>(::arg().asNum("signature-cache-size"));
+  }
+
   {
     SuffixMatchNode dontThrottleNames;
     vector<string> parts;
@@ -5084,6 +5287,7 @@ static int serviceMain(int argc, char*argv[])
     for (const auto &p : parts) {
       dontThrottleNames.add(DNSName(p));
     }
+    dontThrottleNames.freeze();
     g_dontThrottleNames.setState(std::move(dontThrottleNames));
 
     parts.clear();
@@ -5092,6 +5296,7 @@ static int serviceMain(int argc, char*argv[])
     for (const auto &p : parts) {
       dontThrottleNetmasks.addMask(Netmask(p));
     }
+    dontThrottleNetmasks.freeze();
     g_dontThrottleNetmasks.setState(std::move(dontThrottleNetmasks));
   }
 
@@ -5102,6 +5307,7 @@ static int serviceMain(int argc, char*argv[])
     for (const auto &p : parts) {
       xdnssecNames.add(DNSName(p));
     }
+    xdnssecNames.freeze();
     g_xdnssec.setState(std::move(xdnssecNames));
   }
 
@@ -5117,6 +5323,7 @@ static int serviceMain(int argc, char*argv[])
     for (const auto &p : parts) {
       dotauthNames.add(DNSName(p));
     }
+    dotauthNames.freeze();
     g_DoTToAuthNames.setState(std::move(dotauthNames));
   }
 
@@ -5341,6 +5548,13 @@ static int serviceMain(int argc, char*argv[])
     }
     s_avoidUdpSourcePorts.insert(port);
   }
+  s_udpSocketPoolSize = ::arg().asNum("udp-source-socket-pool-size");
+  s_udpSocketPoolMaxUses = std::max(::arg().asNum("udp-source-socket-max-uses"), 1);
+
+#ifdef NOD_ENABLED
+  // after dropping privileges, so that the snapshots are owned by the user we run as
+  setupNODDBs();
+#endif /* NOD_ENABLED */
 
   unsigned int currentThreadId = 1;
   const auto cpusMap = parseCPUMap();
@@ -5432,7 +5646,21 @@ try
   SyncRes tmp(g_now); // make sure it allocates tsstorage before we do anything, like primeHints or so..
   SyncRes::setDomainMap(g_initialDomainMap);
   t_allowFrom = g_initialAllowFrom;
-  t_udpclientsocks = std::unique_ptr<UDPClientSocks>(new UDPClientSocks());
+  t_udpclientsocks = std::unique_ptr<UDPClientSocks>(new UDPClientSocks(s_udpSocketPoolSize, s_udpSocketPoolMaxUses));
+  size_t families = (SyncRes::s_doIPv4 ? 1 : 0) + (SyncRes::s_doIPv6 ? 1 : 0);
+  if (s_udpSocketPoolSize > 0 && families > 0 && (threadInfo.isWorker || threadInfo.isHandler)) {
+    try {
+      if (SyncRes::s_doIPv4) {
+        t_udpclientsocks->prefill(AF_INET, s_udpSocketPoolSize / families);
+      }
+      if (SyncRes::s_doIPv6) {
+        t_udpclientsocks->prefill(AF_INET6, s_udpSocketPoolSize / families);
+      }
+    }
+    catch (const PDNSException& e) {
+      g_log<<Logger::Warning<<"Unable to pre-open the outgoing UDP socket pool: "<<e.reason<<endl;
+    }
+  }
   t_tcpClientCounts = std::unique_ptr<tcpClientCounts_t>(new tcpClientCounts_t());
 
   if (threadInfo.isHandler) {
@@ -5448,11 +5676,6 @@ try
   t_packetCache = std::unique_ptr<RecursorPacketCache>(new RecursorPacketCache());
 
 
-#ifdef NOD_ENABLED
-  if (threadInfo.isWorker)
-    setupNODThread();
-#endif /* NOD_ENABLED */
-
   /* the listener threads handle TCP queries */
   if(threadInfo.isWorker || threadInfo.isListener) {
     try {
@@ -5491,7 +5714,7 @@ try
     t_bogusqueryring = std::unique_ptr<boost::circular_buffer<pair<DNSName, uint16_t> > >(new boost::circular_buffer<pair<DNSName, uint16_t> >());
     t_bogusqueryring->set_capacity(ringsize);
   }
-  MT = std::make_unique<MT_t>(::arg().asNum("stack-size"));
+  MT = std::make_unique<MT_t>(::arg().asNum("stack-size"), ::arg().asNum("stack-cache-size"));
   threadInfo.mt = MT.get();
 
   /* start protobuf export threads if needed */
@@ -5706,6 +5929,7 @@ int main(int argc, char **argv)
 #else
     ::arg().set("stack-size","stack size per mthread")="200000";
 #endif
+    ::arg().set("stack-cache-size","Number of stacks of finished mthreads kept per thread to be reused")="100";
     ::arg().set("soa-minimum-ttl","Don't change")="0";
     ::arg().set("no-shuffle","Don't change")="off";
     ::arg().set("local-port","port to listen on")="53";
@@ -5715,6 +5939,7 @@ int main(int argc, char **argv)
     ::arg().set("dnssec", "DNSSEC mode: off/process-no-validate/process (default)/log-fail/validate")="process";
     ::arg().set("dnssec-log-bogus", "Log DNSSEC bogus validations")="no";
     ::arg().set("signature-inception-skew", "Allow the signature inception to be off by this number of seconds")="60";
+    ::arg().set("signature-cache-size", "Number of DNSSEC signature verification results cached and shared by all threads, 0 to disable")="100000";
     ::arg().set("daemon","Operate as a daemon")="no";
     ::arg().setSwitch("write-pid","Write a PID file")="yes";
     ::arg().set("loglevel","Amount of logging. Higher is more. Do not set below 3")="6";
@@ -5781,6 +6006,8 @@ int main(int argc, char **argv)
     ::arg().set("dont-throttle-netmasks", "Do not throttle nameservers with this IP netmask")="";
     ::arg().set("non-resolving-ns-max-fails", "Number of failed address resolves of a nameserver to start throttling it, 0 is disabled")="5";
     ::arg().set("non-resolving-ns-throttle-time", "Number of seconds to throttle a nameserver with a name failing to resolve")="60";
+    ::arg().set("shared-server-state", "Share the speed, throttle, EDNS and failure status of authoritative servers between all threads")="yes";
+    ::arg().set("shared-server-state-shards", "Number of shards of each of the shared authoritative server tables")="64";
 
     ::arg().set("hint-file", "If set, load root hints from this file")="";
     ::arg().set("max-cache-entries", "If set, maximum number of entries in the main cache")="1000000";
@@ -5875,6 +6102,10 @@ int main(int argc, char **argv)
 
     ::arg().set("tcp-fast-open", "Enable TCP Fast Open support on the listening sockets, using the supplied numerical value as the queue size")="0";
     ::arg().set("tcp-fast-open-connect", "Enable TCP Fast Open support on outgoing sockets")="no";
+    ::arg().set("tcp-out-max-idle-ms", "Time TCP/DoT connections are left idle in milliseconds or 0 if no limit")="10000";
+    ::arg().set("tcp-out-max-idle-per-auth", "Maximum number of idle TCP/DoT connections to a specific IP per thread, 0 means do not keep idle connections open")="10";
+    ::arg().set("tcp-out-max-queries", "Maximum total number of queries per TCP/DoT connection, 0 means no limit")="0";
+    ::arg().set("tcp-out-max-idle-per-thread", "Maximum number of idle TCP/DoT connections per thread")="100";
     ::arg().set("nsec3-max-iterations", "Maximum number of iterations allowed for an NSEC3 record")="150";
 
     ::arg().set("cpu-map", "Thread to CPU mapping, space separated thread-id=cpu1,cpu2..cpuN pairs")="";
@@ -5892,6 +6123,8 @@ int main(int argc, char **argv)
     ::arg().set("udp-source-port-min", "Minimum UDP port to bind on")="1024";
     ::arg().set("udp-source-port-max", "Maximum UDP port to bind on")="65535";
     ::arg().set("udp-source-port-avoid", "List of comma separated UDP port number to avoid")="11211";
+    ::arg().set("udp-source-socket-pool-size", "Number of outgoing UDP sockets bound to random ports each thread keeps open and reuses, 0 opens a new socket for every query")="0";
+    ::arg().set("udp-source-socket-max-uses", "Number of queries a pooled outgoing UDP socket is used for before being replaced by one bound to a new random port")="100";
     ::arg().set("rng", "Specify random number generator to use. Valid values are auto,sodium,openssl,getrandom,arc4random,urandom.")="auto";
     ::arg().set("public-suffix-list-file", "Path to the Public Suffix List file, if any")="";
     ::arg().set("distribution-load-factor", "The load factor used when PowerDNS is distributing queries to worker threads")="0.0";
@@ -5901,6 +6134,9 @@ int main(int argc, char **argv)
     ::arg().set("max-generate-steps", "Maximum number of $GENERATE steps when loading a zone from a file")="0";
     ::arg().set("record-cache-shards", "Number of shards in the record cache")="1024";
     ::arg().set("refresh-on-ttl-perc", "If a record is requested from the cache and only this % of original TTL remains, refetch") = "0";
+    ::arg().set("prefetch-budget", "Maximum number of popular records refreshed per second before they expire from the cache, 0 to disable") = "0";
+    ::arg().set("serve-stale-extensions", "Number of times an expired record can be served for 30 more seconds when its authoritative servers fail, 0 to disable") = "0";
+    ::arg().setSwitch("intern-cache-names", "Share the storage of identical long names between the entries of the record and packet caches") = "no";
 
     ::arg().set("x-dnssec-names", "Collect DNSSEC statistics for names or suffixes in this list in separate x-dnssec counters")="";
 
@@ -19,6 +19,8 @@
 #include "ueberbackend.hh"
 #include "arguments.hh"
 #include "auth-packetcache.hh"
+#include "auth-denialcache.hh"
+#include "auth-nsec3cache.hh"
 #include "auth-querycache.hh"
 #include "auth-zonecache.hh"
 #include "zoneparser-tng.hh"
@@ -28,6 +30,7 @@
 #include "misc.hh"
 #include <fstream>
 #include <utility>
+#include <thread>
 #include <termios.h>            //termios, TCSANOW, ECHO, ICANON
 #include "opensslsigners.hh"
 #ifdef HAVE_LIBSODIUM
@@ -42,6 +45,8 @@ StatBag S;
 AuthPacketCache PC;
 AuthQueryCache QC;
 AuthZoneCache g_zoneCache;
+AuthNSEC3Cache g_nsec3Cache;
+AuthDenialCache g_denialCache;
 
 namespace po = boost::program_options;
 po::variables_map g_vm;
@@ -1358,9 +1363,13 @@ static int loadZone(const DNSName& zone, const string& fname) {
     cerr<<"Unable to start transaction for load of zone '"<<zone<<"'"<<endl;
     return EXIT_FAILURE;
   }
-  rr.domain_id=di.id;
+  /* parsing the content of the records is the expensive part, spread it over all cores */
+  ParallelZoneParser pzp(zpt, std::thread::hardware_concurrency());
+  std::shared_ptr<DNSRecordContent> content;
+  string contentError;
   bool haveSOA = false;
-  while(zpt.get(rr)) {
+  while(pzp.get(rr, content, &contentError)) {
+    rr.domain_id=di.id;
     if(!rr.qname.isPartOf(zone) && rr.qname!=zone) {
       cerr<<"File contains record named '"<<rr.qname<<"' which is not part of zone '"<<zone<<"'"<<endl;
       return EXIT_FAILURE;
@@ -1371,15 +1380,8 @@ static int loadZone(const DNSName& zone, const string& fname) {
       else
         haveSOA = true;
     }
-    try {
-      DNSRecordContent::mastermake(rr.qtype, QClass::IN, rr.content);
-    }
-    catch (const PDNSException &pe) {
-      cerr<<"Bad record content in record for "<<rr.qname<<"|"<<rr.qtype.toString()<<": "<<pe.reason<<endl;
-      return EXIT_FAILURE;
-    }
-    catch (const std::exception &e) {
-      cerr<<"Bad record content in record for "<<rr.qname<<"|"<<rr.qtype.toString()<<": "<<e.what()<<endl;
+    if (!content) {
+      cerr<<"Bad record content in record for "<<rr.qname<<"|"<<rr.qtype.toString()<<": "<<contentError<<endl;
       return EXIT_FAILURE;
     }
     db->feedRecord(rr, DNSName());
@@ -39,6 +39,7 @@
 #include "pubsuffix.hh"
 #include "namespaces.hh"
 #include "rec-taskqueue.hh"
+#include "rec-tcpout.hh"
 
 std::pair<std::string, std::string> PrefixDashNumberCompare::prefixAndTrailingNum(const std::string& a)
 {
@@ -405,7 +406,7 @@ static uint64_t* pleaseDumpNonResolvingNS(int fd)
   return new uint64_t(SyncRes::doDumpNonResolvingNS(fd));
 }
 
-// Generic dump to file command
+// Generic dump to file command, for the authoritative server tables
 static RecursorControlChannel::Answer doDumpToFile(int s, uint64_t* (*function)(int s), const string& name)
 {
   auto fdw = getfd(s);
@@ -417,7 +418,7 @@ static RecursorControlChannel::Answer doDumpToFile(int s, uint64_t* (*function)(
   uint64_t total = 0;
   try {
     int fd = fdw;
-    total = broadcastAccFunction<uint64_t>([function, fd]{ return function(fd); });
+    total = serverStateAccFunction([function, fd]{ return function(fd); });
   }
   catch(std::exception& e)
   {
@@ -570,6 +571,41 @@ static string doSetCarbonServer(T begin, T end)
   return ret;
 }
 
+static void* pleaseClearLocalServerState()
+{
+  SyncRes::clearLocalServerState();
+  return nullptr;
+}
+
+template<typename T>
+static string doSetSharedServerState(T begin, T end)
+{
+  if (begin == end)
+    return "No shared server state setting specified\n";
+
+  if (pdns_iequals(*begin, "on") || pdns_iequals(*begin, "yes")) {
+    if (!SyncRes::isServerStateShared()) {
+      g_log<<Logger::Warning<<"Sharing the authoritative server state between threads, requested via control channel"<<endl;
+      SyncRes::setServerStateShared(true);
+      broadcastFunction(pleaseClearLocalServerState);
+      return "Authoritative server state is now shared between threads\n";
+    }
+    return "Authoritative server state was already shared between threads\n";
+  }
+
+  if (pdns_iequals(*begin, "off") || pdns_iequals(*begin, "no")) {
+    if (SyncRes::isServerStateShared()) {
+      g_log<<Logger::Warning<<"Keeping the authoritative server state per thread, requested via control channel"<<endl;
+      SyncRes::setServerStateShared(false);
+      SyncRes::clearSharedServerState();
+      return "Authoritative server state is now kept per thread\n";
+    }
+    return "Authoritative server state was already kept per thread\n";
+  }
+
+  return "Unknown shared server state setting: '" + *begin +"'\n";
+}
+
 template<typename T>
 static string doSetDnssecLogBogus(T begin, T end)
 {
@@ -1003,7 +1039,7 @@ uint64_t* pleaseGetThrottleSize()
 
 static uint64_t getThrottleSize()
 {
-  return broadcastAccFunction<uint64_t>(pleaseGetThrottleSize);
+  return serverStateAccFunction(pleaseGetThrottleSize);
 }
 
 static uint64_t getNegCacheSize()
@@ -1019,7 +1055,7 @@ static uint64_t* pleaseGetFailedHostsSize()
 
 static uint64_t getFailedHostsSize()
 {
-  return broadcastAccFunction<uint64_t>(pleaseGetFailedHostsSize);
+  return serverStateAccFunction(pleaseGetFailedHostsSize);
 }
 
 uint64_t* pleaseGetNsSpeedsSize()
@@ -1029,7 +1065,7 @@ uint64_t* pleaseGetNsSpeedsSize()
 
 static uint64_t getNsSpeedsSize()
 {
-  return broadcastAccFunction<uint64_t>(pleaseGetNsSpeedsSize);
+  return serverStateAccFunction(pleaseGetNsSpeedsSize);
 }
 
 uint64_t* pleaseGetFailedServersSize()
@@ -1052,6 +1088,26 @@ static uint64_t getConcurrentQueries()
   return broadcastAccFunction<uint64_t>(pleaseGetConcurrentQueries);
 }
 
+static uint64_t* pleaseGetMThreadStackPoolHits()
+{
+  return new uint64_t(getMT() ? getMT()->getStackPoolHits() : 0);
+}
+
+static uint64_t getMThreadStackPoolHits()
+{
+  return broadcastAccFunction<uint64_t>(pleaseGetMThreadStackPoolHits);
+}
+
+static uint64_t* pleaseGetMThreadStackPoolMisses()
+{
+  return new uint64_t(getMT() ? getMT()->getStackPoolMisses() : 0);
+}
+
+static uint64_t getMThreadStackPoolMisses()
+{
+  return broadcastAccFunction<uint64_t>(pleaseGetMThreadStackPoolMisses);
+}
+
 static uint64_t doGetCacheSize()
 {
   return g_recCache->size();
@@ -1072,6 +1128,21 @@ static uint64_t doGetCacheMisses()
   return g_recCache->cacheMisses;
 }
 
+static uint64_t doGetCachePrefetches()
+{
+  return g_recCache->prefetchesQueued;
+}
+
+static uint64_t doGetCachePrefetchHits()
+{
+  return g_recCache->prefetchHits;
+}
+
+static uint64_t doGetCacheServedStale()
+{
+  return g_recCache->servedStale;
+}
+
 uint64_t* pleaseGetPacketCacheSize()
 {
   return new uint64_t(t_packetCache ? t_packetCache->size() : 0);
@@ -1187,6 +1258,9 @@ static void registerAllStats1()
 
   addGetStat("cache-hits", doGetCacheHits);
   addGetStat("cache-misses", doGetCacheMisses); 
+  addGetStat("cache-prefetches", doGetCachePrefetches);
+  addGetStat("cache-prefetch-hits", doGetCachePrefetchHits);
+  addGetStat("cache-served-stale", doGetCacheServedStale);
   addGetStat("cache-entries", doGetCacheSize);
   addGetStat("max-cache-entries", []() { return g_maxCacheEntries.load(); });
   addGetStat("max-packetcache-entries", []() { return g_maxPacketCacheEntries.load();}); 
@@ -1262,6 +1336,9 @@ static void registerAllStats1()
   addGetStat("ignored-packets", &g_stats.ignoredCount);
   addGetStat("empty-queries", &g_stats.emptyQueriesCount);
   addGetStat("max-mthread-stack", &g_stats.maxMThreadStackUsage);
+  addGetStat("max-mthread-stack-high-water", &g_stats.maxMThreadStackHighWater);
+  addGetStat("mthread-stack-pool-hits", getMThreadStackPoolHits);
+  addGetStat("mthread-stack-pool-misses", getMThreadStackPoolMisses);
 
   addGetStat("negcache-entries", getNegCacheSize);
   addGetStat("throttle-entries", getThrottleSize);
@@ -1331,6 +1408,8 @@ static void registerAllStats1()
 #endif
 
   addGetStat("dnssec-validations", &g_stats.dnssecValidations);
+  addGetStat("signature-cache-hits", []() { return g_signatureCache ? g_signatureCache->getHits() : 0; });
+  addGetStat("signature-cache-misses", []() { return g_signatureCache ? g_signatureCache->getMisses() : 0; });
   addGetStat("dnssec-result-insecure", &g_stats.dnssecResults[vState::Insecure]);
   addGetStat("dnssec-result-secure", &g_stats.dnssecResults[vState::Secure]);
   addGetStat("dnssec-result-bogus", []() {
@@ -1407,7 +1486,14 @@ static void registerAllStats1()
   addGetStat("taskqueue-expired",  []() { return getTaskExpired(); });
   addGetStat("taskqueue-size",  []() { return getTaskSize(); });
 
+  addGetStat("tcp-out-new-connections", []() { return getTCPOutNewConnections(); });
+  addGetStat("tcp-out-reused-connections", []() { return getTCPOutReusedConnections(); });
+  addGetStat("tcp-out-idle-connections", []() { return broadcastAccFunction<uint64_t>(pleaseGetTCPOutIdleConnections); });
+
   addGetStat("dns64-prefix-answers",  &g_stats.dns64prefixanswers);
+  addGetStat("udp-pool-reuses", &g_stats.udpPoolReuses);
+  addGetStat("udp-pool-sockets", &g_stats.udpPoolSockets);
+  addGetStat("udp-pool-port-entropy", getOutgoingUDPPortEntropy);
 
   addGetStat("almost-expired-pushed",  []() { return getAlmostExpiredTasksPushed(); });
   addGetStat("almost-expired-run",  []() { return getAlmostExpiredTasksRun(); });
@@ -1728,6 +1814,7 @@ static string addDontThrottleNames(T begin, T end) {
     dnt.add(d);
   }
 
+  dnt.freeze();
   g_dontThrottleNames.setState(std::move(dnt));
 
   ret += " to the list of nameservers that may not be throttled";
@@ -1767,6 +1854,7 @@ static string addDontThrottleNetmasks(T begin, T end) {
     dnt.addMask(t);
   }
 
+  dnt.freeze();
   g_dontThrottleNetmasks.setState(std::move(dnt));
 
   ret += " to the list of nameserver netmasks that may not be throttled";
@@ -1813,6 +1901,7 @@ static string clearDontThrottleNames(T begin, T end) {
     dnt.remove(name);
   }
 
+  dnt.freeze();
   g_dontThrottleNames.setState(std::move(dnt));
 
   ret += " from the list of nameservers that may not be throttled";
@@ -1865,6 +1954,7 @@ static string clearDontThrottleNetmasks(T begin, T end) {
     dnt.deleteMask(mask);
   }
 
+  dnt.freeze();
   g_dontThrottleNetmasks.setState(std::move(dnt));
 
   ret += " from the list of nameservers that may not be throttled";
@@ -1929,6 +2019,7 @@ RecursorControlChannel::Answer RecursorControlParser::getAnswer(int s, const str
 "set-minimum-ttl value            set minimum-ttl-override\n"
 "set-carbon-server                set a carbon server for telemetry\n"
 "set-dnssec-log-bogus SETTING     enable (SETTING=yes) or disable (SETTING=no) logging of DNSSEC validation failures\n"
+"set-shared-server-state SETTING  share (SETTING=yes) the authoritative server speeds, throttles and EDNS status between threads, or keep them per thread (SETTING=no)\n"
 "trace-regex [regex]              emit resolution trace for matching queries (empty regex to clear trace)\n"
 "top-largeanswer-remotes          show top remotes receiving large answers\n"
 "top-queries                      show top queries\n"
@@ -2128,6 +2219,9 @@ RecursorControlChannel::Answer RecursorControlParser::getAnswer(int s, const str
   if (cmd == "set-dnssec-log-bogus") {
     return {0, doSetDnssecLogBogus(begin, end)};
   }
+  if (cmd == "set-shared-server-state") {
+    return {0, doSetSharedServerState(begin, end)};
+  }
   if (cmd == "get-dont-throttle-names") {
     return {0, getDontThrottleNames()};
   }
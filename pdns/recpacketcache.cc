@@ -16,6 +16,7 @@ RecursorPacketCache::RecursorPacketCache()
 }
 
 unsigned int RecursorPacketCache::s_refresh_ttlperc{0};
+bool RecursorPacketCache::s_internNames{false};
 
 int RecursorPacketCache::doWipePacketCache(const DNSName& name, uint16_t qtype, bool subtree)
 {
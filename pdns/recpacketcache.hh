@@ -50,6 +50,7 @@ class RecursorPacketCache: public PacketCache
 {
 public:
   static unsigned int s_refresh_ttlperc;
+  static bool s_internNames;
 
   struct PBData {
     std::string d_message;
@@ -81,6 +82,9 @@ private:
   {
     Entry(const DNSName& qname, std::string&& packet, std::string&& query, bool tcp): d_name(qname), d_packet(std::move(packet)), d_query(std::move(query)), d_tcp(tcp)
     {
+      if (s_internNames) {
+        d_name.intern();
+      }
     }
 
     DNSName d_name;
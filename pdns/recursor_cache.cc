@@ -7,6 +7,7 @@
 #include "recursor_cache.hh"
 #include "misc.hh"
 #include <iostream>
+#include <queue>
 #include "dnsrecords.hh"
 #include "arguments.hh"
 #include "syncres.hh"
@@ -15,6 +16,12 @@
 #include "cachecleaner.hh"
 #include "rec-taskqueue.hh"
 
+uint16_t MemRecursorCache::s_maxServedStaleExtensions;
+bool MemRecursorCache::s_internNames{false};
+
+// entries hit less often than this between two doPrefetch() scans are not worth a refresh
+static const uint32_t s_prefetchMinHits = 2;
+
 MemRecursorCache::MemRecursorCache(size_t mapsCount) : d_maps(mapsCount)
 {
 }
@@ -99,9 +106,24 @@ static void updateDNSSECValidationStateFromCache(boost::optional<vState>& state,
   }
 }
 
-time_t MemRecursorCache::handleHit(MapCombo::LockedContent& content, MemRecursorCache::OrderedTagIterator_t& entry, const DNSName& qname, uint32_t& origTTL, vector<DNSRecord>* res, vector<std::shared_ptr<RRSIGRecordContent>>* signatures, std::vector<std::shared_ptr<DNSRecord>>* authorityRecs, bool* variable, boost::optional<vState>& state, bool* wasAuth, DNSName* fromAuthZone)
+time_t MemRecursorCache::handleHit(time_t now, MapCombo::LockedContent& content, MemRecursorCache::OrderedTagIterator_t& entry, const DNSName& qname, uint32_t& origTTL, vector<DNSRecord>* res, vector<std::shared_ptr<RRSIGRecordContent>>* signatures, std::vector<std::shared_ptr<DNSRecord>>* authorityRecs, bool* variable, boost::optional<vState>& state, bool* wasAuth, DNSName* fromAuthZone)
 {
   // MUTEX SHOULD BE ACQUIRED (as indicated by the reference to the content which is protected by a lock)
+  if (entry->d_ttd <= now) {
+    // we are serving this entry stale, make it live a bit longer (RFC 8767 section 4)
+    entry->d_ttd = now + s_serveStaleExtensionPeriod;
+    ++entry->d_servedStale;
+    ++servedStale;
+  }
+  else if (entry->d_prefetchedTTD != 0 && entry->d_prefetchedTTD <= now) {
+    // without the prefetch this would have been a miss, only the first hit counts
+    ++prefetchHits;
+    entry->d_prefetchedTTD = 0;
+  }
+  if (entry->d_hits < std::numeric_limits<uint32_t>::max()) {
+    ++entry->d_hits;
+  }
+
   time_t ttd = entry->d_ttd;
   origTTL = entry->d_orig_ttl;
 
@@ -147,7 +169,7 @@ time_t MemRecursorCache::handleHit(MapCombo::LockedContent& content, MemRecursor
   return ttd;
 }
 
-MemRecursorCache::cache_t::const_iterator MemRecursorCache::getEntryUsingECSIndex(MapCombo::LockedContent& map, time_t now, const DNSName &qname, const QType qtype, bool requireAuth, const ComboAddress& who)
+MemRecursorCache::cache_t::const_iterator MemRecursorCache::getEntryUsingECSIndex(MapCombo::LockedContent& map, time_t now, const DNSName &qname, const QType qtype, bool requireAuth, const ComboAddress& who, Flags flags)
 {
   // MUTEX SHOULD BE ACQUIRED (as indicated by the reference to the content which is protected by a lock)
   auto ecsIndexKey = tie(qname, qtype);
@@ -195,7 +217,7 @@ MemRecursorCache::cache_t::const_iterator MemRecursorCache::getEntryUsingECSInde
   auto key = boost::make_tuple(qname, qtype, boost::none, Netmask());
   auto entry = map.d_map.find(key);
   if (entry != map.d_map.end()) {
-    if (entry->d_ttd > now) {
+    if (entry->isUsable(now, flags & ServeStale)) {
       if (!requireAuth || entry->d_auth) {
         return entry;
       }
@@ -240,6 +262,10 @@ bool MemRecursorCache::entryMatches(MemRecursorCache::OrderedTagIterator_t& entr
 time_t MemRecursorCache::fakeTTD(MemRecursorCache::OrderedTagIterator_t& entry, const DNSName& qname, QType qtype, time_t ret, time_t now, uint32_t origTTL, bool refresh)
 {
   time_t ttl = ret - now;
+  if (ttl > 0 && refresh && entry->d_prefetchedTTD == entry->d_ttd) {
+    // queued by doPrefetch() and not refreshed yet
+    return -1;
+  }
   if (ttl > 0 && SyncRes::s_refresh_ttlperc > 0) {
     const uint32_t deadline = origTTL * SyncRes::s_refresh_ttlperc / 100;
     const bool almostExpired = static_cast<uint32_t>(ttl) <= deadline;
@@ -257,8 +283,10 @@ time_t MemRecursorCache::fakeTTD(MemRecursorCache::OrderedTagIterator_t& entry,
   return ttl;
 }
 // returns -1 for no hits
-time_t MemRecursorCache::get(time_t now, const DNSName &qname, const QType qt, bool requireAuth, vector<DNSRecord>* res, const ComboAddress& who, bool refresh, const OptTag& routingTag, vector<std::shared_ptr<RRSIGRecordContent>>* signatures, std::vector<std::shared_ptr<DNSRecord>>* authorityRecs, bool* variable, vState* state, bool* wasAuth, DNSName* fromAuthZone)
+time_t MemRecursorCache::get(time_t now, const DNSName &qname, const QType qt, bool requireAuth, vector<DNSRecord>* res, const ComboAddress& who, Flags flags, const OptTag& routingTag, vector<std::shared_ptr<RRSIGRecordContent>>* signatures, std::vector<std::shared_ptr<DNSRecord>>* authorityRecs, bool* variable, vState* state, bool* wasAuth, DNSName* fromAuthZone)
 {
+  const bool refresh = flags & Refresh;
+  const bool serveStale = flags & ServeStale;
   boost::optional<vState> cachedState{boost::none};
   uint32_t origTTL;
 
@@ -281,13 +309,13 @@ time_t MemRecursorCache::get(time_t now, const DNSName &qname, const QType qt, b
     if (qtype == QType::ADDR) {
       time_t ret = -1;
 
-      auto entryA = getEntryUsingECSIndex(*map, now, qname, QType::A, requireAuth, who);
+      auto entryA = getEntryUsingECSIndex(*map, now, qname, QType::A, requireAuth, who, flags);
       if (entryA != map->d_map.end()) {
-        ret = handleHit(*map, entryA, qname, origTTL, res, signatures, authorityRecs, variable, cachedState, wasAuth, fromAuthZone);
+        ret = handleHit(now, *map, entryA, qname, origTTL, res, signatures, authorityRecs, variable, cachedState, wasAuth, fromAuthZone);
       }
-      auto entryAAAA = getEntryUsingECSIndex(*map, now, qname, QType::AAAA, requireAuth, who);
+      auto entryAAAA = getEntryUsingECSIndex(*map, now, qname, QType::AAAA, requireAuth, who, flags);
       if (entryAAAA != map->d_map.end()) {
-        time_t ttdAAAA = handleHit(*map, entryAAAA, qname, origTTL, res, signatures, authorityRecs, variable, cachedState, wasAuth, fromAuthZone);
+        time_t ttdAAAA = handleHit(now, *map, entryAAAA, qname, origTTL, res, signatures, authorityRecs, variable, cachedState, wasAuth, fromAuthZone);
         if (ret > 0) {
           ret = std::min(ret, ttdAAAA);
         } else {
@@ -302,9 +330,9 @@ time_t MemRecursorCache::get(time_t now, const DNSName &qname, const QType qt, b
       return ret > 0 ? (ret - now) : ret;
     }
     else {
-      auto entry = getEntryUsingECSIndex(*map, now, qname, qtype, requireAuth, who);
+      auto entry = getEntryUsingECSIndex(*map, now, qname, qtype, requireAuth, who, flags);
       if (entry != map->d_map.end()) {
-        time_t ret = handleHit(*map, entry, qname, origTTL, res, signatures, authorityRecs, variable, cachedState, wasAuth, fromAuthZone);
+        time_t ret = handleHit(now, *map, entry, qname, origTTL, res, signatures, authorityRecs, variable, cachedState, wasAuth, fromAuthZone);
         if (state && cachedState) {
           *state = *cachedState;
         }
@@ -324,7 +352,7 @@ time_t MemRecursorCache::get(time_t now, const DNSName &qname, const QType qt, b
       for (auto i=entries.first; i != entries.second; ++i) {
         firstIndexIterator = map->d_map.project<OrderedTag>(i);
 
-        if (i->d_ttd <= now) {
+        if (!i->isUsable(now, serveStale)) {
           moveCacheItemToFront<SequencedTag>(map->d_map, firstIndexIterator);
           continue;
         }
@@ -333,7 +361,7 @@ time_t MemRecursorCache::get(time_t now, const DNSName &qname, const QType qt, b
           continue;
         }
         found = true;
-        ttd = handleHit(*map, firstIndexIterator, qname, origTTL, res, signatures, authorityRecs, variable, cachedState, wasAuth, fromAuthZone);
+        ttd = handleHit(now, *map, firstIndexIterator, qname, origTTL, res, signatures, authorityRecs, variable, cachedState, wasAuth, fromAuthZone);
 
         if (qt != QType::ANY && qt != QType::ADDR) { // normally if we have a hit, we are done
           break;
@@ -360,7 +388,7 @@ time_t MemRecursorCache::get(time_t now, const DNSName &qname, const QType qt, b
     for (auto i=entries.first; i != entries.second; ++i) {
       firstIndexIterator = map->d_map.project<OrderedTag>(i);
 
-      if (i->d_ttd <= now) {
+      if (!i->isUsable(now, serveStale)) {
         moveCacheItemToFront<SequencedTag>(map->d_map, firstIndexIterator);
         continue;
       }
@@ -370,7 +398,7 @@ time_t MemRecursorCache::get(time_t now, const DNSName &qname, const QType qt, b
       }
 
       found = true;
-      ttd = handleHit(*map, firstIndexIterator, qname, origTTL, res, signatures, authorityRecs, variable, cachedState, wasAuth, fromAuthZone);
+      ttd = handleHit(now, *map, firstIndexIterator, qname, origTTL, res, signatures, authorityRecs, variable, cachedState, wasAuth, fromAuthZone);
 
       if (qt != QType::ANY && qt != QType::ADDR) { // normally if we have a hit, we are done
         break;
@@ -482,6 +510,11 @@ void MemRecursorCache::replace(time_t now, const DNSName &qname, const QType qt,
   if (!isNew) {
     moveCacheItemToBack<SequencedTag>(map->d_map, stored);
   }
+  if (ce.d_prefetchedTTD != 0 && ce.d_prefetchedTTD <= now) {
+    // the data expired before this update came in, the prefetch did not help
+    ce.d_prefetchedTTD = 0;
+  }
+  ce.d_servedStale = 0;
   ce.d_submitted = false;
   map->d_map.replace(stored, ce);
 }
@@ -593,7 +626,7 @@ bool MemRecursorCache::updateValidationStatus(time_t now, const DNSName &qname,
 
   bool updated = false;
   if (!map->d_ecsIndex.empty() && !routingTag) {
-    auto entry = getEntryUsingECSIndex(*map, now, qname, qtype, requireAuth, who);
+    auto entry = getEntryUsingECSIndex(*map, now, qname, qtype, requireAuth, who, None);
     if (entry == map->d_map.end()) {
       return false;
     }
@@ -670,6 +703,68 @@ uint64_t MemRecursorCache::doDump(int fd)
   return count;
 }
 
+size_t MemRecursorCache::doPrefetch(time_t now, time_t window, size_t budget, size_t stripe, size_t stripes)
+{
+  struct PrefetchCandidate
+  {
+    bool operator>(const PrefetchCandidate& rhs) const
+    {
+      return d_hits > rhs.d_hits;
+    }
+
+    DNSName d_qname;
+    size_t d_shard;
+    uint32_t d_hits;
+    QType d_qtype;
+  };
+
+  if (budget == 0 || stripes == 0) {
+    return 0;
+  }
+
+  // the least popular of the candidates selected so far is on top
+  std::priority_queue<PrefetchCandidate, std::vector<PrefetchCandidate>, std::greater<PrefetchCandidate>> candidates;
+
+  for (size_t shard = stripe; shard < d_maps.size(); shard += stripes) {
+    auto map = d_maps.at(shard).lock();
+    for (const auto& entry : map->d_map) {
+      const uint32_t hits = entry.d_hits;
+      entry.d_hits /= 2;
+
+      /* the refresh is done without a client subnet or routing tag, and the root is refreshed
+         by the housekeeping anyway */
+      if (hits < s_prefetchMinHits || entry.d_submitted || entry.d_ttd <= now || entry.d_ttd > now + window || !entry.d_netmask.empty() || entry.d_rtag || entry.d_qname.isRoot()) {
+        continue;
+      }
+
+      if (candidates.size() < budget) {
+        candidates.push({entry.d_qname, shard, hits, entry.d_qtype});
+      }
+      else if (hits > candidates.top().d_hits) {
+        candidates.pop();
+        candidates.push({entry.d_qname, shard, hits, entry.d_qtype});
+      }
+    }
+  }
+
+  size_t queued = 0;
+  for (; !candidates.empty(); candidates.pop()) {
+    const auto& candidate = candidates.top();
+    auto map = d_maps.at(candidate.d_shard).lock();
+    auto entry = map->d_map.find(boost::make_tuple(candidate.d_qname, candidate.d_qtype, boost::none, Netmask()));
+    if (entry == map->d_map.end() || entry->d_submitted || entry->d_ttd <= now) {
+      continue;
+    }
+    entry->d_submitted = true;
+    entry->d_prefetchedTTD = entry->d_ttd;
+    pushAlmostExpiredTask(candidate.d_qname, candidate.d_qtype.getCode(), entry->d_ttd);
+    ++queued;
+  }
+
+  prefetchesQueued += queued;
+  return queued;
+}
+
 void MemRecursorCache::doPrune(size_t keep)
 {
   //size_t maxCached = d_maxEntries;
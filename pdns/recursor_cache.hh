@@ -56,7 +56,18 @@ public:
 
   typedef boost::optional<std::string> OptTag;
 
-  time_t get(time_t, const DNSName &qname, const QType qt, bool requireAuth, vector<DNSRecord>* res, const ComboAddress& who, bool refresh = false, const OptTag& routingTag = boost::none, vector<std::shared_ptr<RRSIGRecordContent>>* signatures=nullptr, std::vector<std::shared_ptr<DNSRecord>>* authorityRecs=nullptr, bool* variable=nullptr, vState* state=nullptr, bool* wasAuth=nullptr, DNSName* fromAuthZone=nullptr);
+  typedef uint8_t Flags;
+  static constexpr Flags None = 0;
+  static constexpr Flags Refresh = 0x1 << 0;
+  static constexpr Flags ServeStale = 0x1 << 1;
+
+  // The number of times a stale entry can be served, each time for s_serveStaleExtensionPeriod seconds (RFC 8767)
+  static uint16_t s_maxServedStaleExtensions;
+  static constexpr time_t s_serveStaleExtensionPeriod = 30;
+  // Whether the names of the entries share their storage with the other interned copies, see DNSName::intern()
+  static bool s_internNames;
+
+  time_t get(time_t, const DNSName &qname, const QType qt, bool requireAuth, vector<DNSRecord>* res, const ComboAddress& who, Flags flags = None, const OptTag& routingTag = boost::none, vector<std::shared_ptr<RRSIGRecordContent>>* signatures=nullptr, std::vector<std::shared_ptr<DNSRecord>>* authorityRecs=nullptr, bool* variable=nullptr, vState* state=nullptr, bool* wasAuth=nullptr, DNSName* fromAuthZone=nullptr);
 
   void replace(time_t, const DNSName &qname, const QType qt,  const vector<DNSRecord>& content, const vector<shared_ptr<RRSIGRecordContent>>& signatures, const std::vector<std::shared_ptr<DNSRecord>>& authorityRecs, bool auth, const DNSName& authZone, boost::optional<Netmask> ednsmask=boost::none, const OptTag& routingTag = boost::none, vState state=vState::Indeterminate, boost::optional<ComboAddress> from=boost::none);
 
@@ -67,21 +78,38 @@ public:
   bool doAgeCache(time_t now, const DNSName& name, QType qtype, uint32_t newTTL);
   bool updateValidationStatus(time_t now, const DNSName &qname, QType qt, const ComboAddress& who, const OptTag& routingTag, bool requireAuth, vState newState, boost::optional<time_t> capTTD);
 
+  /* Queue a background refresh for at most 'budget' of the most popular entries expiring
+     in the next 'window' seconds. Only the shards whose index modulo 'stripes' is 'stripe'
+     are scanned, so that the work can be shared between threads. The hit counts of the
+     scanned entries are halved, so popularity decays over time. */
+  size_t doPrefetch(time_t now, time_t window, size_t budget, size_t stripe = 0, size_t stripes = 1);
+
   std::atomic<uint64_t> cacheHits{0}, cacheMisses{0};
+  // refreshes queued by doPrefetch(), hits that would have been misses without them, expired entries served
+  std::atomic<uint64_t> prefetchesQueued{0}, prefetchHits{0}, servedStale{0};
 
 private:
 
   struct CacheEntry
   {
     CacheEntry(const boost::tuple<DNSName, QType, OptTag, Netmask>& key, bool auth):
-      d_qname(key.get<0>()), d_netmask(key.get<3>().getNormalized()), d_rtag(key.get<2>()), d_state(vState::Indeterminate), d_ttd(0), d_qtype(key.get<1>()), d_auth(auth), d_submitted(false)
+      d_qname(key.get<0>()), d_netmask(key.get<3>().getNormalized()), d_rtag(key.get<2>()), d_state(vState::Indeterminate), d_ttd(0), d_prefetchedTTD(0), d_hits(0), d_servedStale(0), d_qtype(key.get<1>()), d_auth(auth), d_submitted(false)
     {
+      if (s_internNames) {
+        d_qname.intern();
+      }
     }
 
     typedef vector<std::shared_ptr<DNSRecordContent>> records_t;
     time_t getTTD() const
     {
-      return d_ttd;
+      // keep expired entries around for as long as they might still be served stale
+      return d_ttd + (s_maxServedStaleExtensions - std::min(d_servedStale, s_maxServedStaleExtensions)) * s_serveStaleExtensionPeriod;
+    }
+
+    bool isUsable(time_t now, bool serveStale) const
+    {
+      return d_ttd > now || (serveStale && d_servedStale < s_maxServedStaleExtensions && getTTD() > now);
     }
 
     records_t d_records;
@@ -94,7 +122,10 @@ private:
     OptTag d_rtag;
     mutable vState d_state;
     mutable time_t d_ttd;
+    mutable time_t d_prefetchedTTD; // the TTD this entry had when it was queued by doPrefetch(), 0 if it was not
     uint32_t d_orig_ttl;
+    mutable uint32_t d_hits;        // popularity, halved at each doPrefetch() scan
+    mutable uint16_t d_servedStale; // number of times the TTD has been extended to serve this entry stale
     QType d_qtype;
     bool d_auth;
     mutable bool d_submitted;     // whether this entry has been queued for refetch
@@ -115,6 +146,9 @@ private:
   public:
     ECSIndexEntry(const DNSName& qname, QType qtype): d_nmt(), d_qname(qname), d_qtype(qtype)
     {
+      if (s_internNames) {
+        d_qname.intern();
+      }
     }
 
     Netmask lookupBestMatch(const ComboAddress& addr) const
@@ -251,9 +285,9 @@ private:
 
   bool entryMatches(OrderedTagIterator_t& entry, QType qt, bool requireAuth, const ComboAddress& who);
   Entries getEntries(MapCombo::LockedContent& content, const DNSName &qname, const QType qt, const OptTag& rtag);
-  cache_t::const_iterator getEntryUsingECSIndex(MapCombo::LockedContent& content, time_t now, const DNSName &qname, QType qtype, bool requireAuth, const ComboAddress& who);
+  cache_t::const_iterator getEntryUsingECSIndex(MapCombo::LockedContent& content, time_t now, const DNSName &qname, QType qtype, bool requireAuth, const ComboAddress& who, Flags flags);
 
-  time_t handleHit(MapCombo::LockedContent& content, OrderedTagIterator_t& entry, const DNSName& qname, uint32_t& origTTL, vector<DNSRecord>* res, vector<std::shared_ptr<RRSIGRecordContent>>* signatures, std::vector<std::shared_ptr<DNSRecord>>* authorityRecs, bool* variable, boost::optional<vState>& state, bool* wasAuth, DNSName* authZone);
+  time_t handleHit(time_t now, MapCombo::LockedContent& content, OrderedTagIterator_t& entry, const DNSName& qname, uint32_t& origTTL, vector<DNSRecord>* res, vector<std::shared_ptr<RRSIGRecordContent>>* signatures, std::vector<std::shared_ptr<DNSRecord>>* authorityRecs, bool* variable, boost::optional<vState>& state, bool* wasAuth, DNSName* authZone);
 
 public:
   void preRemoval(MapCombo::LockedContent& map, const CacheEntry& entry)
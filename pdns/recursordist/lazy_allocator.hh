@@ -1 +0,0 @@
-../lazy_allocator.hh
\ No newline at end of file
@@ -62,6 +62,30 @@ namespace ProtoZero
       d_response = protozero::pbf_writer(d_rspbuf);
       reserve(sz1, sz2);
     }
+
+    // Construct a Message in buffers kept by the caller across messages, so that their capacity is reused.
+    // Both are emptied first, and handed back when the RecMessage goes away, the finished message (see finish()) in buf1
+    RecMessage(std::string& buf1, std::string& buf2) :
+      Message(d_msgbuf),
+      d_callerMsgbuf(&buf1),
+      d_callerRspbuf(&buf2)
+    {
+      d_msgbuf.swap(buf1);
+      d_rspbuf.swap(buf2);
+      d_msgbuf.clear();
+      d_rspbuf.clear();
+      d_message = protozero::pbf_writer(d_msgbuf);
+      d_response = protozero::pbf_writer(d_rspbuf);
+    }
+
+    ~RecMessage()
+    {
+      if (d_callerMsgbuf != nullptr) {
+        d_callerMsgbuf->swap(d_msgbuf);
+        d_callerRspbuf->swap(d_rspbuf);
+      }
+    }
+
     RecMessage(const Message&) = delete;
     RecMessage(Message&&) = delete;
     RecMessage& operator=(const Message&) = delete;
@@ -91,11 +115,17 @@ namespace ProtoZero
       return d_rspbuf;
     }
 
-    std::string&& finishAndMoveBuf()
+    // Adds the response part, if any, to the message
+    void finish()
     {
       if (!d_rspbuf.empty()) {
         d_message.add_message(static_cast<protozero::pbf_tag_type>(Field::response), d_rspbuf);
       }
+    }
+
+    std::string&& finishAndMoveBuf()
+    {
+      finish();
       return std::move(d_msgbuf);
     }
 
@@ -243,6 +273,8 @@ namespace ProtoZero
   private:
     std::string d_msgbuf;
     std::string d_rspbuf;
+    std::string* d_callerMsgbuf{nullptr};
+    std::string* d_callerRspbuf{nullptr};
 
 #ifdef NOD_ENABLED
     vector<std::string::size_type> offsets;
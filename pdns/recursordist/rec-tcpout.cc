@@ -0,0 +1,107 @@
+/*
+ * This file is part of PowerDNS or dnsdist.
+ * Copyright -- PowerDNS.COM B.V. and its contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of version 2 of the GNU General Public License as
+ * published by the Free Software Foundation.
+ *
+ * In addition, for the avoidance of any doubt, permission is granted to
+ * link this program with OpenSSL and to (re)distribute the binaries
+ * produced as the result of such linking.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "rec-tcpout.hh"
+#include "stat_t.hh"
+
+struct timeval TCPOutConnectionManager::s_maxIdleTime;
+size_t TCPOutConnectionManager::s_maxIdlePerAuth;
+size_t TCPOutConnectionManager::s_maxQueries;
+size_t TCPOutConnectionManager::s_maxIdlePerThread;
+
+thread_local TCPOutConnectionManager t_tcp_manager;
+
+static pdns::stat_t s_tcpout_new_connections;
+static pdns::stat_t s_tcpout_reused_connections;
+
+TCPOutConnectionManager::Connection TCPOutConnectionManager::get(const ComboAddress& ip)
+{
+  auto range = d_idleConnections.equal_range(ip);
+  // most recently stored last, it is the least likely to have been closed by the remote end
+  while (range.first != range.second) {
+    auto it = std::prev(range.second);
+    auto connection = std::move(it->second.d_connection);
+    d_idleConnections.erase(it);
+    range = d_idleConnections.equal_range(ip);
+
+    if (connection.d_handler && isTCPSocketUsable(connection.d_handler->getDescriptor())) {
+      ++s_tcpout_reused_connections;
+      return connection;
+    }
+    if (connection.d_handler) {
+      connection.d_handler->close();
+    }
+  }
+
+  ++s_tcpout_new_connections;
+  return Connection{};
+}
+
+void TCPOutConnectionManager::store(const struct timeval& now, const ComboAddress& ip, Connection&& connection)
+{
+  if (!connection.d_handler) {
+    return;
+  }
+
+  if (s_maxIdlePerAuth == 0 ||
+      (s_maxQueries > 0 && connection.d_numqueries >= s_maxQueries) ||
+      (s_maxIdlePerThread > 0 && d_idleConnections.size() >= s_maxIdlePerThread) ||
+      d_idleConnections.count(ip) >= s_maxIdlePerAuth) {
+    connection.d_handler->close();
+    return;
+  }
+
+  d_idleConnections.emplace(ip, IdleConnection{std::move(connection), now});
+}
+
+void TCPOutConnectionManager::cleanup(const struct timeval& now)
+{
+  if (s_maxIdleTime.tv_sec == 0 && s_maxIdleTime.tv_usec == 0) {
+    return;
+  }
+
+  auto cutoff = now - s_maxIdleTime;
+  for (auto it = d_idleConnections.begin(); it != d_idleConnections.end(); ) {
+    if (it->second.d_last < cutoff) {
+      it->second.d_connection.d_handler->close();
+      it = d_idleConnections.erase(it);
+    }
+    else {
+      ++it;
+    }
+  }
+}
+
+uint64_t getTCPOutNewConnections()
+{
+  return s_tcpout_new_connections;
+}
+
+uint64_t getTCPOutReusedConnections()
+{
+  return s_tcpout_reused_connections;
+}
+
+uint64_t* pleaseGetTCPOutIdleConnections()
+{
+  return new uint64_t(t_tcp_manager.size());
+}
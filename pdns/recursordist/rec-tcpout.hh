@@ -0,0 +1,78 @@
+/*
+ * This file is part of PowerDNS or dnsdist.
+ * Copyright -- PowerDNS.COM B.V. and its contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of version 2 of the GNU General Public License as
+ * published by the Free Software Foundation.
+ *
+ * In addition, for the avoidance of any doubt, permission is granted to
+ * link this program with OpenSSL and to (re)distribute the binaries
+ * produced as the result of such linking.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#pragma once
+
+#include <map>
+
+#include "iputils.hh"
+#include "tcpiohandler.hh"
+
+/* A per-thread store of idle outgoing TCP and DoT connections to authoritative servers,
+   so that a connection can be used for more than one query instead of being torn down after
+   the first answer. A connection only ever carries a single query at a time: it is taken out
+   of the store for the duration of the query and put back once the answer has been read. */
+class TCPOutConnectionManager
+{
+public:
+  // Max idle time for a connection, 0 is no timeout
+  static struct timeval s_maxIdleTime;
+  // Per remote maximum number of idle connections, 0 disables reuse
+  static size_t s_maxIdlePerAuth;
+  // Max total number of queries to send over a single connection, 0 is no limit
+  static size_t s_maxQueries;
+  // Per thread maximum number of idle connections, 0 is no limit
+  static size_t s_maxIdlePerThread;
+
+  struct Connection
+  {
+    std::shared_ptr<TCPIOHandler> d_handler;
+    size_t d_numqueries{0};
+  };
+
+  // Returns an idle connection to ip, or an empty one if there is none that can be used
+  Connection get(const ComboAddress& ip);
+  // Keeps the connection around for a later query, if the limits allow it
+  void store(const struct timeval& now, const ComboAddress& ip, Connection&& connection);
+  // Closes the connections that have been idle for too long
+  void cleanup(const struct timeval& now);
+
+  size_t size() const
+  {
+    return d_idleConnections.size();
+  }
+
+private:
+  struct IdleConnection
+  {
+    Connection d_connection;
+    struct timeval d_last;
+  };
+
+  // ComboAddress::operator< takes the port into account, which we need as port 853 means DoT
+  std::multimap<ComboAddress, IdleConnection> d_idleConnections;
+};
+
+extern thread_local TCPOutConnectionManager t_tcp_manager;
+
+uint64_t getTCPOutNewConnections();
+uint64_t getTCPOutReusedConnections();
+uint64_t* pleaseGetTCPOutIdleConnections();
@@ -22,11 +22,12 @@
 
 #pragma once
 
+#include <atomic>
 #include <vector>
 #include <cmath>
+#include <cstring>
 #include <random>
 #include <arpa/inet.h>
-#include <boost/dynamic_bitset.hpp>
 #include "misc.hh"
 #include "ext/probds/murmur3.h"
 
@@ -36,6 +37,9 @@ namespace bf
 // Max is always 1 in this implementation, which is best for streaming data
 // This also means we can use a bitset for storing values which is very
 // efficient
+// The cells are stored in atomic 64-bit words, so a single instance can be
+// used from any number of threads without locking. Only restore() needs
+// exclusive access.
 class stableBF
 {
 public:
@@ -43,29 +47,22 @@ public:
     d_k(optimalK(fp_rate)),
     d_num_cells(num_cells),
     d_p(p),
-    d_cells(num_cells),
-    d_gen(std::random_device()()),
-    d_dis(0, num_cells) {}
-  stableBF(uint8_t k, uint32_t num_cells, uint8_t p, const std::string& bitstr) :
-    d_k(k),
-    d_num_cells(num_cells),
-    d_p(p),
-    d_cells(bitstr),
-    d_gen(std::random_device()()),
-    d_dis(0, num_cells) {}
+    d_cells(numWords(num_cells)) {}
+  stableBF(const stableBF&) = delete;
+  stableBF& operator=(const stableBF&) = delete;
   void add(const std::string& data)
   {
     decrement();
     auto hashes = hash(data);
     for (auto& i : hashes) {
-      d_cells.set(i % d_num_cells);
+      set(i % d_num_cells);
     }
   }
   bool test(const std::string& data) const
   {
     auto hashes = hash(data);
     for (auto& i : hashes) {
-      if (d_cells.test(i % d_num_cells) == false)
+      if (isSet(i % d_num_cells) == false)
         return false;
     }
     return true;
@@ -75,25 +72,34 @@ public:
     auto hashes = hash(data);
     bool retval = true;
     for (auto& i : hashes) {
-      if (d_cells.test(i % d_num_cells) == false) {
+      if (isSet(i % d_num_cells) == false) {
         retval = false;
         break;
       }
     }
     decrement();
     for (auto& i : hashes) {
-      d_cells.set(i % d_num_cells);
+      set(i % d_num_cells);
     }
     return retval;
   }
-  void dump(std::ostream& os)
+  // Concurrent updates are not blocked, so the dump might contain some of them only
+  void dump(std::ostream& os) const
   {
     os.write((char*)&d_k, sizeof(d_k));
     uint32_t nint = htonl(d_num_cells);
     os.write((char*)&nint, sizeof(nint));
     os.write((char*)&d_p, sizeof(d_p));
-    std::string temp_str;
-    boost::to_string(d_cells, temp_str);
+    // one character per cell, the last cell first, as boost::to_string() does for a dynamic_bitset
+    std::string temp_str(d_num_cells, '0');
+    for (size_t w = 0; w < d_cells.size(); ++w) {
+      uint64_t word = d_cells[w].load(std::memory_order_relaxed);
+      for (size_t b = 0; word != 0; ++b, word >>= 1) {
+        if (word & 1) {
+          temp_str[d_num_cells - 1 - (w * 64 + b)] = '1';
+        }
+      }
+    }
     uint32_t bitstr_length = htonl((uint32_t)temp_str.length());
     os.write((char*)&bitstr_length, sizeof(bitstr_length));
     os.write((char*)temp_str.c_str(), temp_str.length());
@@ -102,63 +108,85 @@ public:
     }
   }
   void restore(std::istream& is)
+  {
+    std::string content{std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>()};
+    restore(content.data(), content.size());
+  }
+  // Restore from the content of a dump, for example a mmap()ed file
+  void restore(const char* data, size_t len)
   {
     uint8_t k, p;
     uint32_t num_cells, bitstr_len;
-    is.read((char*)&k, sizeof(k));
-    if (is.fail()) {
-      throw std::runtime_error("SBF: read failed (file too short?)");
-    }
-    is.read((char*)&num_cells, sizeof(num_cells));
-    if (is.fail()) {
-      throw std::runtime_error("SBF: read failed (file too short?)");
-    }
+    size_t pos = 0;
+    auto read = [data, len, &pos](void* dest, size_t size) {
+      if (len - pos < size) {
+        throw std::runtime_error("SBF: read failed (file too short?)");
+      }
+      memcpy(dest, data + pos, size);
+      pos += size;
+    };
+    read(&k, sizeof(k));
+    read(&num_cells, sizeof(num_cells));
     num_cells = ntohl(num_cells);
-    is.read((char*)&p, sizeof(p));
-    if (is.fail()) {
-      throw std::runtime_error("SBF: read failed (file too short?)");
-    }
-    is.read((char*)&bitstr_len, sizeof(bitstr_len));
-    if (is.fail()) {
-      throw std::runtime_error("SBF: read failed (file too short?)");
-    }
+    read(&p, sizeof(p));
+    read(&bitstr_len, sizeof(bitstr_len));
     bitstr_len = ntohl(bitstr_len);
     if (bitstr_len > 2 * 64 * 1024 * 1024U) { // twice the current size
       throw std::runtime_error("SBF: read failed (bitstr_len too big)");
     }
-    unique_ptr<char[]> bitcstr = make_unique<char[]>(bitstr_len);
-    is.read(bitcstr.get(), bitstr_len);
-    if (is.fail()) {
+    if (bitstr_len != num_cells || num_cells == 0) {
+      throw std::runtime_error("SBF: read failed (bitstr_len does not match the number of cells)");
+    }
+    if (len - pos < bitstr_len) {
       throw std::runtime_error("SBF: read failed (file too short?)");
     }
-    std::string bitstr(bitcstr.get(), bitstr_len);
-    stableBF tempbf(k, num_cells, p, bitstr);
-    swap(tempbf);
+    const char* bitstr = data + pos;
+    std::vector<std::atomic<uint64_t>> cells(numWords(num_cells));
+    for (uint32_t i = 0; i < num_cells; ++i) {
+      if (bitstr[num_cells - 1 - i] == '1') {
+        cells[i / 64].store(cells[i / 64].load(std::memory_order_relaxed) | (uint64_t(1) << (i % 64)), std::memory_order_relaxed);
+      }
+    }
+    d_k = k;
+    d_num_cells = num_cells;
+    d_p = p;
+    d_cells.swap(cells);
   }
 
 private:
+  static size_t numWords(uint32_t num_cells)
+  {
+    return (static_cast<size_t>(num_cells) + 63) / 64;
+  }
   unsigned int optimalK(float fp_rate)
   {
     return std::ceil(std::log2(1 / fp_rate));
   }
+  bool isSet(size_t cell) const
+  {
+    return d_cells[cell / 64].load(std::memory_order_relaxed) & (uint64_t(1) << (cell % 64));
+  }
+  void set(size_t cell)
+  {
+    d_cells[cell / 64].fetch_or(uint64_t(1) << (cell % 64), std::memory_order_relaxed);
+  }
+  void reset(size_t cell)
+  {
+    d_cells[cell / 64].fetch_and(~(uint64_t(1) << (cell % 64)), std::memory_order_relaxed);
+  }
   void decrement()
   {
     // Choose a random cell then decrement the next p-1
     // The stable bloom algorithm described in the paper says
     // to choose p independent positions, but that is much slower
     // and this shouldn't change the properties of the SBF
-    size_t r = d_dis(d_gen);
+    static thread_local std::mt19937 gen(std::random_device{}());
+    std::uniform_int_distribution<uint32_t> dis(0, d_num_cells);
+    size_t r = dis(gen);
     for (uint64_t i = 0; i < d_p; ++i) {
-      d_cells.reset((r + i) % d_num_cells);
+      reset((r + i) % d_num_cells);
     }
   }
-  void swap(stableBF& rhs)
-  {
-    std::swap(d_k, rhs.d_k);
-    std::swap(d_num_cells, rhs.d_num_cells);
-    std::swap(d_p, rhs.d_p);
-    d_cells.swap(rhs.d_cells);
-  }
   // This is a double hash implementation returning an array of
   // k hashes
   std::vector<uint32_t> hash(const std::string& data) const
@@ -175,8 +203,6 @@ private:
   uint8_t d_k;
   uint32_t d_num_cells;
   uint8_t d_p;
-  boost::dynamic_bitset<> d_cells;
-  std::mt19937 d_gen;
-  std::uniform_int_distribution<> d_dis;
+  std::vector<std::atomic<uint64_t>> d_cells;
 };
 }
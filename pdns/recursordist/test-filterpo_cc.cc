@@ -290,6 +290,186 @@ BOOST_AUTO_TEST_CASE(test_filter_policies_wildcard_with_enc)
   }
 }
 
+BOOST_AUTO_TEST_CASE(test_filter_policies_name_triggers_precedence)
+{
+  DNSFilterEngine dfe;
+
+  auto zone1 = std::make_shared<DNSFilterEngine::Zone>();
+  zone1->setName("Unit test policy 1");
+  auto zone2 = std::make_shared<DNSFilterEngine::Zone>();
+  zone2->setName("Unit test policy 2");
+
+  /* the first zone only has a wildcard, the second one has an exact match and a more specific wildcard */
+  zone1->addQNameTrigger(DNSName("*.example.net."), DNSFilterEngine::Policy(DNSFilterEngine::PolicyKind::Drop, DNSFilterEngine::PolicyType::QName));
+  zone1->addNSTrigger(DNSName("*.example.net."), DNSFilterEngine::Policy(DNSFilterEngine::PolicyKind::Drop, DNSFilterEngine::PolicyType::NSDName));
+  zone2->addQNameTrigger(DNSName("www.sub.example.net."), DNSFilterEngine::Policy(DNSFilterEngine::PolicyKind::NXDOMAIN, DNSFilterEngine::PolicyType::QName));
+  zone2->addQNameTrigger(DNSName("*.sub.example.net."), DNSFilterEngine::Policy(DNSFilterEngine::PolicyKind::NODATA, DNSFilterEngine::PolicyType::QName));
+  zone2->addQNameTrigger(DNSName("*.Example.COM."), DNSFilterEngine::Policy(DNSFilterEngine::PolicyKind::NODATA, DNSFilterEngine::PolicyType::QName));
+  zone2->addQNameTrigger(DNSName("*.www.example.com."), DNSFilterEngine::Policy(DNSFilterEngine::PolicyKind::Truncate, DNSFilterEngine::PolicyType::QName));
+  zone2->addQNameTrigger(DNSName("www.example.com."), DNSFilterEngine::Policy(DNSFilterEngine::PolicyKind::NXDOMAIN, DNSFilterEngine::PolicyType::QName));
+  BOOST_CHECK_EQUAL(zone1->size(), 2U);
+  BOOST_CHECK_EQUAL(zone2->size(), 5U);
+
+  dfe.addZone(zone1);
+  dfe.addZone(zone2);
+
+  {
+    /* the first zone wins, even though the second one has an exact match */
+    auto matchingPolicy = dfe.getQueryPolicy(DNSName("www.sub.example.net."), std::unordered_map<std::string, bool>(), DNSFilterEngine::maximumPriority);
+    BOOST_CHECK(matchingPolicy.d_type == DNSFilterEngine::PolicyType::QName);
+    BOOST_CHECK(matchingPolicy.d_kind == DNSFilterEngine::PolicyKind::Drop);
+    BOOST_CHECK_EQUAL(matchingPolicy.getName(), "Unit test policy 1");
+    BOOST_CHECK_EQUAL(matchingPolicy.d_trigger, DNSName("*.example.net."));
+    BOOST_CHECK_EQUAL(matchingPolicy.d_hit, "www.sub.example.net");
+  }
+
+  {
+    /* unless it has been disabled */
+    std::unordered_map<std::string, bool> discarded = {{"Unit test policy 1", true}};
+    auto matchingPolicy = dfe.getQueryPolicy(DNSName("www.sub.example.net."), discarded, DNSFilterEngine::maximumPriority);
+    BOOST_CHECK(matchingPolicy.d_kind == DNSFilterEngine::PolicyKind::NXDOMAIN);
+    BOOST_CHECK_EQUAL(matchingPolicy.d_trigger, DNSName("www.sub.example.net."));
+
+    matchingPolicy = dfe.getQueryPolicy(DNSName("other.sub.example.net."), discarded, DNSFilterEngine::maximumPriority);
+    BOOST_CHECK(matchingPolicy.d_kind == DNSFilterEngine::PolicyKind::NODATA);
+    BOOST_CHECK_EQUAL(matchingPolicy.d_trigger, DNSName("*.sub.example.net."));
+
+    /* a wildcard does not match its own apex */
+    matchingPolicy = dfe.getQueryPolicy(DNSName("sub.example.net."), discarded, DNSFilterEngine::maximumPriority);
+    BOOST_CHECK(matchingPolicy.d_type == DNSFilterEngine::PolicyType::None);
+  }
+
+  {
+    /* within a zone, the exact match wins, then the most specific wildcard, regardless of the case */
+    auto matchingPolicy = dfe.getQueryPolicy(DNSName("WWW.example.com."), std::unordered_map<std::string, bool>(), DNSFilterEngine::maximumPriority);
+    BOOST_CHECK(matchingPolicy.d_kind == DNSFilterEngine::PolicyKind::NXDOMAIN);
+    BOOST_CHECK_EQUAL(matchingPolicy.getName(), "Unit test policy 2");
+
+    matchingPolicy = dfe.getQueryPolicy(DNSName("a.b.www.example.com."), std::unordered_map<std::string, bool>(), DNSFilterEngine::maximumPriority);
+    BOOST_CHECK(matchingPolicy.d_kind == DNSFilterEngine::PolicyKind::Truncate);
+    BOOST_CHECK_EQUAL(matchingPolicy.d_trigger, DNSName("*.www.example.com."));
+
+    matchingPolicy = dfe.getQueryPolicy(DNSName("mail.example.com."), std::unordered_map<std::string, bool>(), DNSFilterEngine::maximumPriority);
+    BOOST_CHECK(matchingPolicy.d_kind == DNSFilterEngine::PolicyKind::NODATA);
+  }
+
+  {
+    /* NSDNAME triggers */
+    auto matchingPolicy = dfe.getProcessingPolicy(DNSName("ns1.example.net."), std::unordered_map<std::string, bool>(), DNSFilterEngine::maximumPriority);
+    BOOST_CHECK(matchingPolicy.d_type == DNSFilterEngine::PolicyType::NSDName);
+    BOOST_CHECK_EQUAL(matchingPolicy.d_trigger, DNSName("*.example.net.rpz-nsdname."));
+    matchingPolicy = dfe.getProcessingPolicy(DNSName("ns1.example.com."), std::unordered_map<std::string, bool>(), DNSFilterEngine::maximumPriority);
+    BOOST_CHECK(matchingPolicy.d_type == DNSFilterEngine::PolicyType::None);
+  }
+
+  /* removing triggers, as an IXFR would */
+  BOOST_CHECK(zone2->rmQNameTrigger(DNSName("*.www.example.com."), DNSFilterEngine::Policy(DNSFilterEngine::PolicyKind::Truncate, DNSFilterEngine::PolicyType::QName)));
+  BOOST_CHECK(!zone2->rmQNameTrigger(DNSName("*.www.example.com."), DNSFilterEngine::Policy(DNSFilterEngine::PolicyKind::Truncate, DNSFilterEngine::PolicyType::QName)));
+  BOOST_CHECK_EQUAL(zone2->size(), 4U);
+  {
+    auto matchingPolicy = dfe.getQueryPolicy(DNSName("a.b.www.example.com."), std::unordered_map<std::string, bool>(), DNSFilterEngine::maximumPriority);
+    BOOST_CHECK(matchingPolicy.d_kind == DNSFilterEngine::PolicyKind::NODATA);
+    BOOST_CHECK_EQUAL(matchingPolicy.d_trigger, DNSName("*.Example.COM."));
+  }
+
+  BOOST_CHECK(zone2->rmQNameTrigger(DNSName("www.example.com."), DNSFilterEngine::Policy(DNSFilterEngine::PolicyKind::NXDOMAIN, DNSFilterEngine::PolicyType::QName)));
+  BOOST_CHECK(zone2->rmQNameTrigger(DNSName("*.example.com."), DNSFilterEngine::Policy(DNSFilterEngine::PolicyKind::NODATA, DNSFilterEngine::PolicyType::QName)));
+  BOOST_CHECK_EQUAL(zone2->size(), 2U);
+  {
+    auto matchingPolicy = dfe.getQueryPolicy(DNSName("www.example.com."), std::unordered_map<std::string, bool>(), DNSFilterEngine::maximumPriority);
+    BOOST_CHECK(matchingPolicy.d_type == DNSFilterEngine::PolicyType::None);
+  }
+}
+
+/* the owner names of the records of a dumped zone */
+static std::set<DNSName> getDumpedNames(const DNSFilterEngine::Zone& zone)
+{
+  auto fp = std::unique_ptr<FILE, int (*)(FILE*)>(tmpfile(), fclose);
+  if (!fp) {
+    BOOST_FAIL("Temporary file could not be opened");
+  }
+
+  zone.dump(fp.get());
+  rewind(fp.get());
+
+  std::set<DNSName> names;
+  char* line = nullptr;
+  size_t len = 0;
+  while (getline(&line, &len, fp.get()) != -1) {
+    const std::string str(line);
+    names.insert(DNSName(str.substr(0, str.find(' '))));
+  }
+  free(line);
+  return names;
+}
+
+BOOST_AUTO_TEST_CASE(test_filter_policies_zone_copy)
+{
+  /* the copy of a zone made to apply an IXFR shares its data with the original one,
+     make sure that updating the copy does not affect the original */
+  auto zone = std::make_shared<DNSFilterEngine::Zone>();
+  zone->setName("Unit test policy copy");
+  for (size_t idx = 0; idx < 2000; ++idx) {
+    zone->addQNameTrigger(DNSName("name" + std::to_string(idx) + ".example.net."), DNSFilterEngine::Policy(DNSFilterEngine::PolicyKind::Drop, DNSFilterEngine::PolicyType::QName));
+  }
+  zone->addClientTrigger(Netmask("192.0.2.0/24"), DNSFilterEngine::Policy(DNSFilterEngine::PolicyKind::Drop, DNSFilterEngine::PolicyType::ClientIP));
+  BOOST_CHECK_EQUAL(zone->size(), 2001U);
+
+  auto copy = std::make_shared<DNSFilterEngine::Zone>(*zone);
+  BOOST_CHECK(copy->rmQNameTrigger(DNSName("name0.example.net."), DNSFilterEngine::Policy(DNSFilterEngine::PolicyKind::Drop, DNSFilterEngine::PolicyType::QName)));
+  copy->addQNameTrigger(DNSName("*.example.org."), DNSFilterEngine::Policy(DNSFilterEngine::PolicyKind::NXDOMAIN, DNSFilterEngine::PolicyType::QName));
+  BOOST_CHECK(copy->rmClientTrigger(Netmask("192.0.2.0/24"), DNSFilterEngine::Policy(DNSFilterEngine::PolicyKind::Drop, DNSFilterEngine::PolicyType::ClientIP)));
+  BOOST_CHECK_EQUAL(copy->size(), 2000U);
+  BOOST_CHECK_EQUAL(zone->size(), 2001U);
+
+  DNSFilterEngine::Policy zonePolicy;
+  BOOST_CHECK(zone->findExactQNamePolicy(DNSName("name0.example.net."), zonePolicy));
+  BOOST_CHECK(!copy->findExactQNamePolicy(DNSName("name0.example.net."), zonePolicy));
+  BOOST_CHECK(copy->findExactQNamePolicy(DNSName("*.example.org."), zonePolicy));
+  BOOST_CHECK(zonePolicy.d_kind == DNSFilterEngine::PolicyKind::NXDOMAIN);
+  BOOST_CHECK(zonePolicy.d_type == DNSFilterEngine::PolicyType::QName);
+  BOOST_CHECK_EQUAL(zonePolicy.getName(), "Unit test policy copy");
+  BOOST_CHECK(!zone->findExactQNamePolicy(DNSName("*.example.org."), zonePolicy));
+  BOOST_CHECK(zone->findClientPolicy(ComboAddress("192.0.2.1"), zonePolicy));
+  BOOST_CHECK(!copy->findClientPolicy(ComboAddress("192.0.2.1"), zonePolicy));
+
+  /* the trigger names are rebuilt from both layers of the trie, the removed ones hidden */
+  copy->setDomain(DNSName("rpz."));
+  auto names = getDumpedNames(*copy);
+  BOOST_CHECK_EQUAL(names.size(), 2001U);
+  BOOST_CHECK_EQUAL(names.count(DNSName("rpz.")), 1U);
+  BOOST_CHECK_EQUAL(names.count(DNSName("name1.example.net.rpz.")), 1U);
+  BOOST_CHECK_EQUAL(names.count(DNSName("*.example.org.rpz.")), 1U);
+  BOOST_CHECK_EQUAL(names.count(DNSName("name0.example.net.rpz.")), 0U);
+
+  /* enough removals to merge the pending updates of the copy */
+  for (size_t idx = 1; idx < 1500; ++idx) {
+    BOOST_CHECK(copy->rmQNameTrigger(DNSName("name" + std::to_string(idx) + ".example.net."), DNSFilterEngine::Policy(DNSFilterEngine::PolicyKind::Drop, DNSFilterEngine::PolicyType::QName)));
+  }
+  BOOST_CHECK_EQUAL(copy->size(), 501U);
+  BOOST_CHECK_EQUAL(zone->size(), 2001U);
+  names = getDumpedNames(*copy);
+  BOOST_CHECK_EQUAL(names.size(), 502U);
+  BOOST_CHECK_EQUAL(names.count(DNSName("name1499.example.net.rpz.")), 0U);
+  BOOST_CHECK_EQUAL(names.count(DNSName("name1500.example.net.rpz.")), 1U);
+  BOOST_CHECK_EQUAL(names.count(DNSName("*.example.org.rpz.")), 1U);
+
+  DNSFilterEngine dfe;
+  dfe.addZone(copy);
+  auto matchingPolicy = dfe.getQueryPolicy(DNSName("name1499.example.net."), std::unordered_map<std::string, bool>(), DNSFilterEngine::maximumPriority);
+  BOOST_CHECK(matchingPolicy.d_type == DNSFilterEngine::PolicyType::None);
+  matchingPolicy = dfe.getQueryPolicy(DNSName("name1500.example.net."), std::unordered_map<std::string, bool>(), DNSFilterEngine::maximumPriority);
+  BOOST_CHECK(matchingPolicy.d_kind == DNSFilterEngine::PolicyKind::Drop);
+  matchingPolicy = dfe.getQueryPolicy(DNSName("www.example.org."), std::unordered_map<std::string, bool>(), DNSFilterEngine::maximumPriority);
+  BOOST_CHECK(matchingPolicy.d_kind == DNSFilterEngine::PolicyKind::NXDOMAIN);
+
+  dfe.setZone(0, zone);
+  matchingPolicy = dfe.getQueryPolicy(DNSName("name1499.example.net."), std::unordered_map<std::string, bool>(), DNSFilterEngine::maximumPriority);
+  BOOST_CHECK(matchingPolicy.d_kind == DNSFilterEngine::PolicyKind::Drop);
+  matchingPolicy = dfe.getQueryPolicy(DNSName("www.example.org."), std::unordered_map<std::string, bool>(), DNSFilterEngine::maximumPriority);
+  BOOST_CHECK(matchingPolicy.d_type == DNSFilterEngine::PolicyType::None);
+}
+
 BOOST_AUTO_TEST_CASE(test_filter_policies_local_data)
 {
   DNSFilterEngine dfe;
@@ -40,6 +40,40 @@ BOOST_AUTO_TEST_CASE(test_Simple)
   BOOST_CHECK_EQUAL(g_result, o);
 }
 
+static void doNothing(void* p)
+{
+}
+
+BOOST_AUTO_TEST_CASE(test_StackPool)
+{
+  MTasker<> mt(16 * 8192, 1);
+  struct timeval now;
+  gettimeofday(&now, 0);
+
+  for (size_t idx = 0; idx < 3; ++idx) {
+    mt.makeThread(doNothing, &mt);
+    while (mt.schedule(&now))
+      ;
+    BOOST_CHECK(mt.noProcesses());
+  }
+  BOOST_CHECK_EQUAL(mt.getStackPoolMisses(), 1U);
+  BOOST_CHECK_EQUAL(mt.getStackPoolHits(), 2U);
+
+  /* two threads at the same time, only one stack available */
+  mt.makeThread(doNothing, &mt);
+  mt.makeThread(doNothing, &mt);
+  while (mt.schedule(&now))
+    ;
+  BOOST_CHECK(mt.noProcesses());
+  BOOST_CHECK_EQUAL(mt.getStackPoolMisses(), 2U);
+  BOOST_CHECK_EQUAL(mt.getStackPoolHits(), 3U);
+
+#ifdef __linux__
+  BOOST_CHECK_GT(mt.getStackHighWaterMark(), 0U);
+  BOOST_CHECK_LE(mt.getStackHighWaterMark(), 16U * 8192U);
+#endif
+}
+
 static void willThrow(void* p)
 {
   throw std::runtime_error("Help!");
@@ -60,4 +60,39 @@ BOOST_AUTO_TEST_CASE(test_basic)
   }
 }
 
+BOOST_AUTO_TEST_CASE(test_shared)
+{
+  NODDB noddb;
+  BOOST_CHECK_EQUAL(noddb.init(), true);
+
+  // a single instance is used by several threads, every domain should be new for one of them only
+  const size_t numThreads = 4;
+  const size_t numDomains = 10000;
+  std::atomic<size_t> newDomains{0};
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < numThreads; ++t) {
+    threads.emplace_back([&noddb, &newDomains, numDomains]() {
+      for (size_t i = 0; i < numDomains; ++i) {
+        if (noddb.isNewDomain(DNSName("domain" + std::to_string(i) + ".com."))) {
+          ++newDomains;
+        }
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+
+  // the filter is probabilistic and the stable part randomly forgets cells, so allow for a few errors
+  BOOST_CHECK_GE(newDomains.load(), numDomains * 99 / 100);
+  BOOST_CHECK_LE(newDomains.load(), numDomains * 105 / 100);
+  size_t known = 0;
+  for (size_t i = 0; i < numDomains; ++i) {
+    if (!noddb.isNewDomain(DNSName("domain" + std::to_string(i) + ".com."))) {
+      ++known;
+    }
+  }
+  BOOST_CHECK_GE(known, numDomains * 95 / 100);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
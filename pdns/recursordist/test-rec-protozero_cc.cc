@@ -0,0 +1,129 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_NO_MAIN
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <boost/test/unit_test.hpp>
+#include <protozero/pbf_reader.hpp>
+
+#include "rec-protozero.hh"
+
+using Field = pdns::ProtoZero::Message::Field;
+using ResponseField = pdns::ProtoZero::Message::ResponseField;
+
+BOOST_AUTO_TEST_SUITE(test_rec_protozero_cc)
+
+/* decodes the policy tags of a message, checking that they are in a single response part */
+static std::set<std::string> getPolicyTags(const std::string& msg)
+{
+  std::set<std::string> tags;
+  size_t responses = 0;
+  protozero::pbf_reader message{msg};
+  while (message.next()) {
+    /* field 4 at the top level is the socket family, not the tags */
+    BOOST_CHECK(message.tag() != static_cast<protozero::pbf_tag_type>(Field::socketFamily));
+    if (message.tag() != static_cast<protozero::pbf_tag_type>(Field::response)) {
+      message.skip();
+      continue;
+    }
+
+    ++responses;
+    protozero::pbf_reader response = message.get_message();
+    while (response.next()) {
+      if (response.tag() == static_cast<protozero::pbf_tag_type>(ResponseField::tags)) {
+        tags.insert(response.get_string());
+      }
+      else {
+        response.skip();
+      }
+    }
+  }
+
+  BOOST_CHECK_EQUAL(responses, tags.empty() ? 0U : 1U);
+  return tags;
+}
+
+BOOST_AUTO_TEST_CASE(test_policy_tags_in_response)
+{
+  /* built like the outgoing query messages of protobufLogQuery() */
+  std::string msgbuf;
+  std::string rspbuf;
+  {
+    pdns::ProtoZero::RecMessage m{msgbuf, rspbuf};
+    m.reserve(128, 64);
+    m.setType(pdns::ProtoZero::Message::MessageType::DNSQueryType);
+    m.setServerIdentity("server");
+    m.addPolicyTags({"tag1", "tag2"});
+    m.finish();
+  }
+
+  const auto tags = getPolicyTags(msgbuf);
+  BOOST_CHECK_EQUAL(tags.size(), 2U);
+  BOOST_CHECK(tags.count("tag1") == 1);
+  BOOST_CHECK(tags.count("tag2") == 1);
+
+  /* the same through the buffers owned by the message */
+  std::string msg;
+  {
+    pdns::ProtoZero::RecMessage m{"", "", 128, 64};
+    m.setType(pdns::ProtoZero::Message::MessageType::DNSQueryType);
+    m.addPolicyTags({"tag1", "tag2"});
+    msg = m.finishAndMoveBuf();
+  }
+  BOOST_CHECK(getPolicyTags(msg) == tags);
+}
+
+BOOST_AUTO_TEST_CASE(test_reused_buffers)
+{
+  std::string msgbuf;
+  std::string rspbuf;
+  {
+    pdns::ProtoZero::RecMessage m{msgbuf, rspbuf};
+    m.reserve(128, 64);
+    m.setType(pdns::ProtoZero::Message::MessageType::DNSQueryType);
+    m.setServerIdentity(std::string(1000, 'a'));
+    m.addPolicyTags({"tag1"});
+    m.finish();
+  }
+  BOOST_CHECK_GT(msgbuf.size(), 1000U);
+  const auto capacity = msgbuf.capacity();
+  const auto rspCapacity = rspbuf.capacity();
+
+  /* the buffers are emptied, but they keep their capacity */
+  {
+    pdns::ProtoZero::RecMessage m{msgbuf, rspbuf};
+    m.reserve(128, 64);
+    m.setType(pdns::ProtoZero::Message::MessageType::DNSQueryType);
+    m.addPolicyTags({"tag2"});
+    m.finish();
+  }
+  BOOST_CHECK_LT(msgbuf.size(), 100U);
+  BOOST_CHECK_EQUAL(msgbuf.capacity(), capacity);
+  BOOST_CHECK_EQUAL(rspbuf.capacity(), rspCapacity);
+
+  const auto tags = getPolicyTags(msgbuf);
+  BOOST_CHECK_EQUAL(tags.size(), 1U);
+  BOOST_CHECK(tags.count("tag2") == 1);
+}
+
+BOOST_AUTO_TEST_CASE(test_no_response_without_tags)
+{
+  std::string msgbuf;
+  std::string rspbuf;
+  {
+    pdns::ProtoZero::RecMessage m{msgbuf, rspbuf};
+    m.reserve(128, 0);
+    m.setType(pdns::ProtoZero::Message::MessageType::DNSQueryType);
+    m.finish();
+  }
+
+  protozero::pbf_reader message{msgbuf};
+  while (message.next()) {
+    BOOST_CHECK(message.tag() != static_cast<protozero::pbf_tag_type>(Field::response));
+    message.skip();
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,282 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_NO_MAIN
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <boost/test/unit_test.hpp>
+
+#include "misc.hh"
+#include "rec-tcpout.hh"
+
+/* Saves and restores the limits of the connection manager, and closes the remote
+   end of every connection created during a test */
+struct TCPOutFixture
+{
+  TCPOutFixture() :
+    d_maxIdleTime(TCPOutConnectionManager::s_maxIdleTime),
+    d_maxIdlePerAuth(TCPOutConnectionManager::s_maxIdlePerAuth),
+    d_maxQueries(TCPOutConnectionManager::s_maxQueries),
+    d_maxIdlePerThread(TCPOutConnectionManager::s_maxIdlePerThread)
+  {
+    TCPOutConnectionManager::s_maxIdleTime = {10, 0};
+    TCPOutConnectionManager::s_maxIdlePerAuth = 10;
+    TCPOutConnectionManager::s_maxQueries = 0;
+    TCPOutConnectionManager::s_maxIdlePerThread = 100;
+  }
+
+  ~TCPOutFixture()
+  {
+    TCPOutConnectionManager::s_maxIdleTime = d_maxIdleTime;
+    TCPOutConnectionManager::s_maxIdlePerAuth = d_maxIdlePerAuth;
+    TCPOutConnectionManager::s_maxQueries = d_maxQueries;
+    TCPOutConnectionManager::s_maxIdlePerThread = d_maxIdlePerThread;
+
+    for (const auto fd : d_remotes) {
+      close(fd);
+    }
+  }
+
+  /* a connected, non-blocking connection whose remote end is kept open (or not) by the test */
+  TCPOutConnectionManager::Connection newConnection(size_t numqueries = 0)
+  {
+    int sockets[2];
+    int res = socketpair(AF_UNIX, SOCK_STREAM, 0, sockets);
+    BOOST_REQUIRE_EQUAL(res, 0);
+    BOOST_REQUIRE_EQUAL(setNonBlocking(sockets[0]), true);
+    BOOST_REQUIRE_EQUAL(setNonBlocking(sockets[1]), true);
+    d_remotes.push_back(sockets[1]);
+
+    TCPOutConnectionManager::Connection connection;
+    connection.d_handler = std::make_shared<TCPIOHandler>("", sockets[0], timeval{1, 0}, nullptr, time(nullptr));
+    connection.d_numqueries = numqueries;
+    return connection;
+  }
+
+  void closeRemote(size_t idx)
+  {
+    close(d_remotes.at(idx));
+    d_remotes.erase(d_remotes.begin() + idx);
+  }
+
+  std::vector<int> d_remotes;
+
+private:
+  struct timeval d_maxIdleTime;
+  size_t d_maxIdlePerAuth;
+  size_t d_maxQueries;
+  size_t d_maxIdlePerThread;
+};
+
+static bool isClosed(const std::shared_ptr<TCPIOHandler>& handler)
+{
+  return handler->getDescriptor() == -1;
+}
+
+BOOST_FIXTURE_TEST_SUITE(test_rec_tcpout_cc, TCPOutFixture)
+
+BOOST_AUTO_TEST_CASE(test_store_get)
+{
+  TCPOutConnectionManager manager;
+  const ComboAddress auth1("192.0.2.1:53");
+  const ComboAddress auth1dot("192.0.2.1:853");
+  const ComboAddress auth2("192.0.2.2:53");
+  const struct timeval now = {1000, 0};
+
+  BOOST_CHECK(manager.get(auth1).d_handler == nullptr);
+
+  auto first = newConnection(1);
+  auto firstHandler = first.d_handler;
+  manager.store(now, auth1, std::move(first));
+  auto second = newConnection(2);
+  auto secondHandler = second.d_handler;
+  manager.store(now, auth1, std::move(second));
+  BOOST_CHECK_EQUAL(manager.size(), 2U);
+
+  /* the port is part of the key */
+  BOOST_CHECK(manager.get(auth1dot).d_handler == nullptr);
+  BOOST_CHECK(manager.get(auth2).d_handler == nullptr);
+  BOOST_CHECK_EQUAL(manager.size(), 2U);
+
+  /* most recently stored first, and the number of queries is kept */
+  auto got = manager.get(auth1);
+  BOOST_CHECK(got.d_handler == secondHandler);
+  BOOST_CHECK_EQUAL(got.d_numqueries, 2U);
+  BOOST_CHECK(!isClosed(got.d_handler));
+  BOOST_CHECK_EQUAL(manager.size(), 1U);
+
+  got = manager.get(auth1);
+  BOOST_CHECK(got.d_handler == firstHandler);
+  BOOST_CHECK_EQUAL(got.d_numqueries, 1U);
+  BOOST_CHECK_EQUAL(manager.size(), 0U);
+
+  BOOST_CHECK(manager.get(auth1).d_handler == nullptr);
+}
+
+BOOST_AUTO_TEST_CASE(test_get_skips_closed)
+{
+  TCPOutConnectionManager manager;
+  const ComboAddress auth1("192.0.2.1:53");
+  const struct timeval now = {1000, 0};
+
+  auto first = newConnection();
+  auto firstHandler = first.d_handler;
+  manager.store(now, auth1, std::move(first));
+  auto second = newConnection();
+  auto secondHandler = second.d_handler;
+  manager.store(now, auth1, std::move(second));
+
+  /* the remote end of the most recent one went away */
+  closeRemote(1);
+
+  auto got = manager.get(auth1);
+  BOOST_CHECK(got.d_handler == firstHandler);
+  BOOST_CHECK(isClosed(secondHandler));
+  BOOST_CHECK_EQUAL(manager.size(), 0U);
+
+  /* and if none is usable, there is nothing to get */
+  manager.store(now, auth1, std::move(got));
+  closeRemote(0);
+  BOOST_CHECK(manager.get(auth1).d_handler == nullptr);
+  BOOST_CHECK(isClosed(firstHandler));
+  BOOST_CHECK_EQUAL(manager.size(), 0U);
+}
+
+BOOST_AUTO_TEST_CASE(test_reuse_disabled)
+{
+  TCPOutConnectionManager manager;
+  const ComboAddress auth1("192.0.2.1:53");
+  const struct timeval now = {1000, 0};
+
+  TCPOutConnectionManager::s_maxIdlePerAuth = 0;
+
+  auto connection = newConnection();
+  auto handler = connection.d_handler;
+  manager.store(now, auth1, std::move(connection));
+  BOOST_CHECK_EQUAL(manager.size(), 0U);
+  BOOST_CHECK(isClosed(handler));
+  BOOST_CHECK(manager.get(auth1).d_handler == nullptr);
+
+  /* an empty connection is ignored */
+  manager.store(now, auth1, TCPOutConnectionManager::Connection{});
+  BOOST_CHECK_EQUAL(manager.size(), 0U);
+}
+
+BOOST_AUTO_TEST_CASE(test_max_idle_per_auth)
+{
+  TCPOutConnectionManager manager;
+  const ComboAddress auth1("192.0.2.1:53");
+  const ComboAddress auth2("192.0.2.2:53");
+  const struct timeval now = {1000, 0};
+
+  TCPOutConnectionManager::s_maxIdlePerAuth = 2;
+
+  std::vector<std::shared_ptr<TCPIOHandler>> handlers;
+  for (size_t idx = 0; idx < 3; idx++) {
+    auto connection = newConnection();
+    handlers.push_back(connection.d_handler);
+    manager.store(now, auth1, std::move(connection));
+  }
+  BOOST_CHECK_EQUAL(manager.size(), 2U);
+  BOOST_CHECK(!isClosed(handlers.at(0)));
+  BOOST_CHECK(!isClosed(handlers.at(1)));
+  BOOST_CHECK(isClosed(handlers.at(2)));
+
+  /* the limit is per remote */
+  auto connection = newConnection();
+  auto handler = connection.d_handler;
+  manager.store(now, auth2, std::move(connection));
+  BOOST_CHECK_EQUAL(manager.size(), 3U);
+  BOOST_CHECK(!isClosed(handler));
+}
+
+BOOST_AUTO_TEST_CASE(test_max_idle_per_thread)
+{
+  TCPOutConnectionManager manager;
+  const struct timeval now = {1000, 0};
+
+  TCPOutConnectionManager::s_maxIdlePerThread = 3;
+
+  std::vector<std::shared_ptr<TCPIOHandler>> handlers;
+  for (size_t idx = 0; idx < 4; idx++) {
+    auto connection = newConnection();
+    handlers.push_back(connection.d_handler);
+    manager.store(now, ComboAddress("192.0.2." + std::to_string(idx + 1) + ":53"), std::move(connection));
+  }
+  BOOST_CHECK_EQUAL(manager.size(), 3U);
+  for (size_t idx = 0; idx < 3; idx++) {
+    BOOST_CHECK(!isClosed(handlers.at(idx)));
+  }
+  BOOST_CHECK(isClosed(handlers.at(3)));
+  BOOST_CHECK(manager.get(ComboAddress("192.0.2.4:53")).d_handler == nullptr);
+
+  /* 0 is no limit */
+  TCPOutConnectionManager::s_maxIdlePerThread = 0;
+  auto connection = newConnection();
+  manager.store(now, ComboAddress("192.0.2.4:53"), std::move(connection));
+  BOOST_CHECK_EQUAL(manager.size(), 4U);
+}
+
+BOOST_AUTO_TEST_CASE(test_max_queries)
+{
+  TCPOutConnectionManager manager;
+  const ComboAddress auth1("192.0.2.1:53");
+  const struct timeval now = {1000, 0};
+
+  TCPOutConnectionManager::s_maxQueries = 3;
+
+  auto connection = newConnection(2);
+  auto handler = connection.d_handler;
+  manager.store(now, auth1, std::move(connection));
+  BOOST_CHECK_EQUAL(manager.size(), 1U);
+
+  /* one more query over it, and it has reached the limit */
+  auto got = manager.get(auth1);
+  BOOST_REQUIRE(got.d_handler == handler);
+  ++got.d_numqueries;
+  manager.store(now, auth1, std::move(got));
+  BOOST_CHECK_EQUAL(manager.size(), 0U);
+  BOOST_CHECK(isClosed(handler));
+  BOOST_CHECK(manager.get(auth1).d_handler == nullptr);
+
+  /* 0 is no limit */
+  TCPOutConnectionManager::s_maxQueries = 0;
+  connection = newConnection(1000);
+  handler = connection.d_handler;
+  manager.store(now, auth1, std::move(connection));
+  BOOST_CHECK(manager.get(auth1).d_handler == handler);
+}
+
+BOOST_AUTO_TEST_CASE(test_cleanup)
+{
+  TCPOutConnectionManager manager;
+  const ComboAddress auth1("192.0.2.1:53");
+  const ComboAddress auth2("192.0.2.2:53");
+
+  auto old = newConnection();
+  auto oldHandler = old.d_handler;
+  manager.store({1000, 0}, auth1, std::move(old));
+  auto recent = newConnection();
+  auto recentHandler = recent.d_handler;
+  manager.store({1005, 0}, auth2, std::move(recent));
+  BOOST_CHECK_EQUAL(manager.size(), 2U);
+
+  /* nothing has been idle for more than 10s yet */
+  manager.cleanup({1010, 0});
+  BOOST_CHECK_EQUAL(manager.size(), 2U);
+
+  manager.cleanup({1012, 0});
+  BOOST_CHECK_EQUAL(manager.size(), 1U);
+  BOOST_CHECK(isClosed(oldHandler));
+  BOOST_CHECK(!isClosed(recentHandler));
+  BOOST_CHECK(manager.get(auth1).d_handler == nullptr);
+
+  /* 0 is no timeout */
+  TCPOutConnectionManager::s_maxIdleTime = {0, 0};
+  manager.cleanup({100000, 0});
+  BOOST_CHECK_EQUAL(manager.size(), 1U);
+  BOOST_CHECK(manager.get(auth2).d_handler == recentHandler);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
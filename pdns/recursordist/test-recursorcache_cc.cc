@@ -1177,4 +1177,124 @@ BOOST_AUTO_TEST_CASE(test_RecursorCacheTagged)
   }
 }
 
+static std::vector<DNSRecord> makeARecordSet(const DNSName& name, const std::string& address, time_t ttd)
+{
+  DNSRecord dr;
+  dr.d_name = name;
+  dr.d_type = QType::A;
+  dr.d_class = QClass::IN;
+  dr.d_content = std::make_shared<ARecordContent>(ComboAddress(address));
+  dr.d_ttl = static_cast<uint32_t>(ttd);
+  dr.d_place = DNSResourceRecord::ANSWER;
+  return {dr};
+}
+
+BOOST_AUTO_TEST_CASE(test_RecursorCachePrefetch)
+{
+  MemRecursorCache MRC(1);
+
+  std::vector<DNSRecord> retrieved;
+  std::vector<std::shared_ptr<DNSRecord>> authRecords;
+  std::vector<std::shared_ptr<RRSIGRecordContent>> signatures;
+  const DNSName authZone(".");
+  const ComboAddress who("192.0.2.1");
+  const DNSName hot("hot.powerdns.com."), warm("warm.powerdns.com."), cold("cold.powerdns.com."), later("later.powerdns.com.");
+
+  time_t now = time(nullptr);
+  time_t ttd = now + 5;
+  MRC.replace(now, hot, QType(QType::A), makeARecordSet(hot, "192.0.2.1", ttd), signatures, authRecords, true, authZone, boost::none);
+  MRC.replace(now, warm, QType(QType::A), makeARecordSet(warm, "192.0.2.2", ttd), signatures, authRecords, true, authZone, boost::none);
+  MRC.replace(now, cold, QType(QType::A), makeARecordSet(cold, "192.0.2.3", ttd), signatures, authRecords, true, authZone, boost::none);
+  MRC.replace(now, later, QType(QType::A), makeARecordSet(later, "192.0.2.4", now + 3600), signatures, authRecords, true, authZone, boost::none);
+  BOOST_CHECK_EQUAL(MRC.size(), 4U);
+
+  for (size_t idx = 0; idx < 5; idx++) {
+    BOOST_CHECK_GT(MRC.get(now, hot, QType(QType::A), false, &retrieved, who), 0);
+    BOOST_CHECK_GT(MRC.get(now, later, QType(QType::A), false, &retrieved, who), 0);
+  }
+  for (size_t idx = 0; idx < 3; idx++) {
+    BOOST_CHECK_GT(MRC.get(now, warm, QType(QType::A), false, &retrieved, who), 0);
+  }
+  BOOST_CHECK_GT(MRC.get(now, cold, QType(QType::A), false, &retrieved, who), 0);
+
+  // disabled
+  BOOST_CHECK_EQUAL(MRC.doPrefetch(now, 10, 0), 0U);
+
+  // only the most popular of the entries about to expire fits in the budget
+  BOOST_CHECK_EQUAL(MRC.doPrefetch(now, 10, 1), 1U);
+  BOOST_CHECK_EQUAL(MRC.prefetchesQueued, 1U);
+  // while refreshing, the queued entry is a miss
+  BOOST_CHECK_LT(MRC.get(now, hot, QType(QType::A), false, &retrieved, who, MemRecursorCache::Refresh), 0);
+  BOOST_CHECK_GT(MRC.get(now, warm, QType(QType::A), false, &retrieved, who, MemRecursorCache::Refresh), 0);
+
+  // hits have been halved, warm is down to 2 (1 + the refresh lookup), cold to 0, and hot is already queued
+  BOOST_CHECK_EQUAL(MRC.doPrefetch(now, 10, 10), 1U);
+  BOOST_CHECK_EQUAL(MRC.doPrefetch(now, 10, 10), 0U);
+  BOOST_CHECK_EQUAL(MRC.prefetchesQueued, 2U);
+
+  // the refresh of hot comes in before it expires, warm is not refreshed in time
+  MRC.replace(now + 1, hot, QType(QType::A), makeARecordSet(hot, "192.0.2.1", now + 3600), signatures, authRecords, true, authZone, boost::none);
+  MRC.replace(now + 6, warm, QType(QType::A), makeARecordSet(warm, "192.0.2.2", now + 3600), signatures, authRecords, true, authZone, boost::none);
+
+  BOOST_CHECK_GT(MRC.get(now + 1, hot, QType(QType::A), false, &retrieved, who), 0);
+  BOOST_CHECK_EQUAL(MRC.prefetchHits, 0U);
+  BOOST_CHECK_GT(MRC.get(now + 6, hot, QType(QType::A), false, &retrieved, who), 0);
+  BOOST_CHECK_GT(MRC.get(now + 6, warm, QType(QType::A), false, &retrieved, who), 0);
+  BOOST_CHECK_GT(MRC.get(now + 6, later, QType(QType::A), false, &retrieved, who), 0);
+  BOOST_CHECK_EQUAL(MRC.prefetchHits, 1U);
+
+  // the prefetch only avoided one miss, the next hits on the refreshed entry do not count
+  BOOST_CHECK_GT(MRC.get(now + 6, hot, QType(QType::A), false, &retrieved, who), 0);
+  BOOST_CHECK_GT(MRC.get(now + 7, hot, QType(QType::A), false, &retrieved, who), 0);
+  BOOST_CHECK_EQUAL(MRC.prefetchHits, 1U);
+}
+
+BOOST_AUTO_TEST_CASE(test_RecursorCacheServeStale)
+{
+  MemRecursorCache MRC;
+
+  std::vector<DNSRecord> retrieved;
+  std::vector<std::shared_ptr<DNSRecord>> authRecords;
+  std::vector<std::shared_ptr<RRSIGRecordContent>> signatures;
+  const DNSName authZone(".");
+  const ComboAddress who("192.0.2.1");
+  const DNSName power("powerdns.com.");
+
+  const auto oldMaxServedStaleExtensions = MemRecursorCache::s_maxServedStaleExtensions;
+  MemRecursorCache::s_maxServedStaleExtensions = 2;
+
+  time_t now = time(nullptr);
+  MRC.replace(now, power, QType(QType::A), makeARecordSet(power, "192.0.2.1", now + 10), signatures, authRecords, true, authZone, boost::none);
+
+  now += 20;
+  // expired
+  BOOST_CHECK_LT(MRC.get(now, power, QType(QType::A), false, &retrieved, who), 0);
+  // but can be served stale, for 30s
+  BOOST_CHECK_EQUAL(MRC.get(now, power, QType(QType::A), false, &retrieved, who, MemRecursorCache::ServeStale), MemRecursorCache::s_serveStaleExtensionPeriod);
+  BOOST_REQUIRE_EQUAL(retrieved.size(), 1U);
+  BOOST_CHECK_EQUAL(getRR<ARecordContent>(retrieved.at(0))->getCA().toString(), "192.0.2.1");
+  BOOST_CHECK_EQUAL(MRC.servedStale, 1U);
+  // during which it is a regular hit
+  BOOST_CHECK_EQUAL(MRC.get(now + 10, power, QType(QType::A), false, &retrieved, who), 20);
+  BOOST_CHECK_EQUAL(MRC.servedStale, 1U);
+
+  // second and last extension
+  now += 40;
+  BOOST_CHECK_EQUAL(MRC.get(now, power, QType(QType::A), false, &retrieved, who, MemRecursorCache::ServeStale), MemRecursorCache::s_serveStaleExtensionPeriod);
+  BOOST_CHECK_EQUAL(MRC.servedStale, 2U);
+  now += 40;
+  BOOST_CHECK_LT(MRC.get(now, power, QType(QType::A), false, &retrieved, who, MemRecursorCache::ServeStale), 0);
+  BOOST_CHECK_EQUAL(MRC.servedStale, 2U);
+
+  // fresh data resets the extensions
+  MRC.replace(now, power, QType(QType::A), makeARecordSet(power, "192.0.2.2", now + 10), signatures, authRecords, true, authZone, boost::none);
+  now += 20;
+  BOOST_CHECK_EQUAL(MRC.get(now, power, QType(QType::A), false, &retrieved, who, MemRecursorCache::ServeStale), MemRecursorCache::s_serveStaleExtensionPeriod);
+  BOOST_REQUIRE_EQUAL(retrieved.size(), 1U);
+  BOOST_CHECK_EQUAL(getRR<ARecordContent>(retrieved.at(0))->getCA().toString(), "192.0.2.2");
+  BOOST_CHECK_EQUAL(MRC.servedStale, 3U);
+
+  MemRecursorCache::s_maxServedStaleExtensions = oldMaxServedStaleExtensions;
+}
+
 BOOST_AUTO_TEST_SUITE_END()
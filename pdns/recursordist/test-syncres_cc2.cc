@@ -3,6 +3,7 @@
 
 #include "test-syncres_cc.hh"
 #include "rec-taskqueue.hh"
+#include <thread>
 
 BOOST_AUTO_TEST_SUITE(syncres_cc2)
 
@@ -459,6 +460,114 @@ BOOST_AUTO_TEST_CASE(test_throttled_server_time)
   BOOST_CHECK(!SyncRes::isThrottled(now + 2, ns));
 }
 
+BOOST_AUTO_TEST_CASE(test_throttled_server_shared)
+{
+  std::unique_ptr<SyncRes> sr;
+  initSR(sr);
+
+  primeHints();
+
+  const ComboAddress ns("192.0.2.1:53");
+  const DNSName nsName("a.gtld-servers.net.");
+  time_t now = sr->getNow().tv_sec;
+
+  /* per-thread mode, what another thread learns is not visible to us */
+  std::thread([now, ns]() {
+    SyncRes::doThrottle(now, ns, SyncRes::s_serverdownthrottletime, 10000);
+  }).join();
+  BOOST_CHECK(!SyncRes::isThrottled(now, ns));
+
+  SyncRes::setServerStateShards(4);
+  SyncRes::setServerStateShared(true);
+
+  std::thread([now, ns, nsName]() {
+    SyncRes::doThrottle(now, ns, SyncRes::s_serverdownthrottletime, 10000);
+    SyncRes::submitNSSpeed(nsName, ns, 1000000, {now, 0});
+    SyncRes::clearLocalServerState();
+  }).join();
+
+  BOOST_CHECK(SyncRes::isThrottled(now, ns));
+  BOOST_CHECK_EQUAL(SyncRes::getThrottledServersSize(), 1U);
+  BOOST_CHECK_EQUAL(SyncRes::getNSSpeedsSize(), 1U);
+  BOOST_CHECK_EQUAL(SyncRes::getNSSpeed(nsName, ns), 1000000U);
+
+  /* going back to per-thread mode, the shared state is dropped */
+  SyncRes::setServerStateShared(false);
+  SyncRes::clearSharedServerState();
+  SyncRes::setServerStateShared(true);
+  BOOST_CHECK(!SyncRes::isThrottled(now, ns));
+  BOOST_CHECK_EQUAL(SyncRes::getNSSpeedsSize(), 0U);
+  SyncRes::setServerStateShared(false);
+}
+
+BOOST_AUTO_TEST_CASE(test_throttled_server_shared_resolution)
+{
+  std::unique_ptr<SyncRes> sr;
+  initSR(sr);
+
+  primeHints();
+
+  SyncRes::setServerStateShards(4);
+  SyncRes::setServerStateShared(true);
+
+  const DNSName target("www.lock-up.");
+  const DNSName nsName("a.gtld-servers.net.");
+  const ComboAddress ns("192.0.2.1:53");
+  size_t queriesToNS = 0;
+
+  sr->setAsyncCallback([ns, nsName, &queriesToNS](const ComboAddress& ip, const DNSName& domain, int type, bool doTCP, bool sendRDQuery, int EDNS0Level, struct timeval* now, boost::optional<Netmask>& srcmask, boost::optional<const ResolveContext&> context, LWResult* res, bool* chained) {
+    if (isRootServer(ip)) {
+      setLWResult(res, 0, false, false, true);
+      addRecordToLW(res, "lock-up.", QType::NS, nsName.toString(), DNSResourceRecord::AUTHORITY, 172800);
+      addRecordToLW(res, nsName, QType::A, ns.toString(), DNSResourceRecord::ADDITIONAL, 3600);
+      return LWResult::Result::Success;
+    }
+    else if (ip == ns) {
+      queriesToNS++;
+
+      setLWResult(res, RCode::FormErr, false, false, false);
+      res->d_validpacket = false;
+      return LWResult::Result::Success;
+    }
+
+    return LWResult::Result::Timeout;
+  });
+
+  vector<DNSRecord> ret;
+  int res = sr->beginResolve(target, QType(QType::A), QClass::IN, ret);
+  BOOST_CHECK_EQUAL(res, RCode::ServFail);
+  BOOST_CHECK_EQUAL(ret.size(), 0U);
+  BOOST_CHECK_GT(queriesToNS, 0U);
+
+  /* what the resolution learned about ns went to the shared tables, so another thread sees it */
+  time_t now = sr->getNow().tv_sec;
+  bool throttled = false;
+  float speed = 0;
+  SyncRes::EDNSStatus::EDNSMode ednsMode = SyncRes::EDNSStatus::EDNSOK;
+  std::thread([now, ns, nsName, target, &throttled, &speed, &ednsMode]() {
+    throttled = SyncRes::isThrottled(now, ns, target, QType::A);
+    speed = SyncRes::getNSSpeed(nsName, ns);
+    ednsMode = SyncRes::getEDNSStatus(ns);
+  }).join();
+  BOOST_CHECK(throttled);
+  BOOST_CHECK_EQUAL(speed, 1000000U);
+  BOOST_CHECK_EQUAL(ednsMode, SyncRes::EDNSStatus::EDNSIGNORANT);
+
+  /* and the next resolution does not query it again */
+  const size_t queriesBefore = queriesToNS;
+  ret.clear();
+  res = sr->beginResolve(target, QType(QType::A), QClass::IN, ret);
+  BOOST_CHECK_EQUAL(res, RCode::ServFail);
+  BOOST_CHECK_EQUAL(queriesToNS, queriesBefore);
+
+  /* nothing went to the per-thread tables */
+  SyncRes::setServerStateShared(false);
+  BOOST_CHECK_EQUAL(SyncRes::getThrottledServersSize(), 0U);
+  BOOST_CHECK_EQUAL(SyncRes::getNSSpeedsSize(), 0U);
+  BOOST_CHECK_EQUAL(SyncRes::getEDNSStatusesSize(), 0U);
+  SyncRes::clearSharedServerState();
+}
+
 BOOST_AUTO_TEST_CASE(test_dont_query_server)
 {
   std::unique_ptr<SyncRes> sr;
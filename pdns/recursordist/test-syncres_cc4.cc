@@ -463,6 +463,58 @@ BOOST_AUTO_TEST_CASE(test_dnssec_rrsig)
   BOOST_CHECK(validateWithKeySet(now, qname, recordcontents, sigs, keyset) == vState::Secure);
 }
 
+BOOST_AUTO_TEST_CASE(test_dnssec_rrsig_signature_cache)
+{
+  initSR();
+  g_signatureCache = std::make_unique<SignatureVerificationCache>(100, 4);
+
+  auto dcke = DNSCryptoKeyEngine::make(DNSSECKeeper::ECDSA256);
+  dcke->create(dcke->getBits());
+  DNSSECPrivateKey dpk;
+  dpk.d_flags = 256;
+  dpk.setKey(std::move(dcke));
+
+  sortedRecords_t recordcontents;
+  recordcontents.insert(getRecordContent(QType::A, "192.0.2.1"));
+
+  DNSName qname("powerdns.com.");
+
+  time_t now = time(nullptr);
+  RRSIGRecordContent rrc;
+  computeRRSIG(dpk, qname, qname, QType::A, 600, 0, rrc, recordcontents, boost::none, now);
+
+  skeyset_t keyset;
+  keyset.insert(std::make_shared<DNSKEYRecordContent>(dpk.getDNSKEY()));
+
+  std::vector<std::shared_ptr<RRSIGRecordContent>> sigs;
+  sigs.push_back(std::make_shared<RRSIGRecordContent>(rrc));
+
+  /* first one is a miss, then the result comes from the cache */
+  BOOST_CHECK(validateWithKeySet(now, qname, recordcontents, sigs, keyset) == vState::Secure);
+  BOOST_CHECK_EQUAL(g_signatureCache->getMisses(), 1U);
+  BOOST_CHECK_EQUAL(g_signatureCache->getHits(), 0U);
+  BOOST_CHECK(validateWithKeySet(now, qname, recordcontents, sigs, keyset) == vState::Secure);
+  BOOST_CHECK_EQUAL(g_signatureCache->getMisses(), 1U);
+  BOOST_CHECK_EQUAL(g_signatureCache->getHits(), 1U);
+
+  /* the same signature over different data must not be found in the cache */
+  sortedRecords_t otherContents;
+  otherContents.insert(getRecordContent(QType::A, "192.0.2.2"));
+  BOOST_CHECK(validateWithKeySet(now, qname, otherContents, sigs, keyset) == vState::BogusNoValidRRSIG);
+  BOOST_CHECK_EQUAL(g_signatureCache->getMisses(), 2U);
+  BOOST_CHECK_EQUAL(g_signatureCache->getHits(), 1U);
+  /* but the failed verification is cached as well */
+  BOOST_CHECK(validateWithKeySet(now, qname, otherContents, sigs, keyset) == vState::BogusNoValidRRSIG);
+  BOOST_CHECK_EQUAL(g_signatureCache->getMisses(), 2U);
+  BOOST_CHECK_EQUAL(g_signatureCache->getHits(), 2U);
+
+  /* time checks are not cached: once the signature has expired, the cached result is not used */
+  BOOST_CHECK(validateWithKeySet(now + 2, qname, recordcontents, sigs, keyset) == vState::BogusSignatureExpired);
+  BOOST_CHECK_EQUAL(g_signatureCache->getHits(), 2U);
+
+  g_signatureCache.reset();
+}
+
 BOOST_AUTO_TEST_CASE(test_dnssec_root_validation_csk)
 {
   std::unique_ptr<SyncRes> sr;
@@ -1,7 +1,6 @@
 #include <unistd.h>
 #include "threadname.hh"
 #include "remote_logger.hh"
-#include <sys/uio.h>
 #ifdef HAVE_CONFIG_H
 #include "config.h"
 #endif
@@ -12,92 +11,7 @@
 #include "dolog.hh"
 #endif
 
-bool CircularWriteBuffer::hasRoomFor(const std::string& str) const
-{
-  if (d_buffer.size() + 2 + str.size() > d_buffer.capacity()) {
-    return false;
-  }
-
-  return true;
-}
-
-bool CircularWriteBuffer::write(const std::string& str)
-{
-  if (str.size() > std::numeric_limits<uint16_t>::max() || !hasRoomFor(str)) {
-    return false;
-  }
-
-  uint16_t len = htons(str.size());
-  const char* ptr = reinterpret_cast<const char*>(&len);
-  d_buffer.insert(d_buffer.end(), ptr, ptr + 2);
-  d_buffer.insert(d_buffer.end(), str.begin(), str.end());
-
-  return true;
-}
-
-bool CircularWriteBuffer::flush(int fd)
-{
-  if (d_buffer.empty()) {
-    // not optional, we report EOF otherwise
-    return false;
-  }
-
-  auto arr1 = d_buffer.array_one();
-  auto arr2 = d_buffer.array_two();
-
-  struct iovec iov[2];
-  int pos = 0;
-  size_t total = 0;
-  for(const auto& arr : {arr1, arr2}) {
-    if(arr.second) {
-      iov[pos].iov_base = arr.first;
-      iov[pos].iov_len = arr.second;
-      total += arr.second;
-      ++pos;
-    }
-  }
-
-  ssize_t res = 0;
-  do {
-    res = writev(fd, iov, pos);
-
-    if (res < 0) {
-      if (errno == EINTR) {
-        continue;
-      }
-
-      if (errno == EAGAIN || errno == EWOULDBLOCK) {
-        return false;
-      }
-
-      /* we can't be sure we haven't sent a partial message,
-         and we don't want to send the remaining part after reconnecting */
-      d_buffer.clear();
-      throw std::runtime_error("Couldn't flush a thing: " + stringerror());
-    }
-    else if (!res) {
-      /* we can't be sure we haven't sent a partial message,
-         and we don't want to send the remaining part after reconnecting */
-      d_buffer.clear();
-      throw std::runtime_error("EOF");
-    }
-  }
-  while (res < 0);
-
-  //  cout<<"Flushed "<<res<<" bytes out of " << total <<endl;
-  if (static_cast<size_t>(res) == d_buffer.size()) {
-    d_buffer.clear();
-  }
-  else {
-    while (res--) {
-      d_buffer.pop_front();
-    }
-  }
-
-  return true;
-}
-
-RemoteLogger::RemoteLogger(const ComboAddress& remote, uint16_t timeout, uint64_t maxQueuedBytes, uint8_t reconnectWaitTime, bool asyncConnect): d_remote(remote), d_timeout(timeout), d_reconnectWaitTime(reconnectWaitTime), d_asyncConnect(asyncConnect), d_runtime({CircularWriteBuffer(maxQueuedBytes), nullptr})
+RemoteLogger::RemoteLogger(const ComboAddress& remote, uint16_t timeout, uint64_t maxQueuedBytes, uint8_t reconnectWaitTime, bool asyncConnect): d_remote(remote), d_maxQueuedBytes(maxQueuedBytes), d_timeout(timeout), d_reconnectWaitTime(reconnectWaitTime), d_asyncConnect(asyncConnect)
 {
   if (!d_asyncConnect) {
     reconnect();
@@ -113,12 +27,7 @@ bool RemoteLogger::reconnect()
     newSock->setNonBlocking();
     newSock->connect(d_remote, d_timeout);
 
-    {
-      /* we are now successfully connected, time to take the lock and update the
-         socket */
-      auto runtime = d_runtime.lock();
-      runtime->d_socket = std::move(newSock);
-    }
+    d_socket = std::move(newSock);
   }
   catch (const std::exception& e) {
 #ifdef WE_ARE_RECURSOR
@@ -138,42 +47,91 @@ void RemoteLogger::queueData(const std::string& data)
     throw std::runtime_error("Got a request to write an object of size " + std::to_string(data.size()));
   }
 
-  auto runtime = d_runtime.lock();
+  bool wakeup = false;
+  {
+    auto pending = d_pending.lock();
+    const size_t before = pending->size();
 
-  if (!runtime->d_writer.hasRoomFor(data)) {
-    /* not connected, queue is full, just drop */
-    if (!runtime->d_socket) {
+    if (before + 2 + data.size() > d_maxQueuedBytes) {
+      /* the batch is full, either because we are not connected or because
+         the remote end does not keep up, just drop */
       ++d_drops;
       return;
     }
-    try {
-      /* we try to flush some data */
-      if (!runtime->d_writer.flush(runtime->d_socket->getHandle())) {
-        /* but failed, let's just drop */
-        ++d_drops;
-        return;
-      }
 
-      /* see if we freed enough data */
-      if (!runtime->d_writer.hasRoomFor(data)) {
-        /* we didn't */
-        ++d_drops;
-        return;
+    uint16_t len = htons(data.size());
+    pending->append(reinterpret_cast<const char*>(&len), sizeof(len));
+    pending->append(data);
+
+    /* only the message that makes us cross the threshold pays for the wake up */
+    wakeup = before <= d_maxQueuedBytes / 2 && pending->size() > d_maxQueuedBytes / 2;
+  }
+
+  ++d_queued;
+  if (wakeup) {
+    wakeUp();
+  }
+}
+
+void RemoteLogger::wakeUp()
+{
+  {
+    std::lock_guard<std::mutex> lock(d_wakeupMutex);
+    d_wakeupRequested = true;
+  }
+  d_wakeupCond.notify_one();
+}
+
+/* Sends the batch in flight then the pending ones until there is nothing left,
+   returning false if the socket would block. The pending batch is swapped, not
+   copied, so both buffers keep their capacity and we don't allocate once warmed up.
+   Throws on error or EOF. */
+bool RemoteLogger::flush()
+{
+  const int fd = d_socket->getHandle();
+
+  for (;;) {
+    while (d_sendingPos < d_sending.size()) {
+      ssize_t res = write(fd, d_sending.data() + d_sendingPos, d_sending.size() - d_sendingPos);
+
+      if (res < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+          return false;
+        }
+
+        /* we can't be sure we haven't sent a partial message,
+           and we don't want to send the remaining part after reconnecting */
+        d_sending.clear();
+        d_sendingPos = 0;
+        throw std::runtime_error("Couldn't flush a thing: " + stringerror());
+      }
+      else if (!res) {
+        /* we can't be sure we haven't sent a partial message,
+           and we don't want to send the remaining part after reconnecting */
+        d_sending.clear();
+        d_sendingPos = 0;
+        throw std::runtime_error("EOF");
       }
+
+      d_sendingPos += res;
     }
-    catch(const std::exception& e) {
-      //      cout << "Got exception writing: "<<e.what()<<endl;
-      ++d_drops;
-      runtime->d_socket.reset();
-      return;
+
+    d_sending.clear();
+    d_sendingPos = 0;
+
+    auto pending = d_pending.lock();
+    if (pending->empty()) {
+      return true;
     }
+    std::swap(*pending, d_sending);
   }
-
-  runtime->d_writer.write(data);
-  ++d_queued;
 }
 
-void RemoteLogger::maintenanceThread() 
+void RemoteLogger::maintenanceThread()
 {
   try {
 #ifdef WE_ARE_RECURSOR
@@ -189,38 +147,31 @@ void RemoteLogger::maintenanceThread()
       }
 
       bool connected = true;
-      if (d_runtime.lock()->d_socket == nullptr) {
-        // if it was unset, it will remain so, we are the only ones setting it!
+      if (d_socket == nullptr) {
+        // we are the only ones using the socket, no need for a lock
         connected = reconnect();
       }
 
       /* we will just go to sleep if the reconnection just failed */
       if (connected) {
         try {
-          /* we don't want to take the lock while trying to reconnect */
-          auto runtime = d_runtime.lock();
-          if (runtime->d_socket) { // check if it is set
-            /* if flush() returns false, it means that we couldn't flush anything yet
-               either because there is nothing to flush, or because the outgoing TCP
-               buffer is full. That's fine by us */
-            runtime->d_writer.flush(runtime->d_socket->getHandle());
-          }
-          else {
-            connected = false;
+          if (!flush()) {
+            /* the outgoing TCP buffer is full, wait until we can write again
+               instead of sleeping while the batch fills up */
+            waitForRWData(d_socket->getHandle(), false, d_reconnectWaitTime, 0);
+            continue;
           }
         }
         catch (const std::exception& e) {
-          d_runtime.lock()->d_socket.reset();
-          connected = false;
-        }
-
-        if (!connected) {
+          d_socket.reset();
           /* let's try to reconnect right away, we are about to sleep anyway */
           reconnect();
         }
       }
 
-      sleep(d_reconnectWaitTime);
+      std::unique_lock<std::mutex> lock(d_wakeupMutex);
+      d_wakeupCond.wait_for(lock, std::chrono::seconds(d_reconnectWaitTime), [this] { return d_wakeupRequested; });
+      d_wakeupRequested = false;
     }
   }
   catch (const std::exception& e)
@@ -235,6 +186,7 @@ void RemoteLogger::maintenanceThread()
 RemoteLogger::~RemoteLogger()
 {
   d_exiting = true;
+  wakeUp();
 
   d_thread.join();
 }
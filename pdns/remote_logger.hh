@@ -25,38 +25,14 @@
 #endif
 
 #include <atomic>
+#include <condition_variable>
 #include <queue>
 #include <thread>
 
 #include "iputils.hh"
-#include "circular_buffer.hh"
 #include "lock.hh"
 #include "sstuff.hh"
 
-/* Writes can be submitted and they are atomically accepted. Either the whole write
-   ends up in the buffer or nothing ends up in the buffer.
-   In case nothing ends up in the buffer, an exception is thrown.
-   Similarly, EOF leads to this treatment
-
-   The filedescriptor can be in non-blocking mode.
-
-   This class is not threadsafe.
-*/
-
-class CircularWriteBuffer
-{
-public:
-  explicit CircularWriteBuffer(size_t size) : d_buffer(size)
-  {
-  }
-
-  bool hasRoomFor(const std::string& str) const;
-  bool write(const std::string& str);
-  bool flush(int fd);
-private:
-  boost::circular_buffer<char> d_buffer;
-};
-
 class RemoteLoggerInterface
 {
 public:
@@ -75,9 +51,13 @@ private:
 };
 
 /* Thread safe. Will connect asynchronously on request.
-   Runs a reconnection thread that also periodicall flushes.
-   Note that the buffer only runs as long as there is a connection.
-   If there is no connection we don't buffer a thing
+   Runs a maintenance thread that (re)connects and does all the writing to the socket.
+   Queued messages are appended, length-prefixed, to a batch that the maintenance
+   thread swaps out and sends in as few syscalls as possible, so callers of
+   queueData() never wait on the socket. The thread is woken up early when the
+   batch is half full, and new messages are dropped (and counted) once it is full.
+   Note that nothing is sent if there is no connection, so the batch fills up
+   and we start dropping.
 */
 class RemoteLogger : public RemoteLoggerInterface
 {
@@ -95,26 +75,33 @@ public:
   void stop()
   {
     d_exiting = true;
+    wakeUp();
   }
 
 private:
   bool reconnect();
+  bool flush();
+  void wakeUp();
   void maintenanceThread();
 
-  struct RuntimeData
-  {
-    CircularWriteBuffer d_writer;
-    std::unique_ptr<Socket> d_socket{nullptr};
-  };
-
   ComboAddress d_remote;
   std::atomic<uint64_t> d_drops{0};
   std::atomic<uint64_t> d_queued{0};
+  const size_t d_maxQueuedBytes;
   uint16_t d_timeout;
   uint8_t d_reconnectWaitTime;
   std::atomic<bool> d_exiting{false};
   bool d_asyncConnect{false};
 
-  LockGuarded<RuntimeData> d_runtime;
+  /* filled by queueData(), swapped with d_sending by the maintenance thread */
+  LockGuarded<std::string> d_pending;
+  /* only ever touched by the maintenance thread (or the constructor, before it starts) */
+  std::string d_sending;
+  size_t d_sendingPos{0};
+  std::unique_ptr<Socket> d_socket{nullptr};
+
+  std::mutex d_wakeupMutex;
+  std::condition_variable d_wakeupCond;
+  bool d_wakeupRequested{false};
   std::thread d_thread;
 };
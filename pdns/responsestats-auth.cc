@@ -9,18 +9,18 @@ extern StatBag S;
  */
 void ResponseStats::submitResponse(DNSPacket &p, bool udpOrTCP, bool last) const {
   const string& buf=p.getString();
-  static AtomicCounter &udpnumanswered=*S.getPointer("udp-answers");
-  static AtomicCounter &udpnumanswered4=*S.getPointer("udp4-answers");
-  static AtomicCounter &udpnumanswered6=*S.getPointer("udp6-answers");
-  static AtomicCounter &udpbytesanswered=*S.getPointer("udp-answers-bytes");
-  static AtomicCounter &udpbytesanswered4=*S.getPointer("udp4-answers-bytes");
-  static AtomicCounter &udpbytesanswered6=*S.getPointer("udp6-answers-bytes");
-  static AtomicCounter &tcpnumanswered=*S.getPointer("tcp-answers");
-  static AtomicCounter &tcpnumanswered4=*S.getPointer("tcp4-answers");
-  static AtomicCounter &tcpnumanswered6=*S.getPointer("tcp6-answers");
-  static AtomicCounter &tcpbytesanswered=*S.getPointer("tcp-answers-bytes");
-  static AtomicCounter &tcpbytesanswered4=*S.getPointer("tcp4-answers-bytes");
-  static AtomicCounter &tcpbytesanswered6=*S.getPointer("tcp6-answers-bytes");
+  static StatCounter &udpnumanswered=*S.getPointer("udp-answers");
+  static StatCounter &udpnumanswered4=*S.getPointer("udp4-answers");
+  static StatCounter &udpnumanswered6=*S.getPointer("udp6-answers");
+  static StatCounter &udpbytesanswered=*S.getPointer("udp-answers-bytes");
+  static StatCounter &udpbytesanswered4=*S.getPointer("udp4-answers-bytes");
+  static StatCounter &udpbytesanswered6=*S.getPointer("udp6-answers-bytes");
+  static StatCounter &tcpnumanswered=*S.getPointer("tcp-answers");
+  static StatCounter &tcpnumanswered4=*S.getPointer("tcp4-answers");
+  static StatCounter &tcpnumanswered6=*S.getPointer("tcp6-answers");
+  static StatCounter &tcpbytesanswered=*S.getPointer("tcp-answers-bytes");
+  static StatCounter &tcpbytesanswered4=*S.getPointer("tcp4-answers-bytes");
+  static StatCounter &tcpbytesanswered6=*S.getPointer("tcp6-answers-bytes");
 
   if(p.d.aa) {
     if (p.d.rcode==RCode::NXDomain) {
@@ -612,6 +612,41 @@ struct BigDNSPacketRefTest
 
 };
 
+/* an AXFR-like chunk, lots of distinct owner names sharing the zone suffix, the worst
+   case for name compression */
+struct ManyNamesTest
+{
+  explicit ManyNamesTest(int records) : d_records(records)
+  {
+    DNSName zone("example.com");
+    for (int idx = 0; idx < d_records; idx++) {
+      d_names.push_back(DNSName("host" + std::to_string(idx)) + zone);
+      d_targets.push_back(DNSName("mail" + std::to_string(idx % 10)) + zone);
+    }
+  }
+
+  string getName() const
+  {
+    return (boost::format("write %d distinct names") % d_records).str();
+  }
+
+  void operator()() const
+  {
+    vector<uint8_t> packet;
+    DNSPacketWriter pw(packet, DNSName("example.com"), QType::AXFR);
+    for (int idx = 0; idx < d_records; idx++) {
+      pw.startRecord(d_names.at(idx), QType::MX, 3600, 1, DNSResourceRecord::ANSWER);
+      pw.xfr16BitInt(10);
+      pw.xfrName(d_targets.at(idx), true);
+    }
+    pw.commit();
+  }
+
+  int d_records;
+  vector<DNSName> d_names;
+  vector<DNSName> d_targets;
+};
+
 
 struct TCacheComp
 {
@@ -714,6 +749,31 @@ struct SimpleCompressTest
   std::string d_name;
 };
 
+struct DNSNameCopyTest
+{
+  explicit DNSNameCopyTest(const std::string& name, bool intern)
+    : d_name(name), d_intern(intern)
+  {
+    if (d_intern) {
+      d_name.intern();
+    }
+  }
+
+  string getName() const
+  {
+    return std::string("copy ") + (d_intern ? "interned " : "") + "'" + d_name.toString() + "'";
+  }
+
+  void operator()() const
+  {
+    for (int n = 0; n < 1000; ++n) {
+      DNSName copy(d_name);
+    }
+  }
+  DNSName d_name;
+  bool d_intern;
+};
+
 struct VectorExpandTest
 {
   string getName() const
@@ -764,6 +824,84 @@ struct DNSNameRootTest
 
 
 
+struct DNSNameEqualTest
+{
+  explicit DNSNameEqualTest(const std::string& a, const std::string& b): d_a(a), d_b(b)
+  {
+  }
+
+  string getName() const
+  {
+    return "DNSName equal '" + d_a.toString() + "' '" + d_b.toString() + "'";
+  }
+
+  void operator()() const
+  {
+    g_ret = (d_a == d_b);
+  }
+
+  DNSName d_a;
+  DNSName d_b;
+};
+
+struct DNSNameCanonCompareTest
+{
+  explicit DNSNameCanonCompareTest(const std::string& a, const std::string& b): d_a(a), d_b(b)
+  {
+  }
+
+  string getName() const
+  {
+    return "DNSName canonCompare '" + d_a.toString() + "' '" + d_b.toString() + "'";
+  }
+
+  void operator()() const
+  {
+    g_ret = d_a.canonCompare(d_b);
+  }
+
+  DNSName d_a;
+  DNSName d_b;
+};
+
+struct DNSNameHashTest
+{
+  explicit DNSNameHashTest(const std::string& name): d_name(name)
+  {
+  }
+
+  string getName() const
+  {
+    return "DNSName hash '" + d_name.toString() + "'";
+  }
+
+  void operator()() const
+  {
+    g_ret = d_name.hash();
+  }
+
+  DNSName d_name;
+};
+
+struct BurtleCIPacketTest
+{
+  explicit BurtleCIPacketTest(size_t size): d_packet(size, 'A')
+  {
+  }
+
+  string getName() const
+  {
+    return "burtleCI over a " + std::to_string(d_packet.size()) + " bytes packet";
+  }
+
+  void operator()() const
+  {
+    g_ret = burtleCI(reinterpret_cast<const unsigned char*>(d_packet.data()), d_packet.size(), 0);
+  }
+
+  std::string d_packet;
+};
+
 struct IEqualsTest
 {
   string getName() const
@@ -882,6 +1020,22 @@ struct StatRingDNSNameQTypeTest
 };
 
 
+#ifndef RECURSOR
+struct StatCounterTest
+{
+  explicit StatCounterTest(StatType type) : d_counter(type), d_type(type) {}
+
+  string getName() const { return d_type == StatType::counter ? "StatCounter increment (sharded)" : "StatCounter increment (gauge)"; }
+
+  void operator()() const {
+    ++d_counter;
+  };
+
+  mutable StatCounter d_counter;
+  StatType d_type;
+};
+#endif
+
 struct NetmaskTreeTest
 {
   string getName() const { return "NetmaskTreeTest"; }
@@ -895,6 +1049,41 @@ struct NetmaskTreeTest
   }
 };
 
+struct NetmaskTreeLookupTest
+{
+  explicit NetmaskTreeLookupTest(size_t count, bool flat) : d_flat(flat)
+  {
+    for (size_t idx = 0; idx < count; idx++) {
+      ComboAddress addr("10.0.0.0");
+      addr.sin4.sin_addr.s_addr = htonl(0x0a000000 | (random() & 0x00ffffff));
+      d_tree.insert(Netmask(addr, 16 + idx % 17)).second = true;
+    }
+    d_flatTree = FlatNetmaskTree<bool>(d_tree);
+    for (size_t idx = 0; idx < 1000; idx++) {
+      ComboAddress addr("10.0.0.0");
+      addr.sin4.sin_addr.s_addr = htonl(0x0a000000 | (random() & 0x00ffffff));
+      d_addresses.push_back(addr);
+    }
+  }
+
+  string getName() const
+  {
+    return (boost::format("%s of 1000 addresses among %d prefixes") % (d_flat ? "FlatNetmaskTree lookup" : "NetmaskTree lookup") % d_tree.size()).str();
+  }
+
+  void operator()() const
+  {
+    for (const auto& addr : d_addresses) {
+      g_ret = d_flat ? d_flatTree.match(addr) : d_tree.match(addr);
+    }
+  }
+
+  NetmaskTree<bool> d_tree;
+  FlatNetmaskTree<bool> d_flatTree;
+  std::vector<ComboAddress> d_addresses;
+  bool d_flat;
+};
+
 struct UUIDGenTest
 {
   string getName() const { return "UUIDGenTest"; }
@@ -1047,6 +1236,8 @@ try
   doRun(TypicalRefTest());
   doRun(BigRefTest());
   doRun(BigDNSPacketRefTest());
+  doRun(ManyNamesTest(50));
+  doRun(ManyNamesTest(500));
 
   auto packet = makeEmptyQuery();
   doRun(ParsePacketTest(packet, "empty-query"));
@@ -1059,6 +1250,10 @@ try
 
   doRun(SimpleCompressTest("www.france.ds9a.nl"));
 
+  doRun(DNSNameCopyTest("www.france.ds9a.nl", false));
+  doRun(DNSNameCopyTest("a-rather-long-label-for-a-host.another-rather-long-label.ds9a.nl", false));
+  doRun(DNSNameCopyTest("a-rather-long-label-for-a-host.another-rather-long-label.ds9a.nl", true));
+
 
   doRun(VectorExpandTest());
 
@@ -1130,7 +1325,18 @@ try
   doRun(DNSNameParseTest());
   doRun(DNSNameRootTest());
 
+  doRun(DNSNameEqualTest("www.PowerDNS.com", "WWW.powerdns.COM"));
+  doRun(DNSNameEqualTest("a-rather-long-label-for-a-host.another-rather-long-label.ds9a.nl", "A-RATHER-LONG-LABEL-FOR-A-HOST.ANOTHER-RATHER-LONG-LABEL.DS9A.NL"));
+  doRun(DNSNameCanonCompareTest("www.PowerDNS.com", "WWW.powerdns.COM"));
+  doRun(DNSNameCanonCompareTest("a-rather-long-label-for-a-host.another-rather-long-label.ds9a.nl", "A-RATHER-LONG-LABEL-FOR-A-HOST.ANOTHER-RATHER-LONG-LABEL.DS9A.NL"));
+  doRun(DNSNameHashTest("www.PowerDNS.com"));
+  doRun(DNSNameHashTest("a-rather-long-label-for-a-host.another-rather-long-label.ds9a.nl"));
+  doRun(BurtleCIPacketTest(64));
+  doRun(BurtleCIPacketTest(512));
+
   doRun(NetmaskTreeTest());
+  doRun(NetmaskTreeLookupTest(100000, false));
+  doRun(NetmaskTreeLookupTest(100000, true));
 
   doRun(UUIDGenTest());
 
@@ -1154,6 +1360,9 @@ try
 
   S.declareDNSNameQTypeRing("testringdnsname", "Just some ring where we'll account things");
   doRun(StatRingDNSNameQTypeTest(DNSName("example.com"), QType(1)));
+
+  doRun(StatCounterTest(StatType::counter));
+  doRun(StatCounterTest(StatType::gauge));
 #endif
 
   cerr<<"Total runs: " << g_totalRuns<<endl;
@@ -36,6 +36,8 @@
 
 #include "namespaces.hh"
 
+std::atomic<size_t> StatShards::s_next{0};
+
 StatBag::StatBag()
 {
   d_doRings=false;
@@ -112,7 +114,7 @@ void StatBag::declare(const string &key, const string &descrip, StatType statTyp
 {
   if(d_stats.count(key)) {
     if (d_allowRedeclare) {
-      *d_stats[key] = 0;
+      d_stats[key]->store(0);
       return;
     }
     else {
@@ -120,7 +122,7 @@ void StatBag::declare(const string &key, const string &descrip, StatType statTyp
     }
   }
 
-  auto i=make_unique<AtomicCounter>(0);
+  auto i=make_unique<StatCounter>(statType);
   d_stats[key]=std::move(i);
   d_keyDescriptions[key]=descrip;
   d_statTypes[key]=statType;
@@ -157,7 +159,7 @@ unsigned long StatBag::readZero(const string &key)
 {
   exists(key);
   unsigned long tmp=*d_stats[key];
-  d_stats[key]=nullptr;
+  d_stats[key]->store(0);
   return tmp;
 }
 
@@ -176,7 +178,7 @@ string StatBag::getValueStrZero(const string &key)
   return o.str();
 }
 
-AtomicCounter *StatBag::getPointer(const string &key)
+StatCounter *StatBag::getPointer(const string &key)
 {
   exists(key);
   return d_stats[key].get();
@@ -189,45 +191,46 @@ StatBag::~StatBag()
 template<typename T, typename Comp>
 StatRing<T,Comp>::StatRing(unsigned int size)
 {
-  d_items.set_capacity(size);
+  resize(size);
 }
 
 template<typename T, typename Comp>
 StatRing<T,Comp>::StatRing(const StatRing<T,Comp> &arg)
 {
-  std::lock_guard<std::mutex> thislock(d_lock);
-  std::lock_guard<std::mutex> arglock(arg.d_lock);
-  
-  d_items = arg.d_items;
+  for (size_t idx = 0; idx < d_shards.size(); idx++) {
+    *d_shards[idx].d_items.lock() = *arg.d_shards[idx].d_items.lock();
+  }
+  d_size = arg.d_size.load();
   d_help = arg.d_help;
 }
 
-template<typename T, typename Comp>
-void StatRing<T,Comp>::account(const T& t)
-{
-  std::lock_guard<std::mutex> l(d_lock);
-  d_items.push_back(t);
-}
-
 template<typename T, typename Comp>
 uint64_t StatRing<T,Comp>::getSize() const
 {
-  std::lock_guard<std::mutex> l(d_lock);
-  return d_items.capacity();
+  return d_size;
 }
 
 template<typename T, typename Comp>
 uint64_t StatRing<T,Comp>::getEntriesCount() const
 {
-  std::lock_guard<std::mutex> l(d_lock);
-  return d_items.size();
+  uint64_t count = 0;
+  for (const auto& shard : d_shards) {
+    count += shard.d_items.lock()->size();
+  }
+  return std::min(count, static_cast<uint64_t>(d_size));
 }
 
 template<typename T, typename Comp>
 void StatRing<T,Comp>::resize(unsigned int newsize)
 {
-  std::lock_guard<std::mutex> l(d_lock);
-  d_items.set_capacity(newsize);
+  d_size = newsize;
+  for (auto& shard : d_shards) {
+    auto items = shard.d_items.lock();
+    /* shards that have never been used are sized on their first use */
+    if (items->capacity() > 0) {
+      items->rset_capacity(newsize);
+    }
+  }
 }
 
 template<typename T, typename Comp>
@@ -246,10 +249,31 @@ string StatRing<T,Comp>::getHelp()
 template<typename T, typename Comp>
 vector<pair<T, unsigned int> >StatRing<T,Comp>::get() const
 {
-  std::lock_guard<std::mutex> l(d_lock);
+  vector<vector<T>> shards;
+  for (const auto& shard : d_shards) {
+    auto items = shard.d_items.lock();
+    if (!items->empty()) {
+      /* most recent first */
+      shards.emplace_back(items->rbegin(), items->rend());
+    }
+  }
+
+  /* together the shards can hold more than d_size items, so take the most recent ones of every shard in turn
+     until we have d_size of them */
   map<T,unsigned int, Comp> res;
-  for(typename boost::circular_buffer<T>::const_iterator i=d_items.begin();i!=d_items.end();++i) {
-    res[*i]++;
+  size_t remaining = d_size;
+  for (size_t pos = 0; remaining > 0; pos++) {
+    bool found = false;
+    for (const auto& items : shards) {
+      if (pos < items.size() && remaining > 0) {
+        res[items[pos]]++;
+        remaining--;
+        found = true;
+      }
+    }
+    if (!found) {
+      break;
+    }
   }
   
   vector<pair<T ,unsigned int> > tmp;
@@ -261,6 +285,46 @@ vector<pair<T, unsigned int> >StatRing<T,Comp>::get() const
   return tmp;
 }
 
+StatHistogram* StatBag::declareHistogram(const string &name, const string &descrip)
+{
+  if (d_histograms.count(name)) {
+    throw PDNSException("Attempt to re-declare histogram '" + name + "'");
+  }
+
+  vector<uint64_t> boundaries;
+  for (uint64_t decade = 10; decade <= 1000000; decade *= 10) {
+    boundaries.push_back(decade);
+    boundaries.push_back(2 * decade);
+    boundaries.push_back(5 * decade);
+  }
+
+  vector<StatCounter*> buckets;
+  buckets.reserve(boundaries.size() + 1);
+  uint64_t previous = 0;
+  for (const auto boundary : boundaries) {
+    declare(name + "-le-" + std::to_string(boundary), descrip + ", number of events that took more than " + std::to_string(previous) + " and at most " + std::to_string(boundary) + " microseconds");
+    buckets.push_back(getPointer(name + "-le-" + std::to_string(boundary)));
+    previous = boundary;
+  }
+  declare(name + "-le-max", descrip + ", number of events that took more than " + std::to_string(previous) + " microseconds");
+  buckets.push_back(getPointer(name + "-le-max"));
+  declare(name + "-sum", descrip + ", total number of microseconds");
+
+  auto histogram = make_unique<StatHistogram>(std::move(boundaries), std::move(buckets), getPointer(name + "-sum"));
+  auto ret = histogram.get();
+  d_histograms[name] = std::move(histogram);
+  return ret;
+}
+
+StatHistogram* StatBag::getHistogram(const string &name)
+{
+  auto it = d_histograms.find(name);
+  if (it == d_histograms.end()) {
+    return nullptr;
+  }
+  return it->second.get();
+}
+
 void StatBag::registerRingStats(const string& name)
 {
   declare("ring-" + name + "-size", "Number of entries in the " + name + " ring", [this,name](const std::string&) { return static_cast<uint64_t>(getRingEntriesCount(name)); }, StatType::gauge);
@@ -313,8 +377,9 @@ vector<pair<string, unsigned int> > StatBag::getRing(const string &name)
 template<typename T, typename Comp>
 void StatRing<T,Comp>::reset()
 {
-  std::lock_guard<std::mutex> l(d_lock);
-  d_items.clear();
+  for (auto& shard : d_shards) {
+    shard.d_items.lock()->clear();
+  }
 }
 
 void StatBag::resetRing(const string &name)
@@ -21,6 +21,9 @@
  */
 #pragma once
 #include <pthread.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <map>
 #include <mutex>
 #include <functional>
@@ -30,8 +33,26 @@
 #include "namespaces.hh"
 #include "iputils.hh"
 #include "circular_buffer.hh"
+#include "stat_t.hh"
 
 
+/* Queries are accounted by all the receiver and distributor threads, so counters and rings are split in shards,
+   each thread using its own one, and the shards are only merged when someone asks for the value. */
+struct StatShards
+{
+  static constexpr size_t s_count = 16;
+
+  //! the shard the calling thread should use, threads are spread over the shards in a round-robin fashion
+  static size_t get()
+  {
+    static thread_local const size_t shard = s_next++ % s_count;
+    return shard;
+  }
+
+private:
+  static std::atomic<size_t> s_next;
+};
+
 template<typename T, typename Comp=std::less<T> >
 class StatRing
 {
@@ -41,7 +62,15 @@ public:
   StatRing(const StatRing &);
   StatRing & operator=(const StatRing &) = delete;
   
-  void account(const T &item);
+  void account(const T &item)
+  {
+    auto items = d_shards.at(StatShards::get()).d_items.lock();
+    if (items->capacity() == 0) {
+      /* first item accounted by the threads of this shard */
+      items->set_capacity(d_size);
+    }
+    items->push_back(item);
+  }
 
   uint64_t getSize() const;
   uint64_t getEntriesCount() const;
@@ -57,8 +86,15 @@ private:
     return (a.second > b.second);
   }
 
-  boost::circular_buffer<T> d_items;
-  mutable std::mutex d_lock;
+  /* every shard that has been used keeps the most recent d_size items of its threads, get() and getEntriesCount()
+     only look at d_size items in total */
+  struct alignas(CPU_LEVEL1_DCACHE_LINESIZE) Shard
+  {
+    mutable LockGuarded<boost::circular_buffer<T>> d_items;
+  };
+
+  std::array<Shard, StatShards::s_count> d_shards;
+  std::atomic<unsigned int> d_size;
   string d_help;
 };
 
@@ -67,15 +103,121 @@ enum class StatType : uint8_t {
   gauge = 2,
 };
 
+/* Counters are only added to by the threads handling queries, and rarely read, so they are sharded.
+   Gauges are read on hot paths as well (the caches compare their size to their maximum on every insertion), so
+   they are kept in a single atomic. */
+class StatCounter
+{
+public:
+  explicit StatCounter(StatType type) : d_sharded(type == StatType::counter)
+  {
+  }
+  StatCounter(const StatCounter&) = delete;
+
+  void operator++()
+  {
+    ++getShard();
+  }
+  void operator++(int)
+  {
+    ++getShard();
+  }
+  void operator--()
+  {
+    --getShard();
+  }
+  void operator--(int)
+  {
+    --getShard();
+  }
+  void operator+=(AtomicCounterInner value)
+  {
+    getShard() += value;
+  }
+  void operator-=(AtomicCounterInner value)
+  {
+    getShard() -= value;
+  }
+
+  AtomicCounterInner load() const
+  {
+    if (!d_sharded) {
+      return d_shards[0].load();
+    }
+    AtomicCounterInner total = 0;
+    for (const auto& shard : d_shards) {
+      total += shard.load();
+    }
+    return total;
+  }
+
+  operator AtomicCounterInner() const
+  {
+    return load();
+  }
+
+  //! not atomic with regard to concurrent updates of a sharded counter
+  void store(AtomicCounterInner value)
+  {
+    for (auto& shard : d_shards) {
+      shard.store(0);
+    }
+    d_shards[0].store(value);
+  }
+
+private:
+  using shard_t = pdns::stat_t_trait<AtomicCounterInner>;
+
+  shard_t& getShard()
+  {
+    return d_shards[d_sharded ? StatShards::get() : 0];
+  }
+
+  std::array<shard_t, StatShards::s_count> d_shards;
+  const bool d_sharded;
+};
+
+/* A latency histogram made of regular counters, so that it is exported like every other metric. For a histogram
+   named 'name', name-le-N counts the events that took more than the previous boundary and at most N microseconds
+   (the buckets are not cumulative), name-le-max the slower ones and name-sum the total number of microseconds.
+   The boundaries grow in a 1-2-5 progression, from 10 microseconds to 5 seconds. */
+class StatHistogram
+{
+public:
+  StatHistogram(std::vector<uint64_t> boundaries, std::vector<StatCounter*> buckets, StatCounter* sum) :
+    d_boundaries(std::move(boundaries)), d_buckets(std::move(buckets)), d_sum(sum)
+  {
+  }
+
+  void operator()(uint64_t usec)
+  {
+    /* the first boundary that is not lower than usec, the last bucket if there is none */
+    auto pos = std::lower_bound(d_boundaries.cbegin(), d_boundaries.cend(), usec);
+    ++(*d_buckets[pos - d_boundaries.cbegin()]);
+    *d_sum += usec;
+  }
+
+  const std::vector<uint64_t>& getBoundaries() const
+  {
+    return d_boundaries;
+  }
+
+private:
+  const std::vector<uint64_t> d_boundaries;
+  const std::vector<StatCounter*> d_buckets;
+  StatCounter* const d_sum;
+};
+
 //! use this to gather and query statistics
 class StatBag
 {
-  map<string, std::unique_ptr<AtomicCounter>> d_stats;
+  map<string, std::unique_ptr<StatCounter>> d_stats;
   map<string, string> d_keyDescriptions;
   map<string, StatType> d_statTypes;
-  map<string,StatRing<string, CIStringCompare> >d_rings;
-  map<string,StatRing<SComboAddress> >d_comboRings;
-  map<string,StatRing<std::tuple<DNSName, QType> > >d_dnsnameqtyperings;
+  map<string,StatRing<string, CIStringCompare>, std::less<> >d_rings;
+  map<string,StatRing<SComboAddress>, std::less<> >d_comboRings;
+  map<string,StatRing<std::tuple<DNSName, QType> >, std::less<> >d_dnsnameqtyperings;
+  map<string, std::unique_ptr<StatHistogram>> d_histograms;
   typedef boost::function<uint64_t(const std::string&)> func_t;
   typedef map<string, func_t> funcstats_t;
   funcstats_t d_funcstats;
@@ -91,6 +233,11 @@ public:
   void declare(const string &key, const string &descrip="", StatType statType=StatType::counter); //!< Before you can store or access a key, you need to declare it
   void declare(const string &key, const string &descrip, func_t func, StatType statType); //!< Before you can store or access a key, you need to declare it
 
+  //! Declares the counters of a latency histogram, see StatHistogram
+  StatHistogram* declareHistogram(const string &name, const string &descrip);
+  //! Returns the histogram, or nullptr if it has not been declared
+  StatHistogram* getHistogram(const string &name);
+
   void declareRing(const string &name, const string &title, unsigned int size=10000);
   void declareComboRing(const string &name, const string &help, unsigned int size=10000);
   void declareDNSNameQTypeRing(const string &name, const string &help, unsigned int size=10000);
@@ -99,26 +246,29 @@ public:
   void ringAccount(const char* name, const string &item)
   {
     if(d_doRings)  {
-      if(!d_rings.count(name))
+      auto ring = d_rings.find(name);
+      if(ring == d_rings.end())
 	throw runtime_error("Attempting to account to non-existent ring '"+std::string(name)+"'");
 
-      d_rings[name].account(item);
+      ring->second.account(item);
     }
   }
   void ringAccount(const char* name, const ComboAddress &item)
   {
     if(d_doRings) {
-      if(!d_comboRings.count(name))
+      auto ring = d_comboRings.find(name);
+      if(ring == d_comboRings.end())
 	throw runtime_error("Attempting to account to non-existent comboRing '"+std::string(name)+"'");
-      d_comboRings[name].account(item);
+      ring->second.account(item);
     }
   }
   void ringAccount(const char* name, const DNSName &dnsname, const QType &qtype)
   {
     if(d_doRings) {
-      if(!d_dnsnameqtyperings.count(name))
+      auto ring = d_dnsnameqtyperings.find(name);
+      if(ring == d_dnsnameqtyperings.end())
 	throw runtime_error("Attempting to account to non-existent dnsname+qtype ring '"+std::string(name)+"'");
-      d_dnsnameqtyperings[name].account(std::make_tuple(dnsname, qtype));
+      ring->second.account(std::make_tuple(dnsname, qtype));
     }
   }
 
@@ -144,7 +294,7 @@ public:
   void set(const string &key, unsigned long value); //!< set this key's value
   unsigned long read(const string &key); //!< read the value behind this key
   unsigned long readZero(const string &key); //!< read the value behind this key, and zero it afterwards
-  AtomicCounter *getPointer(const string &key); //!< get a direct pointer to the value behind a key. Use this for high performance increments
+  StatCounter *getPointer(const string &key); //!< get a direct pointer to the value behind a key. Use this for high performance increments
   string getValueStr(const string &key); //!< read a value behind a key, and return it as a string
   string getValueStrZero(const string &key); //!< read a value behind a key, and return it as a string, and zero afterwards
   void blacklist(const string &str);
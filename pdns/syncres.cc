@@ -38,6 +38,12 @@
 #include "validate-recursor.hh"
 
 thread_local SyncRes::ThreadLocalStorage SyncRes::t_sstorage;
+std::atomic<bool> SyncRes::s_shareServerState{false};
+SharedServerState<SyncRes::nsspeeds_t> SyncRes::s_nsSpeeds;
+SharedServerState<SyncRes::throttle_t> SyncRes::s_throttle;
+SharedServerState<SyncRes::ednsstatus_t> SyncRes::s_ednsstatus;
+SharedServerState<fails_t<ComboAddress>> SyncRes::s_fails;
+SharedServerState<fails_t<DNSName>> SyncRes::s_nonresolving;
 thread_local std::unique_ptr<addrringbuf_t> t_timeouts;
 
 std::unique_ptr<NetmaskGroup> SyncRes::s_dontQuery{nullptr};
@@ -155,7 +161,19 @@ int SyncRes::beginResolve(const DNSName &qname, const QType qtype, QClass qclass
   }
 
   set<GetBestNSAnswer> beenthere;
-  int res=doResolve(qname, qtype, ret, depth, beenthere, state);
+  int res;
+  try {
+    res = doResolve(qname, qtype, ret, depth, beenthere, state);
+  }
+  catch (const ImmediateServFailException&) {
+    if (!serveStale(qname, qtype, ret, depth, state)) {
+      throw;
+    }
+    res = RCode::NoError;
+  }
+  if (res == RCode::ServFail && serveStale(qname, qtype, ret, depth, state)) {
+    res = RCode::NoError;
+  }
   d_queryValidationState = state;
 
   if (shouldValidate()) {
@@ -173,6 +191,36 @@ int SyncRes::beginResolve(const DNSName &qname, const QType qtype, QClass qclass
   return res;
 }
 
+/*! Called when the resolution of qname failed, usually because the authoritative
+ * servers could not be reached. If serve-stale-extensions is set, looks for expired
+ * records in the cache to answer with instead (RFC 8767), without sending any query.
+ * Returns true and replaces the content of ret if it found some.
+ */
+bool SyncRes::serveStale(const DNSName &qname, const QType qtype, vector<DNSRecord>&ret, unsigned int depth, vState& state)
+{
+  if (MemRecursorCache::s_maxServedStaleExtensions == 0 || d_refresh || d_serveStale || d_appliedPolicy.wasHit()) {
+    return false;
+  }
+
+  vector<DNSRecord> stale;
+  vState staleState = vState::Indeterminate;
+  set<GetBestNSAnswer> beenthere;
+  bool oldCacheOnly = setCacheOnly(true);
+  d_serveStale = true;
+  int res = doResolveNoQNameMinimization(qname, qtype, stale, depth, beenthere, staleState, nullptr, nullptr, false);
+  d_serveStale = false;
+  setCacheOnly(oldCacheOnly);
+
+  if (res != RCode::NoError || stale.empty()) {
+    return false;
+  }
+
+  LOG(d_prefix<<qname<<": Resolution failed, serving stale data for '"<<qname<<"|"<<qtype<<"'"<<endl);
+  ret = std::move(stale);
+  state = staleState;
+  return true;
+}
+
 /*! Handles all special, built-in names
  * Fills ret with an answer and returns true if it handled the query.
  *
@@ -437,11 +485,13 @@ uint64_t SyncRes::doEDNSDump(int fd)
   uint64_t count = 0;
 
   fprintf(fp.get(),"; edns from thread follows\n;\n");
-  for(const auto& eds : t_sstorage.ednsstatus) {
-    count++;
-    char tmp[26];
-    fprintf(fp.get(), "%s\t%d\t%s", eds.address.toString().c_str(), (int)eds.mode, ctime_r(&eds.modeSetAt, tmp));
-  }
+  visitEDNSStatus([&fp, &count](ednsstatus_t& ednsstatus) {
+    for(const auto& eds : ednsstatus) {
+      count++;
+      char tmp[26];
+      fprintf(fp.get(), "%s\t%d\t%s", eds.address.toString().c_str(), (int)eds.mode, ctime_r(&eds.modeSetAt, tmp));
+    }
+  });
   return count;
 }
 
@@ -459,19 +509,21 @@ uint64_t SyncRes::doDumpNSSpeeds(int fd)
   fprintf(fp.get(), "; nsspeed dump from thread follows\n;\n");
   uint64_t count=0;
 
-  for(const auto& i : t_sstorage.nsSpeeds)
-  {
-    count++;
-
-    // an <empty> can appear hear in case of authoritative (hosted) zones
-    fprintf(fp.get(), "%s -> ", i.first.toLogString().c_str());
-    for(const auto& j : i.second.d_collection)
+  visitNSSpeeds([&fp, &count](nsspeeds_t& nsSpeeds) {
+    for(const auto& i : nsSpeeds)
     {
-      // typedef vector<pair<ComboAddress, DecayingEwma> > collection_t;
-      fprintf(fp.get(), "%s/%f ", j.first.toString().c_str(), j.second.peek());
+      count++;
+
+      // an <empty> can appear hear in case of authoritative (hosted) zones
+      fprintf(fp.get(), "%s -> ", i.first.toLogString().c_str());
+      for(const auto& j : i.second.d_collection)
+      {
+        // typedef vector<pair<ComboAddress, DecayingEwma> > collection_t;
+        fprintf(fp.get(), "%s/%f ", j.first.toString().c_str(), j.second.peek());
+      }
+      fprintf(fp.get(), "\n");
     }
-    fprintf(fp.get(), "\n");
-  }
+  });
   return count;
 }
 
@@ -490,14 +542,16 @@ uint64_t SyncRes::doDumpThrottleMap(int fd)
   fprintf(fp.get(), "; remote IP\tqname\tqtype\tcount\tttd\n");
   uint64_t count=0;
 
-  const auto& throttleMap = t_sstorage.throttle.getThrottleMap();
-  for(const auto& i : throttleMap)
-  {
-    count++;
-    char tmp[26];
-    // remote IP, dns name, qtype, count, ttd
-    fprintf(fp.get(), "%s\t%s\t%d\t%u\t%s", i.thing.get<0>().toString().c_str(), i.thing.get<1>().toLogString().c_str(), i.thing.get<2>(), i.count, ctime_r(&i.ttd, tmp));
-  }
+  visitThrottle([&fp, &count](throttle_t& throttle) {
+    const auto& throttleMap = throttle.getThrottleMap();
+    for(const auto& i : throttleMap)
+    {
+      count++;
+      char tmp[26];
+      // remote IP, dns name, qtype, count, ttd
+      fprintf(fp.get(), "%s\t%s\t%d\t%u\t%s", i.thing.get<0>().toString().c_str(), i.thing.get<1>().toLogString().c_str(), i.thing.get<2>(), i.count, ctime_r(&i.ttd, tmp));
+    }
+  });
 
   return count;
 }
@@ -517,13 +571,15 @@ uint64_t SyncRes::doDumpFailedServers(int fd)
   fprintf(fp.get(), "; remote IP\tcount\ttimestamp\n");
   uint64_t count=0;
 
-  for(const auto& i : t_sstorage.fails.getMap())
-  {
-    count++;
-    char tmp[26];
-    ctime_r(&i.last, tmp);
-    fprintf(fp.get(), "%s\t%llu\t%s", i.key.toString().c_str(), i.value, tmp);
-  }
+  visitFails([&fp, &count](fails_t<ComboAddress>& fails) {
+    for(const auto& i : fails.getMap())
+    {
+      count++;
+      char tmp[26];
+      ctime_r(&i.last, tmp);
+      fprintf(fp.get(), "%s\t%llu\t%s", i.key.toString().c_str(), i.value, tmp);
+    }
+  });
 
   return count;
 }
@@ -543,13 +599,15 @@ uint64_t SyncRes::doDumpNonResolvingNS(int fd)
   fprintf(fp.get(), "; name\tcount\ttimestamp\n");
   uint64_t count=0;
 
-  for(const auto& i : t_sstorage.nonresolving.getMap())
-  {
-    count++;
-    char tmp[26];
-    ctime_r(&i.last, tmp);
-    fprintf(fp.get(), "%s\t%llu\t%s", i.key.toString().c_str(), i.value, tmp);
-  }
+  visitNonResolving([&fp, &count](fails_t<DNSName>& nonresolving) {
+    for(const auto& i : nonresolving.getMap())
+    {
+      count++;
+      char tmp[26];
+      ctime_r(&i.last, tmp);
+      fprintf(fp.get(), "%s\t%llu\t%s", i.key.toString().c_str(), i.value, tmp);
+    }
+  });
 
   return count;
 }
@@ -597,15 +655,21 @@ LWResult::Result SyncRes::asyncresolveWrapper(const ComboAddress& ip, bool ednsM
      If '3', send bare queries
   */
 
-  auto ednsstatus = t_sstorage.ednsstatus.insert(ip).first; // does this include port? YES
-  auto &ind = t_sstorage.ednsstatus.get<ComboAddress>();
-  if (ednsstatus->modeSetAt && ednsstatus->modeSetAt + 3600 < d_now.tv_sec) {
-    t_sstorage.ednsstatus.reset(ind, ednsstatus);
-    //    cerr<<"Resetting EDNS Status for "<<ip.toString()<<endl);
+  /* the table might be shared with other threads, so we only keep a copy of the mode
+     while the query is in flight and look the entry up again afterwards */
+  SyncRes::EDNSStatus::EDNSMode mode;
+  {
+    auto lock = lockEDNSStatus(ip);
+    auto ednsstatus = lock->insert(ip).first; // does this include port? YES
+    auto &ind = lock->get<ComboAddress>();
+    if (ednsstatus->modeSetAt && ednsstatus->modeSetAt + 3600 < d_now.tv_sec) {
+      lock->reset(ind, ednsstatus);
+      //    cerr<<"Resetting EDNS Status for "<<ip.toString()<<endl);
+    }
+    mode = ednsstatus->mode;
   }
 
-  const SyncRes::EDNSStatus::EDNSMode *mode = &ednsstatus->mode;
-  const SyncRes::EDNSStatus::EDNSMode oldmode = *mode;
+  const SyncRes::EDNSStatus::EDNSMode oldmode = mode;
   int EDNSLevel = 0;
   auto luaconfsLocal = g_luaconfs.getLocal();
   ResolveContext ctx;
@@ -618,11 +682,11 @@ LWResult::Result SyncRes::asyncresolveWrapper(const ComboAddress& ip, bool ednsM
   for(int tries = 0; tries < 3; ++tries) {
     //    cerr<<"Remote '"<<ip.toString()<<"' currently in mode "<<mode<<endl;
     
-    if (*mode == EDNSStatus::NOEDNS) {
+    if (mode == EDNSStatus::NOEDNS) {
       g_stats.noEdnsOutQueries++;
       EDNSLevel = 0; // level != mode
     }
-    else if (ednsMANDATORY || *mode == EDNSStatus::UNKNOWN || *mode == EDNSStatus::EDNSOK || *mode == EDNSStatus::EDNSIGNORANT)
+    else if (ednsMANDATORY || mode == EDNSStatus::UNKNOWN || mode == EDNSStatus::EDNSOK || mode == EDNSStatus::EDNSIGNORANT)
       EDNSLevel = 1;
 
     DNSName sendQname(domain);
@@ -635,9 +699,6 @@ LWResult::Result SyncRes::asyncresolveWrapper(const ComboAddress& ip, bool ednsM
     else {
       ret = asyncresolve(ip, sendQname, type, doTCP, sendRDQuery, EDNSLevel, now, srcmask, ctx, d_outgoingProtobufServers, d_frameStreamServers, luaconfsLocal->outgoingProtobufExportConfig.exportTypes, res, chained);
     }
-    // ednsstatus might be cleared, so do a new lookup
-    ednsstatus = t_sstorage.ednsstatus.insert(ip).first;
-    mode = &ednsstatus->mode;
     if (ret == LWResult::Result::PermanentError || ret == LWResult::Result::OSLimitError || ret == LWResult::Result::Spoofed) {
       return ret; // transport error, nothing to learn here
     }
@@ -645,26 +706,35 @@ LWResult::Result SyncRes::asyncresolveWrapper(const ComboAddress& ip, bool ednsM
     if (ret == LWResult::Result::Timeout) { // timeout, not doing anything with it now
       return ret;
     }
-    else if (*mode == EDNSStatus::UNKNOWN || *mode == EDNSStatus::EDNSOK || *mode == EDNSStatus::EDNSIGNORANT ) {
+
+    // ednsstatus might have been cleared or updated in the meantime, so do a new lookup
+    auto lock = lockEDNSStatus(ip);
+    auto ednsstatus = lock->insert(ip).first;
+    auto &ind = lock->get<ComboAddress>();
+    mode = ednsstatus->mode;
+    if (mode == EDNSStatus::UNKNOWN || mode == EDNSStatus::EDNSOK || mode == EDNSStatus::EDNSIGNORANT ) {
       if(res->d_validpacket && !res->d_haveEDNS && res->d_rcode == RCode::FormErr)  {
 	//	cerr<<"Downgrading to NOEDNS because of "<<RCode::to_s(res->d_rcode)<<" for query to "<<ip.toString()<<" for '"<<domain<<"'"<<endl;
-        t_sstorage.ednsstatus.setMode(ind, ednsstatus, EDNSStatus::NOEDNS);
+        lock->setMode(ind, ednsstatus, EDNSStatus::NOEDNS);
+        mode = EDNSStatus::NOEDNS;
         continue;
       }
       else if(!res->d_haveEDNS) {
-        if (*mode != EDNSStatus::EDNSIGNORANT) {
-          t_sstorage.ednsstatus.setMode(ind, ednsstatus, EDNSStatus::EDNSIGNORANT);
+        if (mode != EDNSStatus::EDNSIGNORANT) {
+          lock->setMode(ind, ednsstatus, EDNSStatus::EDNSIGNORANT);
+          mode = EDNSStatus::EDNSIGNORANT;
 	  //	  cerr<<"We find that "<<ip.toString()<<" is an EDNS-ignorer for '"<<domain<<"', moving to mode 2"<<endl;
 	}
       }
       else {
-        t_sstorage.ednsstatus.setMode(ind, ednsstatus, EDNSStatus::EDNSOK);
+        lock->setMode(ind, ednsstatus, EDNSStatus::EDNSOK);
+        mode = EDNSStatus::EDNSOK;
 	//	cerr<<"We find that "<<ip.toString()<<" is EDNS OK!"<<endl;
       }
     }
 
-    if (oldmode != *mode || !ednsstatus->modeSetAt) {
-      t_sstorage.ednsstatus.setTS(ind, ednsstatus, d_now.tv_sec);
+    if (oldmode != mode || !ednsstatus->modeSetAt) {
+      lock->setTS(ind, ednsstatus, d_now.tv_sec);
     }
     //    cerr<<"Result: ret="<<ret<<", EDNS-level: "<<EDNSLevel<<", haveEDNS: "<<res->d_haveEDNS<<", new mode: "<<mode<<endl;  
     return LWResult::Result::Success;
@@ -1166,13 +1236,16 @@ vector<ComboAddress> SyncRes::getAddrs(const DNSName &qname, unsigned int depth,
      is only one or none at all in the current set.
   */
   map<ComboAddress, float> speeds;
-  auto& collection = t_sstorage.nsSpeeds[qname];
-  float factor = collection.getFactor(d_now);
-  for(const auto& val: ret) {
-    speeds[val] = collection.d_collection[val].get(factor);
-  }
+  {
+    auto nsSpeeds = lockNSSpeeds(qname);
+    auto& collection = (*nsSpeeds)[qname];
+    float factor = collection.getFactor(d_now);
+    for(const auto& val: ret) {
+      speeds[val] = collection.d_collection[val].get(factor);
+    }
 
-  t_sstorage.nsSpeeds[qname].purge(speeds);
+    collection.purge(speeds);
+  }
 
   if (ret.size() > 1) {
     shuffle(ret.begin(), ret.end(), pdns::dns_random_engine());
@@ -1436,7 +1509,7 @@ bool SyncRes::doCNAMECacheCheck(const DNSName &qname, const QType qtype, vector<
   QType foundQT = QType::ENT;
 
   /* we don't require auth data for forward-recurse lookups */
-  if (g_recCache->get(d_now.tv_sec, qname, QType::CNAME, !wasForwardRecurse && d_requireAuthData, &cset, d_cacheRemote, d_refresh, d_routingTag, d_doDNSSEC ? &signatures : nullptr, d_doDNSSEC ? &authorityRecs : nullptr, &d_wasVariable, &state, &wasAuth, &authZone) > 0) {
+  if (g_recCache->get(d_now.tv_sec, qname, QType::CNAME, !wasForwardRecurse && d_requireAuthData, &cset, d_cacheRemote, getCacheFlags(), d_routingTag, d_doDNSSEC ? &signatures : nullptr, d_doDNSSEC ? &authorityRecs : nullptr, &d_wasVariable, &state, &wasAuth, &authZone) > 0) {
     foundName = qname;
     foundQT = QType::CNAME;
   }
@@ -1452,7 +1525,7 @@ bool SyncRes::doCNAMECacheCheck(const DNSName &qname, const QType qtype, vector<
       if (dnameName == qname && qtype != QType::DNAME) { // The client does not want a DNAME, but we've reached the QNAME already. So there is no match
         break;
       }
-      if (g_recCache->get(d_now.tv_sec, dnameName, QType::DNAME, !wasForwardRecurse && d_requireAuthData, &cset, d_cacheRemote, d_refresh, d_routingTag, d_doDNSSEC ? &signatures : nullptr, d_doDNSSEC ? &authorityRecs : nullptr, &d_wasVariable, &state, &wasAuth, &authZone) > 0) {
+      if (g_recCache->get(d_now.tv_sec, dnameName, QType::DNAME, !wasForwardRecurse && d_requireAuthData, &cset, d_cacheRemote, getCacheFlags(), d_routingTag, d_doDNSSEC ? &signatures : nullptr, d_doDNSSEC ? &authorityRecs : nullptr, &d_wasVariable, &state, &wasAuth, &authZone) > 0) {
         foundName = dnameName;
         foundQT = QType::DNAME;
         break;
@@ -1838,7 +1911,7 @@ bool SyncRes::doCacheCheck(const DNSName &qname, const DNSName& authname, bool w
   uint32_t capTTL = std::numeric_limits<uint32_t>::max();
   bool wasCachedAuth;
 
-  if(g_recCache->get(d_now.tv_sec, sqname, sqt, !wasForwardRecurse && d_requireAuthData, &cset, d_cacheRemote, d_refresh, d_routingTag, d_doDNSSEC ? &signatures : nullptr, d_doDNSSEC ? &authorityRecs : nullptr, &d_wasVariable, &cachedState, &wasCachedAuth) > 0) {
+  if(g_recCache->get(d_now.tv_sec, sqname, sqt, !wasForwardRecurse && d_requireAuthData, &cset, d_cacheRemote, getCacheFlags(), d_routingTag, d_doDNSSEC ? &signatures : nullptr, d_doDNSSEC ? &authorityRecs : nullptr, &d_wasVariable, &cachedState, &wasCachedAuth) > 0) {
 
     LOG(prefix<<sqname<<": Found cache hit for "<<sqt.toString()<<": ");
 
@@ -1972,7 +2045,7 @@ inline std::vector<std::pair<DNSName, float>> SyncRes::shuffleInSpeedOrder(NsSet
   std::vector<std::pair<DNSName, float>> rnameservers;
   rnameservers.reserve(tnameservers.size());
   for(const auto& tns: tnameservers) {
-    float speed = t_sstorage.nsSpeeds[tns.first].get(d_now);
+    float speed = (*lockNSSpeeds(tns.first))[tns.first].get(d_now);
     rnameservers.push_back({tns.first, speed});
     if(tns.first.empty()) // this was an authoritative OOB zone, don't pollute the nsSpeeds with that
       return rnameservers;
@@ -2006,7 +2079,7 @@ inline vector<ComboAddress> SyncRes::shuffleForwardSpeed(const vector<ComboAddre
   for(const auto& val: nameservers) {
     float speed;
     DNSName nsName = DNSName(val.toStringWithPort());
-    speed=t_sstorage.nsSpeeds[nsName].get(d_now);
+    speed=(*lockNSSpeeds(nsName))[nsName].get(d_now);
     speeds[val]=speed;
   }
   shuffle(nameservers.begin(),nameservers.end(), pdns::dns_random_engine());
@@ -2310,7 +2383,7 @@ vector<ComboAddress> SyncRes::retrieveAddressesForNS(const std::string& prefix,
   size_t nonresolvingfails = 0;
   if (!tns->first.empty()) {
     if (s_nonresolvingnsmaxfails > 0) {
-      nonresolvingfails = t_sstorage.nonresolving.value(tns->first);
+      nonresolvingfails = lockNonResolving(tns->first)->value(tns->first);
       if (nonresolvingfails >= s_nonresolvingnsmaxfails) {
         LOG(prefix<<qname<<": NS "<<tns->first<< " in non-resolving map, skipping"<<endl);
         return result;
@@ -2327,7 +2400,7 @@ vector<ComboAddress> SyncRes::retrieveAddressesForNS(const std::string& prefix,
       if (s_nonresolvingnsmaxfails > 0 && d_outqueries > oldOutQueries) {
         auto dontThrottleNames = g_dontThrottleNames.getLocal();
         if (!dontThrottleNames->check(tns->first)) {
-          t_sstorage.nonresolving.incr(tns->first, d_now);
+          lockNonResolving(tns->first)->incr(tns->first, d_now);
         }
       }
       throw ex;
@@ -2336,12 +2409,12 @@ vector<ComboAddress> SyncRes::retrieveAddressesForNS(const std::string& prefix,
       if (result.empty()) {
         auto dontThrottleNames = g_dontThrottleNames.getLocal();
         if (!dontThrottleNames->check(tns->first)) {
-          t_sstorage.nonresolving.incr(tns->first, d_now);
+          lockNonResolving(tns->first)->incr(tns->first, d_now);
         }
       }
       else if (nonresolvingfails > 0) {
         // Succeeding resolve, clear memory of recent failures
-        t_sstorage.nonresolving.clear(tns->first);
+        lockNonResolving(tns->first)->clear(tns->first);
       }
     }
     pierceDontQuery=false;
@@ -2363,12 +2436,12 @@ vector<ComboAddress> SyncRes::retrieveAddressesForNS(const std::string& prefix,
 
 bool SyncRes::throttledOrBlocked(const std::string& prefix, const ComboAddress& remoteIP, const DNSName& qname, const QType qtype, bool pierceDontQuery)
 {
-  if(t_sstorage.throttle.shouldThrottle(d_now.tv_sec, boost::make_tuple(remoteIP, "", 0))) {
+  if(isThrottled(d_now.tv_sec, remoteIP)) {
     LOG(prefix<<qname<<": server throttled "<<endl);
     s_throttledqueries++; d_throttledqueries++;
     return true;
   }
-  else if(t_sstorage.throttle.shouldThrottle(d_now.tv_sec, boost::make_tuple(remoteIP, qname, qtype.getCode()))) {
+  else if(isThrottled(d_now.tv_sec, remoteIP, qname, qtype.getCode())) {
     LOG(prefix<<qname<<": query throttled "<<remoteIP.toString()<<", "<<qname<<"; "<<qtype<<endl);
     s_throttledqueries++; d_throttledqueries++;
     return true;
@@ -4003,21 +4076,21 @@ bool SyncRes::doResolveAtThisIP(const std::string& prefix, const DNSName& qname,
     if (resolveret != LWResult::Result::OSLimitError && !chained && !dontThrottle) {
       // don't account for resource limits, they are our own fault
       // And don't throttle when the IP address is on the dontThrottleNetmasks list or the name is part of dontThrottleNames
-      t_sstorage.nsSpeeds[nsName.empty()? DNSName(remoteIP.toStringWithPort()) : nsName].submit(remoteIP, 1000000, d_now); // 1 sec
+      submitNSSpeed(nsName.empty()? DNSName(remoteIP.toStringWithPort()) : nsName, remoteIP, 1000000, d_now); // 1 sec
 
       // code below makes sure we don't filter COM or the root
-      if (s_serverdownmaxfails > 0 && (auth != g_rootdnsname) && t_sstorage.fails.incr(remoteIP, d_now) >= s_serverdownmaxfails) {
+      if (s_serverdownmaxfails > 0 && (auth != g_rootdnsname) && lockFails(remoteIP)->incr(remoteIP, d_now) >= s_serverdownmaxfails) {
         LOG(prefix<<qname<<": Max fails reached resolving on "<< remoteIP.toString() <<". Going full throttle for "<< s_serverdownthrottletime <<" seconds" <<endl);
         // mark server as down
-        t_sstorage.throttle.throttle(d_now.tv_sec, boost::make_tuple(remoteIP, "", 0), s_serverdownthrottletime, 10000);
+        doThrottle(d_now.tv_sec, remoteIP, s_serverdownthrottletime, 10000);
       }
       else if (resolveret == LWResult::Result::Timeout) {
         // unreachable, 1 minute or 100 queries
-        t_sstorage.throttle.throttle(d_now.tv_sec, boost::make_tuple(remoteIP, qname, qtype.getCode()), 60, 100);
+        doThrottle(d_now.tv_sec, remoteIP, qname, qtype.getCode(), 60, 100);
       }
       else {
         // timeout, 10 seconds or 5 queries
-        t_sstorage.throttle.throttle(d_now.tv_sec, boost::make_tuple(remoteIP, qname, qtype.getCode()), 10, 5);
+        doThrottle(d_now.tv_sec, remoteIP, qname, qtype.getCode(), 10, 5);
       }
     }
 
@@ -4029,14 +4102,14 @@ bool SyncRes::doResolveAtThisIP(const std::string& prefix, const DNSName& qname,
     if (!chained && !dontThrottle) {
 
       // let's make sure we prefer a different server for some time, if there is one available
-      t_sstorage.nsSpeeds[nsName.empty()? DNSName(remoteIP.toStringWithPort()) : nsName].submit(remoteIP, 1000000, d_now); // 1 sec
+      submitNSSpeed(nsName.empty()? DNSName(remoteIP.toStringWithPort()) : nsName, remoteIP, 1000000, d_now); // 1 sec
 
       if (doTCP) {
         // we can be more heavy-handed over TCP
-        t_sstorage.throttle.throttle(d_now.tv_sec, boost::make_tuple(remoteIP, qname, qtype.getCode()), 60, 10);
+        doThrottle(d_now.tv_sec, remoteIP, qname, qtype.getCode(), 60, 10);
       }
       else {
-        t_sstorage.throttle.throttle(d_now.tv_sec, boost::make_tuple(remoteIP, qname, qtype.getCode()), 10, 2);
+        doThrottle(d_now.tv_sec, remoteIP, qname, qtype.getCode(), 10, 2);
       }
     }
     return false;
@@ -4050,10 +4123,10 @@ bool SyncRes::doResolveAtThisIP(const std::string& prefix, const DNSName& qname,
           // rather than throttling what could be the only server we have for this destination, let's make sure we try a different one if there is one available
           // on the other hand, we might keep hammering a server under attack if there is no other alternative, or the alternative is overwhelmed as well, but
           // at the very least we will detect that if our packets stop being answered
-          t_sstorage.nsSpeeds[nsName.empty()? DNSName(remoteIP.toStringWithPort()) : nsName].submit(remoteIP, 1000000, d_now); // 1 sec
+          submitNSSpeed(nsName.empty()? DNSName(remoteIP.toStringWithPort()) : nsName, remoteIP, 1000000, d_now); // 1 sec
         }
         else {
-          t_sstorage.throttle.throttle(d_now.tv_sec, boost::make_tuple(remoteIP, qname, qtype.getCode()), 60, 3);
+          doThrottle(d_now.tv_sec, remoteIP, qname, qtype.getCode(), 60, 3);
         }
       }
       return false;
@@ -4062,7 +4135,7 @@ bool SyncRes::doResolveAtThisIP(const std::string& prefix, const DNSName& qname,
 
   /* this server sent a valid answer, mark it backup up if it was down */
   if(s_serverdownmaxfails > 0) {
-    t_sstorage.fails.clear(remoteIP);
+    lockFails(remoteIP)->clear(remoteIP);
   }
 
   if (lwr.d_tcbit) {
@@ -4072,7 +4145,7 @@ bool SyncRes::doResolveAtThisIP(const std::string& prefix, const DNSName& qname,
       LOG(prefix<<qname<<": truncated bit set, over TCP?"<<endl);
       if (!dontThrottle) {
         /* let's treat that as a ServFail answer from this server */
-        t_sstorage.throttle.throttle(d_now.tv_sec, boost::make_tuple(remoteIP, qname, qtype.getCode()), 60, 3);
+        doThrottle(d_now.tv_sec, remoteIP, qname, qtype.getCode(), 60, 3);
       }
       return false;
     }
@@ -4452,7 +4525,7 @@ int SyncRes::doResolveAt(NsSet &nameservers, DNSName auth, bool flawedNSSet, con
           */
           //        cout<<"msec: "<<lwr.d_usec/1000.0<<", "<<g_avgLatency/1000.0<<'\n';
 
-          t_sstorage.nsSpeeds[tns->first.empty()? DNSName(remoteIP->toStringWithPort()) : tns->first].submit(*remoteIP, lwr.d_usec, d_now);
+          submitNSSpeed(tns->first.empty()? DNSName(remoteIP->toStringWithPort()) : tns->first, *remoteIP, lwr.d_usec, d_now);
 
           /* we have received an answer, are we done ? */
           bool done = processAnswer(depth, lwr, qname, qtype, auth, wasForwarded, ednsmask, sendRDQuery, nameservers, ret, luaconfsLocal->dfe, &gotNewServers, &rcode, state, *remoteIP);
@@ -4467,7 +4540,7 @@ int SyncRes::doResolveAt(NsSet &nameservers, DNSName auth, bool flawedNSSet, con
             break;
           }
           /* was lame */
-          t_sstorage.throttle.throttle(d_now.tv_sec, boost::make_tuple(*remoteIP, qname, qtype.getCode()), 60, 100);
+          doThrottle(d_now.tv_sec, *remoteIP, qname, qtype.getCode(), 60, 100);
         }
 
         if (gotNewServers) {
@@ -4545,6 +4618,7 @@ void SyncRes::parseEDNSSubnetAllowlist(const std::string& alist)
       s_ednsdomains.add(DNSName(a));
     }
   }
+  s_ednsdomains.freeze();
 }
 
 void SyncRes::parseEDNSSubnetAddFor(const std::string& subnetlist)
@@ -22,6 +22,7 @@
 #pragma once
 #include <string>
 #include <atomic>
+#include <mutex>
 #include "utility.hh"
 #include "dns.hh"
 #include "qtype.hh"
@@ -168,8 +169,11 @@ public:
       d_val = val;
     }
     else {
-      float diff = makeFloat(d_last - now);
-      d_last = now;
+      // when shared between threads, submissions can arrive slightly out of order
+      float diff = std::min(makeFloat(d_last - now), 0.0f);
+      if (d_last < now) {
+        d_last = now;
+      }
       float factor = expf(diff)/2.0f; // might be '0.5', or 0.0001
       d_val = (1-factor)*val + factor*d_val;
     }
@@ -258,6 +262,81 @@ private:
   cont_t d_cont;
 };
 
+/** Gives access to one of the per-authoritative-server tables (speeds, throttle, EDNS status, failures).
+    When the table is the thread-local copy no lock is taken, otherwise the holder owns the lock of the
+    shard the table lives in until it goes out of scope. Never keep a holder across a call that might yield.
+*/
+template <typename T>
+class ServerStateHolder
+{
+public:
+  explicit ServerStateHolder(T& value): d_value(value)
+  {
+  }
+
+  explicit ServerStateHolder(T& value, std::mutex& mutex): d_lock(mutex), d_value(value)
+  {
+  }
+
+  T& operator*() const noexcept
+  {
+    return d_value;
+  }
+
+  T* operator->() const noexcept
+  {
+    return &d_value;
+  }
+
+private:
+  std::unique_lock<std::mutex> d_lock;
+  T& d_value;
+};
+
+/** A process-wide copy of a per-authoritative-server table, split into shards
+    protected by their own mutex so that worker threads rarely contend.
+*/
+template <typename T>
+class SharedServerState : public boost::noncopyable
+{
+public:
+  explicit SharedServerState(size_t shards = 1): d_shards(shards)
+  {
+  }
+
+  ServerStateHolder<T> lock(size_t hash)
+  {
+    auto& shard = d_shards.at(hash % d_shards.size());
+    return ServerStateHolder<T>(shard.d_value, shard.d_mutex);
+  }
+
+  template <typename F>
+  void visit(F f)
+  {
+    for (auto& shard : d_shards) {
+      std::lock_guard<std::mutex> lock(shard.d_mutex);
+      f(shard.d_value);
+    }
+  }
+
+  void resize(size_t shards)
+  {
+    if (shards == 0) {
+      shards = 1;
+    }
+    d_shards = std::vector<Shard>(shards);
+  }
+
+private:
+  struct Shard
+  {
+    std::mutex d_mutex;
+    T d_value;
+  };
+
+  std::vector<Shard> d_shards;
+};
+
 extern std::unique_ptr<NegCache> g_negCache;
 
 class SyncRes : public boost::noncopyable
@@ -278,7 +357,7 @@ public:
     }
 
     float getFactor(const struct timeval &now) {
-      float diff = makeFloat(d_lastget - now);
+      float diff = std::min(makeFloat(d_lastget - now), 0.0f);
       return expf(diff / 60.0f); // is 1.0 or less
     }
     
@@ -299,7 +378,9 @@ public:
           ret = tmp;
         }
       }
-      d_lastget = now;
+      if (d_lastget < now) {
+        d_lastget = now;
+      }
       return ret;
     }
 
@@ -469,102 +550,155 @@ public:
   }
   static void pruneNSSpeeds(time_t limit)
   {
-    for(auto i = t_sstorage.nsSpeeds.begin(), end = t_sstorage.nsSpeeds.end(); i != end; ) {
-      if(i->second.stale(limit)) {
-        i = t_sstorage.nsSpeeds.erase(i);
-      }
-      else {
-        ++i;
+    visitNSSpeeds([limit](nsspeeds_t& nsSpeeds) {
+      for(auto i = nsSpeeds.begin(), end = nsSpeeds.end(); i != end; ) {
+        if(i->second.stale(limit)) {
+          i = nsSpeeds.erase(i);
+        }
+        else {
+          ++i;
+        }
       }
-    }
+    });
   }
   static uint64_t getNSSpeedsSize()
   {
-    return t_sstorage.nsSpeeds.size();
+    uint64_t count = 0;
+    visitNSSpeeds([&count](nsspeeds_t& nsSpeeds) { count += nsSpeeds.size(); });
+    return count;
   }
   static void submitNSSpeed(const DNSName& server, const ComboAddress& ca, uint32_t usec, const struct timeval& now)
   {
-    t_sstorage.nsSpeeds[server].submit(ca, usec, now);
+    (*lockNSSpeeds(server))[server].submit(ca, usec, now);
   }
   static void clearNSSpeeds()
   {
-    t_sstorage.nsSpeeds.clear();
+    visitNSSpeeds([](nsspeeds_t& nsSpeeds) { nsSpeeds.clear(); });
   }
   static float getNSSpeed(const DNSName& server, const ComboAddress& ca)
   {
-    return t_sstorage.nsSpeeds[server].d_collection[ca].peek();
+    return (*lockNSSpeeds(server))[server].d_collection[ca].peek();
   }
   static EDNSStatus::EDNSMode getEDNSStatus(const ComboAddress& server)
   {
-    const auto& it = t_sstorage.ednsstatus.find(server);
-    if (it == t_sstorage.ednsstatus.end())
+    auto ednsstatus = lockEDNSStatus(server);
+    const auto& it = ednsstatus->find(server);
+    if (it == ednsstatus->end())
       return EDNSStatus::UNKNOWN;
 
     return it->mode;
   }
   static uint64_t getEDNSStatusesSize()
   {
-    return t_sstorage.ednsstatus.size();
+    uint64_t count = 0;
+    visitEDNSStatus([&count](ednsstatus_t& ednsstatus) { count += ednsstatus.size(); });
+    return count;
   }
   static void clearEDNSStatuses()
   {
-    t_sstorage.ednsstatus.clear();
+    visitEDNSStatus([](ednsstatus_t& ednsstatus) { ednsstatus.clear(); });
   }
   static void pruneEDNSStatuses(time_t cutoff)
   {
-    t_sstorage.ednsstatus.prune(cutoff);
+    visitEDNSStatus([cutoff](ednsstatus_t& ednsstatus) { ednsstatus.prune(cutoff); });
   }
   static uint64_t getThrottledServersSize()
   {
-    return t_sstorage.throttle.size();
+    uint64_t count = 0;
+    visitThrottle([&count](throttle_t& throttle) { count += throttle.size(); });
+    return count;
   }
   static void pruneThrottledServers()
   {
-    t_sstorage.throttle.prune();
+    visitThrottle([](throttle_t& throttle) { throttle.prune(); });
   }
   static void clearThrottle()
   {
-    t_sstorage.throttle.clear();
+    visitThrottle([](throttle_t& throttle) { throttle.clear(); });
   }
   static bool isThrottled(time_t now, const ComboAddress& server, const DNSName& target, uint16_t qtype)
   {
-    return t_sstorage.throttle.shouldThrottle(now, boost::make_tuple(server, target, qtype));
+    return lockThrottle(server)->shouldThrottle(now, boost::make_tuple(server, target, qtype));
   }
   static bool isThrottled(time_t now, const ComboAddress& server)
   {
-    return t_sstorage.throttle.shouldThrottle(now, boost::make_tuple(server, "", 0));
+    return lockThrottle(server)->shouldThrottle(now, boost::make_tuple(server, "", 0));
   }
   static void doThrottle(time_t now, const ComboAddress& server, time_t duration, unsigned int tries)
   {
-    t_sstorage.throttle.throttle(now, boost::make_tuple(server, "", 0), duration, tries);
+    lockThrottle(server)->throttle(now, boost::make_tuple(server, "", 0), duration, tries);
+  }
+  static void doThrottle(time_t now, const ComboAddress& server, const DNSName& target, uint16_t qtype, time_t duration, unsigned int tries)
+  {
+    lockThrottle(server)->throttle(now, boost::make_tuple(server, target, qtype), duration, tries);
   }
   static uint64_t getFailedServersSize()
   {
-    return t_sstorage.fails.size();
+    uint64_t count = 0;
+    visitFails([&count](fails_t<ComboAddress>& fails) { count += fails.size(); });
+    return count;
   }
   static uint64_t getNonResolvingNSSize()
   {
-    return t_sstorage.nonresolving.size();
+    uint64_t count = 0;
+    visitNonResolving([&count](fails_t<DNSName>& nonresolving) { count += nonresolving.size(); });
+    return count;
   }
   static void clearFailedServers()
   {
-    t_sstorage.fails.clear();
+    visitFails([](fails_t<ComboAddress>& fails) { fails.clear(); });
   }
   static void clearNonResolvingNS()
   {
-    t_sstorage.nonresolving.clear();
+    visitNonResolving([](fails_t<DNSName>& nonresolving) { nonresolving.clear(); });
   }
   static void pruneFailedServers(time_t cutoff)
   {
-    t_sstorage.fails.prune(cutoff);
+    visitFails([cutoff](fails_t<ComboAddress>& fails) { fails.prune(cutoff); });
   }
   static unsigned long getServerFailsCount(const ComboAddress& server)
   {
-    return t_sstorage.fails.value(server);
+    return lockFails(server)->value(server);
   }
   static void pruneNonResolving(time_t cutoff)
   {
-    t_sstorage.nonresolving.prune(cutoff);
+    visitNonResolving([cutoff](fails_t<DNSName>& nonresolving) { nonresolving.prune(cutoff); });
+  }
+  /* Whether the per-authoritative-server tables (speeds, throttle, EDNS status, failed and
+     non-resolving servers) are shared by all threads instead of being kept per thread. */
+  static bool isServerStateShared()
+  {
+    return s_shareServerState.load();
+  }
+  static void setServerStateShared(bool shared)
+  {
+    s_shareServerState.store(shared);
+  }
+  static void setServerStateShards(size_t shards)
+  {
+    s_nsSpeeds.resize(shards);
+    s_throttle.resize(shards);
+    s_ednsstatus.resize(shards);
+    s_fails.resize(shards);
+    s_nonresolving.resize(shards);
+  }
+  /* Drops the content of the shared tables, used once the threads have gone back to their own */
+  static void clearSharedServerState()
+  {
+    s_nsSpeeds.visit([](nsspeeds_t& nsSpeeds) { nsSpeeds.clear(); });
+    s_throttle.visit([](throttle_t& throttle) { throttle.clear(); });
+    s_ednsstatus.visit([](ednsstatus_t& ednsstatus) { ednsstatus.clear(); });
+    s_fails.visit([](fails_t<ComboAddress>& fails) { fails.clear(); });
+    s_nonresolving.visit([](fails_t<DNSName>& nonresolving) { nonresolving.clear(); });
+  }
+  /* Drops the content of the thread-local tables, used once the shared ones have taken over */
+  static void clearLocalServerState()
+  {
+    t_sstorage.nsSpeeds.clear();
+    t_sstorage.throttle.clear();
+    t_sstorage.ednsstatus.clear();
+    t_sstorage.fails.clear();
+    t_sstorage.nonresolving.clear();
   }
   static void setDomainMap(std::shared_ptr<domainmap_t> newMap)
   {
@@ -628,6 +762,11 @@ public:
     return old;
   }
 
+  MemRecursorCache::Flags getCacheFlags() const
+  {
+    return (d_refresh ? MemRecursorCache::Refresh : MemRecursorCache::None) | (d_serveStale ? MemRecursorCache::ServeStale : MemRecursorCache::None);
+  }
+
   void setQNameMinimization(bool state=true)
   {
     d_qNameMinimization=state;
@@ -815,6 +954,78 @@ private:
   static std::unique_ptr<NetmaskGroup> s_dontQuery;
   const static std::unordered_set<QType> s_redirectionQTypes;
 
+  static std::atomic<bool> s_shareServerState;
+  static SharedServerState<nsspeeds_t> s_nsSpeeds;
+  static SharedServerState<throttle_t> s_throttle;
+  static SharedServerState<ednsstatus_t> s_ednsstatus;
+  static SharedServerState<fails_t<ComboAddress>> s_fails;
+  static SharedServerState<fails_t<DNSName>> s_nonresolving;
+
+  template <typename T>
+  static ServerStateHolder<T> lockServerState(T& local, SharedServerState<T>& shared, size_t hash)
+  {
+    if (s_shareServerState.load(std::memory_order_relaxed)) {
+      return shared.lock(hash);
+    }
+    return ServerStateHolder<T>(local);
+  }
+  template <typename T, typename F>
+  static void visitServerState(T& local, SharedServerState<T>& shared, F f)
+  {
+    if (s_shareServerState.load(std::memory_order_relaxed)) {
+      shared.visit(f);
+    }
+    else {
+      f(local);
+    }
+  }
+
+  static ServerStateHolder<nsspeeds_t> lockNSSpeeds(const DNSName& server)
+  {
+    return lockServerState(t_sstorage.nsSpeeds, s_nsSpeeds, server.hash());
+  }
+  static ServerStateHolder<throttle_t> lockThrottle(const ComboAddress& server)
+  {
+    return lockServerState(t_sstorage.throttle, s_throttle, ComboAddress::addressOnlyHash()(server));
+  }
+  static ServerStateHolder<ednsstatus_t> lockEDNSStatus(const ComboAddress& server)
+  {
+    return lockServerState(t_sstorage.ednsstatus, s_ednsstatus, ComboAddress::addressOnlyHash()(server));
+  }
+  static ServerStateHolder<fails_t<ComboAddress>> lockFails(const ComboAddress& server)
+  {
+    return lockServerState(t_sstorage.fails, s_fails, ComboAddress::addressOnlyHash()(server));
+  }
+  static ServerStateHolder<fails_t<DNSName>> lockNonResolving(const DNSName& server)
+  {
+    return lockServerState(t_sstorage.nonresolving, s_nonresolving, server.hash());
+  }
+  template <typename F>
+  static void visitNSSpeeds(F f)
+  {
+    visitServerState(t_sstorage.nsSpeeds, s_nsSpeeds, f);
+  }
+  template <typename F>
+  static void visitThrottle(F f)
+  {
+    visitServerState(t_sstorage.throttle, s_throttle, f);
+  }
+  template <typename F>
+  static void visitEDNSStatus(F f)
+  {
+    visitServerState(t_sstorage.ednsstatus, s_ednsstatus, f);
+  }
+  template <typename F>
+  static void visitFails(F f)
+  {
+    visitServerState(t_sstorage.fails, s_fails, f);
+  }
+  template <typename F>
+  static void visitNonResolving(F f)
+  {
+    visitServerState(t_sstorage.nonresolving, s_nonresolving, f);
+  }
+
   struct GetBestNSAnswer
   {
     DNSName qname;
@@ -837,6 +1048,7 @@ private:
   bool processAnswer(unsigned int depth, LWResult& lwr, const DNSName& qname, const QType qtype, DNSName& auth, bool wasForwarded, const boost::optional<Netmask> ednsmask, bool sendRDQuery, NsSet &nameservers, std::vector<DNSRecord>& ret, const DNSFilterEngine& dfe, bool* gotNewServers, int* rcode, vState& state, const ComboAddress& remoteIP);
 
   int doResolve(const DNSName &qname, QType qtype, vector<DNSRecord>&ret, unsigned int depth, set<GetBestNSAnswer>& beenthere, vState& state);
+  bool serveStale(const DNSName &qname, QType qtype, vector<DNSRecord>&ret, unsigned int depth, vState& state);
   int doResolveNoQNameMinimization(const DNSName &qname, QType qtype, vector<DNSRecord>&ret, unsigned int depth, set<GetBestNSAnswer>& beenthere, vState& state, bool* fromCache = NULL, StopAtDelegation* stopAtDelegation = NULL, bool considerforwards = true);
   bool doOOBResolve(const AuthDomain& domain, const DNSName &qname, QType qtype, vector<DNSRecord>&ret, int& res);
   bool doOOBResolve(const DNSName &qname, QType qtype, vector<DNSRecord>&ret, unsigned int depth, int &res);
@@ -926,6 +1138,7 @@ private:
   bool d_queryReceivedOverTCP{false};
   bool d_followCNAME{true};
   bool d_refresh{false};
+  bool d_serveStale{false};
 
   LogMode d_lm;
 };
@@ -1068,6 +1281,7 @@ struct RecursorStats
   std::atomic<uint64_t> dnssecCheckDisabledQueries;
   std::atomic<uint64_t> variableResponses;
   std::atomic<uint64_t> maxMThreadStackUsage;
+  std::atomic<uint64_t> maxMThreadStackHighWater{0};
   std::atomic<uint64_t> dnssecValidations; // should be the sum of all dnssecResult* stats
   std::map<vState, std::atomic<uint64_t> > dnssecResults;
   std::map<vState, std::atomic<uint64_t> > xdnssecResults;
@@ -1077,6 +1291,8 @@ struct RecursorStats
   std::atomic<uint64_t> proxyProtocolInvalidCount{0};
   std::atomic<uint64_t> nodLookupsDroppedOversize{0};
   std::atomic<uint64_t> dns64prefixanswers{0};
+  std::atomic<uint64_t> udpPoolReuses{0};
+  std::atomic<uint64_t> udpPoolSockets{0};
 
   RecursorStats() :
     answers("answers", { 1000, 10000, 100000, 1000000 }),
@@ -1169,6 +1385,8 @@ int getFakeAAAARecords(const DNSName& qname, ComboAddress prefix, vector<DNSReco
 int getFakePTRRecords(const DNSName& qname, vector<DNSRecord>& ret);
 
 template<class T> T broadcastAccFunction(const boost::function<T*()>& func);
+uint64_t serverStateAccFunction(const boost::function<uint64_t*()>& func);
+uint64_t getOutgoingUDPPortEntropy();
 
 std::shared_ptr<SyncRes::domainmap_t> parseAuthAndForwards();
 uint64_t* pleaseGetNsSpeedsSize();
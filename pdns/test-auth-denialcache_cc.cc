@@ -0,0 +1,156 @@
+/*
+    PowerDNS Versatile Database Driven Nameserver
+    Copyright (C) 2021  PowerDNS.COM BV
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2
+    as published by the Free Software Foundation
+
+    Additionally, the license of this program contains a special
+    exception which allows to distribute the program in binary form when
+    it is linked against OpenSSL.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_NO_MAIN
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <boost/test/unit_test.hpp>
+
+#include "auth-denialcache.hh"
+
+BOOST_AUTO_TEST_SUITE(test_auth_denialcache_cc)
+
+BOOST_AUTO_TEST_CASE(test_disabled)
+{
+  AuthDenialCache cache;
+  const DNSName zone("example.org.");
+
+  cache.insertGap(1, zone, DNSName("a.example.org."), DNSName("c.example.org."));
+  BOOST_CHECK_EQUAL(cache.size(), 0U);
+  BOOST_CHECK(!cache.isAbsent(1, DNSName("b.example.org.")));
+}
+
+BOOST_AUTO_TEST_CASE(test_gaps)
+{
+  AuthDenialCache cache;
+  cache.setTTL(3600);
+  const DNSName zone("example.org.");
+
+  /* example.org, *.example.org, a.example.org, mail.a.example.org, www.example.org */
+  cache.insertGap(1, zone, DNSName("*.example.org."), DNSName("a.example.org."));
+  cache.insertGap(1, zone, DNSName("mail.a.example.org."), DNSName("www.example.org."));
+  /* last one, wrapping around to the apex */
+  cache.insertGap(1, zone, DNSName("www.example.org."), zone);
+  BOOST_CHECK_EQUAL(cache.size(), 3U);
+
+  DNSName before, after;
+  BOOST_CHECK(cache.getGap(1, DNSName("0.example.org."), before, after));
+  BOOST_CHECK_EQUAL(before, DNSName("*.example.org."));
+  BOOST_CHECK_EQUAL(after, DNSName("a.example.org."));
+  /* below the wildcard itself */
+  BOOST_CHECK(cache.isAbsent(1, DNSName("foo.*.example.org.")));
+
+  /* names that do exist, or which are outside of the known gaps */
+  BOOST_CHECK(!cache.isAbsent(1, zone));
+  BOOST_CHECK(!cache.isAbsent(1, DNSName("*.example.org.")));
+  BOOST_CHECK(!cache.isAbsent(1, DNSName("a.example.org.")));
+  BOOST_CHECK(!cache.isAbsent(1, DNSName("b.a.example.org.")));
+  BOOST_CHECK(!cache.isAbsent(1, DNSName("mail.a.example.org.")));
+  BOOST_CHECK(!cache.isAbsent(1, DNSName("www.example.org.")));
+  BOOST_CHECK(!cache.isAbsent(1, DNSName("!.example.org.")));
+
+  /* canonical order puts names below mail.a after it */
+  BOOST_CHECK(cache.isAbsent(1, DNSName("x.mail.a.example.org.")));
+  BOOST_CHECK(cache.isAbsent(1, DNSName("random123.example.org.")));
+  BOOST_CHECK(cache.isAbsent(1, DNSName("RANDOM123.example.org.")));
+  BOOST_CHECK(cache.getGap(1, DNSName("zzz.example.org."), before, after));
+  BOOST_CHECK_EQUAL(before, DNSName("www.example.org."));
+  BOOST_CHECK_EQUAL(after, zone);
+  BOOST_CHECK(cache.isAbsent(1, DNSName("x.www.example.org.")));
+
+  /* other zones and other ids know nothing */
+  BOOST_CHECK(!cache.isAbsent(2, DNSName("random123.example.org.")));
+  BOOST_CHECK(!cache.isAbsent(1, DNSName("random123.example.net.")));
+}
+
+BOOST_AUTO_TEST_CASE(test_empty_non_terminals)
+{
+  AuthDenialCache cache;
+  cache.setTTL(3600);
+  const DNSName zone("example.org.");
+
+  /* example.org, a.example.org, x.y.b.example.org, z.example.org: b and y.b are empty non-terminals,
+     which have no ordername in NSEC zones */
+  cache.insertGap(1, zone, DNSName("a.example.org."), DNSName("x.y.b.example.org."));
+  cache.insertGap(1, zone, DNSName("x.y.b.example.org."), DNSName("z.example.org."));
+
+  /* they do exist */
+  DNSName before, after;
+  BOOST_CHECK(!cache.getGap(1, DNSName("b.example.org."), before, after));
+  BOOST_CHECK(!cache.getGap(1, DNSName("y.b.example.org."), before, after));
+  BOOST_CHECK(!cache.isAbsent(1, DNSName("B.example.org.")));
+
+  /* but their other children do not */
+  BOOST_CHECK(cache.isAbsent(1, DNSName("c.b.example.org.")));
+  BOOST_CHECK(cache.isAbsent(1, DNSName("*.b.example.org.")));
+  BOOST_CHECK(cache.isAbsent(1, DNSName("c.y.b.example.org.")));
+  BOOST_CHECK(cache.isAbsent(1, DNSName("c.example.org.")));
+}
+
+BOOST_AUTO_TEST_CASE(test_purge)
+{
+  AuthDenialCache cache;
+  cache.setTTL(3600);
+  const DNSName zone("example.org.");
+  const DNSName sub("sub.example.org.");
+
+  cache.insertGap(1, zone, zone, DNSName("b.example.org."));
+  cache.insertGap(2, sub, sub, DNSName("b.sub.example.org."));
+  cache.insertGap(3, DNSName("example.net."), DNSName("example.net."), DNSName("b.example.net."));
+  BOOST_CHECK_EQUAL(cache.size(), 3U);
+
+  /* a change to a name removes the zone containing it */
+  BOOST_CHECK_EQUAL(cache.purgeExact(DNSName("a.example.net.")), 1U);
+  BOOST_CHECK_EQUAL(cache.size(), 2U);
+  BOOST_CHECK(!cache.isAbsent(3, DNSName("a.example.net.")));
+
+  /* sub is below example.org, and example.org is its parent */
+  BOOST_CHECK_EQUAL(cache.purge("sub.example.org$"), 2U);
+  BOOST_CHECK_EQUAL(cache.size(), 0U);
+
+  cache.insertGap(1, zone, zone, DNSName("b.example.org."));
+  BOOST_CHECK_EQUAL(cache.purge(), 1U);
+  BOOST_CHECK_EQUAL(cache.size(), 0U);
+}
+
+BOOST_AUTO_TEST_CASE(test_max_entries)
+{
+  AuthDenialCache cache;
+  cache.setTTL(3600);
+  cache.setMaxEntries(2);
+  const DNSName zone("example.org.");
+
+  cache.insertGap(1, zone, DNSName("a.example.org."), DNSName("c.example.org."));
+  cache.insertGap(1, zone, DNSName("d.example.org."), DNSName("f.example.org."));
+  BOOST_CHECK_EQUAL(cache.size(), 2U);
+  /* full, the zone is started over */
+  cache.insertGap(1, zone, DNSName("g.example.org."), DNSName("i.example.org."));
+  BOOST_CHECK_EQUAL(cache.size(), 1U);
+  BOOST_CHECK(!cache.isAbsent(1, DNSName("b.example.org.")));
+  BOOST_CHECK(cache.isAbsent(1, DNSName("h.example.org.")));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,257 @@
+/*
+    PowerDNS Versatile Database Driven Nameserver
+    Copyright (C) 2021  PowerDNS.COM BV
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2
+    as published by the Free Software Foundation
+
+    Additionally, the license of this program contains a special
+    exception which allows to distribute the program in binary form when
+    it is linked against OpenSSL.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_NO_MAIN
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <boost/test/unit_test.hpp>
+
+#include "auth-nsec3cache.hh"
+#include "dnsrecords.hh"
+#include "dnssecinfra.hh"
+
+BOOST_AUTO_TEST_SUITE(test_auth_nsec3cache_cc)
+
+static NSEC3PARAMRecordContent getParams(uint16_t iterations = 1)
+{
+  NSEC3PARAMRecordContent ns3prc;
+  ns3prc.d_algorithm = 1;
+  ns3prc.d_iterations = iterations;
+  ns3prc.d_salt = "\xab\xcd";
+  return ns3prc;
+}
+
+BOOST_AUTO_TEST_CASE(test_hash)
+{
+  AuthNSEC3Cache cache;
+  cache.setTTL(3600);
+  const auto ns3prc = getParams();
+  const DNSName zone("example.org.");
+  const DNSName name("*.example.org.");
+
+  BOOST_CHECK_EQUAL(cache.size(), 0U);
+  BOOST_CHECK(cache.getHash(1, zone, ns3prc, name) == hashQNameWithSalt(ns3prc, name));
+  BOOST_CHECK_EQUAL(cache.size(), 1U);
+  /* from the cache this time */
+  BOOST_CHECK(cache.getHash(1, zone, ns3prc, name) == hashQNameWithSalt(ns3prc, name));
+  BOOST_CHECK_EQUAL(cache.size(), 1U);
+
+  /* new parameters, the zone should be flushed */
+  const auto newParams = getParams(2);
+  BOOST_CHECK(cache.getHash(1, zone, newParams, name) == hashQNameWithSalt(newParams, name));
+  BOOST_CHECK_EQUAL(cache.size(), 1U);
+}
+
+BOOST_AUTO_TEST_CASE(test_disabled)
+{
+  AuthNSEC3Cache cache;
+  const auto ns3prc = getParams();
+  const DNSName zone("example.org.");
+
+  BOOST_CHECK(cache.getHash(1, zone, ns3prc, zone) == hashQNameWithSalt(ns3prc, zone));
+  cache.insertRange(1, zone, ns3prc, "\x10", "\x20", zone);
+  BOOST_CHECK_EQUAL(cache.size(), 0U);
+}
+
+BOOST_AUTO_TEST_CASE(test_ranges)
+{
+  AuthNSEC3Cache cache;
+  cache.setTTL(3600);
+  const auto ns3prc = getParams();
+  const DNSName zone("example.org.");
+  DNSName unhashed;
+  std::string before, after;
+
+  BOOST_CHECK(!cache.getRange(1, ns3prc, "\x15", false, unhashed, before, after));
+
+  cache.insertRange(1, zone, ns3prc, "\x10", "\x20", DNSName("a.example.org."));
+  /* last range of the chain, wrapping around to the first hash */
+  cache.insertRange(1, zone, ns3prc, "\x80", "\x05", DNSName("b.example.org."));
+  BOOST_CHECK_EQUAL(cache.size(), 2U);
+
+  BOOST_REQUIRE(cache.getRange(1, ns3prc, "\x15", false, unhashed, before, after));
+  BOOST_CHECK(before == "\x10");
+  BOOST_CHECK(after == "\x20");
+  BOOST_CHECK_EQUAL(unhashed, DNSName("a.example.org."));
+
+  BOOST_REQUIRE(cache.getRange(1, ns3prc, "\x10", false, unhashed, before, after));
+  BOOST_CHECK(before == "\x10");
+
+  /* not covered by anything we know about */
+  BOOST_CHECK(!cache.getRange(1, ns3prc, "\x20", false, unhashed, before, after));
+  BOOST_CHECK(!cache.getRange(1, ns3prc, "\x50", false, unhashed, before, after));
+  BOOST_CHECK(!cache.getRange(1, ns3prc, "\x07", false, unhashed, before, after));
+
+  /* wrapping around, both after the last hash and before the first one */
+  BOOST_REQUIRE(cache.getRange(1, ns3prc, "\x90", false, unhashed, before, after));
+  BOOST_CHECK(before == "\x80");
+  BOOST_CHECK(after == "\x05");
+  BOOST_REQUIRE(cache.getRange(1, ns3prc, "\x01", false, unhashed, before, after));
+  BOOST_CHECK(before == "\x80");
+  BOOST_CHECK_EQUAL(unhashed, DNSName("b.example.org."));
+
+  /* exact matches only work for the start of a range */
+  unhashed = DNSName("c.example.org.");
+  BOOST_REQUIRE(cache.getRange(1, ns3prc, "\x10", true, unhashed, before, after));
+  BOOST_CHECK(after == "\x20");
+  BOOST_CHECK_EQUAL(unhashed, DNSName("c.example.org."));
+  BOOST_CHECK(!cache.getRange(1, ns3prc, "\x15", true, unhashed, before, after));
+
+  /* another zone */
+  BOOST_CHECK(!cache.getRange(2, ns3prc, "\x15", false, unhashed, before, after));
+  /* different parameters */
+  BOOST_CHECK(!cache.getRange(1, getParams(2), "\x15", false, unhashed, before, after));
+}
+
+BOOST_AUTO_TEST_CASE(test_absent_flood)
+{
+  AuthNSEC3Cache cache;
+  cache.setTTL(3600);
+  cache.setMaxEntriesPerZone(100);
+  const auto ns3prc = getParams();
+  const DNSName zone("example.org.");
+
+  /* no ranges known yet */
+  BOOST_CHECK(!cache.isAbsent(1, ns3prc, DNSName("nothing.example.org.")));
+
+  /* a single range wrapping around, covering almost every hash */
+  cache.insertRange(1, zone, ns3prc, "\xff\xff", "\xff\xfe", DNSName("a.example.org."));
+  BOOST_CHECK_EQUAL(cache.size(), 1U);
+
+  /* a flood of unique names, ten times the maximum number of entries */
+  size_t absent = 0;
+  for (size_t idx = 0; idx < 1000; idx++) {
+    if (cache.isAbsent(1, ns3prc, DNSName("random" + std::to_string(idx) + ".example.org."))) {
+      absent++;
+    }
+  }
+  BOOST_CHECK_EQUAL(absent, 1000U);
+
+  /* the hashes of these names were not cached, so the range is still there */
+  BOOST_CHECK_EQUAL(cache.size(), 1U);
+  DNSName unhashed;
+  std::string before, after;
+  BOOST_CHECK(cache.getRange(1, ns3prc, "\x42", false, unhashed, before, after));
+  BOOST_CHECK(before == "\xff\xff");
+
+  /* the name starting the range exists */
+  const DNSName existing("a.example.org.");
+  const auto hashed = hashQNameWithSalt(ns3prc, existing);
+  cache.insertRange(1, zone, ns3prc, hashed, hashed + "\x01", existing);
+  BOOST_CHECK(!cache.isAbsent(1, ns3prc, existing));
+}
+
+BOOST_AUTO_TEST_CASE(test_max_entries_per_zone)
+{
+  AuthNSEC3Cache cache;
+  cache.setTTL(3600);
+  cache.setMaxEntriesPerZone(10);
+  const auto ns3prc = getParams();
+  const DNSName zone1("example.org.");
+  const DNSName zone2("example.net.");
+  DNSName unhashed;
+  std::string before, after;
+
+  cache.insertRange(1, zone1, ns3prc, "\x10", "\x20", DNSName("a.example.org."));
+  cache.insertRange(2, zone2, ns3prc, "\x10", "\x20", DNSName("a.example.net."));
+  cache.insertAuth(2, zone2, ns3prc, DNSName("b.example.net."), true);
+  BOOST_CHECK_EQUAL(cache.size(), 3U);
+
+  /* a lot more hashes than the limit for the first zone */
+  for (size_t idx = 0; idx < 100; idx++) {
+    cache.getHash(1, zone1, ns3prc, DNSName("name" + std::to_string(idx) + ".example.org."));
+  }
+  BOOST_CHECK_LE(cache.size(), 12U);
+
+  /* the first zone kept its range, and the second one was left alone */
+  BOOST_CHECK(cache.getRange(1, ns3prc, "\x15", false, unhashed, before, after));
+  BOOST_CHECK(cache.getRange(2, ns3prc, "\x15", false, unhashed, before, after));
+  bool auth = false;
+  BOOST_CHECK(cache.getAuth(2, ns3prc, DNSName("b.example.net."), auth));
+
+  /* when the ranges alone fill the zone, it starts over */
+  for (uint8_t idx = 0; idx < 10; idx++) {
+    const std::string start(1, static_cast<char>(0x30 + 2 * idx));
+    cache.insertRange(1, zone1, ns3prc, start, std::string(1, static_cast<char>(0x31 + 2 * idx)), zone1);
+  }
+  BOOST_CHECK(!cache.getRange(1, ns3prc, "\x15", false, unhashed, before, after));
+  BOOST_CHECK(cache.getRange(2, ns3prc, "\x15", false, unhashed, before, after));
+}
+
+BOOST_AUTO_TEST_CASE(test_auth)
+{
+  AuthNSEC3Cache cache;
+  cache.setTTL(3600);
+  const auto ns3prc = getParams();
+  const DNSName zone("example.org.");
+  bool auth = false;
+
+  BOOST_CHECK(!cache.getAuth(1, ns3prc, DNSName("a.example.org."), auth));
+  cache.insertAuth(1, zone, ns3prc, DNSName("a.example.org."), true);
+  cache.insertAuth(1, zone, ns3prc, DNSName("b.example.org."), false);
+  BOOST_REQUIRE(cache.getAuth(1, ns3prc, DNSName("a.example.org."), auth));
+  BOOST_CHECK(auth);
+  BOOST_REQUIRE(cache.getAuth(1, ns3prc, DNSName("b.example.org."), auth));
+  BOOST_CHECK(!auth);
+}
+
+BOOST_AUTO_TEST_CASE(test_purge)
+{
+  AuthNSEC3Cache cache;
+  cache.setTTL(3600);
+  const auto ns3prc = getParams();
+  const DNSName zone1("example.org.");
+  const DNSName zone2("sub.example.org.");
+  const DNSName zone3("powerdns.com.");
+
+  cache.insertAuth(1, zone1, ns3prc, DNSName("a.example.org."), true);
+  cache.insertAuth(2, zone2, ns3prc, DNSName("a.sub.example.org."), true);
+  cache.insertAuth(3, zone3, ns3prc, DNSName("a.powerdns.com."), true);
+  BOOST_CHECK_EQUAL(cache.size(), 3U);
+
+  /* a change to a name inside the zone invalidates the whole zone */
+  BOOST_CHECK_EQUAL(cache.purgeExact(DNSName("www.powerdns.com.")), 1U);
+  BOOST_CHECK_EQUAL(cache.size(), 2U);
+
+  /* we do not know whether the names below a suffix belong to the zone itself or to a child zone,
+     so purging a suffix invalidates the zones above it as well */
+  BOOST_CHECK_EQUAL(cache.purge("sub.example.org$"), 2U);
+  BOOST_CHECK_EQUAL(cache.size(), 0U);
+
+  cache.insertAuth(1, zone1, ns3prc, DNSName("a.example.org."), true);
+  cache.insertAuth(2, zone2, ns3prc, DNSName("a.sub.example.org."), true);
+  cache.insertAuth(3, zone3, ns3prc, DNSName("a.powerdns.com."), true);
+  BOOST_CHECK_EQUAL(cache.purge("example.org$"), 2U);
+  BOOST_CHECK_EQUAL(cache.size(), 1U);
+  BOOST_CHECK_EQUAL(cache.purge(), 1U);
+  BOOST_CHECK_EQUAL(cache.size(), 0U);
+
+  cache.insertAuth(1, zone1, ns3prc, DNSName("a.example.org."), true);
+  BOOST_CHECK_EQUAL(cache.purge(), 1U);
+  BOOST_CHECK_EQUAL(cache.size(), 0U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
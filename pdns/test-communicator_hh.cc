@@ -6,6 +6,7 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <boost/test/unit_test.hpp>
+#include "arguments.hh"
 #include "communicator.hh"
 
 BOOST_AUTO_TEST_SUITE(test_communicator_hh)
@@ -106,4 +107,132 @@ BOOST_AUTO_TEST_CASE(test_axfr_queue_insert_and_priority_order_after_modify)
   BOOST_CHECK(suckDomains.empty());
 }
 
+static void initRandom()
+{
+  /* NotificationQueue::add() picks a random query ID */
+  ::arg().set("rng") = "auto";
+  ::arg().set("entropy-source") = "/dev/urandom";
+}
+
+BOOST_AUTO_TEST_CASE(test_notification_queue_ack)
+{
+  initRandom();
+  NotificationQueue nq;
+  const time_t now = 1000;
+  nq.add(DNSName("test1.com"), "192.0.2.1:53", now);
+  nq.add(DNSName("test1.com"), "192.0.2.2:53", now);
+  nq.add(DNSName("test2.com"), "192.0.2.1:53", now + 2);
+  BOOST_CHECK_EQUAL(nq.size(), 3U);
+  BOOST_CHECK_EQUAL(nq.earliest(now), 0);
+
+  DNSName domain;
+  string ip;
+  uint16_t id1, id2, id3;
+  bool purged;
+  BOOST_REQUIRE(nq.getOne(domain, ip, &id1, purged, now));
+  BOOST_CHECK(!purged);
+  BOOST_CHECK_EQUAL(domain, DNSName("test1.com"));
+  string ip1 = ip;
+  BOOST_REQUIRE(nq.getOne(domain, ip, &id2, purged, now));
+  BOOST_CHECK_EQUAL(domain, DNSName("test1.com"));
+  string ip2 = ip;
+  BOOST_CHECK(ip1 != ip2);
+  /* the third one is not due yet */
+  BOOST_CHECK(!nq.getOne(domain, ip, &id3, purged, now));
+  BOOST_REQUIRE(nq.getOne(domain, ip, &id3, purged, now + 2));
+  BOOST_CHECK_EQUAL(domain, DNSName("test2.com"));
+
+  /* wrong id, wrong domain, wrong address */
+  BOOST_CHECK(!nq.removeIf(ComboAddress(ip1, 53), id1 + 1, DNSName("test1.com")));
+  BOOST_CHECK(!nq.removeIf(ComboAddress(ip1, 53), id1, DNSName("test3.com")));
+  BOOST_CHECK(!nq.removeIf(ComboAddress("192.0.2.3", 53), id1, DNSName("test1.com")));
+
+  /* the source port of the answer does not matter */
+  BOOST_CHECK(nq.removeIf(ComboAddress(ComboAddress(ip1).toString(), 5353), id1, DNSName("test1.com")));
+  BOOST_CHECK(!nq.removeIf(ComboAddress(ip1, 53), id1, DNSName("test1.com")));
+  BOOST_CHECK(nq.removeIf(ip2, id2, DNSName("test1.com")));
+  BOOST_CHECK(nq.removeIf(ComboAddress("192.0.2.1", 53), id3, DNSName("test2.com")));
+  BOOST_CHECK_EQUAL(nq.size(), 0U);
+}
+
+BOOST_AUTO_TEST_CASE(test_notification_queue_retries_and_backoff)
+{
+  initRandom();
+  NotificationQueue nq;
+  time_t now = 1000;
+  nq.add(DNSName("test1.com"), "192.0.2.1:53", now);
+
+  DNSName domain;
+  string ip;
+  uint16_t id;
+  bool purged;
+  time_t delays[4];
+  for (size_t attempt = 0; attempt < 4; attempt++) {
+    BOOST_REQUIRE(nq.getOne(domain, ip, &id, purged, now));
+    BOOST_CHECK(!purged);
+    delays[attempt] = nq.earliest(now);
+    BOOST_CHECK(!nq.getOne(domain, ip, &id, purged, now));
+    now += delays[attempt];
+  }
+  BOOST_CHECK_EQUAL(delays[0], 3);
+  BOOST_CHECK_EQUAL(delays[1], 5);
+  BOOST_CHECK_EQUAL(delays[2], 9);
+  BOOST_CHECK_EQUAL(delays[3], 17);
+
+  /* no answer after all these attempts, we give up */
+  BOOST_REQUIRE(nq.getOne(domain, ip, &id, purged, now));
+  BOOST_CHECK(purged);
+  BOOST_CHECK_EQUAL(nq.size(), 0U);
+
+  /* the next notification to the same target is sent right away, but retried less often */
+  nq.add(DNSName("test2.com"), "192.0.2.1:53", now);
+  nq.add(DNSName("test2.com"), "192.0.2.2:53", now);
+  BOOST_REQUIRE(nq.getOne(domain, ip, &id, purged, now));
+  BOOST_REQUIRE(nq.getOne(domain, ip, &id, purged, now));
+  BOOST_CHECK_EQUAL(nq.earliest(now), 3);
+  BOOST_REQUIRE(nq.getOne(domain, ip, &id, purged, now + 3));
+  BOOST_CHECK_EQUAL(ip, "192.0.2.2:53");
+  BOOST_CHECK(nq.removeIf(ip, id, domain));
+  BOOST_CHECK_EQUAL(nq.earliest(now), 5);
+
+  /* an answer from that target resets its backoff */
+  BOOST_REQUIRE(nq.getOne(domain, ip, &id, purged, now + 5));
+  BOOST_CHECK_EQUAL(ip, "192.0.2.1:53");
+  BOOST_CHECK(nq.removeIf(ip, id, domain));
+  nq.add(DNSName("test3.com"), "192.0.2.1:53", now);
+  BOOST_REQUIRE(nq.getOne(domain, ip, &id, purged, now));
+  BOOST_CHECK_EQUAL(nq.earliest(now), 3);
+}
+
+BOOST_AUTO_TEST_CASE(test_notification_queue_cancel_keeps_backoff)
+{
+  initRandom();
+  NotificationQueue nq;
+  time_t now = 1000;
+  nq.add(DNSName("test1.com"), "192.0.2.1:53", now);
+
+  DNSName domain;
+  string ip;
+  uint16_t id;
+  bool purged;
+  /* no answer to any attempt */
+  for (size_t attempt = 0; attempt < 4; attempt++) {
+    BOOST_REQUIRE(nq.getOne(domain, ip, &id, purged, now));
+    now += nq.earliest(now);
+  }
+  BOOST_REQUIRE(nq.getOne(domain, ip, &id, purged, now));
+  BOOST_CHECK(purged);
+
+  /* a notification we cannot send is dropped, without resetting the backoff of the target */
+  nq.add(DNSName("test2.com"), "192.0.2.1:53", now);
+  BOOST_REQUIRE(nq.getOne(domain, ip, &id, purged, now));
+  BOOST_CHECK(!nq.cancel(ComboAddress("192.0.2.1", 53), id + 1, domain));
+  BOOST_CHECK(nq.cancel(ComboAddress("192.0.2.1", 53), id, domain));
+  BOOST_CHECK_EQUAL(nq.size(), 0U);
+
+  nq.add(DNSName("test3.com"), "192.0.2.1:53", now);
+  BOOST_REQUIRE(nq.getOne(domain, ip, &id, purged, now));
+  BOOST_CHECK_EQUAL(nq.earliest(now), 5);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
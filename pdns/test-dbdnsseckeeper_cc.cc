@@ -0,0 +1,70 @@
+/*
+    PowerDNS Versatile Database Driven Nameserver
+    Copyright (C) 2021  PowerDNS.COM BV
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2
+    as published by the Free Software Foundation
+
+    Additionally, the license of this program contains a special
+    exception which allows to distribute the program in binary form when
+    it is linked against OpenSSL.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_NO_MAIN
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <boost/test/unit_test.hpp>
+
+#include "base32.hh"
+#include "dnsseckeeper.hh"
+
+BOOST_AUTO_TEST_SUITE(test_dbdnsseckeeper_cc)
+
+static void checkOrderNames(const NSEC3PARAMRecordContent& ns3pr, size_t count)
+{
+  vector<DNSName> names;
+  names.reserve(count);
+  for (size_t idx = 0; idx < count; idx++) {
+    names.push_back(DNSName("name" + std::to_string(idx) + ".example.com."));
+  }
+
+  vector<DNSName> ordernames;
+  DNSSECKeeper::hashOrderNames(ns3pr, names, ordernames);
+
+  /* every name gets the same ordername as when hashed one by one, in the same order */
+  BOOST_REQUIRE_EQUAL(ordernames.size(), names.size());
+  for (size_t idx = 0; idx < count; idx++) {
+    BOOST_CHECK_EQUAL(ordernames.at(idx), DNSName(toBase32Hex(hashQNameWithSalt(ns3pr, names.at(idx)))));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_hash_ordernames)
+{
+  NSEC3PARAMRecordContent ns3pr;
+  ns3pr.d_algorithm = 1;
+  ns3pr.d_iterations = 10;
+  ns3pr.d_salt = "\xab\xcd";
+
+  /* nothing to hash */
+  checkOrderNames(ns3pr, 0);
+  /* below the 1000 names per thread threshold, hashed by the calling thread */
+  checkOrderNames(ns3pr, 999);
+  /* split between threads when there is more than one core, with a last range that is not full */
+  checkOrderNames(ns3pr, 10007);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -368,6 +368,20 @@ BOOST_AUTO_TEST_CASE(test_hash) {
   BOOST_CHECK(stdev < 10);      
 }
 
+BOOST_AUTO_TEST_CASE(test_hash_values) {
+  /* these hashes are used to pick a shard and compared between threads, they should not change */
+  BOOST_CHECK_EQUAL(DNSName("www.powerdns.com").hash(), 3404032120U);
+  BOOST_CHECK_EQUAL(DNSName("a-rather-long-label-for-a-host.another-rather-long-label.powerdns.com").hash(), 2110738280U);
+  BOOST_CHECK_EQUAL(DNSName("WWW.PowerDNS.COM").hash(42), 3433209597U);
+
+  /* the case-insensitive hash should match the regular one on lowercase data, whatever the length */
+  std::string data;
+  for (size_t idx = 0; idx < 600; idx++) {
+    BOOST_CHECK_EQUAL(burtleCI(reinterpret_cast<const unsigned char*>(data.data()), data.size(), idx), burtle(reinterpret_cast<const unsigned char*>(toLower(data).data()), data.size(), idx));
+    data.append(1, static_cast<char>("aBcDeFgHiJkLmNoPqRsTuVwXyZ@[`{\x80\xc1"[idx % 32]));
+  }
+}
+
 BOOST_AUTO_TEST_CASE(test_hashContainer) {
   std::unordered_set<DNSName> s;
   s.insert(DNSName("www.powerdns.com"));
@@ -635,6 +649,95 @@ BOOST_AUTO_TEST_CASE(test_suffixmatch_tree) {
   BOOST_CHECK_EQUAL(count, 0U);
 }
 
+BOOST_AUTO_TEST_CASE(test_flat_suffixmatch_tree) {
+  SuffixMatchTree<DNSName> smt;
+
+  {
+    /* empty */
+    FlatSuffixMatchTree<DNSName> flat(smt);
+    BOOST_CHECK(flat.empty());
+    BOOST_CHECK(flat.lookup(DNSName("www.powerdns.com.")) == nullptr);
+    BOOST_CHECK(flat.lookup(g_rootdnsname) == nullptr);
+  }
+
+  DNSName ezdns("ezdns.it.");
+  DNSName org("org.");
+  DNSName newsbbc("news.bbc.co.uk.");
+  DNSName examplenet("example.net.");
+  smt.add(ezdns, DNSName(ezdns));
+  smt.add(org, DNSName(org));
+  smt.add(newsbbc, DNSName(newsbbc));
+  smt.add(examplenet, DNSName(examplenet));
+  /* remove() leaves 'net' as an intermediate, non-end, node */
+  smt.add(DNSName("net."), DNSName("net."));
+  smt.remove(DNSName("net."));
+
+  FlatSuffixMatchTree<DNSName> flat(smt);
+  BOOST_CHECK(!flat.empty());
+
+  BOOST_REQUIRE(flat.lookup(DNSName("www.ezdns.it.")));
+  BOOST_CHECK_EQUAL(*flat.lookup(DNSName("www.ezdns.it.")), ezdns);
+  BOOST_CHECK(flat.lookup(DNSName("www.powerdns.com.")) == nullptr);
+  BOOST_CHECK(flat.lookup(DNSName("it.")) == nullptr);
+  BOOST_REQUIRE(flat.lookup(DNSName("www.powerdns.oRG.")));
+  BOOST_CHECK_EQUAL(*flat.lookup(DNSName("www.powerdns.oRG.")), org);
+  BOOST_REQUIRE(flat.lookup(DNSName("WWW.www.www.www.www.NEWS.bbc.co.uk.")));
+  BOOST_CHECK_EQUAL(*flat.lookup(DNSName("WWW.www.www.www.www.NEWS.bbc.co.uk.")), newsbbc);
+  BOOST_CHECK(flat.lookup(DNSName("images.bbc.co.uk.")) == nullptr);
+  BOOST_CHECK(flat.lookup(DNSName("net.")) == nullptr);
+  BOOST_CHECK(flat.lookup(DNSName("www.example.com.")) == nullptr);
+  BOOST_REQUIRE(flat.lookup(DNSName("www.example.net.")));
+  BOOST_CHECK_EQUAL(*flat.lookup(DNSName("www.example.net.")), examplenet);
+  BOOST_CHECK(flat.lookup(g_rootdnsname) == nullptr);
+
+  /* the longest match wins */
+  smt.add(DNSName("uk."), DNSName("uk."));
+  smt.add(g_rootdnsname, DNSName(g_rootdnsname));
+  FlatSuffixMatchTree<DNSName> flat2(smt);
+  BOOST_CHECK_EQUAL(*flat2.lookup(DNSName("www.news.bbc.co.uk.")), newsbbc);
+  BOOST_CHECK_EQUAL(*flat2.lookup(DNSName("images.bbc.co.uk.")), DNSName("uk."));
+  BOOST_CHECK_EQUAL(*flat2.lookup(DNSName("a.root-servers.net.")), g_rootdnsname);
+  BOOST_CHECK_EQUAL(*flat2.lookup(g_rootdnsname), g_rootdnsname);
+  /* the first copy is not affected */
+  BOOST_CHECK(flat.lookup(DNSName("images.bbc.co.uk.")) == nullptr);
+
+  /* same results as the tree it was built from, for a lot of names sharing their suffixes */
+  SuffixMatchTree<bool> bigTree;
+  for (size_t idx = 0; idx < 5000; idx++) {
+    bigTree.add(DNSName("name" + std::to_string(idx) + ".sub" + std::to_string(idx % 50) + ".example" + std::to_string(idx % 7) + "."), true);
+  }
+  FlatSuffixMatchTree<bool> bigFlat(bigTree);
+  for (size_t idx = 0; idx < 6000; idx++) {
+    DNSName name("www.NAME" + std::to_string(idx) + ".sub" + std::to_string(idx % 50) + ".example" + std::to_string(idx % 9) + ".");
+    BOOST_CHECK_EQUAL(bigFlat.lookup(name) != nullptr, bigTree.lookup(name) != nullptr);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_suffixmatch_freeze) {
+  SuffixMatchNode smn;
+  smn.add(DNSName("powerdns.com."));
+  smn.add(DNSName("news.bbc.co.uk."));
+  smn.freeze();
+
+  BOOST_CHECK(smn.check(DNSName("www.powerdns.com.")));
+  BOOST_CHECK(smn.check(DNSName("NEWS.bbc.co.uk.")));
+  BOOST_CHECK(!smn.check(DNSName("bbc.co.uk.")));
+
+  /* modifications are taken into account right away */
+  smn.add(DNSName("co.uk."));
+  BOOST_CHECK(smn.check(DNSName("bbc.co.uk.")));
+  smn.freeze();
+  BOOST_CHECK(smn.check(DNSName("bbc.co.uk.")));
+  smn.remove(DNSName("powerdns.com."));
+  BOOST_CHECK(!smn.check(DNSName("www.powerdns.com.")));
+
+  /* copies share the frozen version */
+  smn.freeze();
+  SuffixMatchNode copy(smn);
+  BOOST_CHECK(copy.check(DNSName("bbc.co.uk.")));
+  BOOST_CHECK(!copy.check(DNSName("www.powerdns.com.")));
+}
+
 
 BOOST_AUTO_TEST_CASE(test_concat) {
   DNSName first("www."), second("powerdns.com.");
@@ -665,6 +768,21 @@ BOOST_AUTO_TEST_CASE(test_casing) {
   BOOST_CHECK_EQUAL(c.toString(), "www.powerdns.com.");
 }
 
+BOOST_AUTO_TEST_CASE(test_casing_long) {
+  /* long enough to go through the vectorised code, with a difference in the last bytes */
+  DNSName a("A-Rather-Long-Label-For-A-Host.Another-Rather-Long-Label.PowerDNS.com"), b("a-rather-long-label-for-a-host.another-rather-long-label.powerdns.com");
+  DNSName c("a-rather-long-label-for-a-host.another-rather-long-label.powerdns.cOn");
+  BOOST_CHECK_EQUAL(a, b);
+  BOOST_CHECK(a != c);
+  BOOST_CHECK_EQUAL(a.makeLowerCase().toString(), b.toString());
+  BOOST_CHECK(a.isPartOf(DNSName("Another-Rather-Long-Label.powerdns.COM")));
+  BOOST_CHECK(!c.isPartOf(DNSName("Another-Rather-Long-Label.powerdns.COM")));
+  /* '@' and '[' surround the uppercase letters, '`' and '{' the lowercase ones */
+  BOOST_CHECK(DNSName("0123456789abcdef@.com") != DNSName("0123456789abcdef`.com"));
+  BOOST_CHECK(DNSName("0123456789abcdef[.com") != DNSName("0123456789abcdef{.com"));
+  BOOST_CHECK(DNSName("0123456789abcdef\\200.com") != DNSName("0123456789abcdef\\160.com"));
+}
+
 
 
 BOOST_AUTO_TEST_CASE(test_compare_canonical) {
@@ -705,6 +823,19 @@ BOOST_AUTO_TEST_CASE(test_compare_canonical) {
   BOOST_CHECK(vec==right);
 }
 
+BOOST_AUTO_TEST_CASE(test_compare_canonical_long_labels) {
+  BOOST_CHECK(DNSName("a-rather-long-label-for-a-host-A.com").canonCompare(DNSName("A-RATHER-LONG-LABEL-FOR-A-HOST-b.com")));
+  BOOST_CHECK(!DNSName("a-rather-long-label-for-a-host-B.com").canonCompare(DNSName("A-RATHER-LONG-LABEL-FOR-A-HOST-a.com")));
+  BOOST_CHECK(!DNSName("a-rather-long-label-for-a-host.com").canonCompare(DNSName("A-RATHER-LONG-LABEL-FOR-A-HOST.com")));
+  BOOST_CHECK(!DNSName("A-RATHER-LONG-LABEL-FOR-A-HOST.com").canonCompare(DNSName("a-rather-long-label-for-a-host.com")));
+  /* a label sorts before the longer labels it is a prefix of */
+  BOOST_CHECK(DNSName("a-rather-long-label-for-a-host.com").canonCompare(DNSName("a-rather-long-label-for-a-host-a.com")));
+  /* '_' sits between the uppercase and lowercase letters, and is compared to the lowercase version */
+  BOOST_CHECK(DNSName("a-rather-long-label-for-a-host_.com").canonCompare(DNSName("a-rather-long-label-for-a-hostA.com")));
+  /* octets are unsigned */
+  BOOST_CHECK(DNSName("a-rather-long-label-for-a-hostz.com").canonCompare(DNSName("a-rather-long-label-for-a-host\\200.com")));
+}
+
 
 BOOST_AUTO_TEST_CASE(test_empty_label) { // empty label
 
@@ -974,4 +1105,77 @@ BOOST_AUTO_TEST_CASE(test_getcommonlabels) {
   BOOST_CHECK_EQUAL(name4.getCommonLabels(name3), name4);
 }
 
+
+BOOST_AUTO_TEST_CASE(test_storage) {
+  /* short enough to be stored inline */
+  DNSName shortName("www.powerdns.com.");
+  BOOST_CHECK_LE(shortName.getStorage().size(), DNSName::string_t::s_inlineCapacity);
+  DNSName shortCopy(shortName);
+  BOOST_CHECK_EQUAL(shortCopy, shortName);
+  BOOST_CHECK(shortCopy.getStorage().data() != shortName.getStorage().data());
+
+  /* too long, moved to the heap */
+  DNSName longName("a-rather-long-label-for-a-host.another-rather-long-label.powerdns.com.");
+  BOOST_CHECK_GT(longName.getStorage().size(), DNSName::string_t::s_inlineCapacity);
+  BOOST_CHECK_EQUAL(longName.toString(), "a-rather-long-label-for-a-host.another-rather-long-label.powerdns.com.");
+
+  DNSName built;
+  for (size_t idx = 0; idx < 30; idx++) {
+    built.prependRawLabel("label" + std::to_string(idx));
+  }
+  BOOST_CHECK_EQUAL(built.countLabels(), 30U);
+  BOOST_CHECK_EQUAL(built.getRawLabel(0), "label29");
+  BOOST_CHECK(built.chopOff());
+  BOOST_CHECK_EQUAL(built.getRawLabel(0), "label28");
+
+  DNSName moved(std::move(longName));
+  BOOST_CHECK_EQUAL(moved.toString(), "a-rather-long-label-for-a-host.another-rather-long-label.powerdns.com.");
+  BOOST_CHECK(longName.empty());
+  longName = moved;
+  BOOST_CHECK_EQUAL(longName, moved);
+  longName = shortName;
+  BOOST_CHECK_EQUAL(longName, shortName);
+}
+
+BOOST_AUTO_TEST_CASE(test_intern) {
+  DNSName::string_t::purgeInterned();
+  BOOST_CHECK_EQUAL(DNSName::string_t::getInternedCount(), 0U);
+
+  DNSName shortName("www.powerdns.com.");
+  shortName.intern();
+  BOOST_CHECK(!shortName.isInterned());
+
+  const std::string longStr("a-rather-long-label-for-a-host.another-rather-long-label.powerdns.com.");
+  DNSName first(longStr);
+  DNSName second(longStr);
+  first.intern();
+  second.intern();
+  BOOST_CHECK(first.isInterned());
+  BOOST_CHECK(second.isInterned());
+  BOOST_CHECK_EQUAL(DNSName::string_t::getInternedCount(), 1U);
+  BOOST_CHECK(first.getStorage().data() == second.getStorage().data());
+  BOOST_CHECK_EQUAL(first.toString(), longStr);
+
+  /* copies share the buffer as well */
+  DNSName copy(first);
+  BOOST_CHECK(copy.isInterned());
+  BOOST_CHECK(copy.getStorage().data() == first.getStorage().data());
+
+  /* but modifying one of them does not affect the others */
+  copy.makeUsLowerCase();
+  copy.prependRawLabel("www");
+  BOOST_CHECK(!copy.isInterned());
+  BOOST_CHECK_EQUAL(copy.toString(), "www." + longStr);
+  BOOST_CHECK_EQUAL(first.toString(), longStr);
+  BOOST_CHECK(second.chopOff());
+  BOOST_CHECK(!second.isInterned());
+  BOOST_CHECK_EQUAL(first.toString(), longStr);
+
+  /* still in use */
+  BOOST_CHECK_EQUAL(DNSName::string_t::purgeInterned(), 0U);
+  first.clear();
+  BOOST_CHECK_EQUAL(DNSName::string_t::purgeInterned(), 1U);
+  BOOST_CHECK_EQUAL(DNSName::string_t::getInternedCount(), 0U);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -8,6 +8,7 @@
 #include <boost/test/unit_test.hpp>
 
 #include "dnsparser.hh"
+#include "dnsrecords.hh"
 
 BOOST_AUTO_TEST_SUITE(test_dnsparser_cc)
 
@@ -483,4 +484,111 @@ BOOST_AUTO_TEST_CASE(test_getRecordsOfTypeCount) {
 
 }
 
+BOOST_AUTO_TEST_CASE(test_DNSPacketView) {
+  const DNSName name("powerdns.com.");
+  const DNSName target("www.powerdns.com.");
+  const ComboAddress v4("192.0.2.1");
+  const ComboAddress v6("2001:db8::1");
+
+  vector<uint8_t> packet;
+  DNSPacketWriter pwR(packet, name, QType::A, QClass::IN, 0);
+  pwR.getHeader()->qr = 1;
+  pwR.commit();
+
+  pwR.startRecord(name, QType::CNAME, 255, QClass::IN, DNSResourceRecord::ANSWER);
+  pwR.xfrName(target, true);
+  pwR.commit();
+
+  pwR.startRecord(target, QType::A, 256, QClass::IN, DNSResourceRecord::ANSWER);
+  pwR.xfrIP(v4.sin4.sin_addr.s_addr);
+  pwR.commit();
+
+  pwR.startRecord(target, QType::AAAA, 257, QClass::IN, DNSResourceRecord::ANSWER);
+  pwR.xfrIP6(std::string(reinterpret_cast<const char*>(v6.sin6.sin6_addr.s6_addr), 16));
+  pwR.commit();
+
+  pwR.startRecord(name, QType::SOA, 258, QClass::IN, DNSResourceRecord::AUTHORITY);
+  auto soa = DNSRecordContent::mastermake(QType::SOA, QClass::IN, "ns1.powerdns.com. hostmaster.powerdns.com. 2021101901 3600 600 604800 300");
+  soa->toPacket(pwR);
+  pwR.commit();
+
+  pwR.addOpt(4096, 0, 0);
+  pwR.commit();
+
+  DNSPacketView view(false, reinterpret_cast<const char*>(packet.data()), packet.size());
+  MOADNSParser mdp(false, reinterpret_cast<const char*>(packet.data()), packet.size());
+
+  BOOST_CHECK_EQUAL(view.d_header.ancount, 3U);
+  BOOST_CHECK_EQUAL(view.d_header.nscount, 1U);
+  BOOST_CHECK_EQUAL(view.d_header.arcount, 1U);
+  BOOST_CHECK_EQUAL(view.d_qtype, QType::A);
+  BOOST_CHECK_EQUAL(view.d_qclass, QClass::IN);
+  BOOST_CHECK_EQUAL(view.getQName(), name);
+  BOOST_CHECK(view.qnameEquals(DNSName("PowerDNS.COM.")));
+  BOOST_CHECK(!view.qnameEquals(target));
+  BOOST_CHECK(view.hasEDNS());
+
+  const auto& records = view.getRecords();
+  BOOST_REQUIRE_EQUAL(records.size(), mdp.d_answers.size());
+  for (size_t idx = 0; idx < records.size(); idx++) {
+    const auto& record = records.at(idx);
+    const auto& expected = mdp.d_answers.at(idx).first;
+    BOOST_CHECK_EQUAL(view.getName(record), expected.d_name);
+    BOOST_CHECK(view.nameEquals(record, expected.d_name.makeLowerCase()));
+    BOOST_CHECK_EQUAL(record.d_type, expected.d_type);
+    BOOST_CHECK_EQUAL(record.d_class, expected.d_class);
+    BOOST_CHECK_EQUAL(record.d_ttl, expected.d_ttl);
+    BOOST_CHECK_EQUAL(record.d_place, expected.d_place);
+    BOOST_CHECK_EQUAL(view.getContent(record)->getZoneRepresentation(), expected.d_content->getZoneRepresentation());
+  }
+
+  BOOST_CHECK(view.nameEquals(records.at(1), DNSName("WWW.powerdns.com.")));
+  BOOST_CHECK(!view.nameEquals(records.at(1), name));
+  BOOST_CHECK(!view.nameEquals(records.at(1), DNSName("www.powerdns.com.example.")));
+  BOOST_CHECK_EQUAL(view.getTarget(records.at(0)), target);
+  BOOST_CHECK_EQUAL(view.getAddress(records.at(1)).toString(), v4.toString());
+  BOOST_CHECK_EQUAL(view.getAddress(records.at(2)).toString(), v6.toString());
+  BOOST_CHECK_THROW(view.getAddress(records.at(0)), MOADNSException);
+
+  auto soaView = view.getSOA(records.at(3));
+  BOOST_CHECK_EQUAL(soaView.d_mname, DNSName("ns1.powerdns.com."));
+  BOOST_CHECK_EQUAL(soaView.d_rname, DNSName("hostmaster.powerdns.com."));
+  BOOST_CHECK_EQUAL(soaView.d_serial, 2021101901U);
+  BOOST_CHECK_EQUAL(soaView.d_refresh, 3600U);
+  BOOST_CHECK_EQUAL(soaView.d_retry, 600U);
+  BOOST_CHECK_EQUAL(soaView.d_expire, 604800U);
+  BOOST_CHECK_EQUAL(soaView.d_minimum, 300U);
+  BOOST_CHECK_EQUAL(view.getSOASerial(records.at(3)), 2021101901U);
+
+  {
+    /* truncated packet, with the TC bit set: the records we could not read are dropped */
+    auto truncated = packet;
+    truncated.resize(truncated.size() - 5);
+    reinterpret_cast<dnsheader*>(truncated.data())->tc = 1;
+    DNSPacketView truncatedView(false, reinterpret_cast<const char*>(truncated.data()), truncated.size());
+    BOOST_CHECK_EQUAL(truncatedView.getRecords().size(), 4U);
+    BOOST_CHECK_EQUAL(truncatedView.d_header.ancount, 3U);
+    BOOST_CHECK_EQUAL(truncatedView.d_header.nscount, 1U);
+    BOOST_CHECK_EQUAL(truncatedView.d_header.arcount, 0U);
+
+    /* but without it, that's an error */
+    reinterpret_cast<dnsheader*>(truncated.data())->tc = 0;
+    BOOST_CHECK_THROW(DNSPacketView(false, reinterpret_cast<const char*>(truncated.data()), truncated.size()), MOADNSException);
+  }
+
+  {
+    /* names are only decoded when accessed: a forward compression pointer is not detected upfront */
+    vector<uint8_t> bogus;
+    DNSPacketWriter pw(bogus, name, QType::A, QClass::IN, 0);
+    pw.getHeader()->qr = 1;
+    pw.startRecord(g_rootdnsname, QType::CNAME, 255, QClass::IN, DNSResourceRecord::ANSWER);
+    pw.xfr16BitInt(0xc000 | 0x3fff);
+    pw.commit();
+
+    DNSPacketView bogusView(false, reinterpret_cast<const char*>(bogus.data()), bogus.size());
+    BOOST_REQUIRE_EQUAL(bogusView.getRecords().size(), 1U);
+    BOOST_CHECK_THROW(bogusView.getTarget(bogusView.getRecords().at(0)), std::exception);
+  }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -78,6 +78,56 @@ BOOST_AUTO_TEST_CASE(test_compressionBoundary) {
   BOOST_CHECK_NO_THROW(MOADNSParser mdp(false, spacket));
 }
 
+BOOST_AUTO_TEST_CASE(test_compressionWireFormat) {
+  vector<uint8_t> packet;
+  DNSPacketWriter pwR(packet, DNSName("example.com."), QType::A, QClass::IN, 0);
+  pwR.getHeader()->qr = 1;
+
+  pwR.startRecord(DNSName("www.example.com."), QType::A, 3600, QClass::IN, DNSResourceRecord::ANSWER);
+  pwR.xfrIP(htonl(0xc0000201));
+  pwR.commit();
+
+  /* this one does not make it, the names it wrote should not be used as compression targets afterwards */
+  pwR.startRecord(DNSName("mail.example.com."), QType::CNAME, 3600, QClass::IN, DNSResourceRecord::ANSWER);
+  pwR.xfrName(DNSName("target.Example.NET."), true);
+  pwR.rollback();
+
+  /* same name as the first record, only the case differs */
+  pwR.startRecord(DNSName("WWW.EXAMPLE.COM."), QType::NS, 3600, QClass::IN, DNSResourceRecord::ANSWER);
+  pwR.xfrName(DNSName("ns.example.NET."), true);
+  pwR.commit();
+
+  pwR.startRecord(DNSName("mail.example.com."), QType::MX, 3600, QClass::IN, DNSResourceRecord::ANSWER);
+  pwR.xfr16BitInt(10);
+  pwR.xfrName(DNSName("MX.Example.Net."), true);
+  pwR.commit();
+
+  /* 'notexample.com' only shares 'com' with 'example.com' */
+  pwR.startRecord(DNSName("example.com."), QType::CNAME, 3600, QClass::IN, DNSResourceRecord::ANSWER);
+  pwR.xfrName(DNSName("notexample.com."), true);
+  pwR.commit();
+
+  const std::string expected(
+    /* question: example.com. at 0x0c, 'com' at 0x14 */
+    "\x07" "example" "\x03" "com" "\x00" "\x00\x01" "\x00\x01"
+    /* www.example.com. A, at 0x1d */
+    "\x03" "www" "\xc0\x0c" "\x00\x01" "\x00\x01" "\x00\x00\x0e\x10" "\x00\x04" "\xc0\x00\x02\x01"
+    /* WWW.EXAMPLE.COM. NS ns.example.NET., with the target at 0x3d and 'example.NET' at 0x40 */
+    "\xc0\x1d" "\x00\x02" "\x00\x01" "\x00\x00\x0e\x10" "\x00\x10" "\x02" "ns" "\x07" "example" "\x03" "NET" "\x00"
+    /* mail.example.com. MX 10 MX.Example.Net. */
+    "\x04" "mail" "\xc0\x0c" "\x00\x0f" "\x00\x01" "\x00\x00\x0e\x10" "\x00\x07" "\x00\x0a" "\x02" "MX" "\xc0\x40"
+    /* example.com. CNAME notexample.com. */
+    "\xc0\x0c" "\x00\x05" "\x00\x01" "\x00\x00\x0e\x10" "\x00\x0d" "\x0a" "notexample" "\xc0\x14",
+    114);
+
+  BOOST_REQUIRE_EQUAL(packet.size(), sizeof(dnsheader) + expected.size());
+  BOOST_CHECK(std::string(packet.begin() + sizeof(dnsheader), packet.end()) == expected);
+  BOOST_CHECK_EQUAL(ntohs(pwR.getHeader()->ancount), 4);
+
+  string spacket(packet.begin(), packet.end());
+  BOOST_CHECK_NO_THROW(MOADNSParser mdp(false, spacket));
+}
+
 BOOST_AUTO_TEST_CASE(test_xfrSvcParamKeyVals_mandatory) {
   DNSName name("powerdns.com.");
   vector<uint8_t> packet;
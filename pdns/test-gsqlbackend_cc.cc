@@ -0,0 +1,96 @@
+/*
+    PowerDNS Versatile Database Driven Nameserver
+    Copyright (C) 2021  PowerDNS.COM BV
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 2
+    as published by the Free Software Foundation
+
+    Additionally, the license of this program contains a special
+    exception which allows to distribute the program in binary form when
+    it is linked against OpenSSL.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_NO_MAIN
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <boost/test/unit_test.hpp>
+
+#include "dnsbackend.hh"
+#include "backends/gsql/gsqlbackend.hh"
+
+/* makeBulkQuery() is only meant to be used by the backend itself */
+class BulkQueryMaker : public GSQLBackend
+{
+public:
+  using GSQLBackend::makeBulkQuery;
+};
+
+BOOST_AUTO_TEST_SUITE(test_gsqlbackend_cc)
+
+BOOST_AUTO_TEST_CASE(test_bulk_query_numbered)
+{
+  const std::string query("insert into records (content,ttl,prio,type,domain_id,disabled,name,ordername,auth) values ($1,$2,$3,$4,$5,$6,$7,$8,$9)");
+
+  BOOST_CHECK_EQUAL(BulkQueryMaker::makeBulkQuery(query, 9, 1), query);
+  BOOST_CHECK_EQUAL(BulkQueryMaker::makeBulkQuery(query, 9, 3),
+                    "insert into records (content,ttl,prio,type,domain_id,disabled,name,ordername,auth) values ($1,$2,$3,$4,$5,$6,$7,$8,$9)"
+                    ", ($10,$11,$12,$13,$14,$15,$16,$17,$18)"
+                    ", ($19,$20,$21,$22,$23,$24,$25,$26,$27)");
+
+  /* constants are copied as they are, parameters are renumbered with the number of parameters of a row */
+  BOOST_CHECK_EQUAL(BulkQueryMaker::makeBulkQuery("insert into records (type,domain_id,disabled,name,ordername,auth,ttl,prio,content) values (null,$1,false,$2,$3,$4,null,null,null)", 4, 2),
+                    "insert into records (type,domain_id,disabled,name,ordername,auth,ttl,prio,content) values (null,$1,false,$2,$3,$4,null,null,null)"
+                    ", (null,$5,false,$6,$7,$8,null,null,null)");
+}
+
+BOOST_AUTO_TEST_CASE(test_bulk_query_named)
+{
+  BOOST_CHECK_EQUAL(BulkQueryMaker::makeBulkQuery("insert into records (type,domain_id,disabled,name,ordername,auth,ttl,prio,content) values (null,:domain_id,0,:qname,:ordername,:auth,null,null,null)", 4, 3),
+                    "insert into records (type,domain_id,disabled,name,ordername,auth,ttl,prio,content) values (null,:domain_id,0,:qname,:ordername,:auth,null,null,null)"
+                    ", (null,:domain_id_1,0,:qname_1,:ordername_1,:auth_1,null,null,null)"
+                    ", (null,:domain_id_2,0,:qname_2,:ordername_2,:auth_2,null,null,null)");
+
+  /* '::type' casts and quoted strings are not parameters */
+  BOOST_CHECK_EQUAL(BulkQueryMaker::makeBulkQuery("INSERT INTO records (name,ttl,content) VALUES (:qname,:ttl::integer,':not_a_parameter')", 3, 2),
+                    "INSERT INTO records (name,ttl,content) VALUES (:qname,:ttl::integer,':not_a_parameter')"
+                    ", (:qname_1,:ttl_1::integer,':not_a_parameter')");
+}
+
+BOOST_AUTO_TEST_CASE(test_bulk_query_positional)
+{
+  /* '?' parameters are bound in order, so they stay the same */
+  BOOST_CHECK_EQUAL(BulkQueryMaker::makeBulkQuery("insert into records (content,ttl,prio,type,domain_id,disabled,name,ordername,auth) values (?,?,?,?,?,?,?,convert(varbinary(255),?),?);", 9, 2),
+                    "insert into records (content,ttl,prio,type,domain_id,disabled,name,ordername,auth) values (?,?,?,?,?,?,?,convert(varbinary(255),?),?)"
+                    ", (?,?,?,?,?,?,?,convert(varbinary(255),?),?);");
+}
+
+BOOST_AUTO_TEST_CASE(test_bulk_query_fallback)
+{
+  /* no values */
+  BOOST_CHECK_EQUAL(BulkQueryMaker::makeBulkQuery("insert into records select * from other_records", 9, 2), "");
+  /* 'values' only as part of another word */
+  BOOST_CHECK_EQUAL(BulkQueryMaker::makeBulkQuery("insert into records (name) select my_values from other", 1, 2), "");
+  /* no tuple after values */
+  BOOST_CHECK_EQUAL(BulkQueryMaker::makeBulkQuery("insert into records (name) values", 1, 2), "");
+  /* unbalanced tuple */
+  BOOST_CHECK_EQUAL(BulkQueryMaker::makeBulkQuery("insert into records (name,ttl) values ($1,($2)", 2, 2), "");
+  /* something after the tuple */
+  BOOST_CHECK_EQUAL(BulkQueryMaker::makeBulkQuery("insert into records (name) values ($1) returning id", 1, 2), "");
+  BOOST_CHECK_EQUAL(BulkQueryMaker::makeBulkQuery("insert into records (name) values ($1) on conflict do nothing", 1, 2), "");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -5,6 +5,7 @@
 #endif
 #include <boost/test/unit_test.hpp>
 #include <bitset>
+#include <random>
 #include "iputils.hh"
 
 using namespace boost;
@@ -367,6 +368,23 @@ BOOST_AUTO_TEST_CASE(test_NetmaskGroup) {
     BOOST_CHECK(ng.match(ComboAddress("fe80:0100::1")));
 
     BOOST_CHECK_EQUAL(NMGOutputToSorted(ng.toString()), NMGOutputToSorted("10.0.1.0/32, 127.0.0.0/8, 10.0.0.0/24, ::1/128, fe80::/16, 172.16.0.0/16, !172.16.4.0/24, !fe80::/24"));
+
+    /* the frozen version should give the same results, until the group is modified */
+    ng.freeze();
+    BOOST_CHECK(ng.match(ComboAddress("172.16.1.1")));
+    BOOST_CHECK(!ng.match(ComboAddress("172.16.4.50")));
+    BOOST_CHECK(!ng.match(ComboAddress("fe80::1")));
+    BOOST_CHECK(ng.match(ComboAddress("fe80:0100::1")));
+    BOOST_CHECK(!ng.match(ComboAddress("128.1.2.3")));
+    Netmask nm;
+    BOOST_CHECK(!ng.lookup(ComboAddress("172.16.4.50"), &nm));
+    BOOST_CHECK_EQUAL(nm.toString(), "172.16.4.0/24");
+    ng.addMask(Netmask("128.1.2.0/24"));
+    BOOST_CHECK(ng.match(ComboAddress("128.1.2.3")));
+    ng.freeze();
+    BOOST_CHECK(ng.match(ComboAddress("128.1.2.3")));
+    ng.deleteMask(Netmask("128.1.2.0/24"));
+    BOOST_CHECK(!ng.match(ComboAddress("128.1.2.3")));
   }
 }
 
@@ -795,6 +813,101 @@ BOOST_AUTO_TEST_CASE(test_iterator) {
   }
 }
 
+BOOST_AUTO_TEST_CASE(test_FlatNetmaskTree) {
+  NetmaskTree<int> nmt;
+  nmt.insert(Netmask("130.161.252.0/24")).second = 0;
+  nmt.insert(Netmask("130.161.0.0/16")).second = 1;
+  nmt.insert(Netmask("130.0.0.0/8")).second = 2;
+  nmt.insert(Netmask("::1")).second = 3;
+  nmt.insert(Netmask("fe80::/16")).second = 4;
+
+  FlatNetmaskTree<int> flat(nmt);
+  BOOST_CHECK_EQUAL(flat.empty(), false);
+  BOOST_CHECK_EQUAL(flat.size(), 5U);
+  BOOST_CHECK(flat.lookup(ComboAddress("213.244.168.210")) == nullptr);
+  BOOST_CHECK_EQUAL(flat.lookup(ComboAddress("130.161.252.29"))->second, 0);
+  BOOST_CHECK_EQUAL(flat.lookup(ComboAddress("130.161.252.29"))->first.toString(), "130.161.252.0/24");
+  BOOST_CHECK_EQUAL(flat.lookup(ComboAddress("130.161.180.1"))->second, 1);
+  BOOST_CHECK_EQUAL(flat.lookup(ComboAddress("130.145.180.1"))->second, 2);
+  BOOST_CHECK_EQUAL(flat.lookup(ComboAddress("130.161.252.29"), 16)->second, 1);
+  BOOST_CHECK(flat.lookup(ComboAddress("130.161.252.29"), 7) == nullptr);
+  BOOST_CHECK_EQUAL(flat.lookup(Netmask("130.161.0.0/20"))->second, 1);
+  BOOST_CHECK(flat.has_key(Netmask("130.161.0.0/16")));
+  BOOST_CHECK(!flat.has_key(Netmask("130.161.0.0/20")));
+  BOOST_CHECK_EQUAL(flat.lookup(ComboAddress("::1"))->second, 3);
+  BOOST_CHECK(flat.lookup(ComboAddress("::2")) == nullptr);
+  BOOST_CHECK_EQUAL(flat.lookup(ComboAddress("fe80::1"))->second, 4);
+  BOOST_CHECK(!flat.match(ComboAddress("fe81::1")));
+
+  /* bulk build, the last value wins for duplicates and the prefixes are normalized */
+  std::vector<std::pair<Netmask, int>> entries;
+  entries.emplace_back(Netmask("192.0.2.1/24"), 1);
+  entries.emplace_back(Netmask("0.0.0.0/0"), 2);
+  entries.emplace_back(Netmask("192.0.2.0/24"), 3);
+  entries.emplace_back(Netmask("192.0.2.128/25"), 4);
+  FlatNetmaskTree<int> bulk(std::move(entries));
+  BOOST_CHECK_EQUAL(bulk.size(), 3U);
+  BOOST_CHECK_EQUAL(bulk.lookup(ComboAddress("192.0.2.1"))->second, 3);
+  BOOST_CHECK_EQUAL(bulk.lookup(ComboAddress("192.0.2.1"))->first.toString(), "192.0.2.0/24");
+  BOOST_CHECK_EQUAL(bulk.lookup(ComboAddress("192.0.2.129"))->second, 4);
+  BOOST_CHECK_EQUAL(bulk.lookup(ComboAddress("198.51.100.1"))->second, 2);
+  BOOST_CHECK(bulk.lookup(ComboAddress("2001:db8::1")) == nullptr);
+
+  FlatNetmaskTree<int> empty;
+  BOOST_CHECK(empty.empty());
+  BOOST_CHECK(empty.lookup(ComboAddress("192.0.2.1")) == nullptr);
+}
+
+BOOST_AUTO_TEST_CASE(test_FlatNetmaskTree_random) {
+  /* compare against NetmaskTree, with prefixes nested in each other and lookups using max_bits,
+     enough of them for the first level table to be used */
+  std::mt19937 gen(42);
+  NetmaskTree<int> nmt;
+  for (int idx = 0; idx < 10000; idx++) {
+    ComboAddress addr;
+    if (idx % 2) {
+      addr = ComboAddress("10.0.0.0");
+      addr.sin4.sin_addr.s_addr = htonl(0x0a000000 | (gen() & 0x00ffffff));
+      nmt.insert(Netmask(addr, 8 + gen() % 25)).second = idx;
+    }
+    else {
+      addr = ComboAddress("2001:db8::");
+      for (size_t pos = 4; pos < 16; pos++) {
+        addr.sin6.sin6_addr.s6_addr[pos] = gen() % 4;
+      }
+      nmt.insert(Netmask(addr, 32 + gen() % 97)).second = idx;
+    }
+  }
+
+  FlatNetmaskTree<int> flat(nmt);
+  BOOST_CHECK_EQUAL(flat.size(), nmt.size());
+  for (const auto& entry : nmt) {
+    BOOST_CHECK(flat.has_key(entry.first));
+  }
+
+  for (int idx = 0; idx < 20000; idx++) {
+    ComboAddress addr;
+    if (idx % 2) {
+      addr = ComboAddress("10.0.0.0");
+      addr.sin4.sin_addr.s_addr = htonl(0x0a000000 | (gen() & 0x00ffffff));
+    }
+    else {
+      addr = ComboAddress("2001:db8::");
+      for (size_t pos = 4; pos < 16; pos++) {
+        addr.sin6.sin6_addr.s6_addr[pos] = gen() % 4;
+      }
+    }
+    int max_bits = idx % 3 ? 128 : gen() % 129;
+    const auto* expected = nmt.lookup(addr, max_bits);
+    const auto* got = flat.lookup(addr, max_bits);
+    BOOST_REQUIRE_EQUAL(expected == nullptr, got == nullptr);
+    if (expected != nullptr) {
+      BOOST_CHECK_EQUAL(got->first.toString(), expected->first.toString());
+      BOOST_CHECK_EQUAL(got->second, expected->second);
+    }
+  }
+}
+
 BOOST_AUTO_TEST_CASE(test_ComboAddress_caContainerToString) {
   ComboAddress ca1("192.0.2.1:53");
   ComboAddress ca2("192.0.2.2:5300");
@@ -852,4 +965,43 @@ BOOST_AUTO_TEST_CASE(test_parseIPAndPort)
   }
 }
 
+BOOST_AUTO_TEST_CASE(test_sendUDPBatch)
+{
+  /* two local UDP responders, and the socket we send from */
+  std::vector<int> responders;
+  std::vector<ComboAddress> addresses;
+  for (size_t idx = 0; idx < 2; idx++) {
+    ComboAddress addr("127.0.0.1", 0);
+    int sock = SSocket(AF_INET, SOCK_DGRAM, 0);
+    SBind(sock, addr);
+    socklen_t addrLen = addr.getSocklen();
+    BOOST_REQUIRE_EQUAL(getsockname(sock, reinterpret_cast<struct sockaddr*>(&addr), &addrLen), 0);
+    responders.push_back(sock);
+    addresses.push_back(addr);
+  }
+  int sender = SSocket(AF_INET, SOCK_DGRAM, 0);
+
+  std::vector<std::pair<ComboAddress, std::vector<uint8_t>>> packets;
+  for (uint8_t idx = 0; idx < 5; idx++) {
+    packets.emplace_back(addresses.at(idx % 2), std::vector<uint8_t>(idx + 1, idx));
+  }
+  BOOST_CHECK_EQUAL(sendUDPBatch(sender, packets), packets.size());
+
+  /* every responder got its own packets, in order */
+  for (uint8_t idx = 0; idx < 5; idx++) {
+    char buffer[16];
+    BOOST_REQUIRE_EQUAL(waitForData(responders.at(idx % 2), 1), 1);
+    ssize_t got = recv(responders.at(idx % 2), buffer, sizeof(buffer), 0);
+    BOOST_REQUIRE_EQUAL(got, idx + 1);
+    BOOST_CHECK_EQUAL(buffer[0], static_cast<char>(idx));
+  }
+
+  BOOST_CHECK_EQUAL(sendUDPBatch(sender, {}), 0U);
+
+  for (const auto& sock : responders) {
+    close(sock);
+  }
+  close(sender);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -12,11 +12,12 @@
 #include <thread>
 #include "misc.hh"
 #include "dns.hh"
+#include "pdnsexception.hh"
 #include "statbag.hh"
 
 using std::string;
 
-static void threadMangler(AtomicCounter* ac)
+static void threadMangler(StatCounter* ac)
 {
   for(unsigned int n=0; n < 1000000; ++n)
     (*ac)++;
@@ -46,13 +47,13 @@ BOOST_AUTO_TEST_CASE(test_StatBagBasic) {
 
   BOOST_CHECK_EQUAL(s.read("b"), n);
 
-  AtomicCounter* ac = s.getPointer("a");
+  StatCounter* ac = s.getPointer("a");
   for(n=0; n < 1000000; ++n)
     (*ac)++;
 
   BOOST_CHECK_EQUAL(s.read("a"), n+1);
 
-  AtomicCounter* acc = s.getPointer("c");
+  StatCounter* acc = s.getPointer("c");
   std::vector<std::thread> manglers;
   for (int i=0; i < 4; ++i) {
     manglers.push_back(std::thread(threadMangler, acc));
@@ -107,6 +108,112 @@ BOOST_AUTO_TEST_CASE(test_StatBagBasic) {
 #endif
 }
 
+BOOST_AUTO_TEST_CASE(test_StatBagGauge) {
+  StatBag s;
+  s.declare("gauge", "description", StatType::gauge);
+  StatCounter* gauge = s.getPointer("gauge");
+  (*gauge)++;
+  *gauge += 10;
+  (*gauge)--;
+  *gauge -= 5;
+  BOOST_CHECK_EQUAL(s.read("gauge"), 5U);
+  BOOST_CHECK_EQUAL(s.readZero("gauge"), 5U);
+  BOOST_CHECK_EQUAL(s.read("gauge"), 0U);
+}
+
+static void ringMangler(StatBag* S, unsigned int id)
+{
+  for(unsigned int n=0; n < 1000; ++n) {
+    S->ringAccount("ring", DNSName("thread" + std::to_string(id) + ".example."), QType(QType::A));
+    S->ringAccount("remotes", ComboAddress("192.0.2." + std::to_string(id)));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_StatBagRings) {
+  StatBag s;
+  s.doRings();
+  s.declareDNSNameQTypeRing("ring", "description", 100000);
+  s.declareComboRing("remotes", "description", 100000);
+
+  std::vector<std::thread> manglers;
+  for (unsigned int i=0; i < 4; ++i) {
+    manglers.push_back(std::thread(ringMangler, &s, i));
+  }
+  for (auto& t : manglers) {
+    t.join();
+  }
+
+  BOOST_CHECK_EQUAL(s.getRingSize("ring"), 100000U);
+  BOOST_CHECK_EQUAL(s.getRingEntriesCount("ring"), 4000U);
+  BOOST_CHECK_EQUAL(s.read("ring-ring-size"), 4000U);
+  BOOST_CHECK_EQUAL(s.read("ring-ring-capacity"), 100000U);
+
+  auto ring = s.getRing("ring");
+  BOOST_REQUIRE_EQUAL(ring.size(), 4U);
+  for (const auto& entry : ring) {
+    BOOST_CHECK_EQUAL(entry.second, 1000U);
+  }
+  auto remotes = s.getRing("remotes");
+  BOOST_REQUIRE_EQUAL(remotes.size(), 4U);
+  BOOST_CHECK_EQUAL(remotes.at(0).second, 1000U);
+
+  /* the shards together only report as many entries as the ring can hold, the most recent ones of each thread */
+  s.resizeRing("ring", 160);
+  BOOST_CHECK_EQUAL(s.getRingSize("ring"), 160U);
+  BOOST_CHECK_EQUAL(s.getRingEntriesCount("ring"), 160U);
+  ring = s.getRing("ring");
+  BOOST_REQUIRE_EQUAL(ring.size(), 4U);
+  for (const auto& entry : ring) {
+    BOOST_CHECK_EQUAL(entry.second, 40U);
+  }
+
+  /* a single thread gets the whole capacity of the ring */
+  s.resetRing("ring");
+  ringMangler(&s, 5);
+  BOOST_CHECK_EQUAL(s.getRingEntriesCount("ring"), 160U);
+  ring = s.getRing("ring");
+  BOOST_REQUIRE_EQUAL(ring.size(), 1U);
+  BOOST_CHECK_EQUAL(ring.at(0).first, "thread5.example/A");
+  BOOST_CHECK_EQUAL(ring.at(0).second, 160U);
+
+  s.resetRing("ring");
+  BOOST_CHECK_EQUAL(s.getRingEntriesCount("ring"), 0U);
+  BOOST_CHECK(s.getRing("ring").empty());
+}
+
+BOOST_AUTO_TEST_CASE(test_StatBagHistogram) {
+  StatBag s;
+  BOOST_CHECK(s.getHistogram("latency") == nullptr);
+  StatHistogram* histogram = s.declareHistogram("latency", "description");
+  BOOST_REQUIRE(histogram != nullptr);
+  BOOST_CHECK(s.getHistogram("latency") == histogram);
+  BOOST_CHECK_THROW(s.declareHistogram("latency", "description"), PDNSException);
+
+  const auto& boundaries = histogram->getBoundaries();
+  BOOST_REQUIRE_EQUAL(boundaries.size(), 18U);
+  BOOST_CHECK_EQUAL(boundaries.front(), 10U);
+  BOOST_CHECK_EQUAL(boundaries.at(1), 20U);
+  BOOST_CHECK_EQUAL(boundaries.at(2), 50U);
+  BOOST_CHECK_EQUAL(boundaries.back(), 5000000U);
+
+  (*histogram)(0);
+  (*histogram)(10);
+  (*histogram)(11);
+  (*histogram)(20);
+  (*histogram)(5000000);
+  (*histogram)(5000001);
+  BOOST_CHECK_EQUAL(s.read("latency-le-10"), 2U);
+  BOOST_CHECK_EQUAL(s.read("latency-le-20"), 2U);
+  BOOST_CHECK_EQUAL(s.read("latency-le-50"), 0U);
+  BOOST_CHECK_EQUAL(s.read("latency-le-5000000"), 1U);
+  BOOST_CHECK_EQUAL(s.read("latency-le-max"), 1U);
+  BOOST_CHECK_EQUAL(s.read("latency-sum"), 10000042U);
+  BOOST_CHECK(s.getStatType("latency-le-max") == StatType::counter);
+
+  auto entries = s.getEntries();
+  BOOST_CHECK_EQUAL(entries.size(), boundaries.size() + 2);
+}
+
 
 BOOST_AUTO_TEST_SUITE_END()
 
@@ -165,4 +165,76 @@ BOOST_AUTO_TEST_CASE(test_tng_upgrade) {
   BOOST_CHECK_EQUAL(rr.content, std::string("192.0.3.4"));
 }
 
+BOOST_AUTO_TEST_CASE(test_tng_parallel) {
+  reportAllTypes();
+
+  std::ostringstream pathbuf;
+  const char* p = std::getenv("SRCDIR");
+  if(!p)
+    p = ".";
+  pathbuf << p << "/../regression-tests/zones/unit.test";
+
+  for (const size_t threads : {1, 4}) {
+    ZoneParserTNG serial(pathbuf.str(), DNSName("unit.test"));
+    ZoneParserTNG zp(pathbuf.str(), DNSName("unit.test"));
+    /* small batches so that we go through several of them */
+    ParallelZoneParser pzp(zp, threads, 7);
+    DNSResourceRecord expected, rr;
+    std::shared_ptr<DNSRecordContent> content;
+    std::string error;
+    size_t count = 0;
+
+    while (serial.get(expected)) {
+      BOOST_REQUIRE(pzp.get(rr, content, &error));
+      BOOST_CHECK_EQUAL(rr.qname, expected.qname);
+      BOOST_CHECK_EQUAL(rr.qtype.getCode(), expected.qtype.getCode());
+      BOOST_CHECK_EQUAL(rr.ttl, expected.ttl);
+      BOOST_CHECK_EQUAL(rr.content, expected.content);
+      BOOST_REQUIRE(content != nullptr);
+      BOOST_CHECK_EQUAL(content->getZoneRepresentation(), DNSRecordContent::mastermake(expected.qtype.getCode(), QClass::IN, expected.content)->getZoneRepresentation());
+      count++;
+    }
+    BOOST_CHECK(!pzp.get(rr, content, &error));
+    BOOST_CHECK_GT(count, 0U);
+  }
+
+  {
+    /* invalid content is reported for the record itself, an invalid line only after the records preceding it */
+    ZoneParserTNG zp(std::vector<std::string>({
+          "a.test. 3600 IN A 192.0.2.1",
+          "b.test. 3600 IN A not-an-address",
+          "c.test. 3600 IN A 192.0.2.3",
+          "d.test. 3600 IN NOSUCHTYPE foo",
+          "e.test. 3600 IN A 192.0.2.5"}), DNSName("test"));
+    ParallelZoneParser pzp(zp, 2, 2);
+    DNSResourceRecord rr;
+    std::shared_ptr<DNSRecordContent> content;
+    std::string error;
+
+    BOOST_REQUIRE(pzp.get(rr, content, &error));
+    BOOST_CHECK_EQUAL(rr.qname, DNSName("a.test."));
+    BOOST_CHECK(content != nullptr);
+
+    BOOST_REQUIRE(pzp.get(rr, content, &error));
+    BOOST_CHECK_EQUAL(rr.qname, DNSName("b.test."));
+    BOOST_CHECK(content == nullptr);
+    BOOST_CHECK(!error.empty());
+
+    BOOST_REQUIRE(pzp.get(rr, content, &error));
+    BOOST_CHECK_EQUAL(rr.qname, DNSName("c.test."));
+    BOOST_CHECK(content != nullptr);
+
+    BOOST_CHECK_THROW(pzp.get(rr, content, &error), std::exception);
+  }
+
+  {
+    /* without a place to store the error, invalid content is thrown */
+    ZoneParserTNG zp(std::vector<std::string>({"b.test. 3600 IN A not-an-address"}), DNSName("test"));
+    ParallelZoneParser pzp(zp, 1);
+    DNSResourceRecord rr;
+    std::shared_ptr<DNSRecordContent> content;
+    BOOST_CHECK_THROW(pzp.get(rr, content), PDNSException);
+  }
+}
+
 BOOST_AUTO_TEST_SUITE_END();
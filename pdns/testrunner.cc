@@ -5,7 +5,9 @@
 #endif
 #include <boost/test/unit_test.hpp>
 #include "arguments.hh"
+#include "auth-denialcache.hh"
 #include "auth-packetcache.hh"
+#include "auth-nsec3cache.hh"
 #include "auth-querycache.hh"
 #include "auth-zonecache.hh"
 #include "statbag.hh"
@@ -13,6 +15,8 @@ StatBag S;
 AuthPacketCache PC;
 AuthQueryCache QC;
 AuthZoneCache g_zoneCache;
+AuthNSEC3Cache g_nsec3Cache;
+AuthDenialCache g_denialCache;
 
 ArgvMap &arg()
 {
@@ -58,7 +58,7 @@ bool UeberBackend::d_go=false;
 bool UeberBackend::s_doANYLookupsOnly=false;
 std::mutex UeberBackend::d_mut;
 std::condition_variable UeberBackend::d_cond;
-AtomicCounter* UeberBackend::s_backendQueries = nullptr;
+StatCounter* UeberBackend::s_backendQueries = nullptr;
 
 //! Loads a module and reports it to all UeberBackend threads
 bool UeberBackend::loadmodule(const string &name)
@@ -532,6 +532,22 @@ UeberBackend::UeberBackend(const string &pname)
   d_stale = false;
 
   backends=BackendMakers().all(pname=="key-only");
+
+  auto names = BackendMakers().getInstanceNames();
+  if (names.size() == backends.size()) {
+    for (const auto& name : names) {
+      auto histogram = S.getHistogram("latency-backend-" + name);
+      if (histogram == nullptr) {
+        d_backendLatency.clear();
+        break;
+      }
+      d_backendLatency.push_back(histogram);
+    }
+  }
+  if (!d_backendLatency.empty()) {
+    d_backendNames = std::move(names);
+    d_slowQueryThreshold = ::arg().asNum("slow-backend-query-threshold") * 1000;
+  }
 }
 
 static void del(DNSBackend* d)
@@ -626,6 +642,8 @@ void UeberBackend::lookup(const QType &qtype,const DNSName &qname, int zoneId, D
 
   d_qtype=qtype.getCode();
 
+  d_handle.parent=this;
+  d_handle.reportLatency(); // the previous question might not have been read until the end
   d_handle.i=0;
   d_handle.qtype=s_doANYLookupsOnly ? QType::ANY : qtype;
   d_handle.qname=qname;
@@ -647,7 +665,8 @@ void UeberBackend::lookup(const QType &qtype,const DNSName &qname, int zoneId, D
       //      cout<<"UeberBackend::lookup("<<qname<<"|"<<DNSRecordContent::NumberToType(qtype.getCode())<<"): uncached"<<endl;
       d_negcached=d_cached=false;
       d_answers.clear(); 
-      (d_handle.d_hinterBackend=backends[d_handle.i++])->lookup(d_handle.qtype, d_handle.qname, d_handle.zoneId, d_handle.pkt_p);
+      d_handle.d_hinterBackend=backends[d_handle.i++];
+      d_handle.lookupInBackend();
       ++(*s_backendQueries);
     } 
     else if(cstat==0) {
@@ -663,8 +682,6 @@ void UeberBackend::lookup(const QType &qtype,const DNSName &qname, int zoneId, D
       d_cachehandleiter = d_answers.begin();
     }
   }
-
-  d_handle.parent=this;
 }
 
 void UeberBackend::getAllDomains(vector<DomainInfo> *domains, bool include_disabled) {
@@ -750,13 +767,14 @@ bool UeberBackend::handle::get(DNSZoneRecord &r)
 {
   DLOG(g_log << "Ueber get() was called for a "<<qtype<<" record" << endl);
   bool isMore=false;
-  while(d_hinterBackend && !(isMore=d_hinterBackend->get(r))) { // this backend out of answers
+  while(d_hinterBackend && !(isMore=getFromBackend(r))) { // this backend out of answers
+    reportLatency();
     if(i<parent->backends.size()) {
       DLOG(g_log<<"Backend #"<<i<<" of "<<parent->backends.size()
            <<" out of answers, taking next"<<endl);
       
       d_hinterBackend=parent->backends[i++];
-      d_hinterBackend->lookup(qtype,qname,zoneId,pkt_p);
+      lookupInBackend();
       ++(*s_backendQueries);
     }
     else 
@@ -774,3 +792,43 @@ bool UeberBackend::handle::get(DNSZoneRecord &r)
   i=parent->backends.size(); // don't go on to the next backend
   return true;
 }
+
+void UeberBackend::handle::lookupInBackend()
+{
+  if(parent->d_backendLatency.empty()) {
+    d_hinterBackend->lookup(qtype,qname,zoneId,pkt_p);
+    return;
+  }
+
+  DTime dt;
+  dt.set();
+  d_hinterBackend->lookup(qtype,qname,zoneId,pkt_p);
+  d_usec=dt.udiffNoReset();
+  d_timedBackend=i-1;
+  d_timed=true;
+}
+
+bool UeberBackend::handle::getFromBackend(DNSZoneRecord &r)
+{
+  if(!d_timed)
+    return d_hinterBackend->get(r);
+
+  DTime dt;
+  dt.set();
+  bool ret=d_hinterBackend->get(r);
+  d_usec+=dt.udiffNoReset();
+  return ret;
+}
+
+//! Accounts the time the timed backend spent on the current question, once it has no more answers or the question is abandoned
+void UeberBackend::handle::reportLatency()
+{
+  if(!d_timed)
+    return;
+  d_timed=false;
+
+  (*parent->d_backendLatency.at(d_timedBackend))(d_usec);
+  if(parent->d_slowQueryThreshold && d_usec >= parent->d_slowQueryThreshold) {
+    S.ringAccount("slow-backend-queries", qname.toLogString()+"/"+qtype.toString()+" ("+parent->d_backendNames.at(d_timedBackend)+")");
+  }
+}
@@ -31,6 +31,7 @@
 
 #include "dnspacket.hh"
 #include "dnsbackend.hh"
+#include "statbag.hh"
 #include "namespaces.hh"
 
 /** This is a very magic backend that allows us to load modules dynamically,
@@ -89,7 +90,16 @@ public:
     QType qtype;
     int zoneId;
 
+    void lookupInBackend();
+    void reportLatency();
+
   private:
+    bool getFromBackend(DNSZoneRecord &r);
+
+    //! Microseconds spent in lookup() and get() of the backend at d_timedBackend, only counted when latency histograms are enabled
+    uint64_t d_usec{0};
+    unsigned int d_timedBackend{0};
+    bool d_timed{false};
 
     static AtomicCounter instances;
   };
@@ -150,12 +160,17 @@ private:
     QType qtype;
   }d_question;
 
+  //! One latency histogram per entry in backends, empty when latency histograms are disabled
+  vector<StatHistogram*> d_backendLatency;
+  vector<string> d_backendNames;
+  uint64_t d_slowQueryThreshold{0};
+
   unsigned int d_cache_ttl, d_negcache_ttl;
   uint16_t d_qtype;
 
   bool d_negcached;
   bool d_cached;
-  static AtomicCounter* s_backendQueries;
+  static StatCounter* s_backendQueries;
   static bool d_go;
   bool d_stale;
   static bool s_doANYLookupsOnly;
@@ -5,9 +5,12 @@
 #include "rec-lua-conf.hh"
 #include "base32.hh"
 #include "logger.hh"
+#include <openssl/sha.h>
+
 bool g_dnssecLOG{false};
 time_t g_signatureInceptionSkew{0};
 uint16_t g_maxNSEC3Iterations{0};
+std::unique_ptr<SignatureVerificationCache> g_signatureCache{nullptr};
 
 #define LOG(x) if(g_dnssecLOG) { g_log <<Logger::Warning << x; }
 
@@ -909,6 +912,75 @@ bool isRRSIGIncepted(const time_t now, const shared_ptr<RRSIGRecordContent>& sig
   return sig->d_siginception - g_signatureInceptionSkew <= now;
 }
 
+SignatureVerificationCache::SignatureVerificationCache(size_t maxEntries, size_t shardsCount): d_shards(shardsCount)
+{
+  if (shardsCount == 0) {
+    throw std::runtime_error("The number of shards of the signature verification cache should be greater than 0");
+  }
+  const size_t perShard = std::max(maxEntries / shardsCount, static_cast<size_t>(1));
+  for (auto& shard : d_shards) {
+    shard.lock()->resize(perShard);
+  }
+}
+
+SignatureVerificationCache::digest_t SignatureVerificationCache::getDigest(uint8_t algorithm, const std::string& publicKey, const std::string& signature, const std::string& msg)
+{
+  /* the lengths make sure that moving bytes from one field to the next can't produce a collision */
+  uint16_t keyLen = htons(publicKey.size());
+  uint16_t sigLen = htons(signature.size());
+
+  static thread_local std::string input;
+  input.clear();
+  input.reserve(1 + 2 + publicKey.size() + 2 + signature.size() + msg.size());
+  input.append(1, static_cast<char>(algorithm));
+  input.append(reinterpret_cast<const char*>(&keyLen), sizeof(keyLen));
+  input.append(publicKey);
+  input.append(reinterpret_cast<const char*>(&sigLen), sizeof(sigLen));
+  input.append(signature);
+  input.append(msg);
+
+  digest_t digest;
+  SHA256(reinterpret_cast<const unsigned char*>(input.data()), input.size(), digest.data());
+  return digest;
+}
+
+LockGuarded<std::vector<SignatureVerificationCache::Entry>>& SignatureVerificationCache::getShard(const digest_t& digest)
+{
+  uint32_t hash;
+  memcpy(&hash, digest.data(), sizeof(hash));
+  return d_shards.at(hash % d_shards.size());
+}
+
+SignatureVerificationCache::Entry& SignatureVerificationCache::getEntry(std::vector<Entry>& entries, const digest_t& digest) const
+{
+  /* use different bits than the ones used to pick the shard */
+  uint32_t hash;
+  memcpy(&hash, digest.data() + sizeof(hash), sizeof(hash));
+  return entries.at(hash % entries.size());
+}
+
+bool SignatureVerificationCache::get(const digest_t& digest, bool& valid)
+{
+  auto entries = getShard(digest).lock();
+  const auto& entry = getEntry(*entries, digest);
+  if (entry.d_used && entry.d_digest == digest) {
+    valid = entry.d_valid;
+    ++d_hits;
+    return true;
+  }
+  ++d_misses;
+  return false;
+}
+
+void SignatureVerificationCache::insert(const digest_t& digest, bool valid)
+{
+  auto entries = getShard(digest).lock();
+  auto& entry = getEntry(*entries, digest);
+  entry.d_digest = digest;
+  entry.d_used = true;
+  entry.d_valid = valid;
+}
+
 static bool checkSignatureWithKey(time_t now, const shared_ptr<RRSIGRecordContent> sig, const shared_ptr<DNSKEYRecordContent> key, const std::string& msg)
 {
   bool result = false;
@@ -918,8 +990,19 @@ static bool checkSignatureWithKey(time_t now, const shared_ptr<RRSIGRecordConten
        - The validator's notion of the current time MUST be greater than or equal to the time listed in the RRSIG RR's Inception field.
     */
     if (isRRSIGIncepted(now, sig) && isRRSIGNotExpired(now, sig)) {
-      auto dke = DNSCryptoKeyEngine::makeFromPublicKeyString(key->d_algorithm, key->d_key);
-      result = dke->verify(msg, sig->d_signature);
+      SignatureVerificationCache::digest_t digest;
+      bool cached = false;
+      if (g_signatureCache) {
+        digest = SignatureVerificationCache::getDigest(key->d_algorithm, key->d_key, sig->d_signature, msg);
+        cached = g_signatureCache->get(digest, result);
+      }
+      if (!cached) {
+        auto dke = DNSCryptoKeyEngine::makeFromPublicKeyString(key->d_algorithm, key->d_key);
+        result = dke->verify(msg, sig->d_signature);
+        if (g_signatureCache) {
+          g_signatureCache->insert(digest, result);
+        }
+      }
       LOG("signature by key with tag "<<sig->d_tag<<" and algorithm "<<DNSSECKeeper::algorithm2name(sig->d_algorithm)<<" was " << (result ? "" : "NOT ")<<"valid"<<endl);
     }
     else {
@@ -23,10 +23,13 @@
 
 #include "dnsparser.hh"
 #include "dnsname.hh"
+#include <array>
+#include <atomic>
 #include <vector>
 #include "namespaces.hh"
 #include "dnsrecords.hh"
 #include "dnssecinfra.hh"
+#include "lock.hh"
  
 extern bool g_dnssecLOG;
 extern time_t g_signatureInceptionSkew;
@@ -72,6 +75,51 @@ struct sharedDNSKeyRecordContentCompare
 
 typedef set<shared_ptr<DNSKEYRecordContent>, sharedDNSKeyRecordContentCompare > skeyset_t;
 
+/* Process-wide cache of signature verification outcomes, so that an RRSIG seen by
+   several threads (or by the same thread over and over, for example while a DNSKEY
+   RRset is being re-validated) only goes through the public key operation once.
+   Entries are keyed on a SHA-256 digest of the algorithm, the public key, the
+   signature and the signed data, so a hit can never validate different data.
+   Time-related checks (inception and expiration) are not cached. */
+class SignatureVerificationCache
+{
+public:
+  typedef std::array<uint8_t, 32> digest_t;
+
+  SignatureVerificationCache(size_t maxEntries, size_t shardsCount = 64);
+
+  static digest_t getDigest(uint8_t algorithm, const std::string& publicKey, const std::string& signature, const std::string& msg);
+  bool get(const digest_t& digest, bool& valid);
+  void insert(const digest_t& digest, bool valid);
+
+  uint64_t getHits() const
+  {
+    return d_hits;
+  }
+  uint64_t getMisses() const
+  {
+    return d_misses;
+  }
+
+private:
+  struct Entry
+  {
+    digest_t d_digest;
+    bool d_used{false};
+    bool d_valid{false};
+  };
+
+  Entry& getEntry(std::vector<Entry>& entries, const digest_t& digest) const;
+  LockGuarded<std::vector<Entry>>& getShard(const digest_t& digest);
+
+  /* direct-mapped, a newer entry simply replaces the older one in its slot */
+  std::vector<LockGuarded<std::vector<Entry>>> d_shards;
+  std::atomic<uint64_t> d_hits{0};
+  std::atomic<uint64_t> d_misses{0};
+};
+
+extern std::unique_ptr<SignatureVerificationCache> g_signatureCache;
+
 
 vState validateWithKeySet(time_t now, const DNSName& name, const sortedRecords_t& records, const vector<shared_ptr<RRSIGRecordContent> >& signatures, const skeyset_t& keys, bool validateAllSigs=true);
 bool isCoveredByNSEC(const DNSName& name, const DNSName& begin, const DNSName& next);
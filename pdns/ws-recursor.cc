@@ -581,6 +581,15 @@ const std::map<std::string, MetricDefinition> MetricDefinitionStorage::d_metrics
   {"cache-misses",
    MetricDefinition(PrometheusMetricType::counter,
                     "Number of cache misses since starting")},
+  {"cache-prefetch-hits",
+   MetricDefinition(PrometheusMetricType::counter,
+                    "Number of cache hits that would have been misses without a prefetch")},
+  {"cache-prefetches",
+   MetricDefinition(PrometheusMetricType::counter,
+                    "Number of refreshes of popular records queued by the prefetch engine")},
+  {"cache-served-stale",
+   MetricDefinition(PrometheusMetricType::counter,
+                    "Number of times an expired record was served from the cache")},
   {"case-mismatches",
    MetricDefinition(PrometheusMetricType::counter,
                     "Number of mismatches in character case since starting")},
@@ -642,6 +651,12 @@ const std::map<std::string, MetricDefinition> MetricDefinitionStorage::d_metrics
   {"dnssec-validations",
    MetricDefinition(PrometheusMetricType::counter,
                     "Number of DNSSEC validations performed")},
+  {"signature-cache-hits",
+   MetricDefinition(PrometheusMetricType::counter,
+                    "Number of DNSSEC signature verifications answered from the signature cache")},
+  {"signature-cache-misses",
+   MetricDefinition(PrometheusMetricType::counter,
+                    "Number of DNSSEC signature verifications not found in the signature cache")},
   {"dont-outqueries",
    MetricDefinition(PrometheusMetricType::counter,
                     "Number of outgoing queries dropped because of `setting-dont-query` setting")},
@@ -684,6 +699,15 @@ const std::map<std::string, MetricDefinition> MetricDefinitionStorage::d_metrics
   {"max-mthread-stack",
    MetricDefinition(PrometheusMetricType::gauge,
                     "Maximum amount of thread stack ever used")},
+  {"max-mthread-stack-high-water",
+   MetricDefinition(PrometheusMetricType::gauge,
+                    "Largest part of a thread stack ever touched, rounded up to a page")},
+  {"mthread-stack-pool-hits",
+   MetricDefinition(PrometheusMetricType::counter,
+                    "Number of mthreads started on a reused stack")},
+  {"mthread-stack-pool-misses",
+   MetricDefinition(PrometheusMetricType::counter,
+                    "Number of mthreads for which a new stack had to be allocated")},
 
   {"negcache-entries",
    MetricDefinition(PrometheusMetricType::gauge,
@@ -1060,6 +1084,30 @@ const std::map<std::string, MetricDefinition> MetricDefinitionStorage::d_metrics
     MetricDefinition(PrometheusMetricType::counter,
                      "Number of answers synthesized from the NSEC3 aggressive cache")},
 
+  { "tcp-out-idle-connections",
+    MetricDefinition(PrometheusMetricType::gauge,
+                     "Number of idle outgoing TCP/DoT connections kept open for reuse")},
+
+  { "tcp-out-new-connections",
+    MetricDefinition(PrometheusMetricType::counter,
+                     "Number of outgoing TCP/DoT queries for which a new connection was opened")},
+
+  { "tcp-out-reused-connections",
+    MetricDefinition(PrometheusMetricType::counter,
+                     "Number of outgoing TCP/DoT queries sent over an already open connection")},
+
+  { "udp-pool-port-entropy",
+    MetricDefinition(PrometheusMetricType::gauge,
+                     "Number of bits of the source port to guess to spoof an answer to an outgoing UDP query")},
+
+  { "udp-pool-reuses",
+    MetricDefinition(PrometheusMetricType::counter,
+                     "Number of outgoing UDP queries sent over an already open pooled socket")},
+
+  { "udp-pool-sockets",
+    MetricDefinition(PrometheusMetricType::gauge,
+                     "Number of outgoing UDP sockets currently kept open in the pools")},
+
   // For cumulative histogram, state the xxx_count name where xxx matches the name in rec_channel_rec
   { "cumul-answers-count",
     MetricDefinition(PrometheusMetricType::histogram,
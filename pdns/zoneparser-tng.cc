@@ -36,6 +36,8 @@
 #include <boost/algorithm/string.hpp>
 #include <system_error>
 #include <cinttypes>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 static string g_INstr("IN");
 
@@ -64,14 +66,35 @@ void ZoneParserTNG::stackFile(const std::string& fname)
   }
 
   filestate fs(fp, fname);
+
+  struct stat st;
+  if (fstat(fileno(fp), &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+    void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fileno(fp), 0);
+    if (data != MAP_FAILED) {
+      madvise(data, st.st_size, MADV_SEQUENTIAL);
+      fs.d_data = static_cast<const char*>(data);
+      fs.d_size = st.st_size;
+    }
+    /* otherwise we just read the file the usual way */
+  }
+
   d_filestates.push(fs);
   d_fromfile = true;
 }
 
+void ZoneParserTNG::filestate::close()
+{
+  if (d_data != nullptr) {
+    munmap(const_cast<char*>(d_data), d_size);
+    d_data = nullptr;
+  }
+  fclose(d_fp);
+}
+
 ZoneParserTNG::~ZoneParserTNG()
 {
   while(!d_filestates.empty()) {
-    fclose(d_filestates.top().d_fp);
+    d_filestates.top().close();
     d_filestates.pop();
   }
 }
@@ -573,12 +596,119 @@ bool ZoneParserTNG::getLine()
     return false;
   }
   while(!d_filestates.empty()) {
-    if(stringfgets(d_filestates.top().d_fp, d_line)) {
-      d_filestates.top().d_lineno++;
+    auto& fs = d_filestates.top();
+    if (fs.d_data != nullptr) {
+      if (fs.d_pos < fs.d_size) {
+        const char* start = fs.d_data + fs.d_pos;
+        size_t left = fs.d_size - fs.d_pos;
+        const char* newline = static_cast<const char*>(memchr(start, '\n', left));
+        size_t len = newline != nullptr ? (newline - start + 1) : left;
+        d_line.assign(start, len);
+        fs.d_pos += len;
+        fs.d_lineno++;
+        return true;
+      }
+    }
+    else if(stringfgets(fs.d_fp, d_line)) {
+      fs.d_lineno++;
       return true;
     }
-    fclose(d_filestates.top().d_fp);
+    fs.close();
     d_filestates.pop();
   }
   return false;
 }
+
+ParallelZoneParser::ParallelZoneParser(ZoneParserTNG& zpt, size_t threads, size_t batchSize): d_zpt(zpt), d_threads(std::max(threads, static_cast<size_t>(1))), d_batchSize(std::max(batchSize, static_cast<size_t>(1)))
+{
+  fill(d_next);
+}
+
+void ParallelZoneParser::makeContents(std::vector<Entry>& entries, size_t begin, size_t end)
+{
+  for (size_t idx = begin; idx < end; idx++) {
+    auto& entry = entries.at(idx);
+    try {
+      entry.d_content = DNSRecordContent::mastermake(entry.d_rr.qtype.getCode(), QClass::IN, entry.d_rr.content);
+    }
+    catch (const PDNSException& pe) {
+      entry.d_error = pe.reason;
+    }
+    catch (const std::exception& e) {
+      entry.d_error = e.what();
+    }
+  }
+}
+
+void ParallelZoneParser::fill(Batch& batch)
+{
+  batch.d_entries.clear();
+  batch.d_workers.clear();
+  batch.d_parseError = nullptr;
+
+  if (d_exhausted) {
+    return;
+  }
+
+  try {
+    while (batch.d_entries.size() < d_batchSize) {
+      Entry entry;
+      if (!d_zpt.get(entry.d_rr)) {
+        d_exhausted = true;
+        break;
+      }
+      batch.d_entries.push_back(std::move(entry));
+    }
+  }
+  catch (...) {
+    /* raised once the records we already have are consumed */
+    batch.d_parseError = std::current_exception();
+    d_exhausted = true;
+  }
+
+  if (d_threads == 1) {
+    makeContents(batch.d_entries, 0, batch.d_entries.size());
+    return;
+  }
+
+  size_t perThread = (batch.d_entries.size() + d_threads - 1) / d_threads;
+  for (size_t begin = 0; begin < batch.d_entries.size(); begin += perThread) {
+    size_t end = std::min(begin + perThread, batch.d_entries.size());
+    batch.d_workers.push_back(std::async(std::launch::async, makeContents, std::ref(batch.d_entries), begin, end));
+  }
+}
+
+bool ParallelZoneParser::get(DNSResourceRecord& rr, std::shared_ptr<DNSRecordContent>& content, std::string* contentError)
+{
+  while (d_pos >= d_current.d_entries.size()) {
+    if (d_current.d_parseError) {
+      auto error = d_current.d_parseError;
+      d_current.d_parseError = nullptr;
+      std::rethrow_exception(error);
+    }
+
+    if (d_next.d_entries.empty() && !d_next.d_parseError) {
+      return false;
+    }
+
+    for (auto& worker : d_next.d_workers) {
+      worker.get();
+    }
+    std::swap(d_current, d_next);
+    d_pos = 0;
+    /* read the next batch while the caller is busy with this one */
+    fill(d_next);
+  }
+
+  auto& entry = d_current.d_entries.at(d_pos++);
+  rr = std::move(entry.d_rr);
+  content = std::move(entry.d_content);
+  if (!content) {
+    if (contentError == nullptr) {
+      throw PDNSException(entry.d_error);
+    }
+    *contentError = std::move(entry.d_error);
+  }
+
+  return true;
+}
@@ -25,6 +25,10 @@
 #include <stdexcept>
 #include <stack>
 #include <deque>
+#include <exception>
+#include <future>
+#include <memory>
+#include <vector>
 
 #include "namespaces.hh"
 
@@ -57,7 +61,12 @@ private:
 
   struct filestate {
     filestate(FILE* fp, string filename) : d_fp(fp), d_filename(filename), d_lineno(0){}
+    void close();
     FILE *d_fp;
+    /* regular files are mapped into memory, so that lines can be split without copying them around first */
+    const char* d_data{nullptr};
+    size_t d_size{0};
+    size_t d_pos{0};
     string d_filename;
     int d_lineno;
   };
@@ -80,3 +89,48 @@ private:
   bool d_generateEnabled{true};
   bool d_upgradeContent;
 };
+
+class DNSRecordContent;
+
+/* Wraps a ZoneParserTNG to also turn the content of the records into DNSRecordContent objects,
+   which is by far the most expensive part of loading a zone. The zone file itself is read in batches
+   by the calling thread, while the content of the previous batch is parsed by up to 'threads' threads.
+   Records are returned in the order of the zone file, and an error in the zone file is only raised
+   once all the records preceding it have been returned. */
+class ParallelZoneParser
+{
+public:
+  ParallelZoneParser(ZoneParserTNG& zpt, size_t threads, size_t batchSize=4096);
+  ParallelZoneParser(const ParallelZoneParser&) = delete;
+  ParallelZoneParser& operator=(const ParallelZoneParser&) = delete;
+
+  /* If the content of a record could not be parsed, content is set to nullptr and the error is stored into contentError,
+     or thrown as a PDNSException if contentError is not set */
+  bool get(DNSResourceRecord& rr, std::shared_ptr<DNSRecordContent>& content, std::string* contentError=nullptr);
+
+private:
+  struct Entry
+  {
+    DNSResourceRecord d_rr;
+    std::shared_ptr<DNSRecordContent> d_content;
+    std::string d_error;
+  };
+
+  struct Batch
+  {
+    std::vector<Entry> d_entries;
+    std::vector<std::future<void>> d_workers;
+    std::exception_ptr d_parseError{nullptr};
+  };
+
+  void fill(Batch& batch);
+  static void makeContents(std::vector<Entry>& entries, size_t begin, size_t end);
+
+  ZoneParserTNG& d_zpt;
+  Batch d_current;
+  Batch d_next;
+  size_t d_pos{0};
+  size_t d_threads;
+  size_t d_batchSize;
+  bool d_exhausted{false};
+};